@@ -0,0 +1,35 @@
+/*
+ * Dreamreel host benchmark support
+ *
+ * These benchmarks build with the host compiler (see bench/Makefile) so
+ * that the portable C paths can be timed off-console.
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <time.h>
+
+/* read a free-running cycle counter if the host has one, otherwise fall
+ * back to nanoseconds */
+static inline uint64_t bench_cycles(void) {
+
+#if defined(__i386__) || defined(__x86_64__)
+  uint32_t lo, hi;
+  __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t)hi << 32) | lo;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+#if defined(__i386__) || defined(__x86_64__)
+#define BENCH_UNIT "cycles"
+#else
+#define BENCH_UNIT "ns"
+#endif
+
+#endif
@@ -0,0 +1,209 @@
+/*
+ * Dreamreel bitstream benchmark
+ *
+ * Reads the same random buffer through each of the bitstream readers in
+ * common.h: fields of random widths with get_bits(), single bits from a
+ * reader held in locals, as Huffman tree walks do, and table driven
+ * variable length codes with get_vlc2(). Each reader is checked against
+ * a plain C reference of its bit order, then timed.
+ *
+ *   ./bitstream_bench [kbytes]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "avcodec.h"
+#include "common.h"
+#include "bitstream_bench.h"
+
+#define MAX_FIELD_BITS 16   ///< what the libmpeg2 reader can show at once
+#define VLC_BITS       9
+#define MIN_TIME_NS    50000000
+
+READER_FUNCS(alt)
+READER_FUNCS(a32)
+READER_FUNCS(libmpeg2)
+READER_FUNCS(cached)
+READER_FUNCS(cached32)
+READER_FUNCS(cached_le)
+READER_FUNCS(cached32_le)
+
+typedef struct {
+  const char *name;
+  int         le;
+  uint32_t  (*read_fields)(const uint8_t *buf, int size,
+                           const uint8_t *widths, int count);
+  uint32_t  (*read_bits1)(const uint8_t *buf, int size, int count);
+  uint32_t  (*read_vlc)(const uint8_t *buf, int size, VLC *vlc,
+                        int count, int *bits);
+} reader_t;
+
+#define READER(reader, le) \
+  { #reader, le, read_fields_ ## reader, read_bits1_ ## reader, read_vlc_ ## reader }
+
+static const reader_t readers[] = {
+  READER(alt, 0),
+  READER(a32, 0),
+  READER(libmpeg2, 0),
+  READER(cached, 0),
+  READER(cached32, 0),
+  READER(cached_le, 1),
+  READER(cached32_le, 1),
+};
+#define NUM_READERS (sizeof(readers) / sizeof(readers[0]))
+
+static unsigned int seed = 1;
+
+static int rnd(void) {
+
+  seed = seed * 1103515245 + 12345;
+  return (seed >> 16) & 0x7fff;
+}
+
+static uint64_t time_ns(void) {
+
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* the bit at position pos, most or least significant bit of each byte
+ * first */
+static int ref_bit(const uint8_t *buf, int pos, int le) {
+
+  return (buf[pos >> 3] >> (le ? pos & 7 : 7 - (pos & 7))) & 1;
+}
+
+static uint32_t ref_fields(const uint8_t *buf, const uint8_t *widths,
+                           int count, int le) {
+
+  uint32_t sum = 0, v;
+  int i, j, pos = 0;
+
+  for (i = 0; i < count; i++) {
+    for (v = 0, j = 0; j < widths[i]; j++, pos++)
+      v = le ? v | ref_bit(buf, pos, 1) << j : v << 1 | ref_bit(buf, pos, 0);
+    sum = MIX(sum, v);
+  }
+  return sum;
+}
+
+static uint32_t ref_bits1(const uint8_t *buf, int count, int le) {
+
+  uint32_t sum = 0;
+  int i;
+
+  for (i = 0; i < count; i++)
+    sum = MIX(sum, ref_bit(buf, i, le));
+  return sum;
+}
+
+/* a complete prefix code of 504 symbols, 4 to 13 bits long; random input
+ * averages a little over 6 bits a code */
+static void make_vlc(VLC *vlc) {
+
+  static uint8_t bits[504];
+  static uint16_t codes[504];
+  static const int lengths[6] = { 4, 6, 8, 10, 12, 13 };
+  int i, n, l, code = 0, len = 0;
+
+  for (n = 0, l = 0; l < 6; l++) {
+    for (i = 0; i < 8 << l; i++, n++) {
+      code <<= lengths[l] - len;
+      len = lengths[l];
+      bits[n] = len;
+      codes[n] = code++;
+    }
+  }
+  init_vlc(vlc, VLC_BITS, n, bits, 1, 1, codes, 2, 2);
+}
+
+/* megabits per second of a reader, over as many runs as take
+ * MIN_TIME_NS */
+#define MBITS(call, bits) ({\
+  uint64_t start_ = time_ns(), elapsed_;\
+  int runs_ = 0;\
+  do {\
+    call;\
+    runs_++;\
+    elapsed_ = time_ns() - start_;\
+  } while (elapsed_ < MIN_TIME_NS);\
+  (double)(bits) * runs_ * 1000.0 / elapsed_;\
+})
+
+int main(int argc, char *argv[]) {
+
+  const reader_t *r;
+  VLC vlc;
+  uint8_t *buf, *widths;
+  uint32_t sum, expected;
+  uint32_t vlc_sum[2] = { 0, 0 };
+  int vlc_bits[2] = { -1, -1 }, bits;
+  int size = 256 * 1024, fields, field_bits, vlc_count;
+  int i, errors = 0;
+
+  if (argc > 1)
+    size = atoi(argv[1]) * 1024;
+
+  /* aligned and padded for the a32 and libmpeg2 readers */
+  buf = av_mallocz(size + FF_INPUT_BUFFER_PADDING_SIZE);
+  for (i = 0; i < size; i++)
+    buf[i] = rnd();
+
+  widths = av_malloc(size * 8);
+  for (fields = 0, field_bits = 0; field_bits + MAX_FIELD_BITS <= size * 8; fields++) {
+    widths[fields] = 1 + rnd() % MAX_FIELD_BITS;
+    field_bits += widths[fields];
+  }
+  /* codes are at most 13 bits */
+  vlc_count = (size * 8 - 13) / 13;
+  make_vlc(&vlc);
+
+  printf("%-12s %10s %10s %10s   (Mbit/s, %d kbytes)\n",
+    "reader", "get_bits", "bits1", "vlc", size / 1024);
+  for (i = 0; i < NUM_READERS; i++) {
+    r = &readers[i];
+
+    expected = ref_fields(buf, widths, fields, r->le);
+    if ((sum = r->read_fields(buf, size, widths, fields)) != expected) {
+      printf("%s: get_bits gives %08X, expected %08X\n", r->name, sum, expected);
+      errors++;
+    }
+    expected = ref_bits1(buf, size * 8, r->le);
+    if ((sum = r->read_bits1(buf, size, size * 8)) != expected) {
+      printf("%s: bits1 gives %08X, expected %08X\n", r->name, sum, expected);
+      errors++;
+    }
+    /* no reference for the codes, but readers of one bit order must
+     * agree */
+    sum = r->read_vlc(buf, size, &vlc, vlc_count, &bits);
+    if (vlc_bits[r->le] < 0) {
+      vlc_sum[r->le] = sum;
+      vlc_bits[r->le] = bits;
+    } else if (sum != vlc_sum[r->le] || bits != vlc_bits[r->le]) {
+      printf("%s: vlc gives %08X after %d bits, expected %08X after %d\n",
+        r->name, sum, bits, vlc_sum[r->le], vlc_bits[r->le]);
+      errors++;
+    }
+
+    printf("%-12s %10.1f %10.1f %10.1f\n", r->name,
+      MBITS(r->read_fields(buf, size, widths, fields), field_bits),
+      MBITS(r->read_bits1(buf, size, size * 8), size * 8),
+      MBITS(r->read_vlc(buf, size, &vlc, vlc_count, &bits), bits));
+  }
+
+  free_vlc(&vlc);
+  av_free(widths);
+  av_free(buf);
+
+  if (errors) {
+    printf("%d errors\n", errors);
+    return 1;
+  }
+  printf("all readers read what they should\n");
+  return 0;
+}
@@ -0,0 +1,20 @@
+/*
+ * Dreamreel bitstream benchmark, shared between the reader copies and
+ * the driver
+ */
+
+#ifndef BITSTREAM_BENCH_H
+#define BITSTREAM_BENCH_H
+
+/* folds a value into a checksum; a rotate and an xor, so that the
+ * checksum costs less than the reads it checks */
+#define MIX(sum, v) (((sum) << 1 | (sum) >> 31) ^ (uint32_t)(v))
+
+#define READER_FUNCS(reader) \
+  uint32_t read_fields_ ## reader(const uint8_t *buf, int size,\
+                                  const uint8_t *widths, int count);\
+  uint32_t read_bits1_ ## reader(const uint8_t *buf, int size, int count);\
+  uint32_t read_vlc_ ## reader(const uint8_t *buf, int size, VLC *vlc,\
+                               int count, int *bits);
+
+#endif
@@ -0,0 +1,66 @@
+/*
+ * Dreamreel bitstream benchmark, reader side
+ *
+ * libavcodec picks its bitstream reader at compile time, so this file is
+ * built once per reader, with that reader's defines and READER set to a
+ * name for it (see the Makefile); bitstream_bench.c calls the copies.
+ */
+
+#include "avcodec.h"
+#include "common.h"
+#include "bitstream_bench.h"
+
+#define NAME2(prefix, reader) prefix ## _ ## reader
+#define NAME(prefix, reader) NAME2(prefix, reader)
+
+READER_FUNCS(READER)
+
+/* get_bits() with each width in turn */
+uint32_t NAME(read_fields, READER)(const uint8_t *buf, int size,
+                                   const uint8_t *widths, int count) {
+
+  GetBitContext gb;
+  uint32_t sum = 0;
+  int i;
+
+  init_get_bits(&gb, buf, size * 8);
+  for (i = 0; i < count; i++)
+    sum = MIX(sum, get_bits(&gb, widths[i]));
+  return sum;
+}
+
+/* a bit at a time from a reader held in locals, the way a Huffman tree
+ * walk reads */
+uint32_t NAME(read_bits1, READER)(const uint8_t *buf, int size, int count) {
+
+  GetBitContext gb;
+  uint32_t sum = 0;
+  int i;
+
+  init_get_bits(&gb, buf, size * 8);
+  {
+    OPEN_READER(re, &gb)
+    for (i = 0; i < count; i++) {
+      UPDATE_CACHE(re, &gb)
+      sum = MIX(sum, SHOW_UBITS(re, &gb, 1));
+      SKIP_BITS(re, &gb, 1)
+    }
+    CLOSE_READER(re, &gb)
+  }
+  return sum;
+}
+
+/* table driven variable length codes */
+uint32_t NAME(read_vlc, READER)(const uint8_t *buf, int size, VLC *vlc,
+                                int count, int *bits) {
+
+  GetBitContext gb;
+  uint32_t sum = 0;
+  int i;
+
+  init_get_bits(&gb, buf, size * 8);
+  for (i = 0; i < count; i++)
+    sum = MIX(sum, get_vlc2(&gb, vlc->table, vlc->bits, 2));
+  *bits = get_bits_count(&gb);
+  return sum;
+}
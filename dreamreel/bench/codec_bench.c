@@ -0,0 +1,1820 @@
+/*
+ * Dreamreel codec benchmark
+ *
+ * Encodes a synthetic scene (a banded backdrop, a moving sprite and a
+ * patch of noise) into a stream for each codec the engine decodes, then
+ * times every avcodec_decode_video() call and reports the per-frame cost
+ * distribution:
+ *
+ *   fli-brun   320x200 FLI, every frame BRUN (byte run)
+ *   fli-lc     320x200 FLI, a BRUN frame then LC (line compressed) deltas
+ *   flc-delta  320x200 FLC, a BRUN frame then DELTA (word) deltas
+ *   flc-mix    320x200 FLC, BRUN every 25 frames, LC and DELTA between,
+ *              a palette change every 50 frames
+ *   idcin      320x240 Id CIN, Huffman coded against a 256-context table
+ *   cyuv       320x240 Creative YUV
+ *   y4m        320x240 YUV4MPEG2; there is no decoder, so this times the
+ *              img_convert() to RGB565 that a raw YUV frame needs instead
+ *   mpeg1-i    352x240 MPEG1, all I pictures
+ *   mpeg1-ipb  352x240 MPEG1, IBBPBBPBBPBB GOPs
+ *   mpeg1-skip the same, decoded as though running late so that the
+ *              B pictures are dropped
+ *   rpza       320x240 Apple Video, decoded in raster order and then
+ *              twiddled into a texture with twiddle_16bpp()
+ *   rpza-tw    the same, decoded straight into the twiddled texture
+ *   msvc       320x240 Microsoft Video-1, decoded in raster order and
+ *              then twiddled
+ *   msvc-tw    the same, decoded straight into the twiddled texture
+ *
+ * The palettized codecs and RPZA are lossless, so their output is checked
+ * against the scene. The MPEG1 streams come from an encoder here that
+ * tracks the decoder's reconstruction, so their output is checked against
+ * that, and the PSNR against the scene is shown as well. A stream decoded
+ * straight into a texture is checked against the raster decode, twiddled.
+ * The others print a checksum of the output that has to stay the same
+ * across optimizations.
+ *
+ *   ./codec_bench [stream-name-prefix]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "avcodec.h"
+#include "dsputil.h"
+#include "mpegvideo.h"
+#include "mpeg12data.h"
+#include "twiddle.h"
+#include "bench.h"
+
+#define FRAMES 150
+#define PASSES 5
+
+#define SPRITE_WIDTH  64
+#define SPRITE_HEIGHT 48
+#define NOISE_WIDTH   96
+#define NOISE_HEIGHT  16
+
+#define FLI_256_COLOR 4
+#define FLI_DELTA     7
+#define FLI_LC        12
+#define FLI_BRUN      15
+
+typedef struct {
+  int       size;
+  uint8_t  *data;
+  int       display;       /* MPEG1: the picture's place in display order */
+} bench_frame_t;
+
+typedef struct {
+  const char      *name;
+  enum CodecID     codec_id;
+  int              width, height;
+  int              frames;
+  const char      *fli_mix;      /* FLI frame kinds, repeating: B, L, D */
+  int              fli_palette;  /* frames between palette changes */
+  int              mpeg_gop;     /* pictures from one I picture to the next */
+  int              mpeg_b_frames;/* B pictures between references */
+  int              hurry_up;     /* decode as though running late */
+  int              twiddled;     /* decode with CODEC_FLAG_TWIDDLED */
+  bench_frame_t   *frame;
+  uint8_t         *histograms;   /* Id CIN extradata */
+  uint8_t        **recon;        /* MPEG1 encoder's reconstruction, per
+                                  * picture in display order */
+} bench_stream_t;
+
+static uint32_t noise_state = 1;
+
+static int noise(void) {
+
+  noise_state = noise_state * 1103515245 + 12345;
+  return (noise_state >> 16) & 0x7FFF;
+}
+
+/**************************************************************************
+ * the scene
+ **************************************************************************/
+
+/* a palettized frame at time t: horizontal bands that give byte runs, a
+ * checkered sprite that moves and changes colors, and a patch of noise
+ * that changes completely every frame */
+static void scene_pal8(uint8_t *pixels, int width, int height, int t) {
+
+  int x, y;
+  int sprite_x, sprite_y;
+  int noise_x, noise_y;
+
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++)
+      pixels[y * width + x] = 16 + (y / 8) * 2 + (x / 40);
+
+  sprite_x = (t * 3) % (width - SPRITE_WIDTH);
+  sprite_y = (t * 2) % (height - SPRITE_HEIGHT);
+  for (y = 0; y < SPRITE_HEIGHT; y++)
+    for (x = 0; x < SPRITE_WIDTH; x++)
+      pixels[(sprite_y + y) * width + sprite_x + x] =
+        (((x / 4) ^ (y / 4)) & 1) ? 200 + (t & 15) : 100 + (x + y) / 8;
+
+  noise_x = width - NOISE_WIDTH - 8;
+  noise_y = height - NOISE_HEIGHT - 8;
+  for (y = 0; y < NOISE_HEIGHT; y++)
+    for (x = 0; x < NOISE_WIDTH; x++)
+      pixels[(noise_y + y) * width + noise_x + x] = noise() & 0xFF;
+}
+
+/* a smooth gradient with the same sprite on top, as 8-bit luma */
+static void scene_luma(uint8_t *pixels, int width, int height, int t) {
+
+  int x, y;
+  int sprite_x, sprite_y;
+
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++)
+      pixels[y * width + x] = 32 + (x + y) * 160 / (width + height);
+
+  sprite_x = (t * 3) % (width - SPRITE_WIDTH);
+  sprite_y = (t * 2) % (height - SPRITE_HEIGHT);
+  for (y = 0; y < SPRITE_HEIGHT; y++)
+    for (x = 0; x < SPRITE_WIDTH; x++)
+      pixels[(sprite_y + y) * width + sprite_x + x] =
+        (((x / 8) ^ (y / 8)) & 1) ? 220 : 40;
+}
+
+/* the palettized scene in 15-bit RGB */
+static void scene_rgb555(uint16_t *pixels, int width, int height, int t) {
+
+  uint8_t *indices = malloc(width * height);
+  int i, c;
+
+  scene_pal8(indices, width, height, t);
+  for (i = 0; i < width * height; i++) {
+    c = indices[i];
+    pixels[i] = ((c * 5) & 0x1F) << 10 | ((c * 3 + 7) & 0x1F) << 5 |
+      ((255 - c) >> 3);
+  }
+  free(indices);
+}
+
+/**************************************************************************
+ * FLI/FLC encoder
+ **************************************************************************/
+
+static uint8_t *put_le16(uint8_t *p, int v) {
+
+  p[0] = v & 0xFF;
+  p[1] = (v >> 8) & 0xFF;
+  return p + 2;
+}
+
+static uint8_t *put_le32(uint8_t *p, int v) {
+
+  p = put_le16(p, v & 0xFFFF);
+  return put_le16(p, (v >> 16) & 0xFFFF);
+}
+
+static uint8_t *put_be16(uint8_t *p, int v) {
+
+  p[0] = (v >> 8) & 0xFF;
+  p[1] = v & 0xFF;
+  return p + 2;
+}
+
+/* one chunk; returns the end of it */
+static uint8_t *fli_chunk(uint8_t *chunk, int type, uint8_t *end) {
+
+  put_le32(chunk, end - chunk);
+  put_le16(chunk + 4, type);
+  return end;
+}
+
+static uint8_t *fli_color_256(uint8_t *p, int shift) {
+
+  uint8_t *chunk = p;
+  int i;
+
+  p += 6;
+  p = put_le16(p, 1);
+  *p++ = 0;  /* skip */
+  *p++ = 0;  /* 256 changes */
+  for (i = 0; i < 256; i++) {
+    *p++ = (i + shift) & 0x3F;
+    *p++ = (i * 2 + shift) & 0x3F;
+    *p++ = (i * 3) & 0x3F;
+  }
+  return fli_chunk(chunk, FLI_256_COLOR, p);
+}
+
+/* BRUN: a positive count repeats one byte, a negative one copies bytes */
+static uint8_t *fli_brun(uint8_t *p, const uint8_t *pixels,
+                         int width, int height) {
+
+  uint8_t *chunk = p;
+  uint8_t *packets;
+  const uint8_t *line;
+  int x, y, run, literal;
+
+  p += 6;
+  for (y = 0; y < height; y++) {
+    line = pixels + y * width;
+    packets = p++;
+    *packets = 0;
+    x = 0;
+    while (x < width) {
+      for (run = 1; x + run < width && run < 127 &&
+           line[x + run] == line[x]; run++);
+      if (run >= 3) {
+        *p++ = run;
+        *p++ = line[x];
+        x += run;
+      } else {
+        /* gather literals up to the next run of 3 */
+        for (literal = 0; x + literal < width && literal < 127; literal++)
+          if (x + literal + 2 < width &&
+              line[x + literal] == line[x + literal + 1] &&
+              line[x + literal] == line[x + literal + 2])
+            break;
+        *p++ = -literal;
+        memcpy(p, line + x, literal);
+        p += literal;
+        x += literal;
+      }
+      (*packets)++;
+    }
+  }
+  return fli_chunk(chunk, FLI_BRUN, p);
+}
+
+/* the packets of one LC or DELTA line in units of 1 or 2 bytes; a
+ * positive count copies units, a negative one repeats one unit */
+static uint8_t *fli_line_packets(uint8_t *p, uint8_t *packets,
+                                 const uint8_t *cur, const uint8_t *prev,
+                                 int width, int unit) {
+
+  int units = width / unit;
+  int x, skip, span, run;
+
+  *packets = 0;
+  x = 0;
+  while (1) {
+    for (skip = 0; x < units &&
+         !memcmp(cur + x * unit, prev + x * unit, unit); x++, skip++);
+    if (x == units)
+      break;
+    /* a long skip takes empty packets; an empty LC packet still
+     * carries its repeat byte */
+    while (skip * unit > 255) {
+      *p++ = (255 / unit) * unit;
+      *p++ = 0;
+      if (unit == 1)
+        *p++ = 0;
+      skip -= 255 / unit;
+      (*packets)++;
+    }
+    /* the changed span, bridging gaps of a unit or two */
+    for (span = 1; x + span < units && span < 127; span++)
+      if (!memcmp(cur + (x + span) * unit, prev + (x + span) * unit, unit) &&
+          (x + span + 1 >= units ||
+           !memcmp(cur + (x + span + 1) * unit,
+                   prev + (x + span + 1) * unit, unit)))
+        break;
+    for (run = 1; run < span &&
+         !memcmp(cur + (x + run) * unit, cur + x * unit, unit); run++);
+    *p++ = skip * unit;
+    if (run >= 3) {
+      *p++ = -run;
+      memcpy(p, cur + x * unit, unit);
+      p += unit;
+      x += run;
+    } else {
+      *p++ = span;
+      memcpy(p, cur + x * unit, span * unit);
+      p += span * unit;
+      x += span;
+    }
+    (*packets)++;
+  }
+
+  return p;
+}
+
+/* LC: the first changed line, a line count and the packets of each */
+static uint8_t *fli_lc(uint8_t *p, const uint8_t *cur, const uint8_t *prev,
+                       int width, int height) {
+
+  uint8_t *chunk = p;
+  int first, last, y;
+
+  for (first = 0; first < height &&
+       !memcmp(cur + first * width, prev + first * width, width); first++);
+  for (last = height - 1; last > first &&
+       !memcmp(cur + last * width, prev + last * width, width); last--);
+  if (first == height)
+    first = last = 0;
+
+  p += 6;
+  p = put_le16(p, first);
+  p = put_le16(p, last - first + 1);
+  for (y = first; y <= last; y++)
+    p = fli_line_packets(p + 1, p, cur + y * width, prev + y * width,
+      width, 1);
+  return fli_chunk(chunk, FLI_LC, p);
+}
+
+/* DELTA: a line count, then per line either a negative count of lines to
+ * skip or a 16-bit packet count and the packets */
+static uint8_t *fli_delta(uint8_t *p, const uint8_t *cur, const uint8_t *prev,
+                          int width, int height) {
+
+  uint8_t *chunk = p;
+  uint8_t *line_count, *line;
+  uint8_t packets;
+  int lines, skip, y;
+
+  p += 6;
+  line_count = p;
+  p += 2;
+  lines = skip = 0;
+  for (y = 0; y < height; y++) {
+    if (!memcmp(cur + y * width, prev + y * width, width)) {
+      skip++;
+      continue;
+    }
+    if (skip) {
+      p = put_le16(p, -skip);
+      skip = 0;
+    }
+    line = p;
+    p = fli_line_packets(p + 2, &packets, cur + y * width, prev + y * width,
+      width, 2);
+    put_le16(line, packets);
+    lines++;
+  }
+  put_le16(line_count, lines);
+  return fli_chunk(chunk, FLI_DELTA, p);
+}
+
+static void make_fli_stream(bench_stream_t *stream) {
+
+  uint8_t *cur, *prev, *p, *frame, *packets_at;
+  int size = stream->width * stream->height;
+  int t, chunks;
+  char kind;
+
+  cur = malloc(size);
+  prev = malloc(size);
+  stream->frame = malloc(stream->frames * sizeof(bench_frame_t));
+  for (t = 0; t < stream->frames; t++) {
+
+    scene_pal8(cur, stream->width, stream->height, t);
+
+    kind = t ? stream->fli_mix[t % strlen(stream->fli_mix)] : 'B';
+
+    frame = p = malloc(16 + 6 + 4 + 768 + size * 2);
+    p += 16;
+    chunks = 0;
+    if (t == 0 || (stream->fli_palette && t % stream->fli_palette == 0)) {
+      p = fli_color_256(p, t);
+      chunks++;
+    }
+    switch (kind) {
+    case 'L':
+      p = fli_lc(p, cur, prev, stream->width, stream->height);
+      break;
+    case 'D':
+      p = fli_delta(p, cur, prev, stream->width, stream->height);
+      break;
+    default:
+      p = fli_brun(p, cur, stream->width, stream->height);
+      break;
+    }
+    chunks++;
+    put_le32(frame, p - frame);
+    put_le16(frame + 4, 0xF1FA);
+    packets_at = put_le16(frame + 6, chunks);
+    memset(packets_at, 0, 8);
+
+    stream->frame[t].data = frame;
+    stream->frame[t].size = p - frame;
+    memcpy(prev, cur, size);
+  }
+
+  free(cur);
+  free(prev);
+}
+
+/**************************************************************************
+ * Id CIN encoder
+ **************************************************************************/
+
+/* the Huffman trees are built exactly the way idcinvideo.c builds them so
+ * that the codes match */
+#define HUF_TOKENS 256
+
+typedef struct {
+  int count;
+  unsigned char used;
+  int children[2];
+  int parent;
+  int bit;
+} bench_hnode_t;
+
+static bench_hnode_t bench_hnodes[256][HUF_TOKENS * 2];
+static int bench_num_hnodes[256];
+
+static int bench_huff_smallest_node(bench_hnode_t *hnodes, int num_hnodes) {
+
+  int i, best = 99999999, best_node = -1;
+
+  for (i = 0; i < num_hnodes; i++) {
+    if (hnodes[i].used || !hnodes[i].count)
+      continue;
+    if (hnodes[i].count < best) {
+      best = hnodes[i].count;
+      best_node = i;
+    }
+  }
+  if (best_node != -1)
+    hnodes[best_node].used = 1;
+  return best_node;
+}
+
+static void bench_huff_build_tree(int prev) {
+
+  bench_hnode_t *hnodes = bench_hnodes[prev];
+  bench_hnode_t *node;
+  int num_hnodes = HUF_TOKENS;
+
+  while (1) {
+    node = &hnodes[num_hnodes];
+    node->children[0] = bench_huff_smallest_node(hnodes, num_hnodes);
+    if (node->children[0] == -1)
+      break;
+    node->children[1] = bench_huff_smallest_node(hnodes, num_hnodes);
+    if (node->children[1] == -1)
+      break;
+    node->count = hnodes[node->children[0]].count +
+      hnodes[node->children[1]].count;
+    hnodes[node->children[0]].parent = num_hnodes;
+    hnodes[node->children[0]].bit = 0;
+    hnodes[node->children[1]].parent = num_hnodes;
+    hnodes[node->children[1]].bit = 1;
+    num_hnodes++;
+  }
+  bench_num_hnodes[prev] = num_hnodes - 1;
+}
+
+/* bits go out LSB first, root first */
+static void make_idcin_stream(bench_stream_t *stream) {
+
+  uint8_t *pixels, *frame;
+  int size = stream->width * stream->height;
+  int prev, i, j, t, d;
+  int node, depth, bit_pos, byte_pos;
+  int path[HUF_TOKENS * 2];
+
+  memset(bench_hnodes, 0, sizeof(bench_hnodes));
+  /* each context favours the symbols closest to it, the way the
+   * backdrop's neighbouring pixels relate; every symbol stays codable */
+  stream->histograms = malloc(65536);
+  for (i = 0; i < 256; i++)
+    for (j = 0; j < 256; j++) {
+      d = abs(i - j);
+      stream->histograms[i * 256 + j] = (d == 0) ? 255 : (d < 32) ? 96 - d * 3 : 1;
+    }
+  for (i = 0; i < 256; i++) {
+    for (j = 0; j < HUF_TOKENS; j++)
+      bench_hnodes[i][j].count = stream->histograms[i * 256 + j];
+    bench_huff_build_tree(i);
+  }
+
+  pixels = malloc(size);
+  stream->frame = malloc(stream->frames * sizeof(bench_frame_t));
+  for (t = 0; t < stream->frames; t++) {
+
+    scene_pal8(pixels, stream->width, stream->height, t);
+
+    frame = calloc(size * 4, 1);
+    prev = bit_pos = byte_pos = 0;
+    for (i = 0; i < size; i++) {
+      depth = 0;
+      for (node = pixels[i]; node != bench_num_hnodes[prev];
+           node = bench_hnodes[prev][node].parent)
+        path[depth++] = bench_hnodes[prev][node].bit;
+      while (depth--) {
+        frame[byte_pos] |= path[depth] << bit_pos;
+        if (++bit_pos == 8) {
+          bit_pos = 0;
+          byte_pos++;
+        }
+      }
+      prev = pixels[i];
+    }
+
+    stream->frame[t].data = frame;
+    stream->frame[t].size = byte_pos + 1;
+  }
+
+  free(pixels);
+}
+
+/**************************************************************************
+ * CYUV encoder
+ **************************************************************************/
+
+static const signed char cyuv_table[16] = {
+  0, -1, 1, -2, 2, -4, 4, -8, 8, -16, 16, -32, 32, -64, 64, -128
+};
+
+/* the table entry that brings the prediction closest to the target */
+static int cyuv_nearest(unsigned char *pred, int target) {
+
+  int i, best = 0, best_error = 1000, error;
+
+  for (i = 0; i < 16; i++) {
+    error = abs(((*pred + cyuv_table[i]) & 0xFF) - target);
+    if (error < best_error) {
+      best_error = error;
+      best = i;
+    }
+  }
+  *pred += cyuv_table[best];
+  return best;
+}
+
+static void make_cyuv_stream(bench_stream_t *stream) {
+
+  uint8_t *luma, *p;
+  unsigned char y_pred, u_pred, v_pred;
+  int width = stream->width, height = stream->height;
+  int size = 48 + height * (width * 3 / 4);
+  int t, x, y, u, v, a, b;
+
+  luma = malloc(width * height);
+  stream->frame = malloc(stream->frames * sizeof(bench_frame_t));
+  for (t = 0; t < stream->frames; t++) {
+
+    scene_luma(luma, width, height, t);
+
+    p = stream->frame[t].data = malloc(size);
+    stream->frame[t].size = size;
+    for (x = 0; x < 3; x++)
+      memcpy(p + x * 16, cyuv_table, 16);
+    p += 48;
+
+    for (y = 0; y < height; y++) {
+      const uint8_t *line = luma + y * width;
+
+      /* chroma drifts slowly across the picture */
+      u = 96 + (y + t) % 64;
+      v = 160 - (y + t) % 64;
+
+      /* the first group starts the predictors */
+      u_pred = u & 0xF0;
+      y_pred = line[0] & 0xF0;
+      *p++ = u_pred | (y_pred >> 4);
+      v_pred = v & 0xF0;
+      a = cyuv_nearest(&y_pred, line[1]);
+      *p++ = v_pred | a;
+      a = cyuv_nearest(&y_pred, line[2]);
+      b = cyuv_nearest(&y_pred, line[3]);
+      *p++ = (b << 4) | a;
+
+      for (x = 4; x < width; x += 4) {
+        b = cyuv_nearest(&u_pred, u + x / 16);
+        a = cyuv_nearest(&y_pred, line[x]);
+        *p++ = (b << 4) | a;
+        b = cyuv_nearest(&v_pred, v - x / 16);
+        a = cyuv_nearest(&y_pred, line[x + 1]);
+        *p++ = (b << 4) | a;
+        a = cyuv_nearest(&y_pred, line[x + 2]);
+        b = cyuv_nearest(&y_pred, line[x + 3]);
+        *p++ = (b << 4) | a;
+      }
+    }
+  }
+
+  free(luma);
+}
+
+/**************************************************************************
+ * RPZA and MS Video-1 encoders
+ **************************************************************************/
+
+/* the 16 pixels of the 4x4 block at column bx, row by, in raster order */
+static void get_block(uint16_t *block, const uint16_t *pixels, int width,
+                      int bx, int by) {
+
+  int i;
+
+  for (i = 0; i < 16; i++)
+    block[i] = pixels[(by * 4 + i / 4) * width + bx * 4 + i % 4];
+}
+
+/* RPZA: unchanged blocks are skipped, and the rest coded as one color,
+ * as the two ends of a 4-color block or as 16 colors, all lossless */
+static void make_rpza_stream(bench_stream_t *stream) {
+
+  uint16_t *cur, *prev, block[16], old[16];
+  uint8_t *p, *frame;
+  int width = stream->width, height = stream->height;
+  int blocks_wide = width / 4, blocks_high = height / 4;
+  int t, bx, by, i, x, skip, c0, c1, index;
+
+  cur = malloc(width * height * 2);
+  prev = malloc(width * height * 2);
+  stream->frame = malloc(stream->frames * sizeof(bench_frame_t));
+  for (t = 0; t < stream->frames; t++) {
+
+    scene_rgb555(cur, width, height, t);
+
+    frame = p = malloc(4 + blocks_wide * blocks_high * 33);
+    p += 4;
+    skip = 0;
+    for (by = 0; by < blocks_high; by++)
+      for (bx = 0; bx < blocks_wide; bx++) {
+        get_block(block, cur, width, bx, by);
+        if (t) {
+          get_block(old, prev, width, bx, by);
+          if (!memcmp(block, old, sizeof(block))) {
+            if (++skip == 32) {
+              *p++ = 0x80 | (skip - 1);
+              skip = 0;
+            }
+            continue;
+          }
+        }
+        if (skip) {
+          *p++ = 0x80 | (skip - 1);
+          skip = 0;
+        }
+
+        c0 = block[0];
+        for (c1 = -1, i = 1; i < 16; i++)
+          if (block[i] != c0) {
+            if (c1 < 0)
+              c1 = block[i];
+            else if (block[i] != c1)
+              break;
+          }
+        if (c1 < 0) {
+          *p++ = 0xA0;
+          p = put_be16(p, c0);
+        } else if (i == 16) {
+          /* color A is index 3, color B index 0 */
+          *p++ = 0xC0;
+          p = put_be16(p, c1);
+          p = put_be16(p, c0);
+          for (i = 0; i < 16; i += 4) {
+            for (index = 0, x = 0; x < 4; x++)
+              index = (index << 2) | (block[i + x] == c1 ? 3 : 0);
+            *p++ = index;
+          }
+        } else {
+          /* the first color's top bit, clear, marks the block */
+          for (i = 0; i < 16; i++)
+            p = put_be16(p, block[i]);
+        }
+      }
+    if (skip)
+      *p++ = 0x80 | (skip - 1);
+
+    frame[0] = 0xE1;
+    frame[1] = ((p - frame) >> 16) & 0xFF;
+    put_be16(frame + 2, p - frame);
+    stream->frame[t].data = frame;
+    stream->frame[t].size = p - frame;
+    memcpy(prev, cur, width * height * 2);
+  }
+
+  free(cur);
+  free(prev);
+}
+
+static int rgb555_distance(int a, int b) {
+
+  int r = ((a >> 10) & 0x1F) - ((b >> 10) & 0x1F);
+  int g = ((a >> 5) & 0x1F) - ((b >> 5) & 0x1F);
+  int bl = (a & 0x1F) - (b & 0x1F);
+
+  return r * r + g * g + bl * bl;
+}
+
+/* MS Video-1: the blocks from the bottom row up and the pixels of each
+ * from its bottom row up. Unchanged blocks are skipped, one color and
+ * two color blocks are coded as such, and the rest as 8-color blocks, a
+ * pair of colors for each quadrant: the color of its last pixel and the
+ * color furthest from it. Only that is lossy. */
+static void make_msvideo1_stream(bench_stream_t *stream) {
+
+  uint16_t *cur, *prev, block[16], old[16], pixel[16], colors[8];
+  uint8_t *p, *frame;
+  int width = stream->width, height = stream->height;
+  int blocks_wide = width / 4, blocks_high = height / 4;
+  int t, bx, by, i, q, skip, c0, c1, flags, far, d;
+
+  cur = malloc(width * height * 2);
+  prev = malloc(width * height * 2);
+  stream->frame = malloc(stream->frames * sizeof(bench_frame_t));
+  for (t = 0; t < stream->frames; t++) {
+
+    scene_rgb555(cur, width, height, t);
+
+    frame = p = malloc(blocks_wide * blocks_high * 18);
+    skip = 0;
+    for (by = blocks_high - 1; by >= 0; by--)
+      for (bx = 0; bx < blocks_wide; bx++) {
+        get_block(block, cur, width, bx, by);
+        if (t) {
+          get_block(old, prev, width, bx, by);
+          if (!memcmp(block, old, sizeof(block))) {
+            if (++skip == 0x3FF) {
+              p = put_le16(p, 0x8400 | skip);
+              skip = 0;
+            }
+            continue;
+          }
+        }
+        if (skip) {
+          p = put_le16(p, 0x8400 | skip);
+          skip = 0;
+        }
+
+        /* pixel k is x = k % 4, y = k / 4 from the bottom */
+        for (i = 0; i < 16; i++)
+          pixel[i] = block[(3 - i / 4) * 4 + i % 4];
+
+        /* the last pixel must take the second color, flag bit clear */
+        c1 = pixel[15];
+        for (c0 = -1, i = 0; i < 16; i++)
+          if (pixel[i] != c1) {
+            if (c0 < 0)
+              c0 = pixel[i];
+            else if (pixel[i] != c0)
+              break;
+          }
+        if (c0 < 0 && (c1 >> 10) != 1) {
+          p = put_le16(p, 0x8000 | c1);
+        } else if (i == 16) {
+          /* a one color block that would read as a skip code goes out as
+           * two of the same color */
+          if (c0 < 0)
+            c0 = c1;
+          for (flags = 0, i = 0; i < 16; i++)
+            flags |= (pixel[i] == c0 && pixel[i] != c1) << i;
+          p = put_le16(p, flags);
+          p = put_le16(p, c0);
+          p = put_le16(p, c1);
+        } else {
+          for (flags = 0, q = 0; q < 8; q += 2) {
+            /* quadrant q / 2 is pixels x & 2 == q & 2, y & 2 == (q & 4) / 2 */
+            int first = (q & 4) * 2 + (q & 2);
+            int last = first + 5;
+            colors[q + 1] = pixel[last];
+            for (far = -1, colors[q] = pixel[last], i = 0; i < 16; i++)
+              if ((i & 2) == (q & 2) && ((i >> 2) & 2) == ((q & 4) >> 1)) {
+                d = rgb555_distance(pixel[i], pixel[last]);
+                if (d > far) {
+                  far = d;
+                  colors[q] = pixel[i];
+                }
+              }
+            for (i = 0; i < 16; i++)
+              if ((i & 2) == (q & 2) && ((i >> 2) & 2) == ((q & 4) >> 1))
+                flags |= (rgb555_distance(pixel[i], colors[q]) <
+                  rgb555_distance(pixel[i], colors[q + 1])) << i;
+          }
+          p = put_le16(p, flags);
+          p = put_le16(p, 0x8000 | colors[0]);
+          for (i = 1; i < 8; i++)
+            p = put_le16(p, colors[i]);
+        }
+      }
+    if (skip)
+      p = put_le16(p, 0x8400 | skip);
+
+    stream->frame[t].data = frame;
+    stream->frame[t].size = p - frame;
+    memcpy(prev, cur, width * height * 2);
+  }
+
+  free(cur);
+  free(prev);
+}
+
+/**************************************************************************
+ * MPEG1 encoder
+ **************************************************************************/
+
+/* a plain encoder: a float DCT, fixed quantizers per picture type that
+ * vary from slice to slice, and a motion search that only looks at no
+ * motion and at the sprite's motion. It reconstructs every picture with
+ * the same dequantization, prediction and IDCT as mpeg12.c, so a correct
+ * decoder reproduces its reconstruction exactly. */
+#define MPEG_F_CODE   2
+#define MPEG_FRAME_SIZE (256 * 1024)
+
+typedef struct {
+  DSPContext      dsp;
+  PutBitContext   pb;
+  int             width, height;
+  int             mb_width, mb_height;
+  int             pict_type;
+  int             qscale;
+  uint8_t        *source[3];
+  uint8_t        *recon[3];
+  uint8_t        *ref[2][3];     /* forward and backward references */
+  int             ref_distance[2];
+  int             gop_base;      /* display number of the GOP's first picture */
+  int             last_dc[3];
+  int             last_mv[2][2];
+  int             mb_dir;        /* prediction of the last coded macroblock */
+  int             mb_mv[2][2];
+  int             level[6][64];  /* in zigzag order */
+  DCTELEM         block[6][64];
+  uint8_t         rl_index[32][41];
+  float           dct_basis[8][8];
+} bench_mpeg_t;
+
+static bench_mpeg_t mpeg;
+
+static void scene_yuv420(uint8_t *planes[3], int width, int height, int t) {
+
+  int x, y;
+
+  scene_luma(planes[0], width, height, t);
+  for (y = 0; y < height / 2; y++)
+    for (x = 0; x < width / 2; x++) {
+      planes[1][y * width / 2 + x] = 64 + (x + y) * 128 / (width / 2 + height / 2);
+      planes[2][y * width / 2 + x] = 192 - x * 128 / (width / 2);
+    }
+}
+
+static void mpeg_init(int width, int height) {
+
+  AVCodecContext *context;
+  int i, u, x;
+
+  context = avcodec_alloc_context();
+  dsputil_init(&mpeg.dsp, context);
+  free(context);
+
+  mpeg.width = width;
+  mpeg.height = height;
+  mpeg.mb_width = width / 16;
+  mpeg.mb_height = height / 16;
+
+  memset(mpeg.rl_index, 0, sizeof(mpeg.rl_index));
+  for (i = 0; i < MPEG1_RL_ESCAPE; i++)
+    mpeg.rl_index[(int)mpeg1_run[i]][(int)mpeg1_level[i]] = i + 1;
+
+  for (u = 0; u < 8; u++)
+    for (x = 0; x < 8; x++)
+      mpeg.dct_basis[u][x] = (u ? sqrt(2.0 / 8) : sqrt(1.0 / 8)) *
+        cos((2 * x + 1) * u * M_PI / 16);
+}
+
+static void mpeg_start_code(int code) {
+
+  align_put_bits(&mpeg.pb);
+  put_bits(&mpeg.pb, 16, 0x0000);
+  put_bits(&mpeg.pb, 16, 0x0100 | code);
+}
+
+static void mpeg_put_dc(int diff, int component) {
+
+  int size = 0;
+
+  while (abs(diff) >> size)
+    size++;
+  if (component == 0)
+    put_bits(&mpeg.pb, vlc_dc_lum_bits[size], vlc_dc_lum_code[size]);
+  else
+    put_bits(&mpeg.pb, vlc_dc_chroma_bits[size], vlc_dc_chroma_code[size]);
+  if (size)
+    put_bits(&mpeg.pb, size, diff > 0 ? diff : diff + (1 << size) - 1);
+}
+
+/* the AC levels of a block and the end of block; the first coefficient
+ * of a non-intra block has the short code "1s" for a level of 1 */
+static void mpeg_put_ac(const int *level, int start, int intra) {
+
+  int i, run, a, l, code, first = !intra;
+
+  run = 0;
+  for (i = start; i < 64; i++) {
+    l = level[i];
+    if (!l) {
+      run++;
+      continue;
+    }
+    a = abs(l);
+    if (first && run == 0 && a == 1)
+      put_bits(&mpeg.pb, 2, 2 | (l < 0));
+    else if (run < 32 && a < 41 && (code = mpeg.rl_index[run][a])) {
+      put_bits(&mpeg.pb, mpeg1_vlc[code - 1][1], mpeg1_vlc[code - 1][0]);
+      put_bits(&mpeg.pb, 1, l < 0);
+    } else {
+      put_bits(&mpeg.pb, mpeg1_vlc[MPEG1_RL_ESCAPE][1],
+        mpeg1_vlc[MPEG1_RL_ESCAPE][0]);
+      put_bits(&mpeg.pb, 6, run);
+      if (a < 128)
+        put_bits(&mpeg.pb, 8, l & 0xFF);
+      else if (l > 0) {
+        put_bits(&mpeg.pb, 8, 0x00);
+        put_bits(&mpeg.pb, 8, l);
+      } else {
+        put_bits(&mpeg.pb, 8, 0x80);
+        put_bits(&mpeg.pb, 8, l + 256);
+      }
+    }
+    run = 0;
+    first = 0;
+  }
+  put_bits(&mpeg.pb, mpeg1_vlc[MPEG1_RL_EOB][1], mpeg1_vlc[MPEG1_RL_EOB][0]);
+}
+
+static void mpeg_put_mb_incr(int incr) {
+
+  while (incr > 33) {
+    put_bits(&mpeg.pb, mbAddrIncrTable[MB_ADDR_ESCAPE][1],
+      mbAddrIncrTable[MB_ADDR_ESCAPE][0]);
+    incr -= 33;
+  }
+  put_bits(&mpeg.pb, mbAddrIncrTable[incr - 1][1],
+    mbAddrIncrTable[incr - 1][0]);
+}
+
+static void mpeg_put_motion(int val, int pred) {
+
+  const int shift = MPEG_F_CODE - 1, f = 1 << shift;
+  int delta = val - pred, code, a;
+
+  /* into the range the modulo decoding brings back */
+  if (delta < -16 * f)
+    delta += 32 * f;
+  else if (delta >= 16 * f)
+    delta -= 32 * f;
+  if (!delta) {
+    put_bits(&mpeg.pb, mbMotionVectorTable[0][1], mbMotionVectorTable[0][0]);
+    return;
+  }
+  a = abs(delta) - 1;
+  code = (a >> shift) + 1;
+  put_bits(&mpeg.pb, mbMotionVectorTable[code][1], mbMotionVectorTable[code][0]);
+  put_bits(&mpeg.pb, 1, delta < 0);
+  if (shift)
+    put_bits(&mpeg.pb, shift, a & (f - 1));
+}
+
+static void mpeg_put_mb_type(const uint8_t (*table)[3], int count, int type) {
+
+  int i;
+
+  for (i = 0; i < count; i++)
+    if (table[i][2] == type) {
+      put_bits(&mpeg.pb, table[i][1], table[i][0]);
+      return;
+    }
+  fprintf(stderr, "no macroblock type %02X\n", type);
+  exit(1);
+}
+
+/* block n of the macroblock at mb_x, mb_y in one of the planes */
+static uint8_t *mpeg_block_ptr(uint8_t **planes, int mb_x, int mb_y, int n,
+                               int *stride) {
+
+  if (n < 4) {
+    *stride = mpeg.width;
+    return planes[0] + (mb_y * 16 + (n & 2) * 4) * mpeg.width +
+      mb_x * 16 + (n & 1) * 8;
+  }
+  *stride = mpeg.width / 2;
+  return planes[n - 3] + mb_y * 8 * (mpeg.width / 2) + mb_x * 8;
+}
+
+/* DCT of source - prediction; the prediction is NULL for intra blocks */
+static void mpeg_fdct(float *coef, const uint8_t *src, const uint8_t *pred,
+                      int stride) {
+
+  float tmp[64];
+  int u, v, x, y;
+  float sum;
+
+  for (y = 0; y < 8; y++)
+    for (u = 0; u < 8; u++) {
+      for (sum = 0, x = 0; x < 8; x++)
+        sum += mpeg.dct_basis[u][x] *
+          (src[y * stride + x] - (pred ? pred[y * stride + x] : 0));
+      tmp[y * 8 + u] = sum;
+    }
+  for (v = 0; v < 8; v++)
+    for (u = 0; u < 8; u++) {
+      for (sum = 0, y = 0; y < 8; y++)
+        sum += mpeg.dct_basis[v][y] * tmp[y * 8 + u];
+      coef[v * 8 + u] = sum;
+    }
+}
+
+/* quantizes block n into mpeg.level and dequantizes it into mpeg.block
+ * the way the decoder will; returns whether any level is coded */
+static int mpeg_quantize(int n, const float *coef, int intra) {
+
+  int *level = mpeg.level[n];
+  DCTELEM *block = mpeg.block[n];
+  const int16_t *matrix = intra ? ff_mpeg1_default_intra_matrix :
+    ff_mpeg1_default_non_intra_matrix;
+  int i, j, l, a, v, coded = 0;
+
+  memset(block, 0, 64 * sizeof(DCTELEM));
+  if (intra) {
+    l = (int)floor(coef[0] / 8 + 0.5);
+    level[0] = l < 0 ? 0 : l > 255 ? 255 : l;
+    block[0] = level[0] << 3;
+  }
+  for (i = intra; i < 64; i++) {
+    j = ff_zigzag_direct[i];
+    a = (int)(fabs(coef[j]) * 8 / (mpeg.qscale * matrix[j]) + (intra ? 0.5 : 0));
+    if (a > 255)
+      a = 255;
+    level[i] = coef[j] < 0 ? -a : a;
+    if (!a)
+      continue;
+    coded = 1;
+    if (intra)
+      v = (a * mpeg.qscale * matrix[j]) >> 3;
+    else
+      v = ((a * 2 + 1) * mpeg.qscale * matrix[j]) >> 4;
+    v = (v - 1) | 1;
+    block[mpeg.dsp.idct_permutation[j]] = coef[j] < 0 ? -v : v;
+  }
+  return coded;
+}
+
+/* predicts the macroblock into the reconstruction, like mpeg1_motion() */
+static void mpeg_predict(int mb_x, int mb_y, int dir, int (*mv)[2]) {
+
+  op_pixels_func (*op_pix)[4] = mpeg.dsp.put_pixels_tab;
+  int d, mx, my, stride = mpeg.width, uvstride = mpeg.width / 2, offset;
+  uint8_t **ref;
+
+  for (d = 0; d < 2; d++) {
+    if (!(dir & (d ? MB_BACK : MB_FOR)))
+      continue;
+    ref = mpeg.ref[d];
+    mx = mv[d][0];
+    my = mv[d][1];
+    op_pix[0][((my & 1) << 1) | (mx & 1)](
+      mpeg.recon[0] + mb_y * 16 * stride + mb_x * 16,
+      ref[0] + (mb_y * 16 + (my >> 1)) * stride + mb_x * 16 + (mx >> 1),
+      stride, 16);
+    mx /= 2;
+    my /= 2;
+    offset = (mb_y * 8 + (my >> 1)) * uvstride + mb_x * 8 + (mx >> 1);
+    op_pix[1][((my & 1) << 1) | (mx & 1)](
+      mpeg.recon[1] + mb_y * 8 * uvstride + mb_x * 8, ref[1] + offset,
+      uvstride, 8);
+    op_pix[1][((my & 1) << 1) | (mx & 1)](
+      mpeg.recon[2] + mb_y * 8 * uvstride + mb_x * 8, ref[2] + offset,
+      uvstride, 8);
+    op_pix = mpeg.dsp.avg_pixels_tab;
+  }
+}
+
+static int mpeg_luma_sad(int mb_x, int mb_y) {
+
+  int x, y, sad = 0, offset;
+
+  for (y = 0; y < 16; y++)
+    for (x = 0; x < 16; x++) {
+      offset = (mb_y * 16 + y) * mpeg.width + mb_x * 16 + x;
+      sad += abs(mpeg.source[0][offset] - mpeg.recon[0][offset]);
+    }
+  return sad;
+}
+
+/* whether a vector keeps the whole prediction inside the picture */
+static int mpeg_mv_inside(int mb_x, int mb_y, int mx, int my) {
+
+  int x = mb_x * 16 * 2 + mx, y = mb_y * 16 * 2 + my;
+
+  return x >= 0 && y >= 0 &&
+    x + 32 <= mpeg.width * 2 - 2 && y + 32 <= mpeg.height * 2 - 2;
+}
+
+/* the best of no motion and a small search around the sprite's motion
+ * from reference d; leaves the vector in mv[d] */
+static int mpeg_search(int mb_x, int mb_y, int d, int (*mv)[2]) {
+
+  int best = 0x7FFFFFFF, sad, i, mx, my;
+  int sprite_x = -6 * mpeg.ref_distance[d];
+  int sprite_y = -4 * mpeg.ref_distance[d];
+  int best_mv[2] = { 0, 0 };
+
+  for (i = -1; i < 9; i++) {
+    if (i < 0)
+      mx = my = 0;
+    else {
+      mx = sprite_x + i % 3 - 1;
+      my = sprite_y + i / 3 - 1;
+    }
+    if (!mpeg_mv_inside(mb_x, mb_y, mx, my))
+      continue;
+    mv[d][0] = mx;
+    mv[d][1] = my;
+    mpeg_predict(mb_x, mb_y, d ? MB_BACK : MB_FOR, mv);
+    sad = mpeg_luma_sad(mb_x, mb_y);
+    if (sad < best) {
+      best = sad;
+      best_mv[0] = mx;
+      best_mv[1] = my;
+    }
+  }
+  mv[d][0] = best_mv[0];
+  mv[d][1] = best_mv[1];
+  return best;
+}
+
+static int mpeg_intra_cost(int mb_x, int mb_y) {
+
+  const uint8_t *src = mpeg.source[0] + mb_y * 16 * mpeg.width + mb_x * 16;
+  int x, y, mean = 0, cost = 0;
+
+  for (y = 0; y < 16; y++)
+    for (x = 0; x < 16; x++)
+      mean += src[y * mpeg.width + x];
+  mean /= 256;
+  for (y = 0; y < 16; y++)
+    for (x = 0; x < 16; x++)
+      cost += abs(src[y * mpeg.width + x] - mean);
+  return cost;
+}
+
+static void mpeg_intra_mb(int mb_x, int mb_y, int quant) {
+
+  float coef[64];
+  uint8_t *src, *dst;
+  int n, component, stride;
+
+  if (mpeg.pict_type == I_TYPE)
+    put_bits(&mpeg.pb, quant ? 2 : 1, 1);
+  else
+    mpeg_put_mb_type(mpeg.pict_type == P_TYPE ? table_mb_ptype : table_mb_btype,
+      mpeg.pict_type == P_TYPE ? 7 : 11, quant ? MB_QUANT | MB_INTRA : MB_INTRA);
+  if (quant)
+    put_bits(&mpeg.pb, 5, mpeg.qscale);
+
+  for (n = 0; n < 6; n++) {
+    src = mpeg_block_ptr(mpeg.source, mb_x, mb_y, n, &stride);
+    dst = mpeg_block_ptr(mpeg.recon, mb_x, mb_y, n, &stride);
+    mpeg_fdct(coef, src, NULL, stride);
+    mpeg_quantize(n, coef, 1);
+    component = n < 4 ? 0 : n - 3;
+    mpeg_put_dc(mpeg.level[n][0] - mpeg.last_dc[component], component);
+    mpeg.last_dc[component] = mpeg.level[n][0];
+    mpeg_put_ac(mpeg.level[n], 1, 1);
+    mpeg.dsp.idct_put(dst, stride, mpeg.block[n]);
+  }
+
+  memset(mpeg.last_mv, 0, sizeof(mpeg.last_mv));
+  mpeg.mb_dir = 0;
+}
+
+static void mpeg_encode_slice(int mb_y) {
+
+  float coef[64];
+  uint8_t *src, *dst;
+  int mb_x, last_x, n, stride, cbp, dir, sad, best, d, type;
+  int mv[2][2], bi_mv[2][2];
+
+  mpeg_start_code(1 + mb_y);
+  put_bits(&mpeg.pb, 5, mpeg.qscale);
+  put_bits(&mpeg.pb, 1, 0);
+
+  mpeg.last_dc[0] = mpeg.last_dc[1] = mpeg.last_dc[2] = 128;
+  memset(mpeg.last_mv, 0, sizeof(mpeg.last_mv));
+  mpeg.mb_dir = 0;
+
+  last_x = -1;
+  for (mb_x = 0; mb_x < mpeg.mb_width; mb_x++) {
+
+    if (mpeg.pict_type == I_TYPE) {
+      mpeg_put_mb_incr(mb_x - last_x);
+      last_x = mb_x;
+      /* every seventh macroblock changes the quantizer */
+      if (mb_x && mb_x % 7 == 0) {
+        mpeg.qscale ^= 1;
+        mpeg_intra_mb(mb_x, mb_y, 1);
+      } else
+        mpeg_intra_mb(mb_x, mb_y, 0);
+      continue;
+    }
+
+    /* pick the prediction */
+    memset(mv, 0, sizeof(mv));
+    best = mpeg_search(mb_x, mb_y, 0, mv);
+    dir = MB_FOR;
+    if (mpeg.pict_type == B_TYPE) {
+      sad = mpeg_search(mb_x, mb_y, 1, mv);
+      if (sad < best) {
+        best = sad;
+        dir = MB_BACK;
+      }
+      memcpy(bi_mv, mv, sizeof(mv));
+      mpeg_predict(mb_x, mb_y, MB_FOR | MB_BACK, bi_mv);
+      sad = mpeg_luma_sad(mb_x, mb_y);
+      if (sad < best) {
+        best = sad;
+        dir = MB_FOR | MB_BACK;
+      }
+    }
+    if (mpeg_intra_cost(mb_x, mb_y) + 512 < best) {
+      mpeg_put_mb_incr(mb_x - last_x);
+      last_x = mb_x;
+      mpeg_intra_mb(mb_x, mb_y, 0);
+      continue;
+    }
+
+    /* the residual */
+    mpeg_predict(mb_x, mb_y, dir, mv);
+    cbp = 0;
+    for (n = 0; n < 6; n++) {
+      src = mpeg_block_ptr(mpeg.source, mb_x, mb_y, n, &stride);
+      dst = mpeg_block_ptr(mpeg.recon, mb_x, mb_y, n, &stride);
+      mpeg_fdct(coef, src, dst, stride);
+      if (mpeg_quantize(n, coef, 0))
+        cbp |= 32 >> n;
+    }
+
+    /* the first and the last macroblock of a slice are always coded */
+    if (!cbp && mb_x && mb_x != mpeg.mb_width - 1) {
+      if (mpeg.pict_type == P_TYPE && !mv[0][0] && !mv[0][1]) {
+        memset(mpeg.last_mv, 0, sizeof(mpeg.last_mv));
+        mpeg.last_dc[0] = mpeg.last_dc[1] = mpeg.last_dc[2] = 128;
+        continue;
+      }
+      if (mpeg.pict_type == B_TYPE && dir == mpeg.mb_dir &&
+          (!(dir & MB_FOR) || !memcmp(mv[0], mpeg.mb_mv[0], sizeof(mv[0]))) &&
+          (!(dir & MB_BACK) || !memcmp(mv[1], mpeg.mb_mv[1], sizeof(mv[1])))) {
+        mpeg.last_dc[0] = mpeg.last_dc[1] = mpeg.last_dc[2] = 128;
+        continue;
+      }
+    }
+
+    mpeg_put_mb_incr(mb_x - last_x);
+    last_x = mb_x;
+    type = dir | (cbp ? MB_PAT : 0);
+    if (mpeg.pict_type == P_TYPE && !mv[0][0] && !mv[0][1] && cbp)
+      type = MB_PAT;  /* no motion compensation */
+    if (mpeg.pict_type == P_TYPE)
+      mpeg_put_mb_type(table_mb_ptype, 7, type);
+    else
+      mpeg_put_mb_type(table_mb_btype, 11, type);
+    for (d = 0; d < 2; d++) {
+      if (!(type & (d ? MB_BACK : MB_FOR)))
+        continue;
+      mpeg_put_motion(mv[d][0], mpeg.last_mv[d][0]);
+      mpeg_put_motion(mv[d][1], mpeg.last_mv[d][1]);
+      mpeg.last_mv[d][0] = mv[d][0];
+      mpeg.last_mv[d][1] = mv[d][1];
+    }
+    if (type == MB_PAT)
+      memset(mpeg.last_mv[0], 0, sizeof(mpeg.last_mv[0]));
+    if (cbp)
+      put_bits(&mpeg.pb, mbPatTable[cbp][1], mbPatTable[cbp][0]);
+    for (n = 0; n < 6; n++) {
+      if (!(cbp & (32 >> n)))
+        continue;
+      mpeg_put_ac(mpeg.level[n], 0, 0);
+      dst = mpeg_block_ptr(mpeg.recon, mb_x, mb_y, n, &stride);
+      mpeg.dsp.idct_add(dst, stride, mpeg.block[n]);
+    }
+    mpeg.last_dc[0] = mpeg.last_dc[1] = mpeg.last_dc[2] = 128;
+    mpeg.mb_dir = dir;
+    memcpy(mpeg.mb_mv, mv, sizeof(mv));
+  }
+}
+
+/* codes picture d of the scene as coded picture t; ref is the reference
+ * it is (or the backward reference of a B picture) and prev_ref the one
+ * before that */
+static void mpeg_encode_picture(bench_stream_t *stream, int t, int d,
+                                int ref, int prev_ref) {
+
+  static const int qscale[3] = { 4, 6, 8 };  /* I, P, B */
+  int width = stream->width, height = stream->height;
+  int size = width * height;
+  int mb_y;
+  uint8_t *buf;
+
+  stream->frame[t].display = d;
+  stream->recon[d] = malloc(size * 3 / 2);
+  mpeg.recon[0] = stream->recon[d];
+  mpeg.recon[1] = stream->recon[d] + size;
+  mpeg.recon[2] = stream->recon[d] + size * 5 / 4;
+  scene_yuv420(mpeg.source, width, height, d);
+
+  if (d != ref)
+    mpeg.pict_type = B_TYPE;
+  else if (d % stream->mpeg_gop == 0)
+    mpeg.pict_type = I_TYPE;
+  else
+    mpeg.pict_type = P_TYPE;
+
+  mpeg.ref_distance[0] = d - prev_ref;
+  mpeg.ref_distance[1] = d - ref;
+  if (mpeg.pict_type != B_TYPE) {
+    memcpy(mpeg.ref[0], mpeg.ref[1], sizeof(mpeg.ref[0]));
+    memcpy(mpeg.ref[1], mpeg.recon, sizeof(mpeg.ref[1]));
+  }
+
+  buf = malloc(MPEG_FRAME_SIZE);
+  init_put_bits(&mpeg.pb, buf, MPEG_FRAME_SIZE, NULL, NULL);
+
+  if (mpeg.pict_type == I_TYPE) {
+    mpeg_start_code(0xB3);
+    put_bits(&mpeg.pb, 12, width);
+    put_bits(&mpeg.pb, 12, height);
+    put_bits(&mpeg.pb, 4, 1);        /* square pixels */
+    put_bits(&mpeg.pb, 4, 4);        /* 29.97 Hz */
+    put_bits(&mpeg.pb, 18, 0x3FFFF); /* variable bit rate */
+    put_bits(&mpeg.pb, 1, 1);
+    put_bits(&mpeg.pb, 10, 20);
+    put_bits(&mpeg.pb, 1, 0);
+    put_bits(&mpeg.pb, 1, 0);        /* default matrices */
+    put_bits(&mpeg.pb, 1, 0);
+
+    /* an open GOP starts with the B pictures shown before its I */
+    mpeg.gop_base = d ? prev_ref + 1 : 0;
+    mpeg_start_code(0xB8);
+    put_bits(&mpeg.pb, 1, 0);
+    put_bits(&mpeg.pb, 5, 0);
+    put_bits(&mpeg.pb, 6, mpeg.gop_base / 1800);
+    put_bits(&mpeg.pb, 1, 1);
+    put_bits(&mpeg.pb, 6, mpeg.gop_base / 30 % 60);
+    put_bits(&mpeg.pb, 6, mpeg.gop_base % 30);
+    put_bits(&mpeg.pb, 1, d == 0);   /* closed */
+    put_bits(&mpeg.pb, 1, 0);
+  }
+
+  mpeg_start_code(0x00);
+  put_bits(&mpeg.pb, 10, (d - mpeg.gop_base) & 1023);
+  put_bits(&mpeg.pb, 3, mpeg.pict_type);
+  put_bits(&mpeg.pb, 16, 0xFFFF);
+  if (mpeg.pict_type != I_TYPE) {
+    put_bits(&mpeg.pb, 1, 0);
+    put_bits(&mpeg.pb, 3, MPEG_F_CODE);
+  }
+  if (mpeg.pict_type == B_TYPE) {
+    put_bits(&mpeg.pb, 1, 0);
+    put_bits(&mpeg.pb, 3, MPEG_F_CODE);
+  }
+  put_bits(&mpeg.pb, 1, 0);
+
+  for (mb_y = 0; mb_y < mpeg.mb_height; mb_y++) {
+    mpeg.qscale = qscale[mpeg.pict_type - 1] + mb_y % 3;
+    mpeg_encode_slice(mb_y);
+  }
+  if (t == stream->frames - 1)
+    mpeg_start_code(0xB7);
+  flush_put_bits(&mpeg.pb);
+
+  stream->frame[t].data = buf;
+  stream->frame[t].size = pbBufPtr(&mpeg.pb) - buf;
+}
+
+static void make_mpeg1_stream(bench_stream_t *stream) {
+
+  int size = stream->width * stream->height;
+  int t, d, ref, prev_ref;
+  uint8_t *source;
+
+  mpeg_init(stream->width, stream->height);
+
+  stream->frame = malloc(stream->frames * sizeof(bench_frame_t));
+  stream->recon = malloc(stream->frames * sizeof(uint8_t *));
+  source = malloc(size * 3 / 2);
+  mpeg.source[0] = source;
+  mpeg.source[1] = source + size;
+  mpeg.source[2] = source + size * 5 / 4;
+
+  /* coded order: each reference, then the B pictures shown before it */
+  t = 0;
+  prev_ref = 0;
+  for (ref = 0; ref < stream->frames; ref++) {
+    if (ref % (stream->mpeg_b_frames + 1) && ref != stream->frames - 1)
+      continue;
+    mpeg_encode_picture(stream, t++, ref, ref, prev_ref);
+    for (d = prev_ref + 1; d < ref; d++)
+      mpeg_encode_picture(stream, t++, d, ref, prev_ref);
+    prev_ref = ref;
+  }
+
+  free(source);
+}
+
+/**************************************************************************
+ * YUV4MPEG2 frames
+ **************************************************************************/
+
+static void make_y4m_stream(bench_stream_t *stream) {
+
+  int width = stream->width, height = stream->height;
+  int size = width * height;
+  uint8_t *p;
+  int t, i;
+
+  stream->frame = malloc(stream->frames * sizeof(bench_frame_t));
+  for (t = 0; t < stream->frames; t++) {
+    p = stream->frame[t].data = malloc(size * 3 / 2);
+    stream->frame[t].size = size * 3 / 2;
+    scene_luma(p, width, height, t);
+    for (i = 0; i < size / 4; i++) {
+      p[size + i] = 96 + (i / width + t) % 64;
+      p[size + size / 4 + i] = 160 - (i / width + t) % 64;
+    }
+  }
+}
+
+/**************************************************************************
+ * decoding
+ **************************************************************************/
+
+/* the power of 2 texture dimension that n pixels fit in */
+static int texture_dimension(int n) {
+
+  int d = 16;
+
+  while (d < n)
+    d <<= 1;
+  return d;
+}
+
+/* like the engine, give the palettized decoders one flat frame that they
+ * keep drawing into; the 16-bit decoders drawing in raster order get one
+ * the size of the texture, which twiddle_16bpp() can take as it is */
+static int bench_get_buffer(AVCodecContext *context, AVFrame *av_frame) {
+
+  int width = context->width, size = context->width * context->height;
+
+  if (context->pix_fmt == PIX_FMT_RGB555) {
+    width = texture_dimension(context->width) * 2;
+    size = width * texture_dimension(context->height);
+  } else if (context->pix_fmt != PIX_FMT_PAL8)
+    return avcodec_default_get_buffer(context, av_frame);
+
+  if (!context->opaque)
+    context->opaque = calloc(size, 1);
+  av_frame->data[0] = context->opaque;
+  av_frame->data[1] = av_frame->data[2] = NULL;
+  av_frame->linesize[0] = width;
+  av_frame->linesize[1] = av_frame->linesize[2] = 0;
+
+  return 0;
+}
+
+static void bench_release_buffer(AVCodecContext *context, AVFrame *av_frame) {
+
+  if (context->pix_fmt != PIX_FMT_PAL8 &&
+      context->pix_fmt != PIX_FMT_RGB555)
+    avcodec_default_release_buffer(context, av_frame);
+}
+
+/* a decoder in raster order for the picture a stream decoded straight
+ * into a texture is checked against */
+static AVCodecContext *open_raster(bench_stream_t *stream) {
+
+  AVCodecContext *context = avcodec_alloc_context();
+
+  context->width = stream->width;
+  context->height = stream->height;
+  context->get_buffer = bench_get_buffer;
+  context->release_buffer = bench_release_buffer;
+  avcodec_open(context, avcodec_find_decoder(stream->codec_id));
+  return context;
+}
+
+/* whether an RPZA picture in raster order differs from the scene */
+static int rpza_mismatch(bench_stream_t *stream, AVFrame *av_frame, int t) {
+
+  int width = stream->width, height = stream->height;
+  uint16_t *scene = malloc(width * height * 2);
+  int x, y, mismatch = 0;
+
+  scene_rgb555(scene, width, height, t);
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++)
+      if (((uint16_t *)(av_frame->data[0] + y * av_frame->linesize[0]))[x] !=
+          (scene[y * width + x] | 0x8000))
+        mismatch = 1;
+  free(scene);
+
+  return mismatch;
+}
+
+static uint32_t checksum(uint32_t sum, const uint8_t *p, int width,
+                         int height, int linesize) {
+
+  int x, y;
+
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++)
+      sum = sum * 31 + p[y * linesize + x];
+  return sum;
+}
+
+/* whether a decoded MPEG1 picture differs from the encoder's
+ * reconstruction of picture d; adds its squared luma error against the
+ * scene to *sse */
+static int mpeg_mismatch(bench_stream_t *stream, AVFrame *av_frame, int d,
+                         double *sse) {
+
+  int width = stream->width, height = stream->height;
+  int size = width * height;
+  uint8_t *source[3], *plane;
+  int i, x, y, w, h, diff, mismatch = 0;
+
+  for (i = 0; i < 3; i++) {
+    w = i ? width / 2 : width;
+    h = i ? height / 2 : height;
+    plane = stream->recon[d] + (i ? size + (i - 1) * size / 4 : 0);
+    for (y = 0; y < h; y++)
+      if (memcmp(av_frame->data[i] + y * av_frame->linesize[i],
+                 plane + y * w, w))
+        mismatch = 1;
+  }
+
+  source[0] = malloc(size * 3 / 2);
+  source[1] = source[0] + size;
+  source[2] = source[1] + size / 4;
+  scene_yuv420(source, width, height, d);
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++) {
+      diff = av_frame->data[0][y * av_frame->linesize[0] + x] -
+        source[0][y * width + x];
+      *sse += diff * diff;
+    }
+  free(source[0]);
+
+  return mismatch;
+}
+
+static int compare_uint64(const void *a, const void *b) {
+
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+  return (x > y) - (x < y);
+}
+
+static void run_stream(bench_stream_t *stream) {
+
+  AVCodecContext *context = NULL, *raster = NULL;
+  AVFrame av_frame, raster_frame;
+  AVPicture src, dst;
+  uint8_t *expected = NULL, *rgb = NULL;
+  uint16_t *texture = NULL;
+  uint64_t *samples, start, total;
+  uint32_t sum = 0;
+  double sse = 0;
+  int n, pass, t, got_picture, bytes, mismatches, palettized;
+  int mpeg, shown, pending, outputs, rgb16, lossless;
+  int texture_width, texture_height;
+
+  samples = malloc(PASSES * stream->frames * sizeof(uint64_t));
+  palettized = (stream->codec_id == CODEC_ID_FLIC ||
+                stream->codec_id == CODEC_ID_IDCIN);
+  mpeg = (stream->codec_id == CODEC_ID_MPEG1VIDEO);
+  rgb16 = (stream->codec_id == CODEC_ID_RPZA ||
+           stream->codec_id == CODEC_ID_MSVIDEO1);
+  lossless = palettized || stream->codec_id == CODEC_ID_RPZA ||
+    stream->twiddled;
+  texture_width = texture_dimension(stream->width);
+  texture_height = texture_dimension(stream->height);
+
+  if (stream->codec_id != CODEC_ID_NONE) {
+    context = avcodec_alloc_context();
+    context->width = stream->width;
+    context->height = stream->height;
+    context->get_buffer = bench_get_buffer;
+    context->release_buffer = bench_release_buffer;
+    if (stream->codec_id == CODEC_ID_IDCIN) {
+      context->pix_fmt = PIX_FMT_PAL8;
+      context->extradata = stream->histograms;
+      context->extradata_size = 65536;
+    }
+    context->hurry_up = stream->hurry_up;
+    if (stream->twiddled)
+      context->flags |= CODEC_FLAG_TWIDDLED;
+    if (avcodec_open(context, avcodec_find_decoder(stream->codec_id)) < 0) {
+      printf("%-10s could not open the decoder\n", stream->name);
+      return;
+    }
+  } else {
+    /* the YUV to RGB converters clamp through the crop table, which only
+     * dsputil_init() fills in */
+    DSPContext dsp;
+    context = avcodec_alloc_context();
+    dsputil_init(&dsp, context);
+    free(context);
+    context = NULL;
+
+    rgb = malloc(stream->width * stream->height * 2);
+    avpicture_fill(&dst, rgb, PIX_FMT_RGB565, stream->width, stream->height);
+  }
+  if (palettized)
+    expected = malloc(stream->width * stream->height);
+  if (rgb16)
+    texture = malloc(texture_width * texture_height * 2);
+  if (stream->twiddled)
+    raster = open_raster(stream);
+
+  n = bytes = mismatches = outputs = pending = 0;
+  for (pass = 0; pass < PASSES; pass++) {
+    for (t = 0; t < stream->frames; t++) {
+
+      if (context) {
+        start = bench_cycles();
+        avcodec_decode_video(context, &av_frame, &got_picture,
+          stream->frame[t].data, stream->frame[t].size);
+        if (rgb16 && !stream->twiddled)
+          twiddle_16bpp(texture, (uint16_t *)av_frame.data[0],
+            texture_width, texture_height);
+        samples[n++] = bench_cycles() - start;
+      } else {
+        avpicture_fill(&src, stream->frame[t].data, PIX_FMT_YUV420P,
+          stream->width, stream->height);
+        start = bench_cycles();
+        img_convert(&dst, PIX_FMT_RGB565, &src, PIX_FMT_YUV420P,
+          stream->width, stream->height);
+        samples[n++] = bench_cycles() - start;
+      }
+      if (pass)
+        continue;
+
+      bytes += stream->frame[t].size;
+      if (palettized) {
+        scene_pal8(expected, stream->width, stream->height, t);
+        if (memcmp(expected, av_frame.data[0],
+                   stream->width * stream->height))
+          mismatches++;
+      } else if (mpeg) {
+        /* references come out one picture late, the B pictures at once */
+        if (context->coded_frame->pict_type == FF_B_TYPE)
+          shown = stream->frame[t].display;
+        else {
+          shown = pending;
+          pending = stream->frame[t].display;
+        }
+        if (got_picture) {
+          mismatches += mpeg_mismatch(stream, &av_frame, shown, &sse);
+          outputs++;
+        }
+      } else if (stream->twiddled) {
+        avcodec_decode_video(raster, &raster_frame, &got_picture,
+          stream->frame[t].data, stream->frame[t].size);
+        twiddle_16bpp(texture, (uint16_t *)raster_frame.data[0],
+          texture_width, texture_height);
+        if (memcmp(texture, av_frame.data[0],
+                   texture_width * texture_height * 2))
+          mismatches++;
+      } else if (stream->codec_id == CODEC_ID_RPZA) {
+        mismatches += rpza_mismatch(stream, &av_frame, t);
+      } else if (rgb16) {
+        sum = checksum(sum, av_frame.data[0], stream->width * 2,
+          stream->height, av_frame.linesize[0]);
+      } else if (context) {
+        sum = checksum(sum, av_frame.data[0], stream->width,
+          stream->height, av_frame.linesize[0]);
+        sum = checksum(sum, av_frame.data[1], stream->width / 4,
+          stream->height, av_frame.linesize[1]);
+        sum = checksum(sum, av_frame.data[2], stream->width / 4,
+          stream->height, av_frame.linesize[2]);
+      } else
+        sum = checksum(sum, rgb, stream->width * 2, stream->height,
+          stream->width * 2);
+    }
+
+    /* the last reference is still held back */
+    if (mpeg) {
+      avcodec_decode_video(context, &av_frame, &got_picture, NULL, 0);
+      if (!pass && got_picture) {
+        mismatches += mpeg_mismatch(stream, &av_frame, pending, &sse);
+        outputs++;
+      }
+    }
+  }
+
+  qsort(samples, n, sizeof(uint64_t), compare_uint64);
+  for (total = 0, t = 0; t < n; t++)
+    total += samples[t];
+
+  printf("%-10s %4dx%-4d %8d %10llu %10llu %10llu %10llu  ",
+    stream->name, stream->width, stream->height,
+    bytes / stream->frames,
+    (unsigned long long)samples[0],
+    (unsigned long long)samples[n / 2],
+    (unsigned long long)samples[(n * 99 + 99) / 100 - 1],
+    (unsigned long long)(total / n));
+  if (lossless)
+    printf("%s\n", mismatches ? "MISMATCH" : "ok");
+  else if (mpeg) {
+    printf("%s %.1fdB", mismatches ? "MISMATCH" : "ok",
+      10 * log10(255.0 * 255.0 * stream->width * stream->height * outputs /
+                 (sse ? sse : 1)));
+    if (outputs != stream->frames)
+      printf(", %d shown", outputs);
+    printf("\n");
+  } else
+    printf("%08X\n", sum);
+  if (mismatches)
+    printf("  %d of %d frames did not decode to the %s\n", mismatches,
+      mpeg ? outputs : stream->frames,
+      mpeg ? "encoder's reconstruction" :
+        stream->twiddled ? "raster picture, twiddled" : "scene");
+
+  if (context) {
+    avcodec_close(context);
+    free(context->opaque);
+    free(context);
+  }
+  if (raster) {
+    avcodec_close(raster);
+    free(raster->opaque);
+    free(raster);
+  }
+  free(texture);
+  free(expected);
+  free(rgb);
+  free(samples);
+}
+
+int main(int argc, char *argv[]) {
+
+  static bench_stream_t streams[] = {
+    { "fli-brun",  CODEC_ID_FLIC,  320, 200, FRAMES, "B" },
+    { "fli-lc",    CODEC_ID_FLIC,  320, 200, FRAMES, "L" },
+    { "flc-delta", CODEC_ID_FLIC,  320, 200, FRAMES, "D" },
+    { "flc-mix",   CODEC_ID_FLIC,  320, 200, FRAMES,
+      "BLDLDLDLDLDLDLDLDLDLDLDLD", 50 },
+    { "idcin",     CODEC_ID_IDCIN, 320, 240, FRAMES },
+    { "cyuv",      CODEC_ID_CYUV,  320, 240, FRAMES },
+    { "y4m",       CODEC_ID_NONE,  320, 240, FRAMES },
+    { "mpeg1-i",   CODEC_ID_MPEG1VIDEO, 352, 240, FRAMES, NULL, 0, 1, 0 },
+    { "mpeg1-ipb", CODEC_ID_MPEG1VIDEO, 352, 240, FRAMES, NULL, 0, 12, 2 },
+    { "mpeg1-skip", CODEC_ID_MPEG1VIDEO, 352, 240, FRAMES, NULL, 0, 12, 2, 1 },
+    { "rpza",      CODEC_ID_RPZA,  320, 240, FRAMES },
+    { "rpza-tw",   CODEC_ID_RPZA,  320, 240, FRAMES, NULL, 0, 0, 0, 0, 1 },
+    { "msvc",      CODEC_ID_MSVIDEO1, 320, 240, FRAMES },
+    { "msvc-tw",   CODEC_ID_MSVIDEO1, 320, 240, FRAMES, NULL, 0, 0, 0, 0, 1 },
+  };
+  bench_stream_t *stream;
+  int i, t;
+
+  avcodec_init();
+  register_avcodec(&cyuv_decoder);
+  register_avcodec(&flic_decoder);
+  register_avcodec(&idcin_decoder);
+  register_avcodec(&mpeg_decoder);
+  register_avcodec(&msvideo1_decoder);
+  register_avcodec(&rpza_decoder);
+
+  printf("%-10s %-9s %8s %10s %10s %10s %10s  %s\n",
+    "stream", "size", "bytes", "min", "median", "p99", "mean", "check");
+  printf("%-10s %-9s %8s %43s\n", "", "", "/frame", BENCH_UNIT "/frame");
+  for (i = 0; i < sizeof(streams) / sizeof(streams[0]); i++) {
+    stream = &streams[i];
+    if (argc > 1 && strncmp(stream->name, argv[1], strlen(argv[1])))
+      continue;
+
+    noise_state = 1;
+    if (stream->codec_id == CODEC_ID_FLIC)
+      make_fli_stream(stream);
+    else if (stream->codec_id == CODEC_ID_IDCIN)
+      make_idcin_stream(stream);
+    else if (stream->codec_id == CODEC_ID_CYUV)
+      make_cyuv_stream(stream);
+    else if (stream->codec_id == CODEC_ID_MPEG1VIDEO)
+      make_mpeg1_stream(stream);
+    else if (stream->codec_id == CODEC_ID_RPZA)
+      make_rpza_stream(stream);
+    else if (stream->codec_id == CODEC_ID_MSVIDEO1)
+      make_msvideo1_stream(stream);
+    else
+      make_y4m_stream(stream);
+    noise_state = 1;
+
+    run_stream(stream);
+
+    for (t = 0; t < stream->frames; t++) {
+      free(stream->frame[t].data);
+      if (stream->recon)
+        free(stream->recon[t]);
+    }
+    free(stream->frame);
+    free(stream->histograms);
+    free(stream->recon);
+  }
+
+  return 0;
+}
@@ -0,0 +1,309 @@
+/*
+ * Dreamreel pixel format conversion benchmark
+ *
+ * Converts random pictures between the decoders' formats and packed
+ * YUV422 or RGB, and times three ways of doing it:
+ *
+ *   via rgb24    what img_convert() used to do for a pair it had no
+ *                converter for: allocate an RGB24 picture, convert into
+ *                it and out of it, free it
+ *   img_convert  img_convert() as it is now, planning on every call
+ *   planned      img_convert_frame() on a context set up once
+ *
+ * The speedup is of the planned conversion over going via RGB24, or over
+ * img_convert() where one end is RGB24. The planned conversion must give
+ * exactly what img_convert() gives. The direct converters to YUV422 and
+ * from YUV411P are checked against the converters they stand in for, at
+ * an odd size as well: YUV420P and YUV411P against YUV422P with the
+ * chroma repeated, PAL8 against going through RGB24, and the luma from
+ * RGB against the gray converter.
+ *
+ * None of this is the console's output path. PIX_FMT_YUV422 is Y0 U Y1
+ * V, where a PVR texture wants U Y0 V Y1, and the engine packs or
+ * twiddles its textures itself (see twiddle_bench).
+ *
+ *   ./convert_bench [passes]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "avcodec.h"
+#include "dsputil.h"
+#include "bench.h"
+
+#define WIDTH        320
+#define HEIGHT       240
+#define CHECK_WIDTH  321
+#define CHECK_HEIGHT 241
+
+static const struct {
+  const char *name;
+  int src_pix_fmt, dst_pix_fmt;
+} pairs[] = {
+  { "pal8>yuv422",    PIX_FMT_PAL8,      PIX_FMT_YUV422 },
+  { "pal8>rgb565",    PIX_FMT_PAL8,      PIX_FMT_RGB565 },
+  { "pal8>yuv420p",   PIX_FMT_PAL8,      PIX_FMT_YUV420P },
+  { "yuv420p>yuv422", PIX_FMT_YUV420P,   PIX_FMT_YUV422 },
+  { "yuv420p>rgb565", PIX_FMT_YUV420P,   PIX_FMT_RGB565 },
+  { "yuv411p>yuv422", PIX_FMT_YUV411P,   PIX_FMT_YUV422 },
+  { "yuv411p>rgb565", PIX_FMT_YUV411P,   PIX_FMT_RGB565 },
+  { "yuv411p>rgb555", PIX_FMT_YUV411P,   PIX_FMT_RGB555 },
+  { "rgb24>yuv422",   PIX_FMT_RGB24,     PIX_FMT_YUV422 },
+  { "rgb24>rgb555",   PIX_FMT_RGB24,     PIX_FMT_RGB555 },
+  { "rgb565>yuv422",  PIX_FMT_RGB565,    PIX_FMT_YUV422 },
+  { "yuv422>rgb565",  PIX_FMT_YUV422,    PIX_FMT_RGB565 },
+  { "gray>yuv422",    PIX_FMT_GRAY8,     PIX_FMT_YUV422 },
+  { "monow>rgb565",   PIX_FMT_MONOWHITE, PIX_FMT_RGB565 },
+};
+#define NUM_PAIRS (sizeof(pairs) / sizeof(pairs[0]))
+
+static unsigned int seed = 1;
+
+static int errors;
+
+static int rnd(void) {
+
+  seed = seed * 1103515245 + 12345;
+  return (seed >> 16) & 0x7fff;
+}
+
+/* a picture of random bytes, palette and all */
+static uint8_t *alloc_picture(AVPicture *picture, int pix_fmt,
+                              int width, int height, int fill) {
+
+  int size = avpicture_get_size(pix_fmt, width, height);
+  uint8_t *buf = malloc(size);
+  int i;
+
+  for (i = 0; i < size; i++)
+    buf[i] = fill ? rnd() : 0;
+  avpicture_fill(picture, buf, pix_fmt, width, height);
+  return buf;
+}
+
+static void check(int ok, const char *what, const char *name) {
+
+  if (!ok) {
+    printf("%s: %s\n", name, what);
+    errors++;
+  }
+}
+
+/* the YUV422P picture with the chroma of a YUV420P or YUV411P one
+ * repeated */
+static void upsample_to_422p(AVPicture *dst, AVPicture *src, int pix_fmt,
+                             int width, int height) {
+
+  int x, y, i;
+
+  memcpy(dst->data[0], src->data[0], width * height);
+  for (i = 1; i <= 2; i++)
+    for (y = 0; y < height; y++)
+      for (x = 0; x < (width + 1) >> 1; x++)
+        dst->data[i][y * dst->linesize[i] + x] = pix_fmt == PIX_FMT_YUV420P ?
+          src->data[i][(y >> 1) * src->linesize[i] + x] :
+          src->data[i][y * src->linesize[i] + (x >> 1)];
+}
+
+/* YUV422P packed into YUYV; an odd last pixel gets Y and U */
+static void pack_yuyv(uint8_t *q, AVPicture *src, int width, int height) {
+
+  int x, y;
+
+  for (y = 0; y < height; y++) {
+    for (x = 0; x < width; x++) {
+      *q++ = src->data[0][y * src->linesize[0] + x];
+      *q++ = src->data[1 + (x & 1)][y * src->linesize[1] + (x >> 1)];
+    }
+  }
+}
+
+/* the direct converters against the ones they stand in for */
+static void check_kernels(int width, int height) {
+
+  AVPicture src, yuv422p, rgb24, out, expected;
+  uint8_t *src_buf, *yuv422p_buf, *rgb24_buf, *out_buf, *expected_buf;
+  int pix_fmt, x, y;
+  static const int rgb_fmts[] = { PIX_FMT_RGB24, PIX_FMT_RGB565, PIX_FMT_RGB555 };
+  int i;
+
+  yuv422p_buf = alloc_picture(&yuv422p, PIX_FMT_YUV422P, width, height, 0);
+  out_buf = alloc_picture(&out, PIX_FMT_RGB24, width, height, 0);
+  expected_buf = alloc_picture(&expected, PIX_FMT_RGB24, width, height, 0);
+
+  for (pix_fmt = PIX_FMT_YUV420P; pix_fmt >= 0;
+       pix_fmt = pix_fmt == PIX_FMT_YUV420P ? PIX_FMT_YUV411P : -1) {
+    src_buf = alloc_picture(&src, pix_fmt, width, height, 1);
+    upsample_to_422p(&yuv422p, &src, pix_fmt, width, height);
+
+    avpicture_fill(&out, out_buf, PIX_FMT_YUV422, width, height);
+    img_convert(&out, PIX_FMT_YUV422, &src, pix_fmt, width, height);
+    pack_yuyv(expected_buf, &yuv422p, width, height);
+    check(!memcmp(out_buf, expected_buf, width * height * 2),
+      "differs from YUV422P with the chroma repeated",
+      pix_fmt == PIX_FMT_YUV420P ? "yuv420p>yuv422" : "yuv411p>yuv422");
+
+    if (pix_fmt == PIX_FMT_YUV411P) {
+      for (i = 0; i < 3; i++) {
+        avpicture_fill(&out, out_buf, rgb_fmts[i], width, height);
+        avpicture_fill(&expected, expected_buf, rgb_fmts[i], width, height);
+        img_convert(&out, rgb_fmts[i], &src, pix_fmt, width, height);
+        img_convert(&expected, rgb_fmts[i], &yuv422p, PIX_FMT_YUV422P,
+          width, height);
+        check(!memcmp(out_buf, expected_buf,
+                      avpicture_get_size(rgb_fmts[i], width, height)),
+          "differs from YUV422P with the chroma repeated",
+          rgb_fmts[i] == PIX_FMT_RGB24 ? "yuv411p>rgb24" :
+          rgb_fmts[i] == PIX_FMT_RGB565 ? "yuv411p>rgb565" : "yuv411p>rgb555");
+      }
+    }
+    free(src_buf);
+  }
+
+  /* PAL8 to YUV422 against the same through RGB24 */
+  src_buf = alloc_picture(&src, PIX_FMT_PAL8, width, height, 1);
+  rgb24_buf = alloc_picture(&rgb24, PIX_FMT_RGB24, width, height, 0);
+  avpicture_fill(&out, out_buf, PIX_FMT_YUV422, width, height);
+  avpicture_fill(&expected, expected_buf, PIX_FMT_YUV422, width, height);
+  img_convert(&out, PIX_FMT_YUV422, &src, PIX_FMT_PAL8, width, height);
+  img_convert(&rgb24, PIX_FMT_RGB24, &src, PIX_FMT_PAL8, width, height);
+  img_convert(&expected, PIX_FMT_YUV422, &rgb24, PIX_FMT_RGB24, width, height);
+  check(!memcmp(out_buf, expected_buf, width * height * 2),
+    "differs from going through RGB24", "pal8>yuv422");
+
+  /* the luma of RGB24 to YUV422 against RGB24 to gray */
+  avpicture_fill(&expected, expected_buf, PIX_FMT_GRAY8, width, height);
+  img_convert(&expected, PIX_FMT_GRAY8, &rgb24, PIX_FMT_RGB24, width, height);
+  img_convert(&out, PIX_FMT_YUV422, &rgb24, PIX_FMT_RGB24, width, height);
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++)
+      if (out_buf[(y * width + x) * 2] != expected_buf[y * width + x]) {
+        check(0, "luma differs from RGB24 to gray", "rgb24>yuv422");
+        y = height;
+        break;
+      }
+
+  free(src_buf);
+  free(rgb24_buf);
+  free(yuv422p_buf);
+  free(out_buf);
+  free(expected_buf);
+}
+
+/* the old fallback: a temporary RGB24 picture for every frame */
+static int via_rgb24(AVPicture *dst, int dst_pix_fmt,
+                     AVPicture *src, int src_pix_fmt, int width, int height) {
+
+  AVPicture tmp;
+  uint8_t *buf;
+  int ret;
+
+  buf = av_malloc(avpicture_get_size(PIX_FMT_RGB24, width, height));
+  avpicture_fill(&tmp, buf, PIX_FMT_RGB24, width, height);
+  ret = img_convert(&tmp, PIX_FMT_RGB24, src, src_pix_fmt, width, height);
+  if (ret == 0)
+    ret = img_convert(dst, dst_pix_fmt, &tmp, PIX_FMT_RGB24, width, height);
+  av_free(buf);
+  return ret;
+}
+
+/* cycles per frame, of the best pass */
+#define TIME(call) ({\
+  uint64_t start_, elapsed_, best_ = ~(uint64_t)0;\
+  int pass_;\
+  for (pass_ = 0; pass_ < passes; pass_++) {\
+    start_ = bench_cycles();\
+    call;\
+    elapsed_ = bench_cycles() - start_;\
+    if (elapsed_ < best_)\
+      best_ = elapsed_;\
+  }\
+  (double)best_;\
+})
+
+/* checks the planned conversion of a pair against img_convert(), then
+ * times the three ways */
+static void run_pair(int i, int width, int height, int passes) {
+
+  AVPicture src, dst;
+  ImgConvertContext *s;
+  uint8_t *src_buf, *dst_buf, *expected;
+  int src_pix_fmt = pairs[i].src_pix_fmt, dst_pix_fmt = pairs[i].dst_pix_fmt;
+  int size = avpicture_get_size(dst_pix_fmt, width, height);
+  double via = 0, single, planned;
+  char via_text[16];
+
+  src_buf = alloc_picture(&src, src_pix_fmt, width, height, 1);
+  dst_buf = alloc_picture(&dst, dst_pix_fmt, width, height, 0);
+  expected = malloc(size);
+
+  s = img_convert_init(dst_pix_fmt, src_pix_fmt, width, height);
+  if (!s) {
+    check(0, "no route planned", pairs[i].name);
+    goto done;
+  }
+  if (img_convert(&dst, dst_pix_fmt, &src, src_pix_fmt, width, height) < 0) {
+    check(0, "img_convert() fails", pairs[i].name);
+    goto done;
+  }
+  memcpy(expected, dst_buf, size);
+  memset(dst_buf, 0, size);
+  img_convert_frame(s, &dst, &src);
+  check(!memcmp(expected, dst_buf, size),
+    "the planned conversion differs from img_convert()", pairs[i].name);
+
+  strcpy(via_text, "-");
+  if (src_pix_fmt != PIX_FMT_RGB24 && dst_pix_fmt != PIX_FMT_RGB24) {
+    via = TIME(via_rgb24(&dst, dst_pix_fmt, &src, src_pix_fmt,
+      width, height));
+    sprintf(via_text, "%.0f", via);
+  }
+  single = TIME(img_convert(&dst, dst_pix_fmt, &src, src_pix_fmt,
+    width, height));
+  planned = TIME(img_convert_frame(s, &dst, &src));
+  printf("%-16s %12s %12.0f %12.0f %7.2fx\n", pairs[i].name, via_text,
+    single, planned, (via ? via : single) / planned);
+
+done:
+  if (s)
+    img_convert_close(s);
+  free(src_buf);
+  free(dst_buf);
+  free(expected);
+}
+
+int main(int argc, char *argv[]) {
+
+  AVCodecContext *context;
+  DSPContext dsp;
+  int passes = 50;
+  int i;
+
+  if (argc > 1)
+    passes = atoi(argv[1]);
+
+  /* the YUV to RGB converters clamp through the crop table, which only
+   * dsputil_init() fills in */
+  avcodec_init();
+  context = avcodec_alloc_context();
+  dsputil_init(&dsp, context);
+  av_free(context);
+
+  check_kernels(CHECK_WIDTH, CHECK_HEIGHT);
+  check_kernels(WIDTH, HEIGHT);
+
+  printf("%-16s %12s %12s %12s %8s   (%s/frame, %dx%d)\n", "pair",
+    "via rgb24", "img_convert", "planned", "speedup", BENCH_UNIT,
+    WIDTH, HEIGHT);
+  for (i = 0; i < NUM_PAIRS; i++)
+    run_pair(i, WIDTH, HEIGHT, passes);
+
+  if (errors) {
+    printf("%d errors\n", errors);
+    return 1;
+  }
+  printf("the planned conversions match img_convert() and the references\n");
+  return 0;
+}
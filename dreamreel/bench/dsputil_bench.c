@@ -0,0 +1,290 @@
+/*
+ * Dreamreel dsputil benchmark
+ *
+ * Sets up one DSPContext with every CPU feature masked off, which leaves
+ * the C functions, and one the way a decoder gets it, with whatever
+ * dsputil_init() picked for this machine. Each entry that differs is fed
+ * the same random input in both, at every size and height a decoder asks
+ * for and from unaligned sources, and the results must match exactly;
+ * then both are timed. A dsp_mask, as an AVCodecContext takes it, can be
+ * given to leave some of the instruction sets out.
+ *
+ *   ./dsputil_bench [iterations [dsp_mask]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "avcodec.h"
+#include "dsputil.h"
+#include "bench.h"
+
+#define STRIDE      64
+#define PLANE_SIZE  (STRIDE * 20)
+#define TIME_CALLS  256
+#define TIME_PASSES 32
+
+static DSPContext ref_dsp, dsp;
+
+static uint8_t src[PLANE_SIZE], src2[PLANE_SIZE];
+static uint8_t ref_dst[PLANE_SIZE], dst[PLANE_SIZE];
+static DCTELEM ref_blocks[6 * 64], blocks[6 * 64];
+
+static unsigned int seed = 1;
+
+static int mismatches;
+
+static int rnd(void) {
+
+  seed = seed * 1103515245 + 12345;
+  return (seed >> 16) & 0x7fff;
+}
+
+static void fill(uint8_t *buf, int size) {
+
+  int i;
+
+  for (i = 0; i < size; i++)
+    buf[i] = rnd();
+}
+
+static void init_dsp(DSPContext *c, unsigned dsp_mask) {
+
+  AVCodecContext *avctx = avcodec_alloc_context();
+
+  avctx->idct_algo = FF_IDCT_SIMPLE;
+  avctx->dsp_mask = dsp_mask;
+  dsputil_init(c, avctx);
+  av_free(avctx);
+}
+
+static void check(int ok, const char *name, int size, int h) {
+
+  if (!ok) {
+    printf("%s %dx%d differs from C\n", name, size, h);
+    mismatches++;
+  }
+}
+
+/* cycles per call, of the best pass */
+#define TIME(call) ({\
+  uint64_t start_, elapsed_, best_ = ~(uint64_t)0;\
+  int pass_, i_;\
+  for (pass_ = 0; pass_ < TIME_PASSES; pass_++) {\
+    start_ = bench_cycles();\
+    for (i_ = 0; i_ < TIME_CALLS; i_++)\
+      call;\
+    elapsed_ = bench_cycles() - start_;\
+    if (elapsed_ < best_)\
+      best_ = elapsed_;\
+  }\
+  (double)best_ / TIME_CALLS;\
+})
+
+static void report(const char *name, double c, double simd) {
+
+  printf("%-28s %10.1f %10.1f %7.2fx\n", name, c, simd, c / simd);
+}
+
+static const char *tab_names[4] = {
+  "put_pixels", "avg_pixels", "put_no_rnd_pixels", "avg_no_rnd_pixels"
+};
+static const char *mode_names[4] = { "", "_x2", "_y2", "_xy2" };
+
+static op_pixels_func (*pixels_tab(DSPContext *c, int tab))[4] {
+
+  switch (tab) {
+  case 0:  return c->put_pixels_tab;
+  case 1:  return c->avg_pixels_tab;
+  case 2:  return c->put_no_rnd_pixels_tab;
+  default: return c->avg_no_rnd_pixels_tab;
+  }
+}
+
+static void test_pixels(int iterations) {
+
+  op_pixels_func f, ref_f;
+  char name[64];
+  int tab, size, mode, h, n, offset;
+
+  for (tab = 0; tab < 4; tab++) {
+    for (size = 0; size < 2; size++) {
+      for (mode = 0; mode < 4; mode++) {
+        f = pixels_tab(&dsp, tab)[size][mode];
+        ref_f = pixels_tab(&ref_dsp, tab)[size][mode];
+        sprintf(name, "%s%d%s",
+          tab_names[tab], size ? 8 : 16, mode_names[mode]);
+
+        for (h = size ? 4 : 8; h <= (size ? 8 : 16); h *= 2) {
+          for (n = 0; n < iterations; n++) {
+            offset = rnd() % 16 + STRIDE;
+            fill(src, PLANE_SIZE);
+            fill(ref_dst, PLANE_SIZE);
+            memcpy(dst, ref_dst, PLANE_SIZE);
+            ref_f(ref_dst + STRIDE, src + offset, STRIDE, h);
+            f(dst + STRIDE, src + offset, STRIDE, h);
+            check(!memcmp(ref_dst, dst, PLANE_SIZE), name, size ? 8 : 16, h);
+          }
+        }
+
+        if (f != ref_f)
+          report(name,
+            TIME(ref_f(ref_dst, src + 1, STRIDE, size ? 8 : 16)),
+            TIME(f(dst, src + 1, STRIDE, size ? 8 : 16)));
+      }
+    }
+  }
+}
+
+/* the C versions clip through a table that covers -384..639, so that is
+ * the range they are compared over */
+static void fill_block(DCTELEM *block, int min, int max) {
+
+  int i;
+
+  for (i = 0; i < 64; i++)
+    block[i] = min + rnd() % (max - min + 1);
+}
+
+static void test_clamped(int iterations) {
+
+  int n;
+
+  for (n = 0; n < iterations; n++) {
+    fill_block(ref_blocks, -384, 639);
+    fill(ref_dst, PLANE_SIZE);
+    memcpy(dst, ref_dst, PLANE_SIZE);
+    ref_dsp.put_pixels_clamped(ref_blocks, ref_dst + 3, STRIDE);
+    dsp.put_pixels_clamped(ref_blocks, dst + 3, STRIDE);
+    check(!memcmp(ref_dst, dst, PLANE_SIZE), "put_pixels_clamped", 8, 8);
+
+    fill_block(ref_blocks, -384, 384);
+    fill(ref_dst, PLANE_SIZE);
+    memcpy(dst, ref_dst, PLANE_SIZE);
+    ref_dsp.add_pixels_clamped(ref_blocks, ref_dst + 3, STRIDE);
+    dsp.add_pixels_clamped(ref_blocks, dst + 3, STRIDE);
+    check(!memcmp(ref_dst, dst, PLANE_SIZE), "add_pixels_clamped", 8, 8);
+
+    fill_block(ref_blocks, -32768, 32767);
+    fill_block(blocks, -32768, 32767);
+    ref_dsp.clear_blocks(ref_blocks);
+    dsp.clear_blocks(blocks);
+    check(!memcmp(ref_blocks, blocks, sizeof(blocks)), "clear_blocks", 6 * 64, 1);
+  }
+
+  report("put_pixels_clamped",
+    TIME(ref_dsp.put_pixels_clamped(ref_blocks, ref_dst, STRIDE)),
+    TIME(dsp.put_pixels_clamped(ref_blocks, dst, STRIDE)));
+  report("add_pixels_clamped",
+    TIME(ref_dsp.add_pixels_clamped(ref_blocks, ref_dst, STRIDE)),
+    TIME(dsp.add_pixels_clamped(ref_blocks, dst, STRIDE)));
+  report("clear_blocks",
+    TIME(ref_dsp.clear_blocks(ref_blocks)),
+    TIME(dsp.clear_blocks(blocks)));
+}
+
+static void test_bytes(int iterations) {
+
+  static const int widths[] = { 1, 15, 16, 17, 31, 32, 33, 63, 320, 641 };
+  int n, i, w;
+
+  for (i = 0; i < sizeof(widths) / sizeof(widths[0]); i++) {
+    w = widths[i];
+    for (n = 0; n < iterations; n++) {
+      fill(src, PLANE_SIZE);
+      fill(src2, PLANE_SIZE);
+      fill(ref_dst, PLANE_SIZE);
+      memcpy(dst, ref_dst, PLANE_SIZE);
+      ref_dsp.add_bytes(ref_dst, src + 1, w);
+      dsp.add_bytes(dst, src + 1, w);
+      check(!memcmp(ref_dst, dst, PLANE_SIZE), "add_bytes", w, 1);
+
+      ref_dsp.diff_bytes(ref_dst, src + 2, src2 + 1, w);
+      dsp.diff_bytes(dst, src + 2, src2 + 1, w);
+      check(!memcmp(ref_dst, dst, PLANE_SIZE), "diff_bytes", w, 1);
+    }
+  }
+
+  report("add_bytes 640",
+    TIME(ref_dsp.add_bytes(ref_dst, src, 640)),
+    TIME(dsp.add_bytes(dst, src, 640)));
+  report("diff_bytes 640",
+    TIME(ref_dsp.diff_bytes(ref_dst, src, src2, 640)),
+    TIME(dsp.diff_bytes(dst, src, src2, 640)));
+}
+
+static void test_sad(int iterations) {
+
+  op_pixels_abs_func fs[8], ref_fs[8];
+  me_cmp_func sad, ref_sad;
+  static const char *names[8] = {
+    "pix_abs16x16", "pix_abs16x16_x2", "pix_abs16x16_y2", "pix_abs16x16_xy2",
+    "pix_abs8x8", "pix_abs8x8_x2", "pix_abs8x8_y2", "pix_abs8x8_xy2"
+  };
+  int i, n, offset, size;
+
+  fs[0] = dsp.pix_abs16x16;     ref_fs[0] = ref_dsp.pix_abs16x16;
+  fs[1] = dsp.pix_abs16x16_x2;  ref_fs[1] = ref_dsp.pix_abs16x16_x2;
+  fs[2] = dsp.pix_abs16x16_y2;  ref_fs[2] = ref_dsp.pix_abs16x16_y2;
+  fs[3] = dsp.pix_abs16x16_xy2; ref_fs[3] = ref_dsp.pix_abs16x16_xy2;
+  fs[4] = dsp.pix_abs8x8;       ref_fs[4] = ref_dsp.pix_abs8x8;
+  fs[5] = dsp.pix_abs8x8_x2;    ref_fs[5] = ref_dsp.pix_abs8x8_x2;
+  fs[6] = dsp.pix_abs8x8_y2;    ref_fs[6] = ref_dsp.pix_abs8x8_y2;
+  fs[7] = dsp.pix_abs8x8_xy2;   ref_fs[7] = ref_dsp.pix_abs8x8_xy2;
+
+  for (i = 0; i < 8; i++) {
+    size = i < 4 ? 16 : 8;
+    for (n = 0; n < iterations; n++) {
+      fill(src, PLANE_SIZE);
+      fill(src2, PLANE_SIZE);
+      offset = rnd() % 16;
+      check(ref_fs[i](src, src2 + offset, STRIDE) ==
+            fs[i](src, src2 + offset, STRIDE), names[i], size, size);
+    }
+    if (fs[i] != ref_fs[i])
+      report(names[i],
+        TIME(ref_fs[i](src, src2 + 1, STRIDE)),
+        TIME(fs[i](src, src2 + 1, STRIDE)));
+  }
+
+  for (i = 0; i < 2; i++) {
+    sad = dsp.sad[i];
+    ref_sad = ref_dsp.sad[i];
+    for (n = 0; n < iterations; n++) {
+      fill(src, PLANE_SIZE);
+      fill(src2, PLANE_SIZE);
+      offset = rnd() % 16;
+      check(ref_sad(NULL, src, src2 + offset, STRIDE) ==
+            sad(NULL, src, src2 + offset, STRIDE), "sad", i ? 8 : 16, i ? 8 : 16);
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+
+  int iterations = 200;
+  unsigned dsp_mask = 0;
+
+  if (argc > 1)
+    iterations = atoi(argv[1]);
+  if (argc > 2)
+    dsp_mask = strtoul(argv[2], NULL, 0);
+
+  avcodec_init();
+  init_dsp(&ref_dsp, 0xffff);
+  init_dsp(&dsp, dsp_mask);
+
+  printf("%-28s %10s %10s %8s\n", "function", BENCH_UNIT " C", BENCH_UNIT, "speedup");
+  test_pixels(iterations);
+  test_clamped(iterations);
+  test_bytes(iterations);
+  test_sad(iterations);
+
+  if (mismatches) {
+    printf("%d mismatches\n", mismatches);
+    return 1;
+  }
+  printf("all functions match C\n");
+  return 0;
+}
@@ -0,0 +1,271 @@
+/*
+ * Dreamreel FILM sample index check
+ *
+ * Packs synthetic FILM sample tables with the demuxer's film_index_add()
+ * and checks every entry that film_index_get() hands back against the
+ * film_sample_t the demuxer used to keep for it, computed here the way
+ * the loader computes it. Each table is walked forwards, backwards, and
+ * in short runs either way after jumps to random samples, and
+ * film_index_find_offset() and film_index_find_pts() are checked against
+ * a linear search where the table is in order for them.
+ *
+ * The tables are:
+ *
+ *   video      video only, a keyframe every 12 frames, the odd frame
+ *              with a longer duration
+ *   av         video and audio interleaved, audio chunks of varying size
+ *   gaps       av with padding between samples, and the odd sample
+ *              listed before the one it follows in the file
+ *   long       60000 samples of av, timing the walks
+ *   short      fewer samples than a group
+ *
+ * Exits with 1 if any entry differs.
+ *
+ *   ./film_index_bench
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "film_index.h"
+#include "bench.h"
+
+#define FREQUENCY 600
+#define AUDIO_BYTES_PER_SECOND 22050
+
+enum { TABLE_VIDEO, TABLE_AV, TABLE_GAPS };
+
+static const struct {
+  const char *name;
+  int layout;
+  unsigned int count;
+} tables[] = {
+  { "video", TABLE_VIDEO,  2000 },
+  { "av",    TABLE_AV,     2000 },
+  { "gaps",  TABLE_GAPS,   2000 },
+  { "long",  TABLE_AV,    60000 },
+  { "short", TABLE_AV,       21 },
+};
+#define NUM_TABLES (sizeof(tables) / sizeof(tables[0]))
+
+static unsigned int seed = 1;
+
+static int rnd(void) {
+
+  seed = seed * 1103515245 + 12345;
+  return (seed >> 16) & 0x7fff;
+}
+
+/* the STAB entries of a synthetic table */
+typedef struct {
+  off_t offset;
+  unsigned int size, pts, duration;
+} stab_entry_t;
+
+static void make_table(stab_entry_t *stab, unsigned int count, int layout) {
+
+  unsigned int i, frame = 0;
+  off_t offset = 0x800;
+  stab_entry_t swap;
+
+  for (i = 0; i < count; i++) {
+    if ((layout != TABLE_VIDEO) && (rnd() % 3 == 0)) {
+      stab[i].size = 1000 + rnd() % 2000;
+      stab[i].pts = 0xFFFFFFFF;
+      stab[i].duration = 1;
+    } else {
+      stab[i].size = 100 + rnd() % 8000;
+      stab[i].pts = frame * 40;
+      if (frame % 12)
+        stab[i].pts |= 0x80000000;
+      stab[i].duration = (rnd() % 50) ? 40 : 80;
+      frame++;
+    }
+    if ((layout == TABLE_GAPS) && (rnd() % 8 == 0))
+      offset += rnd() % 4096;
+    stab[i].offset = offset;
+    offset += stab[i].size;
+  }
+
+  /* list the odd pair of samples in the other order */
+  if (layout == TABLE_GAPS) {
+    for (i = 1; i < count; i += 37) {
+      swap = stab[i - 1];
+      stab[i - 1] = stab[i];
+      stab[i] = swap;
+    }
+  }
+}
+
+/* what the loader made of a STAB entry before the index was packed */
+static void unpack_entry(film_sample_t *sample, const stab_entry_t *entry,
+  unsigned int *audio_bytes) {
+
+  sample->sample_offset = entry->offset;
+  sample->sample_size = entry->size;
+  sample->duration = entry->duration;
+
+  if (entry->pts == 0xFFFFFFFF) {
+    sample->audio = 1;
+    sample->keyframe = 0;
+    sample->pts = *audio_bytes;
+    sample->pts *= 90000;
+    sample->pts /= AUDIO_BYTES_PER_SECOND;
+    *audio_bytes += entry->size;
+  } else {
+    sample->audio = 0;
+    sample->keyframe = (entry->pts & 0x80000000) ? 0 : 1;
+    sample->pts = entry->pts & 0x7FFFFFFF;
+    sample->pts *= 90000;
+    sample->pts /= FREQUENCY;
+    sample->duration *= 90000;
+    sample->duration /= FREQUENCY;
+  }
+}
+
+static int check_entry(film_index_t *index, film_sample_t *expected,
+  unsigned int n, const char *name, const char *walk) {
+
+  film_sample_t *packed = film_index_get(index, n);
+
+  if ((packed->sample_offset == expected[n].sample_offset) &&
+      (packed->sample_size == expected[n].sample_size) &&
+      (packed->pts == expected[n].pts) &&
+      (packed->duration == expected[n].duration) &&
+      (packed->audio == expected[n].audio) &&
+      (packed->keyframe == expected[n].keyframe))
+    return 0;
+
+  printf("%s: sample %u differs walking %s\n", name, n, walk);
+  return 1;
+}
+
+static unsigned int linear_find_offset(film_sample_t *samples,
+  unsigned int count, off_t key) {
+
+  unsigned int n, last = 0;
+
+  for (n = 0; n < count; n++)
+    if (samples[n].sample_offset <= key)
+      last = n;
+  return last;
+}
+
+static unsigned int linear_find_pts(film_sample_t *samples,
+  unsigned int count, int64_t key) {
+
+  unsigned int n, last = 0;
+
+  for (n = 0; n < count; n++)
+    if (samples[n].pts <= key)
+      last = n;
+  return last;
+}
+
+int main(void) {
+
+  film_index_t index;
+  stab_entry_t *stab;
+  film_sample_t *expected;
+  unsigned int i, j, n, count, audio_bytes, steps;
+  int errors = 0, table_errors;
+  uint64_t start, forwards, backwards;
+  off_t offset_key;
+  int64_t pts_key;
+
+  memset(&index, 0, sizeof(index));
+
+  printf("%-6s %8s %9s %9s %12s %12s   (%s/sample)\n", "table", "samples",
+    "packed", "unpacked", "forwards", "backwards", BENCH_UNIT);
+  for (i = 0; i < NUM_TABLES; i++) {
+    count = tables[i].count;
+    stab = malloc(count * sizeof(stab_entry_t));
+    expected = malloc(count * sizeof(film_sample_t));
+    if (!stab || !expected)
+      return 1;
+    make_table(stab, count, tables[i].layout);
+
+    if (!film_index_init(&index, count, FREQUENCY, AUDIO_BYTES_PER_SECOND))
+      return 1;
+    audio_bytes = 0;
+    for (j = 0; j < count; j++) {
+      if (!film_index_add(&index, stab[j].offset, stab[j].size,
+        stab[j].pts, stab[j].duration))
+        return 1;
+      unpack_entry(&expected[j], &stab[j], &audio_bytes);
+    }
+    film_index_finish(&index);
+
+    table_errors = 0;
+
+    start = bench_cycles();
+    for (n = 0; n < count; n++)
+      table_errors += check_entry(&index, expected, n, tables[i].name,
+        "forwards");
+    forwards = bench_cycles() - start;
+
+    start = bench_cycles();
+    for (n = count; n-- > 0; )
+      table_errors += check_entry(&index, expected, n, tables[i].name,
+        "backwards");
+    backwards = bench_cycles() - start;
+
+    /* jump about, then play on or scan back a little from there */
+    for (j = 0; j < 500; j++) {
+      n = (rnd() * 32768 + rnd()) % count;
+      steps = rnd() % 80;
+      if (j & 1) {
+        for (; steps-- && (n < count); n++)
+          table_errors += check_entry(&index, expected, n, tables[i].name,
+            "forwards after a seek");
+      } else {
+        for (; steps-- && (n > 0); n--)
+          table_errors += check_entry(&index, expected, n, tables[i].name,
+            "backwards after a seek");
+      }
+    }
+
+    /* the searches need the field in order over the table */
+    if (tables[i].layout != TABLE_GAPS) {
+      for (j = 0; j < 200; j++) {
+        offset_key = expected[count - 1].sample_offset *
+          (rnd() % 1100) / 1000;
+        if (film_index_find_offset(&index, offset_key) !=
+            linear_find_offset(expected, count, offset_key)) {
+          printf("%s: film_index_find_offset(%lld) differs\n",
+            tables[i].name, (long long)offset_key);
+          table_errors++;
+        }
+      }
+    }
+    if (tables[i].layout == TABLE_VIDEO) {
+      for (j = 0; j < 200; j++) {
+        pts_key = expected[count - 1].pts * (rnd() % 1100) / 1000;
+        if (film_index_find_pts(&index, pts_key) !=
+            linear_find_pts(expected, count, pts_key)) {
+          printf("%s: film_index_find_pts(%lld) differs\n",
+            tables[i].name, (long long)pts_key);
+          table_errors++;
+        }
+      }
+    }
+
+    printf("%-6s %8u %9u %9u %12.1f %12.1f%s\n", tables[i].name, count,
+      index.data_size, (unsigned int)(count * sizeof(film_sample_t)),
+      (double)forwards / count, (double)backwards / count,
+      table_errors ? "  FAILED" : "");
+    errors += table_errors;
+
+    film_index_free(&index);
+    free(stab);
+    free(expected);
+  }
+
+  if (errors) {
+    printf("%d errors\n", errors);
+    return 1;
+  }
+  printf("every packed entry matches the unpacked table\n");
+  return 0;
+}
@@ -0,0 +1,147 @@
+/*
+ * Dreamreel IDCT benchmark
+ *
+ * Runs each of the idcts that dsputil_init() can choose from through the
+ * IEEE 1180 accuracy test, at every range and sign the standard asks
+ * for, and times it on full random blocks and on blocks as sparse as a
+ * decoder's. The C reference of the ftrv IDCT is timed as well, and
+ * checked against the ftrv path that was built for this machine. Last
+ * comes the choice FF_IDCT_AUTO makes.
+ *
+ *   ./idct_bench [blocks]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "avcodec.h"
+#include "dsputil.h"
+#include "bench.h"
+
+#define TIME_BLOCKS 256
+#define TIME_PASSES 64
+
+static const struct {
+  int         idct_algo;
+  const char *name;
+} idcts[] = {
+  { FF_IDCT_SIMPLE, "simple" },
+  { FF_IDCT_INT,    "jrevdct" },
+  { FF_IDCT_FTRV,   "ftrv" },
+};
+#define NUM_IDCTS (sizeof(idcts) / sizeof(idcts[0]))
+
+/* the ranges of the IEEE 1180 test, each run with both signs */
+static const int ranges[] = { 256, 5, 300 };
+#define NUM_RANGES (sizeof(ranges) / sizeof(ranges[0]))
+
+static DCTELEM full_blocks[TIME_BLOCKS][64];
+static DCTELEM sparse_blocks[TIME_BLOCKS][64];
+
+static const char *idct_name(int idct_algo) {
+
+  int i;
+
+  for (i = 0; i < NUM_IDCTS; i++)
+    if (idcts[i].idct_algo == idct_algo)
+      return idcts[i].name;
+  return "?";
+}
+
+/* cost per block of the bare idct, permutation not included */
+static double time_idct(void (*idct)(DCTELEM *block), uint8_t *permutation,
+                        DCTELEM blocks[TIME_BLOCKS][64]) {
+
+  static DCTELEM permuted[TIME_BLOCKS][64];
+  DCTELEM block[64];
+  uint64_t start, elapsed, best = ~(uint64_t)0;
+  int pass, i, j;
+
+  for (i = 0; i < TIME_BLOCKS; i++)
+    for (j = 0; j < 64; j++)
+      permuted[i][permutation[j]] = blocks[i][j];
+
+  for (pass = 0; pass < TIME_PASSES; pass++) {
+    start = bench_cycles();
+    for (i = 0; i < TIME_BLOCKS; i++) {
+      memcpy(block, permuted[i], sizeof(block));
+      idct(block);
+    }
+    elapsed = bench_cycles() - start;
+    if (elapsed < best)
+      best = elapsed;
+  }
+
+  return (double)best / TIME_BLOCKS;
+}
+
+int main(int argc, char *argv[]) {
+
+  void (*idct)(DCTELEM *block);
+  uint8_t permutation[64];
+  IDCTAccuracy acc;
+  DCTELEM block[64], reference[64];
+  int mismatches;
+  unsigned int seed = 1;
+  int blocks = 10000;
+  int i, r, sign, pass, all_pass;
+
+  if (argc > 1)
+    blocks = atoi(argv[1]);
+
+  for (i = 0; i < TIME_BLOCKS; i++) {
+    ff_idct_random_block(full_blocks[i], 256, 256, 1, &seed);
+    ff_idct_sparse_block(sparse_blocks[i], i, &seed);
+  }
+
+  printf("%-8s %6s %5s %4s %8s %8s %8s %8s  %s\n",
+    "idct", "range", "sign", "peak", "pmse", "omse", "pme", "ome", "1180");
+  for (i = 0; i < NUM_IDCTS; i++) {
+    all_pass = 1;
+    for (r = 0; r < NUM_RANGES; r++) {
+      for (sign = 1; sign >= -1; sign -= 2) {
+        pass = ff_idct_test(idcts[i].idct_algo, blocks, ranges[r], sign, &acc);
+        all_pass &= (pass == 1);
+        printf("%-8s %6d %5s %4d %8.5f %8.5f %8.5f %8.5f  %s\n",
+          idcts[i].name, ranges[r], sign > 0 ? "+" : "-", acc.peak_error,
+          acc.peak_mse, acc.overall_mse, acc.peak_mean_error,
+          acc.overall_mean_error, pass == 1 ? "pass" : "FAIL");
+      }
+    }
+    if (!all_pass)
+      printf("%-8s does not meet IEEE 1180\n", idcts[i].name);
+  }
+
+  printf("\n%-8s %14s %14s\n",
+    "idct", BENCH_UNIT "/full", BENCH_UNIT "/sparse");
+  for (i = 0; i < NUM_IDCTS; i++) {
+    ff_idct_get(idcts[i].idct_algo, &idct, permutation);
+    printf("%-8s %14.1f %14.1f\n", idcts[i].name,
+      time_idct(idct, permutation, full_blocks),
+      time_idct(idct, permutation, sparse_blocks));
+  }
+
+  /* the C reference of the ftrv formulation, and whether the path that
+   * was built agrees with it */
+  for (i = 0; i < 64; i++)
+    permutation[i] = i;
+  printf("%-8s %14.1f %14.1f\n", "ftrv-c",
+    time_idct(ff_idct_ftrv_c, permutation, full_blocks),
+    time_idct(ff_idct_ftrv_c, permutation, sparse_blocks));
+  mismatches = 0;
+  for (i = 0; i < TIME_BLOCKS; i++) {
+    memcpy(block, full_blocks[i], sizeof(block));
+    memcpy(reference, full_blocks[i], sizeof(reference));
+    ff_idct_ftrv(block);
+    ff_idct_ftrv_c(reference);
+    if (memcmp(block, reference, sizeof(block)))
+      mismatches++;
+  }
+  printf("ftrv differs from ftrv-c in %d of %d blocks\n",
+    mismatches, TIME_BLOCKS);
+
+  printf("\nFF_IDCT_AUTO picks %s\n", idct_name(ff_idct_auto()));
+
+  return 0;
+}
@@ -0,0 +1,147 @@
+/*
+ * Dreamreel codec open benchmark
+ *
+ * Times avcodec_open() and avcodec_close() for each decoder the engine
+ * uses and counts the heap calls they make. The first open of a decoder
+ * also pays for whatever tables it sets up once per process, so it is
+ * reported apart from the opens after it. The IDCT is fixed, so that
+ * FF_IDCT_AUTO's one-off measurement is left out.
+ *
+ * The allocator calls are counted by wrapping av_malloc(), av_realloc()
+ * and av_free() at link time (see the Makefile); av_mallocz() goes
+ * through av_malloc(), so it is counted there.
+ *
+ *   ./open_bench [reopens]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "avcodec.h"
+#include "bench.h"
+
+typedef struct {
+  const char      *name;
+  enum CodecID     codec_id;
+  int              width, height;
+} open_test_t;
+
+static const open_test_t tests[] = {
+  { "flic",  CODEC_ID_FLIC,       320, 200 },
+  { "idcin", CODEC_ID_IDCIN,      320, 240 },
+  { "cyuv",  CODEC_ID_CYUV,       320, 240 },
+  { "mpeg1", CODEC_ID_MPEG1VIDEO, 352, 240 },
+  { "rpza",  CODEC_ID_RPZA,       320, 240 },
+  { "msvideo1", CODEC_ID_MSVIDEO1, 320, 240 },
+};
+#define NUM_TESTS (sizeof(tests) / sizeof(tests[0]))
+
+typedef struct {
+  int              mallocs, reallocs, frees;
+  size_t           bytes;
+} heap_count_t;
+
+static heap_count_t heap;
+
+void *__real_av_malloc(unsigned int size);
+void *__real_av_realloc(void *ptr, unsigned int size);
+void __real_av_free(void *ptr);
+
+void *__wrap_av_malloc(unsigned int size) {
+
+  heap.mallocs++;
+  heap.bytes += size;
+  return __real_av_malloc(size);
+}
+
+void *__wrap_av_realloc(void *ptr, unsigned int size) {
+
+  heap.reallocs++;
+  heap.bytes += size;
+  return __real_av_realloc(ptr, size);
+}
+
+void __wrap_av_free(void *ptr) {
+
+  if (ptr)
+    heap.frees++;
+  __real_av_free(ptr);
+}
+
+static uint8_t histograms[65536];
+
+/* cycles for one open and close, and the heap calls made during it */
+static uint64_t open_close(const open_test_t *test, heap_count_t *count) {
+
+  AVCodecContext *context;
+  uint64_t start, elapsed = 0;
+
+  context = avcodec_alloc_context();
+  context->width = test->width;
+  context->height = test->height;
+  /* FF_IDCT_AUTO times the IDCTs on first use, which would swamp the
+   * rest of the first open */
+  context->idct_algo = FF_IDCT_SIMPLE;
+  /* as the engine opens them */
+  context->flags |= CODEC_FLAG_TWIDDLED;
+  if (test->codec_id == CODEC_ID_IDCIN) {
+    context->pix_fmt = PIX_FMT_PAL8;
+    context->extradata = histograms;
+    context->extradata_size = sizeof(histograms);
+  }
+
+  memset(&heap, 0, sizeof(heap));
+  start = bench_cycles();
+  if (avcodec_open(context, avcodec_find_decoder(test->codec_id)) < 0) {
+    printf("%-8s could not open the decoder\n", test->name);
+    exit(1);
+  }
+  avcodec_close(context);
+  elapsed = bench_cycles() - start;
+  *count = heap;
+
+  av_free(context);
+  return elapsed;
+}
+
+int main(int argc, char *argv[]) {
+
+  const open_test_t *test;
+  heap_count_t first, again;
+  uint64_t first_cycles, cycles, best;
+  int reopens = 100;
+  int i, n;
+
+  if (argc > 1)
+    reopens = atoi(argv[1]);
+
+  avcodec_init();
+  register_avcodec(&cyuv_decoder);
+  register_avcodec(&flic_decoder);
+  register_avcodec(&idcin_decoder);
+  register_avcodec(&mpeg_decoder);
+  register_avcodec(&msvideo1_decoder);
+  register_avcodec(&rpza_decoder);
+
+  printf("%-8s %12s %8s %8s %8s %10s   %12s %8s %10s\n",
+    "codec", "first " BENCH_UNIT, "mallocs", "reallocs", "frees", "bytes",
+    "again " BENCH_UNIT, "mallocs", "bytes");
+  for (i = 0; i < NUM_TESTS; i++) {
+    test = &tests[i];
+
+    first_cycles = open_close(test, &first);
+    for (best = ~(uint64_t)0, n = 0; n < reopens; n++) {
+      cycles = open_close(test, &again);
+      if (cycles < best)
+        best = cycles;
+    }
+
+    printf("%-8s %12llu %8d %8d %8d %10lu   %12llu %8d %10lu\n", test->name,
+      (unsigned long long)first_cycles, first.mallocs, first.reallocs,
+      first.frees, (unsigned long)first.bytes,
+      (unsigned long long)best, again.mallocs + again.reallocs,
+      (unsigned long)again.bytes);
+  }
+  return 0;
+}
@@ -0,0 +1,74 @@
+/*
+ * Dreamreel resampler benchmark
+ *
+ * Feeds a synthetic tone through audio_resample() at each quality level
+ * for the sample rates that FILM, Id CIN and QuickTime files commonly use
+ * and reports the cost per output sample.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "avcodec.h"
+#include "bench.h"
+
+#define INPUT_SAMPLES (1 << 18)
+#define OUTPUT_RATE 44100
+#define BUFFER_SAMPLES 4096
+
+static const int input_rates[] = { 11025, 16000, 22050, 22254, 32000 };
+#define NUM_INPUT_RATES (sizeof(input_rates) / sizeof(input_rates[0]))
+
+static const char *quality_names[] = { "linear", "medium", "high" };
+
+int main(int argc, char *argv[]) {
+
+  short *input, *output;
+  ReSampleContext *s;
+  uint64_t start, elapsed;
+  int64_t expected;
+  int channels, quality, r, i, n, total;
+
+  input = malloc(INPUT_SAMPLES * 2 * sizeof(short));
+  output = malloc((BUFFER_SAMPLES * OUTPUT_RATE / 8000 + 2) * 2 * sizeof(short));
+  for (i = 0; i < INPUT_SAMPLES * 2; i++)
+    input[i] = 16000 * sin(i * 0.01);
+
+  printf("%-8s %-6s %3s %12s %10s\n",
+    "rate", "qual", "ch", BENCH_UNIT "/out", "outputs");
+  for (channels = 1; channels <= 2; channels++) {
+    for (r = 0; r < NUM_INPUT_RATES; r++) {
+      for (quality = RESAMPLE_QUALITY_LINEAR;
+           quality <= RESAMPLE_QUALITY_HIGH; quality++) {
+
+        s = audio_resample_init_quality(channels, channels,
+          OUTPUT_RATE, input_rates[r], quality);
+        total = 0;
+        start = bench_cycles();
+        for (i = 0; i < INPUT_SAMPLES; i += BUFFER_SAMPLES) {
+          n = audio_resample(s, output, input + i * channels, BUFFER_SAMPLES);
+          total += n;
+        }
+        elapsed = bench_cycles() - start;
+        audio_resample_close(s);
+
+        /* the sample clock must not drift: the output count may only
+         * trail the ideal count by the filter's look-ahead */
+        expected = (int64_t)INPUT_SAMPLES * OUTPUT_RATE / input_rates[r];
+        if (total > expected + 1 || total < expected - 16 * OUTPUT_RATE / input_rates[r] - 1)
+          printf("  output count %d is off (expected ~%lld)\n",
+            total, (long long)expected);
+
+        printf("%-8d %-6s %3d %12.2f %10d\n",
+          input_rates[r], quality_names[quality], channels,
+          (double)elapsed / total, total);
+      }
+    }
+  }
+
+  free(input);
+  free(output);
+
+  return 0;
+}
@@ -0,0 +1,323 @@
+/*
+ * Dreamreel twiddle benchmark
+ *
+ * Times the routes from a decoded PAL8 frame to a PVR texture at the
+ * texture sizes the engine uses:
+ *
+ *   pal8       twiddle_pal8(), the 8bpp paletted texture
+ *   two-pass   img_convert() to RGB565, then twiddle_16bpp()
+ *   fused565   twiddle_pal8_16bpp() through an RGB565 lookup table
+ *   fused1555  the same through an ARGB1555 table
+ *
+ * The fused routes must give exactly what img_convert() to RGB565 or
+ * RGB555 and then twiddle_16bpp() give.
+ *
+ * Then it times the packing of YUV420P sources too big for the screen
+ * into YUV422 textures, shrunk 2:1 or 4:1:
+ *
+ *   two-pass   box filter the planes into a smaller picture, then
+ *              pack_yuv422()
+ *   fused      pack_yuv422_shrunk(), which must give the same texels
+ *
+ * And the copying out of twiddled ARGB1555 textures from decoders of
+ * sources too big for the screen, shrunk 2:1 or 4:1:
+ *
+ *   copy       the memcpy() of an ARGB1555 texture that is not shrunk
+ *   shrink     shrink_argb1555(), which must give what box filtering the
+ *              picture and then twiddle_16bpp() give
+ *
+ *   ./twiddle_bench [passes]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "avcodec.h"
+#include "twiddle.h"
+#include "bench.h"
+
+static const struct {
+  int width, height;
+} sizes[] = {
+  { 256, 256 },   /* up to 256x256 sources */
+  { 512, 256 },   /* 320x200 and 320x240 */
+  { 512, 512 },   /* 640x480 */
+  { 256, 512 },
+};
+#define NUM_SIZES (sizeof(sizes) / sizeof(sizes[0]))
+
+static const struct {
+  int width, height, shift, texture_width;
+} yuv_sizes[] = {
+  {  720,  576, 1, 512 },   /* PAL DVD */
+  { 1280,  960, 1, 1024 },
+  { 1280,  720, 2, 512 },
+  { 1920, 1080, 2, 512 },
+};
+#define NUM_YUV_SIZES (sizeof(yuv_sizes) / sizeof(yuv_sizes[0]))
+
+static const struct {
+  int width, height, shift;
+} argb1555_sizes[] = {
+  { 1024,  512, 1 },   /* 720x480 */
+  {  512, 1024, 1 },
+  { 2048, 1024, 1 },   /* 1280x960 */
+  { 1024, 1024, 2 },
+  { 2048, 1024, 2 },   /* twiddle_16bpp() goes no further */
+};
+#define NUM_ARGB1555_SIZES (sizeof(argb1555_sizes) / sizeof(argb1555_sizes[0]))
+
+static unsigned int seed = 1;
+
+static int rnd(void) {
+
+  seed = seed * 1103515245 + 12345;
+  return (seed >> 16) & 0x7fff;
+}
+
+/* img_convert() from PAL8 to a 16-bit format, then twiddle_16bpp() */
+static void two_pass(uint16_t *texture, uint16_t *linear, int pix_fmt,
+                     uint8_t *pixels, uint32_t *palette,
+                     int width, int height) {
+
+  AVPicture src, dst;
+
+  src.data[0] = pixels;
+  src.linesize[0] = width;
+  src.data[1] = (uint8_t *)palette;
+  src.linesize[1] = 4;
+  avpicture_fill(&dst, (uint8_t *)linear, pix_fmt, width, height);
+  img_convert(&dst, pix_fmt, &src, PIX_FMT_PAL8, width, height);
+  twiddle_16bpp(texture, linear, width, height);
+}
+
+/* the rounded average of each n x m box of a plane */
+static void box_plane(uint8_t *dst, int dst_linesize, const uint8_t *src,
+                      int src_linesize, int width, int height, int n, int m) {
+
+  int x, y, i, j, sum;
+
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++) {
+      for (sum = 0, j = 0; j < m; j++)
+        for (i = 0; i < n; i++)
+          sum += src[(y * m + j) * src_linesize + x * n + i];
+      dst[y * dst_linesize + x] = (sum + n * m / 2) / (n * m);
+    }
+}
+
+/* a width x height YUV420P picture shrunk by 2^shift into small, a
+ * YUV422P picture, which is then packed into a texture the way
+ * pack_yuv422() packs */
+static void shrink_two_pass(uint16_t *texture, int texture_width,
+                            uint8_t **planes, uint8_t **small,
+                            int width, int height, int shift) {
+
+  uint32_t *out;
+  int n = 1 << shift, x, y;
+
+  width >>= shift;
+  height >>= shift;
+  box_plane(small[0], width, planes[0], width << shift, width, height, n, n);
+  box_plane(small[1], width / 2, planes[1], (width << shift) / 2,
+    width / 2, height, n, n / 2);
+  box_plane(small[2], width / 2, planes[2], (width << shift) / 2,
+    width / 2, height, n, n / 2);
+  for (y = 0; y < height; y++) {
+    out = (uint32_t *)&texture[y * texture_width];
+    for (x = 0; x < width / 2; x++)
+      out[x] = small[1][y * width / 2 + x] |
+        (small[0][y * width + x * 2] << 8) |
+        (small[2][y * width / 2 + x] << 16) |
+        ((uint32_t)small[0][y * width + x * 2 + 1] << 24);
+  }
+}
+
+/* the rounded average of each n x n box of a width x height ARGB1555
+ * picture, a channel at a time */
+static void box_argb1555(uint16_t *dst, const uint16_t *src,
+                         int width, int height, int n) {
+
+  int x, y, i, j, c, sum;
+  uint16_t texel;
+
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++) {
+      texel = 0x8000;
+      for (c = 0; c < 15; c += 5) {
+        for (sum = 0, j = 0; j < n; j++)
+          for (i = 0; i < n; i++)
+            sum += (src[(y * n + j) * width * n + x * n + i] >> c) & 0x1F;
+        texel |= ((sum + n * n / 2) / (n * n)) << c;
+      }
+      dst[y * width + x] = texel;
+    }
+}
+
+/* cycles per frame, of the best pass */
+#define TIME(call) ({\
+  uint64_t start_, elapsed_, best_ = ~(uint64_t)0;\
+  int pass_;\
+  for (pass_ = 0; pass_ < passes; pass_++) {\
+    start_ = bench_cycles();\
+    call;\
+    elapsed_ = bench_cycles() - start_;\
+    if (elapsed_ < best_)\
+      best_ = elapsed_;\
+  }\
+  (double)best_;\
+})
+
+int main(int argc, char *argv[]) {
+
+  uint8_t *pixels;
+  uint16_t *linear, *expected, *texture;
+  uint32_t palette[256];
+  uint16_t lut565[256], lut1555[256];
+  uint8_t *planes[3], *small[3];
+  uint16_t *full, *boxed;
+  double pal8, two, fused565, fused1555, fused, copy, shrink;
+  int passes = 50, width, height, shift, texture_width, i, j, errors = 0;
+
+  if (argc > 1)
+    passes = atoi(argv[1]);
+
+  avcodec_init();
+
+  for (i = 0; i < 256; i++)
+    palette[i] = 0xFF000000 | (rnd() << 16) | rnd();
+  pal8_lut_rgb565(lut565, palette);
+  pal8_lut_argb1555(lut1555, palette);
+
+  printf("%-9s %12s %12s %12s %12s %8s   (%s/frame)\n", "texture",
+    "pal8", "two-pass", "fused565", "fused1555", "speedup", BENCH_UNIT);
+  for (i = 0; i < NUM_SIZES; i++) {
+    width = sizes[i].width;
+    height = sizes[i].height;
+    pixels = malloc(width * height);
+    linear = malloc(width * height * 2);
+    expected = malloc(width * height * 2);
+    texture = malloc(width * height * 2);
+    for (j = 0; j < width * height; j++)
+      pixels[j] = rnd();
+
+    two_pass(expected, linear, PIX_FMT_RGB565, pixels, palette, width, height);
+    twiddle_pal8_16bpp(texture, pixels, width, height, lut565);
+    if (memcmp(expected, texture, width * height * 2)) {
+      printf("%dx%d: fused RGB565 differs from the two passes\n", width, height);
+      errors++;
+    }
+    two_pass(expected, linear, PIX_FMT_RGB555, pixels, palette, width, height);
+    twiddle_pal8_16bpp(texture, pixels, width, height, lut1555);
+    if (memcmp(expected, texture, width * height * 2)) {
+      printf("%dx%d: fused ARGB1555 differs from the two passes\n", width, height);
+      errors++;
+    }
+
+    pal8 = TIME(twiddle_pal8(texture, pixels, width, height));
+    two = TIME(two_pass(texture, linear, PIX_FMT_RGB565, pixels, palette,
+      width, height));
+    fused565 = TIME(twiddle_pal8_16bpp(texture, pixels, width, height, lut565));
+    fused1555 = TIME(twiddle_pal8_16bpp(texture, pixels, width, height, lut1555));
+    printf("%4dx%-4d %12.0f %12.0f %12.0f %12.0f %7.2fx\n", width, height,
+      pal8, two, fused565, fused1555, two / fused565);
+
+    free(pixels);
+    free(linear);
+    free(expected);
+    free(texture);
+  }
+
+  printf("\n%-9s %5s %12s %12s %8s   (%s/frame)\n", "yuv420p",
+    "shift", "two-pass", "fused", "speedup", BENCH_UNIT);
+  for (i = 0; i < NUM_YUV_SIZES; i++) {
+    width = yuv_sizes[i].width;
+    height = yuv_sizes[i].height;
+    shift = yuv_sizes[i].shift;
+    texture_width = yuv_sizes[i].texture_width;
+    planes[0] = malloc(width * height);
+    planes[1] = malloc(width * height / 4);
+    planes[2] = malloc(width * height / 4);
+    for (j = 0; j < width * height; j++)
+      planes[0][j] = rnd();
+    for (j = 0; j < width * height / 4; j++) {
+      planes[1][j] = rnd();
+      planes[2][j] = rnd();
+    }
+    small[0] = malloc((width >> shift) * (height >> shift));
+    small[1] = malloc((width >> shift) * (height >> shift) / 2);
+    small[2] = malloc((width >> shift) * (height >> shift) / 2);
+    expected = calloc(texture_width * (height >> shift), 2);
+    texture = calloc(texture_width * (height >> shift), 2);
+
+    shrink_two_pass(expected, texture_width, planes, small, width, height,
+      shift);
+    pack_yuv422_shrunk(texture, texture_width, planes, width, width, height,
+      shift);
+    if (memcmp(expected, texture, texture_width * (height >> shift) * 2)) {
+      printf("%dx%d: fused shrink differs from the two passes\n",
+        width, height);
+      errors++;
+    }
+
+    two = TIME(shrink_two_pass(texture, texture_width, planes, small,
+      width, height, shift));
+    fused = TIME(pack_yuv422_shrunk(texture, texture_width, planes, width,
+      width, height, shift));
+    printf("%4dx%-4d %5d %12.0f %12.0f %7.2fx\n", width, height, shift,
+      two, fused, two / fused);
+
+    for (j = 0; j < 3; j++) {
+      free(planes[j]);
+      free(small[j]);
+    }
+    free(expected);
+    free(texture);
+  }
+
+  printf("\n%-9s %5s %12s %12s %8s   (%s/frame)\n", "argb1555",
+    "shift", "copy", "shrink", "ratio", BENCH_UNIT);
+  for (i = 0; i < NUM_ARGB1555_SIZES; i++) {
+    width = argb1555_sizes[i].width;
+    height = argb1555_sizes[i].height;
+    shift = argb1555_sizes[i].shift;
+    linear = malloc(width * height * 2);
+    full = malloc(width * height * 2);
+    boxed = malloc((width >> shift) * (height >> shift) * 2);
+    expected = malloc((width >> shift) * (height >> shift) * 2);
+    texture = malloc(width * height * 2);
+    for (j = 0; j < width * height; j++)
+      linear[j] = 0x8000 | rnd();
+    twiddle_16bpp(full, linear, width, height);
+
+    box_argb1555(boxed, linear, width >> shift, height >> shift, 1 << shift);
+    twiddle_16bpp(expected, boxed, width >> shift, height >> shift);
+    shrink_argb1555(texture, full, (width >> shift) * (height >> shift),
+      shift);
+    if (memcmp(expected, texture, (width >> shift) * (height >> shift) * 2)) {
+      printf("%dx%d: ARGB1555 shrink differs from box filtering\n",
+        width, height);
+      errors++;
+    }
+
+    copy = TIME(memcpy(texture, full, width * height * 2));
+    shrink = TIME(shrink_argb1555(texture, full,
+      (width >> shift) * (height >> shift), shift));
+    printf("%4dx%-4d %5d %12.0f %12.0f %7.2fx\n", width, height, shift,
+      copy, shrink, shrink / copy);
+
+    free(linear);
+    free(full);
+    free(boxed);
+    free(expected);
+    free(texture);
+  }
+
+  if (errors) {
+    printf("%d errors\n", errors);
+    return 1;
+  }
+  printf("the fused and shrunk texels match the two passes\n");
+  return 0;
+}
@@ -1,4 +1,170 @@
 #include "dreamreel.h"
+#include "bswap.h"
+#include "trace.h"
+
+#include "common.h"
+#include "avcodec.h"
+
+/**************************************************************************
+ * audio decoder global variables
+ **************************************************************************/
+
+/* define AUDIO_RESAMPLE as 1 to convert and resample each LPCM buffer for
+ * the AICA; there is no audio output module to hand the result to yet, so
+ * by default the buffers are only checked and dropped */
+#ifndef AUDIO_RESAMPLE
+#define AUDIO_RESAMPLE 0
+#endif
+
+/* the AICA runs natively at 44100 Hz; everything else gets resampled */
+#define AUDIO_OUT_RATE 44100
+
+/* number of sample frames converted and resampled in one pass */
+#define AUDIO_CHUNK_SAMPLES 1024
+
+/* if a demuxer pts strays this far from the running sample clock, treat
+ * it as a discontinuity (e.g., a seek) and restart the clock */
+#define AUDIO_PTS_RESYNC 9000
+
+static int audio_type;
+static int audio_rate;
+static int audio_bits;
+static int audio_channels;
+
+#if AUDIO_RESAMPLE
+
+static ReSampleContext *resampler;
+static short pcm_buffer[AUDIO_CHUNK_SAMPLES * 2];
+static short *resample_buffer;
+
+/* The output clock is derived from sample counts relative to the last
+ * discontinuity rather than accumulated per buffer, so it never drifts. */
+static int64_t base_pts;
+static int64_t samples_in;
+static int64_t samples_out;
+
+#endif
+
+/**************************************************************************
+ * audio support functions
+ **************************************************************************/
+
+#if AUDIO_RESAMPLE
+static void close_resampler(void) {
+
+  if (resampler)
+    audio_resample_close(resampler);
+  resampler = NULL;
+  free(resample_buffer);
+  resample_buffer = NULL;
+}
+#endif
+
+/* returns 0 if the audio parameters check out */
+static int init_audio_parameters(buf_element_t *buf) {
+
+#if AUDIO_RESAMPLE
+  close_resampler();
+#endif
+
+  audio_type = buf->type & (BUF_MAJOR_MASK | BUF_DECODER_MASK);
+  audio_rate = buf->decoder_info[1];
+  audio_bits = buf->decoder_info[2];
+  audio_channels = buf->decoder_info[3];
+
+  if ((audio_type != BUF_AUDIO_LPCM_BE) && (audio_type != BUF_AUDIO_LPCM_LE))
+    return 1;
+  if ((audio_bits != 8 && audio_bits != 16) ||
+      (audio_channels < 1 || audio_channels > 2) ||
+      (audio_rate <= 0))
+    return 1;
+
+#if AUDIO_RESAMPLE
+  resampler = audio_resample_init_quality(audio_channels, audio_channels,
+    AUDIO_OUT_RATE, audio_rate, RESAMPLE_QUALITY_DEFAULT);
+  resample_buffer = malloc(
+    (AUDIO_CHUNK_SAMPLES * AUDIO_OUT_RATE / audio_rate + 2) *
+    audio_channels * sizeof(short));
+  if (!resampler || !resample_buffer) {
+    close_resampler();
+    return 1;
+  }
+
+  base_pts = 0;
+  samples_in = samples_out = 0;
+
+debug_printf ("  audio: %d Hz, %d bits, %d channels -> %d Hz\n",
+  audio_rate, audio_bits, audio_channels, AUDIO_OUT_RATE);
+#endif
+
+  return 0;
+}
+
+#if AUDIO_RESAMPLE
+
+/* convert count sample frames of raw PCM to native signed 16-bit; 8-bit
+ * big endian PCM (FILM, QuickTime 'twos') is signed, and 8-bit little
+ * endian PCM (WAV, QuickTime 'raw ') unsigned */
+static void convert_pcm(unsigned char *src, int count) {
+
+  int i;
+
+  count *= audio_channels;
+  if ((audio_bits == 8) && (audio_type == BUF_AUDIO_LPCM_BE)) {
+    for (i = 0; i < count; i++)
+      pcm_buffer[i] = (signed char)src[i] << 8;
+  } else if (audio_bits == 8) {
+    for (i = 0; i < count; i++)
+      pcm_buffer[i] = (src[i] - 0x80) << 8;
+  } else if (audio_type == BUF_AUDIO_LPCM_BE) {
+    for (i = 0; i < count; i++)
+      pcm_buffer[i] = (short)BE_16(&src[i * 2]);
+  } else {
+    for (i = 0; i < count; i++)
+      pcm_buffer[i] = (short)LE_16(&src[i * 2]);
+  }
+}
+
+static void decode_audio(fifo_buffer_t *fifo) {
+
+  unsigned char *data = fifo->buffer_data;
+  int frame_bytes = audio_channels * (audio_bits / 8);
+  int frames = fifo->buffer_data_index / frame_bytes;
+  int64_t pts = fifo->buf.pts;
+  int64_t expected_pts;
+  int count, out_count;
+
+  /* demuxers only stamp some buffers; check the ones that are stamped
+   * against the input sample clock */
+  expected_pts = base_pts + samples_in * 90000 / audio_rate;
+  if (pts && ((pts - expected_pts > AUDIO_PTS_RESYNC) ||
+              (expected_pts - pts > AUDIO_PTS_RESYNC))) {
+    audio_resample_close(resampler);
+    resampler = audio_resample_init_quality(audio_channels, audio_channels,
+      AUDIO_OUT_RATE, audio_rate, RESAMPLE_QUALITY_DEFAULT);
+    base_pts = pts;
+    samples_in = samples_out = 0;
+  }
+  if (!resampler)
+    return;
+
+  while (frames) {
+    count = (frames > AUDIO_CHUNK_SAMPLES) ? AUDIO_CHUNK_SAMPLES : frames;
+    convert_pcm(data, count);
+    data += count * frame_bytes;
+    frames -= count;
+    samples_in += count;
+
+    out_count = audio_resample(resampler, resample_buffer, pcm_buffer, count);
+
+    /* there is no audio output module yet; this is where the block and
+     * its pts (base_pts + samples_out * 90000 / AUDIO_OUT_RATE) will be
+     * handed over */
+    samples_out += out_count;
+  }
+}
+
+#endif
 
 /**************************************************************************
  * audio decoder thread
@@ -8,6 +174,7 @@ void audio_decoder_thread(void *v) {
 
   xine_stream_t *stream = (xine_stream_t *)v;
   int end_of_stream;
+  int decoder_ok = 0;
 
 debug_printf ("  *** this is the audio decoder thread talking\n");
 
@@ -23,13 +190,34 @@ debug_printf ("  audio thread received buffer, type %08X, %d bytes, flags: %08X\
   stream->audio_fifo->buf.decoder_flags);
 */
 
+    trace_event(TRACE_RING_AUDIO_DECODER, TRACE_BUFFER_GET, TRACE_INSTANT,
+      stream->audio_fifo->buf.type, stream->audio_fifo->buffer_data_index);
+
     end_of_stream =
       stream->audio_fifo->buf.decoder_flags & BUF_FLAG_END_STREAM;
 
+    if (stream->audio_fifo->buf.decoder_flags & BUF_FLAG_HEADER) {
+      decoder_ok = (init_audio_parameters(&stream->audio_fifo->buf) == 0);
+      stream->stream_info[XINE_STREAM_INFO_AUDIO_HANDLED] = decoder_ok;
+    }
+#if AUDIO_RESAMPLE
+    else if (decoder_ok && !end_of_stream &&
+             !(stream->audio_fifo->buf.decoder_flags & BUF_FLAG_SPECIAL)) {
+      trace_event(TRACE_RING_AUDIO_DECODER, TRACE_DECODE, TRACE_BEGIN,
+        stream->audio_fifo->buffer_data_index, 0);
+      decode_audio(stream->audio_fifo);
+      trace_event(TRACE_RING_AUDIO_DECODER, TRACE_DECODE, TRACE_END,
+        stream->audio_fifo->buffer_data_index, 0);
+    }
+#endif
+
     stream->audio_fifo->clear(stream->audio_fifo);
 
   } while (!end_of_stream);
 
+#if AUDIO_RESAMPLE
+  close_resampler();
+#endif
+
 debug_printf ("audio decoder thread exit\n");
 }
-
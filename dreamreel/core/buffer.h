@@ -386,8 +386,12 @@ struct fifo_buffer_s
   uint32_t        fifo_data_size;
   void            *fifo_empty_cb_data;
 
-  /* the actual data buffer */
+  /* the actual data buffer; while the decoder works on a whole frame
+   * that an input handed over in its own memory (INPUT_CAP_ZERO_COPY),
+   * buffer_data points at that frame and the allocation is kept in
+   * buffer_data_alloc */
   unsigned char *buffer_data;
+  unsigned char *buffer_data_alloc;
   int buffer_data_size;
   int buffer_data_index;
 
@@ -18,7 +18,6 @@ void demux_thread(void *v) {
   buf_element_t *buf;
   xine_stream_t *stream = (xine_stream_t *)v;
 
-  thread_is_alive = 0;
 debug_printf ("  *** this is the demux thread talking\n");
 
   /* wait for the thread to become active initially */
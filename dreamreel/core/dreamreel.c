@@ -3,6 +3,12 @@
 
 #include "dreamreel.h"
 #include "metronom.h"
+#include "seek_index.h"
+#include "trace.h"
+#include "dsputil.h"
+#ifndef DREAMREEL_HOST
+#include "gui.h"
+#endif
 
 
 //#define MRL "file://cd/film/miniop.cpk"
@@ -16,8 +22,35 @@
 //#define MRL "file://cd/mov/971108_vis2_smc.mov"
 //#define MRL "file://cd/idcin/idlog.cin"
 
+/* where the seek indices of recently played files are kept between runs;
+ * the RAM disk is gone after every run, so this is on the VMU in the
+ * first controller, and nothing is kept when there is none or it is full */
+#define SEEK_INDEX_FILE "/vmu/a1/DRINDEX"
 
+/* where the IDCT that FF_IDCT_AUTO settled on is kept between runs, so
+ * that only the first run spends time measuring them; on the VMU, like
+ * the seek indices, and measured on every run when there is none */
+#define IDCT_CHOICE_FILE "/vmu/a1/DRIDCT"
+
+/* where the pipeline trace goes at the end of playback when
+ * TRACE_PIPELINE is enabled in trace.h; /pc/ is the host, when running
+ * under dcload */
+#define TRACE_FILE "/pc/dreamreel.trace"
+
+/* define DEBUG_STARTUP as 1 to time opening the input and finding the
+ * demuxer, which is most of the wait before the first frame */
+#define DEBUG_STARTUP 0
+
+#if DEBUG_STARTUP
+#define debug_startup printf
+#else
+static inline void debug_startup(const char *format, ...) { }
+#endif
+
+
+#ifndef DREAMREEL_HOST
 KOS_INIT_FLAGS(INIT_DEFAULT | INIT_THD_PREEMPT);
+#endif
 
 void demux_thread(void *v);
 void demux_thread_start(void);
@@ -33,10 +66,18 @@ void video_output_thread(void *v);
  * "plugin" catalogs
  **************************************************************************/
 
+extern void *mmap_init_plugin (xine_t *xine, void *data);
 extern void *cdfile_init_plugin (xine_t *xine, void *data);
+#ifdef DREAMREEL_HOST
+extern void *host_file_init_plugin (xine_t *xine, void *data);
+#endif
 
 plugin_info_t input_plugins[] = {
   /* type, API, "name", version, special_info, init_function, plugin_class */
+#ifdef DREAMREEL_HOST
+  { PLUGIN_INPUT, 11, "file", 1, NULL, host_file_init_plugin, NULL },
+#endif
+  { PLUGIN_INPUT, 11, "mmap", 1, NULL, mmap_init_plugin, NULL },
   { PLUGIN_INPUT, 11, "cdfile", 1, NULL, cdfile_init_plugin, NULL }
 };
 #define NUM_INPUT_MODULES (sizeof(input_plugins) / sizeof(plugin_info_t))
@@ -45,13 +86,54 @@ extern void *demux_film_init_plugin (xine_t *xine, void *data);
 extern void *demux_fli_init_plugin (xine_t *xine, void *data);
 extern void *demux_idcin_init_plugin (xine_t *xine, void *data);
 extern void *demux_yuv4mpeg2_init_plugin (xine_t *xine, void *data);
+extern void *demux_qt_init_plugin (xine_t *xine, void *data);
+extern void *demux_mpeg_init_plugin (xine_t *xine, void *data);
+
+static const demux_signature_t film_signatures[] = {
+  { 0, 4, "FILM" },
+  { 0, 0, NULL }
+};
+
+static const demux_signature_t fli_signatures[] = {
+  { 4, 2, "\x11\xAF" },
+  { 4, 2, "\x12\xAF" },
+  { 0, 0, NULL }
+};
+
+static const demux_signature_t yuv4mpeg2_signatures[] = {
+  { 0, 9, "YUV4MPEG2" },
+  { 0, 0, NULL }
+};
+
+/* the atoms that may come first in a QT file */
+static const demux_signature_t qt_signatures[] = {
+  { 4, 4, "moov" },
+  { 4, 4, "mdat" },
+  { 4, 4, "ftyp" },
+  { 4, 4, "free" },
+  { 4, 4, "wide" },
+  { 4, 4, "skip" },
+  { 4, 4, "junk" },
+  { 4, 4, "pnot" },
+  { 4, 4, "PICT" },
+  { 0, 0, NULL }
+};
+
+/* an MPEG-1 video elementary stream or system stream */
+static const demux_signature_t mpeg_signatures[] = {
+  { 0, 4, "\x00\x00\x01\xB3" },
+  { 0, 4, "\x00\x00\x01\xBA" },
+  { 0, 0, NULL }
+};
 
 plugin_info_t demux_plugins[] = {
   /* type, API, "name", version, special_info,init_function, plugin_class */
-  { PLUGIN_DEMUX, 20, "FILM", 1, NULL, demux_film_init_plugin, NULL},
-  { PLUGIN_DEMUX, 20, "FLI", 1, NULL, demux_fli_init_plugin, NULL },
+  { PLUGIN_DEMUX, 20, "FILM", 1, (void *)film_signatures, demux_film_init_plugin, NULL},
+  { PLUGIN_DEMUX, 20, "FLI", 1, (void *)fli_signatures, demux_fli_init_plugin, NULL },
   { PLUGIN_DEMUX, 20, "Id CIN", 1, NULL, demux_idcin_init_plugin, NULL },
-  { PLUGIN_DEMUX, 20, "YUV4MPEG2", 1, NULL, demux_yuv4mpeg2_init_plugin, NULL }
+  { PLUGIN_DEMUX, 20, "YUV4MPEG2", 1, (void *)yuv4mpeg2_signatures, demux_yuv4mpeg2_init_plugin, NULL },
+  { PLUGIN_DEMUX, 20, "QT", 1, (void *)qt_signatures, demux_qt_init_plugin, NULL },
+  { PLUGIN_DEMUX, 20, "MPEG", 1, (void *)mpeg_signatures, demux_mpeg_init_plugin, NULL }
 };
 #define NUM_DEMUX_MODULES (sizeof(demux_plugins) / sizeof(plugin_info_t))
 
@@ -113,6 +195,55 @@ void xine_demux_control_end (xine_stream_t *stream, uint32_t flags) {
 
 }
 
+int xine_demux_read_header (input_plugin_t *input, unsigned char *buffer,
+                            off_t size) {
+
+  unsigned char preview[MAX_PREVIEW_SIZE];
+  uint32_t caps = input->get_capabilities(input);
+  int read_size;
+
+  if ((caps & INPUT_CAP_PREVIEW) && (size <= MAX_PREVIEW_SIZE)) {
+    read_size = input->get_optional_data(input, preview,
+      INPUT_OPTIONAL_DATA_PREVIEW);
+    if (read_size > size)
+      read_size = size;
+    if (read_size > 0)
+      memcpy(buffer, preview, read_size);
+  } else if (caps & INPUT_CAP_SEEKABLE) {
+    input->seek(input, 0, SEEK_SET);
+    read_size = input->read(input, buffer, size);
+  } else
+    read_size = 0;
+
+  return read_size;
+}
+
+buf_element_t *xine_demux_read_buffer (fifo_buffer_t *fifo,
+                                       input_plugin_t *input, int size) {
+
+  buf_element_t *buf;
+
+  if (input->get_capabilities(input) & INPUT_CAP_ZERO_COPY) {
+    buf = input->read_block(input, fifo, size);
+    if (buf && (buf->size != size)) {
+      buf->free_buffer(buf);
+      buf = NULL;
+    }
+    return buf;
+  }
+
+  buf = fifo->buffer_pool_alloc(fifo);
+  if (size > buf->max_size)
+    size = buf->max_size;
+  buf->size = size;
+  if (input->read(input, buf->content, size) != size) {
+    buf->free_buffer(buf);
+    buf = NULL;
+  }
+
+  return buf;
+}
+
 int  xine_config_lookup_entry (xine_t *self, const char *key,
                                xine_cfg_entry_t *entry) {
 
@@ -132,19 +263,47 @@ void xine_event_send (xine_stream_t *stream, const xine_event_t *event) {
 
 void buf_element_put (fifo_buffer_t *fifo, buf_element_t *buf) {
 
-  /* sanity check the returned data */
-  if (buf->size <= BUFFER_SIZE)
+  /* if the buffer is one of these special types, it is time to process
+   * the buffer */
+  int ready =
+    (buf->decoder_flags & BUF_FLAG_FRAME_END) ||
+    (buf->decoder_flags & BUF_FLAG_HEADER) ||
+    (buf->decoder_flags & BUF_FLAG_PREVIEW) ||
+    (buf->decoder_flags & BUF_FLAG_END_STREAM);
+
+  if (buf->content == &fifo->buffer_data[fifo->buffer_data_index]) {
+
+    /* sanity check the returned data */
+    if (buf->size <= BUFFER_SIZE)
+      fifo->buffer_data_index += buf->size;
+
+  } else if (ready && !fifo->buffer_data_index) {
+
+    /* the buffer came from the input's read_block() and holds a whole
+     * frame; let the decoder work on it where it lies */
+    fifo->buffer_data = buf->content;
+    fifo->buffer_data_index = buf->size;
+
+  } else {
+
+    /* the buffer came from the input's read_block() but is only part of
+     * a frame; gather it like any other */
+    if (fifo->buffer_data_index + buf->size > fifo->buffer_data_size) {
+      fifo->buffer_data_size = fifo->buffer_data_index + buf->size +
+        DATA_ALLOC_INCREMENT;
+      fifo->buffer_data = fifo->buffer_data_alloc =
+        realloc(fifo->buffer_data_alloc, fifo->buffer_data_size);
+    }
+    memcpy(&fifo->buffer_data[fifo->buffer_data_index], buf->content,
+      buf->size);
     fifo->buffer_data_index += buf->size;
+  }
 
   fifo->buf_allocated = 0;
 
-  /* if the buffer is one of these special types, it is time to process
-   * the buffer */
-  if ((buf->decoder_flags & BUF_FLAG_FRAME_END) ||
-      (buf->decoder_flags & BUF_FLAG_HEADER) ||
-      (buf->decoder_flags & BUF_FLAG_PREVIEW) ||
-      (buf->decoder_flags & BUF_FLAG_END_STREAM)) {
-
+  if (ready) {
+    trace_event(TRACE_RING_DEMUX, TRACE_BUFFER_PUT, TRACE_INSTANT,
+      buf->type, fifo->buffer_data_index);
     mutex_lock(fifo->fifo_ready_mutex);
   }
 }
@@ -158,6 +317,7 @@ buf_element_t *buf_element_get (fifo_buffer_t *fifo) {
 
 void buf_element_clear (fifo_buffer_t *fifo) {
 
+  fifo->buffer_data = fifo->buffer_data_alloc;
   fifo->buffer_data_index = 0;
   mutex_unlock(fifo->fifo_ready_mutex);
 }
@@ -185,7 +345,7 @@ uint32_t buf_element_data_size (fifo_buffer_t *fifo) {
 
 void buf_element_dispose (fifo_buffer_t *fifo) {
 
-  free(fifo->buffer_data);
+  free(fifo->buffer_data_alloc);
   free(fifo);
 }
 
@@ -212,7 +372,8 @@ buf_element_t *buf_element_buffer_pool_alloc (fifo_buffer_t *fifo) {
   /* make sure there is enough space for the buffer */
   if (fifo->buffer_data_index + BUFFER_SIZE > fifo->buffer_data_size) {
     fifo->buffer_data_size += DATA_ALLOC_INCREMENT;
-    fifo->buffer_data = realloc(fifo->buffer_data, fifo->buffer_data_size);
+    fifo->buffer_data = fifo->buffer_data_alloc =
+      realloc(fifo->buffer_data_alloc, fifo->buffer_data_size);
   }
 
   /* load up the buffer structure */
@@ -250,7 +411,8 @@ fifo_buffer_t *init_fifo_buffer_t(void) {
   fifo = xine_xmalloc(sizeof(fifo_buffer_t));
 
   fifo->buffer_data_size = DATA_ALLOC_INCREMENT;
-  fifo->buffer_data = xine_xmalloc(fifo->buffer_data_size);
+  fifo->buffer_data = fifo->buffer_data_alloc =
+    xine_xmalloc(fifo->buffer_data_size);
   fifo->buffer_data_index = 0;
 
   fifo->buf_allocated = 0;
@@ -321,13 +483,84 @@ void find_input_module(xine_stream_t *stream, char *mrl) {
 
 }
 
-/* Look for a demux module to handle this MRL */
+/* returns 1 if the extension of the MRL is in the space-separated list */
+static int demux_extension_matches(const char *mrl, const char *extensions) {
+
+  const char *ending;
+  int len;
+
+  ending = strrchr(mrl, '.');
+  if (!ending || strchr(ending, '/') || !extensions)
+    return 0;
+  ending++;
+  len = strlen(ending);
+
+  while (*extensions) {
+    while (*extensions == ' ')
+      extensions++;
+    if (!strncasecmp(extensions, ending, len) &&
+        ((extensions[len] == ' ') || (extensions[len] == '\0')))
+      return 1;
+    while (*extensions && (*extensions != ' '))
+      extensions++;
+  }
+
+  return 0;
+}
+
+/* returns 1 if any of the signatures is found in the header */
+static int demux_signature_matches(const demux_signature_t *signatures,
+                                   const unsigned char *header,
+                                   int header_size) {
+
+  if (!signatures)
+    return 0;
+
+  for (; signatures->length; signatures++)
+    if ((signatures->offset + signatures->length <= header_size) &&
+        !memcmp(&header[signatures->offset], signatures->bytes,
+          signatures->length))
+      return 1;
+
+  return 0;
+}
+
+/* Look for a demux module to handle this MRL. The demuxers are ranked
+ * first by whether the start of the file matches their signatures and
+ * then by whether they claim the extension; ties keep catalog order.
+ * Every demuxer still checks the content itself, so a wrong guess only
+ * costs a probe of the preview and the others are tried after it. */
 void find_demux_module(xine_stream_t *stream, char *mrl) {
 
-  int i;
+  unsigned char header[MAX_PREVIEW_SIZE];
+  int header_size;
+  int order[NUM_DEMUX_MODULES];
+  int rank[NUM_DEMUX_MODULES];
+  demux_class_t *demux_class;
+  int i, j, n;
+
+  header_size = xine_demux_read_header(stream->input, header,
+    MAX_PREVIEW_SIZE);
+
+  /* insertion sort, highest rank first */
+  for (n = 0; n < NUM_DEMUX_MODULES; n++) {
+    demux_class = (demux_class_t *)demux_plugins[n].plugin_class;
+    rank[n] = 0;
+    if (demux_signature_matches(demux_plugins[n].special_info, header,
+      header_size))
+      rank[n] += 2;
+    if (demux_extension_matches(mrl, demux_class->get_extensions(demux_class)))
+      rank[n] += 1;
+
+    for (j = n; (j > 0) && (rank[order[j - 1]] < rank[n]); j--)
+      order[j] = order[j - 1];
+    order[j] = n;
+  }
 
-  for (i = 0; i < NUM_DEMUX_MODULES; i++) {
-    debug_printf ("    attempting module #%d (%s)\n", i, demux_plugins[i].id);
+  for (j = 0; j < NUM_DEMUX_MODULES; j++) {
+    i = order[j];
+    debug_printf ("    attempting module #%d (%s), rank %d\n", i,
+      demux_plugins[i].id, rank[i]);
     stream->demux = 
       ((demux_class_t *)
         demux_plugins[i].plugin_class)->open_plugin(demux_plugins[i].plugin_class, 
@@ -354,6 +587,9 @@ void register_decoders(void) {
   register_avcodec(&cyuv_decoder);
   register_avcodec(&flic_decoder);
   register_avcodec(&idcin_decoder);
+  register_avcodec(&mpeg_decoder);
+  register_avcodec(&msvideo1_decoder);
+  register_avcodec(&rpza_decoder);
 
 }
 
@@ -361,18 +597,53 @@ void register_decoders(void) {
  * main launching point
  **************************************************************************/
 
+/* the host build (see host/) brings its own headless main() */
+#ifndef DREAMREEL_HOST
+
+/* settles FF_IDCT_AUTO before any decoder asks for it, from the saved
+ * choice if there is one and by measuring the IDCTs otherwise */
+static void init_idct_choice(void) {
+
+  file_t fd;
+  uint32 choice, saved = FF_IDCT_AUTO;
+
+  fd = fs_open(IDCT_CHOICE_FILE, O_RDONLY);
+  if (fd) {
+    if (fs_read(fd, &saved, sizeof(saved)) == sizeof(saved))
+      ff_idct_set_auto(saved);
+    fs_close(fd);
+  }
+
+  choice = ff_idct_auto();
+  debug_printf ("  IDCT: FF_IDCT_AUTO is %d\n", choice);
+
+  /* VMU writes are slow, so only write a choice that was just measured */
+  if (choice == saved)
+    return;
+  fd = fs_open(IDCT_CHOICE_FILE, O_WRONLY | O_TRUNC);
+  if (fd) {
+    fs_write(fd, &choice, sizeof(choice));
+    fs_close(fd);
+  }
+}
+
 int main() {
 
   xine_t xine;
   xine_stream_t stream;
   cont_cond_t cont;
+  io_status_t status;
+  uint64_t start_time;
 
   debug_printf ("Dreamreel: %s\n", MRL);
 
   register_decoders();
+  init_idct_choice();
 
   init_metronom();
 
+  seek_index_load(SEEK_INDEX_FILE);
+
   init_xine_t(&xine);
   init_xine_stream_t(&stream);
 
@@ -383,13 +654,18 @@ int main() {
 debug_printf ("  init_modules()\n");
   init_modules(&xine);
 debug_printf ("  find_input_module()\n");
+  start_time = timer_ms_gettime64();
   find_input_module(&stream, MRL);
   if (!stream.input)
     return 1;
+  debug_startup ("  startup: input opened after %d ms\n",
+    (int)(timer_ms_gettime64() - start_time));
 debug_printf ("  find_demux_module()\n");
   find_demux_module(&stream, MRL);
   if (!stream.demux)
     return 1;
+  debug_startup ("  startup: demuxer found after %d ms\n",
+    (int)(timer_ms_gettime64() - start_time));
 
 /*
 debug_printf (" file has %d x %d video\n", 
@@ -429,6 +705,10 @@ printf ("press red to stop...\n");
       printf ("Error getting controller status\n");
     cont.buttons = ~cont.buttons;
 
+    /* let the UI see the buttons too (X toggles the HUD) */
+    status.cont = cont;
+    update_elements(&status);
+
     if (cont.buttons & CONT_Y) {
       if (get_demux_status() == DEMUX_OK) {
         if (paused) {
@@ -455,5 +735,11 @@ debug_printf (" Dreamreel: all threads have finished\n");
   stream.input->dispose(stream.input);
   stream.demux->dispose(stream.demux);
 
+  if (!seek_index_save(SEEK_INDEX_FILE))
+    printf ("couldn't save the seek indices to %s\n", SEEK_INDEX_FILE);
+  trace_dump(TRACE_FILE);
+
   return 0;
 }
+
+#endif
@@ -342,6 +342,17 @@ struct input_class_s {
 
 #define INPUT_CAP_CHAPTERS             0x00000080
 
+/*
+ * INPUT_CAP_ZERO_COPY:
+ *   the whole stream is held in memory. read_block() takes any length
+ *   and returns a buffer whose content points straight at the data,
+ *   which stays valid until the plugin is disposed; its size is short
+ *   only at the end of the stream. demuxers should get their buffers
+ *   through xine_demux_read_buffer() to make use of it.
+ */
+
+#define INPUT_CAP_ZERO_COPY            0x00000100
+
 
 #define INPUT_OPTIONAL_UNSUPPORTED    0
 #define INPUT_OPTIONAL_SUCCESS        1
@@ -470,6 +481,15 @@ typedef struct {
 #define PLUGIN_INPUT          1
 #define PLUGIN_DEMUX          2
 
+/* special_info of a demuxer: the bytes that identify its files, in a list
+ * ending with an entry of length 0; a demuxer whose files can not be told
+ * by their bytes alone has no list */
+typedef struct {
+  int          offset;
+  int          length;
+  const char  *bytes;
+} demux_signature_t;
+
 /**************************************************************************
  * other
  **************************************************************************/
@@ -495,4 +515,22 @@ void xine_demux_control_headers_done (xine_stream_t *stream);
 void xine_demux_control_start        (xine_stream_t *stream);
 void xine_demux_control_end          (xine_stream_t *stream, uint32_t flags);
 
+/* read the first size bytes of the input for content detection, from the
+ * preview if the input has one so that probing does not touch the device;
+ * returns the number of bytes read */
+int  xine_demux_read_header          (input_plugin_t *input,
+                                      unsigned char *buffer, off_t size);
+
+/* get the next buffer of a payload of size bytes from the input; returns
+ * NULL if the input runs short. A buffer from the fifo takes up to its
+ * max_size bytes, a buffer straight from an INPUT_CAP_ZERO_COPY input all
+ * of them; buf->size says how many were taken */
+buf_element_t *xine_demux_read_buffer (fifo_buffer_t *fifo,
+                                       input_plugin_t *input, int size);
+
+int  xine_config_lookup_entry        (xine_t *self, const char *key,
+                                      xine_cfg_entry_t *entry);
+void xine_event_send                 (xine_stream_t *stream,
+                                      const xine_event_t *event);
+
 #endif
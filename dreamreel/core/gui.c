@@ -7,9 +7,16 @@
  *  init_elements()
  *  update_elements(io_status_t)
  *  draw_elements()
+ *
+ * The only element so far is the performance HUD, a panel of playback
+ * statistics (see hud_stats_t in gui.h) that the X button toggles. Its
+ * text is drawn from a 5x7 font that is uploaded to VRAM once; the
+ * strings are formatted a few times a second and every frame only costs
+ * a quad per character.
  */
 
 #include <kos.h>
+#include <malloc.h>
 #include "gui.h"
 
 /**************************************************************************
@@ -20,6 +27,203 @@
  * occurring at the same time. */
 static mutex_t *ui_mutex;
 
+hud_stats_t hud_stats;
+
+/* the font: 5x7 glyphs in 8x8 cells, 8 cells across a 64x64 ARGB4444
+ * texture; each glyph is 5 columns, the top row in bit 0 */
+#define FONT_TEXTURE_SIZE 64
+#define FONT_CELL 8
+static const char font_chars[] =
+  " 0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ.-+:/%";
+static const unsigned char font_glyphs[][5] = {
+  { 0x00, 0x00, 0x00, 0x00, 0x00 },  /* space */
+  { 0x3E, 0x51, 0x49, 0x45, 0x3E },  /* 0 */
+  { 0x00, 0x42, 0x7F, 0x40, 0x00 },
+  { 0x42, 0x61, 0x51, 0x49, 0x46 },
+  { 0x21, 0x41, 0x45, 0x4B, 0x31 },
+  { 0x18, 0x14, 0x12, 0x7F, 0x10 },
+  { 0x27, 0x45, 0x45, 0x45, 0x39 },
+  { 0x3C, 0x4A, 0x49, 0x49, 0x30 },
+  { 0x01, 0x71, 0x09, 0x05, 0x03 },
+  { 0x36, 0x49, 0x49, 0x49, 0x36 },
+  { 0x06, 0x49, 0x49, 0x29, 0x1E },  /* 9 */
+  { 0x7E, 0x11, 0x11, 0x11, 0x7E },  /* A */
+  { 0x7F, 0x49, 0x49, 0x49, 0x36 },
+  { 0x3E, 0x41, 0x41, 0x41, 0x22 },
+  { 0x7F, 0x41, 0x41, 0x22, 0x1C },
+  { 0x7F, 0x49, 0x49, 0x49, 0x41 },
+  { 0x7F, 0x09, 0x09, 0x09, 0x01 },
+  { 0x3E, 0x41, 0x49, 0x49, 0x7A },
+  { 0x7F, 0x08, 0x08, 0x08, 0x7F },
+  { 0x00, 0x41, 0x7F, 0x41, 0x00 },
+  { 0x20, 0x40, 0x41, 0x3F, 0x01 },
+  { 0x7F, 0x08, 0x14, 0x22, 0x41 },
+  { 0x7F, 0x40, 0x40, 0x40, 0x40 },
+  { 0x7F, 0x02, 0x0C, 0x02, 0x7F },
+  { 0x7F, 0x04, 0x08, 0x10, 0x7F },
+  { 0x3E, 0x41, 0x41, 0x41, 0x3E },
+  { 0x7F, 0x09, 0x09, 0x09, 0x06 },
+  { 0x3E, 0x41, 0x51, 0x21, 0x5E },
+  { 0x7F, 0x09, 0x19, 0x29, 0x46 },
+  { 0x46, 0x49, 0x49, 0x49, 0x31 },
+  { 0x01, 0x01, 0x7F, 0x01, 0x01 },
+  { 0x3F, 0x40, 0x40, 0x40, 0x3F },
+  { 0x1F, 0x20, 0x40, 0x20, 0x1F },
+  { 0x3F, 0x40, 0x38, 0x40, 0x3F },
+  { 0x63, 0x14, 0x08, 0x14, 0x63 },
+  { 0x07, 0x08, 0x70, 0x08, 0x07 },
+  { 0x61, 0x51, 0x49, 0x45, 0x43 },  /* Z */
+  { 0x00, 0x60, 0x60, 0x00, 0x00 },  /* . */
+  { 0x08, 0x08, 0x08, 0x08, 0x08 },  /* - */
+  { 0x08, 0x08, 0x3E, 0x08, 0x08 },  /* + */
+  { 0x00, 0x36, 0x36, 0x00, 0x00 },  /* : */
+  { 0x20, 0x10, 0x08, 0x04, 0x02 },  /* / */
+  { 0x23, 0x13, 0x08, 0x64, 0x62 },  /* % */
+};
+static pvr_ptr_t font_texture;
+static unsigned char font_cell[256];
+
+/* the HUD panel */
+#define HUD_X           16
+#define HUD_Y           16
+#define HUD_LINES       9
+#define HUD_COLUMNS     20
+#define HUD_GLYPH_SIZE  16  /* glyphs are drawn at twice their size */
+#define HUD_ADVANCE     12
+#define HUD_REFRESH     15  /* frames between reformatting the text */
+
+static int hud_visible;
+static int hud_frame_count;
+static uint32 hud_us;
+static char hud_text[HUD_LINES][HUD_COLUMNS + 1];
+
+static int last_buttons;
+
+/**************************************************************************
+ * support functions
+ **************************************************************************/
+
+/* build the font in main RAM and send it to VRAM, twiddled */
+static void load_font(void) {
+
+  unsigned short *texture;
+  int i, x, y, cell_x, cell_y;
+
+  texture = calloc(FONT_TEXTURE_SIZE * FONT_TEXTURE_SIZE, 2);
+  if (!texture)
+    return;
+  memset(font_cell, 0, sizeof(font_cell));
+  for (i = 0; font_chars[i]; i++) {
+    font_cell[(unsigned char)font_chars[i]] = i;
+    cell_x = (i % (FONT_TEXTURE_SIZE / FONT_CELL)) * FONT_CELL;
+    cell_y = (i / (FONT_TEXTURE_SIZE / FONT_CELL)) * FONT_CELL;
+    for (x = 0; x < 5; x++)
+      for (y = 0; y < 7; y++)
+        if (font_glyphs[i][x] & (1 << y))
+          texture[(cell_y + y) * FONT_TEXTURE_SIZE + cell_x + x] = 0xFFFF;
+  }
+
+  font_texture = pvr_mem_malloc(FONT_TEXTURE_SIZE * FONT_TEXTURE_SIZE * 2);
+  if (font_texture)
+    pvr_txr_load_ex(texture, font_texture, FONT_TEXTURE_SIZE,
+      FONT_TEXTURE_SIZE, PVR_TXRLOAD_16BPP);
+  free(texture);
+}
+
+/* an estimate of the RAM nobody has claimed: what lies past the heap and
+ * what the heap has free; the main thread's stack is not accounted for */
+static int free_ram_kb(void) {
+
+  extern char end;
+  struct mallinfo info = mallinfo();
+
+  return (0x8D000000 - (uint32)&end - info.uordblks) / 1024;
+}
+
+static void format_ms(char *buf, const char *label, uint32 us) {
+
+  sprintf(buf, "%-7s %3d.%02d MS", label, us / 1000, (us % 1000) / 10);
+}
+
+static void format_hud(void) {
+
+  format_ms(hud_text[0], "DECODE", hud_stats.decode_us);
+  format_ms(hud_text[1], "TWIDDLE", hud_stats.twiddle_us);
+  format_ms(hud_text[2], "DMA", hud_stats.dma_us);
+  sprintf(hud_text[3], "FIFO    V%3dK A%3dK",
+    hud_stats.video_fifo_bytes / 1024, hud_stats.audio_fifo_bytes / 1024);
+  sprintf(hud_text[4], "VRAM    %d/%d",
+    hud_stats.frames_queued, hud_stats.vram_frames);
+  sprintf(hud_text[5], "LATE    %d", hud_stats.frames_late);
+  sprintf(hud_text[6], "A/V     %+d MS", hud_stats.av_offset_ms);
+  sprintf(hud_text[7], "RAM     %dK FREE", free_ram_kb());
+  format_ms(hud_text[8], "HUD", hud_us);
+}
+
+static void draw_vertex(pvr_vertex_t *vert, float x, float y,
+                        float u, float v, int flags) {
+
+  vert->flags = flags;
+  vert->x = x;
+  vert->y = y;
+  vert->u = u;
+  vert->v = v;
+  pvr_prim(vert, sizeof(*vert));
+}
+
+static void draw_hud(void) {
+
+  pvr_poly_cxt_t cxt;
+  pvr_poly_hdr_t hdr;
+  pvr_vertex_t vert;
+  const float cell = (float)FONT_CELL / FONT_TEXTURE_SIZE;
+  float x, y, u, v;
+  const char *c;
+  int i, n;
+
+  /* the panel: a dark, translucent box */
+  pvr_poly_cxt_col(&cxt, PVR_LIST_TR_POLY);
+  pvr_poly_compile(&hdr, &cxt);
+  pvr_prim(&hdr, sizeof(hdr));
+
+  vert.argb = PVR_PACK_COLOR(0.6f, 0.0f, 0.0f, 0.0f);
+  vert.oargb = 0;
+  vert.z = 10;
+  x = HUD_X - 4;
+  y = HUD_Y - 4;
+  draw_vertex(&vert, x, y, 0, 0, PVR_CMD_VERTEX);
+  draw_vertex(&vert, x + HUD_COLUMNS * HUD_ADVANCE + 8, y, 0, 0,
+    PVR_CMD_VERTEX);
+  draw_vertex(&vert, x, y + HUD_LINES * HUD_GLYPH_SIZE + 8, 0, 0,
+    PVR_CMD_VERTEX);
+  draw_vertex(&vert, x + HUD_COLUMNS * HUD_ADVANCE + 8,
+    y + HUD_LINES * HUD_GLYPH_SIZE + 8, 0, 0, PVR_CMD_VERTEX_EOL);
+
+  /* the text: a quad per character out of the font texture */
+  pvr_poly_cxt_txr(&cxt, PVR_LIST_TR_POLY, PVR_TXRFMT_ARGB4444,
+    FONT_TEXTURE_SIZE, FONT_TEXTURE_SIZE, font_texture, PVR_FILTER_NONE);
+  pvr_poly_compile(&hdr, &cxt);
+  pvr_prim(&hdr, sizeof(hdr));
+
+  vert.argb = PVR_PACK_COLOR(1.0f, 1.0f, 1.0f, 1.0f);
+  vert.z = 11;
+  for (i = 0; i < HUD_LINES; i++) {
+    y = HUD_Y + i * HUD_GLYPH_SIZE;
+    for (c = hud_text[i], x = HUD_X; *c; c++, x += HUD_ADVANCE) {
+      n = font_cell[(unsigned char)*c];
+      if (!n)
+        continue;
+      u = (n % (FONT_TEXTURE_SIZE / FONT_CELL)) * cell;
+      v = (n / (FONT_TEXTURE_SIZE / FONT_CELL)) * cell;
+      draw_vertex(&vert, x, y, u, v, PVR_CMD_VERTEX);
+      draw_vertex(&vert, x + HUD_GLYPH_SIZE, y, u + cell, v, PVR_CMD_VERTEX);
+      draw_vertex(&vert, x, y + HUD_GLYPH_SIZE, u, v + cell, PVR_CMD_VERTEX);
+      draw_vertex(&vert, x + HUD_GLYPH_SIZE, y + HUD_GLYPH_SIZE,
+        u + cell, v + cell, PVR_CMD_VERTEX_EOL);
+    }
+  }
+}
+
 /**************************************************************************
  * public functions
  **************************************************************************/
@@ -29,18 +233,46 @@ void init_elements() {
   ui_mutex = mutex_create();
 
   /* load all UI elements into VRAM */
+  load_font();
 
+  memset(&hud_stats, 0, sizeof(hud_stats));
+  hud_visible = 0;
+  hud_frame_count = 0;
+  last_buttons = 0;
 }
 
 void update_elements(io_status_t *status) {
 
   mutex_lock(ui_mutex);
 
+  /* X toggles the HUD when it goes down */
+  if ((status->cont.buttons & CONT_X) && !(last_buttons & CONT_X)) {
+    hud_visible = !hud_visible;
+    hud_frame_count = 0;
+  }
+  last_buttons = status->cont.buttons;
+
   mutex_unlock(ui_mutex);
 }
 
 void draw_elements(void) {
+
+  uint64 start;
+
   mutex_lock(ui_mutex);
 
+  if (hud_visible && font_texture) {
+    start = timer_us_gettime64();
+
+    if (hud_frame_count++ % HUD_REFRESH == 0)
+      format_hud();
+
+    pvr_list_begin(PVR_LIST_TR_POLY);
+    draw_hud();
+    pvr_list_finish();
+
+    HUD_AVERAGE(hud_us, timer_us_gettime64() - start);
+  }
+
   mutex_unlock(ui_mutex);
 }
@@ -5,10 +5,34 @@ typedef struct {
   cont_cond_t cont;
 } io_status_t;
 
+/* What the performance HUD shows. The video output fills this in as it
+ * goes; every field has a single writer, and a torn read only shows up on
+ * screen for one refresh. Times are in microseconds per frame, smoothed
+ * over the last several frames. */
+typedef struct {
+  uint32 decode_us;
+  uint32 twiddle_us;
+  uint32 dma_us;
+  int    video_fifo_bytes;
+  int    audio_fifo_bytes;
+  int    frames_queued;     /* decoded frames waiting in VRAM */
+  int    vram_frames;       /* VRAM frames there are */
+  int    frames_late;       /* frames shown a vblank or more after their pts */
+  int    av_offset_ms;      /* frame pts - metronom clock at the flip */
+} hud_stats_t;
+
+extern hud_stats_t hud_stats;
+
+/* fold a new sample into one of the smoothed times */
+#define HUD_AVERAGE(average, sample) \
+  ((average) = ((average) * 7 + (sample)) / 8)
+
 void init_elements(void);
 
 void update_elements(io_status_t *status);
 
+/* draws into the translucent list; call between scene begin and finish,
+ * outside of any other list */
 void draw_elements(void);
 
 #endif
@@ -12,6 +12,11 @@ typedef struct {
   file_t fd;
   char *mrl;
 
+  /* the start of the file, read once at open time so that demuxers can
+   * probe it without going back to the disc */
+  unsigned char preview[MAX_PREVIEW_SIZE];
+  int preview_size;
+
 } cdfile_input_plugin_t;
 
 typedef struct {
@@ -25,7 +30,7 @@ typedef struct {
 
 static uint32_t cdfile_plugin_get_capabilities (input_plugin_t *this_gen) {
 
-  return INPUT_CAP_SEEKABLE;
+  return INPUT_CAP_SEEKABLE | INPUT_CAP_PREVIEW;
 }
 
 static off_t cdfile_plugin_read (input_plugin_t *this_gen, char *buf, 
@@ -77,7 +82,14 @@ static char* cdfile_plugin_get_mrl (input_plugin_t *this_gen) {
 
 static int cdfile_plugin_get_optional_data (input_plugin_t *this_gen,
                                           void *data, int data_type) {
-  return 0;
+
+  cdfile_input_plugin_t *this = (cdfile_input_plugin_t *) this_gen;
+
+  if (data_type != INPUT_OPTIONAL_DATA_PREVIEW)
+    return INPUT_OPTIONAL_UNSUPPORTED;
+
+  memcpy(data, this->preview, this->preview_size);
+  return this->preview_size;
 }
 
 static void cdfile_plugin_dispose (input_plugin_t *this_gen ) {
@@ -125,6 +137,11 @@ static input_plugin_t *open_plugin (input_class_t *cls_gen, xine_stream_t *strea
 
   this->mrl = strdup(data);
 
+  this->preview_size = fs_read(fd, this->preview, MAX_PREVIEW_SIZE);
+  if (this->preview_size < 0)
+    this->preview_size = 0;
+  fs_seek(fd, 0, SEEK_SET);
+
   return &this->input_plugin;
 }
 
@@ -0,0 +1,249 @@
+/*
+ * Memory-Mapped Input Plugin for Dreamedia
+ *
+ * Files on the romdisk (/rd/) and the RAM disk (/ram/) already sit in
+ * main memory, so this plugin maps them with fs_mmap() instead of reading
+ * them. read_block() hands out buffers that point straight into the
+ * mapping (INPUT_CAP_ZERO_COPY), which means that no data is copied
+ * between the file and the decoder. With no device behind it, this is
+ * also the input to use when timing the decoders.
+ */
+
+#include "dreamreel.h"
+
+typedef struct {
+  input_plugin_t       input_plugin;
+
+  xine_stream_t       *stream;
+
+  file_t fd;
+  char *mrl;
+
+  unsigned char *data;
+  off_t size;
+  off_t pos;
+
+} mmap_input_plugin_t;
+
+typedef struct {
+
+  input_class_t        input_class;
+
+  xine_t              *xine;
+  config_values_t     *config;
+
+} mmap_input_class_t;
+
+static uint32_t mmap_plugin_get_capabilities (input_plugin_t *this_gen) {
+
+  return INPUT_CAP_SEEKABLE | INPUT_CAP_PREVIEW | INPUT_CAP_ZERO_COPY;
+}
+
+static off_t mmap_plugin_read (input_plugin_t *this_gen, char *buf,
+  off_t len) {
+
+  mmap_input_plugin_t *this = (mmap_input_plugin_t *) this_gen;
+
+  if (len > this->size - this->pos)
+    len = this->size - this->pos;
+  if (len <= 0)
+    return 0;
+
+  memcpy(buf, &this->data[this->pos], len);
+  this->pos += len;
+
+  return len;
+}
+
+static buf_element_t *mmap_plugin_read_block (input_plugin_t *this_gen,
+  fifo_buffer_t *fifo, off_t len) {
+
+  mmap_input_plugin_t *this = (mmap_input_plugin_t *) this_gen;
+  buf_element_t *buf;
+
+  if (len > this->size - this->pos)
+    len = this->size - this->pos;
+  if (len <= 0)
+    return NULL;
+
+  /* take the fifo's buffer for its bookkeeping, but point it at the
+   * mapping */
+  buf = fifo->buffer_pool_alloc(fifo);
+  buf->content = buf->mem = &this->data[this->pos];
+  buf->size = buf->max_size = len;
+  this->pos += len;
+
+  return buf;
+}
+
+static off_t mmap_plugin_seek (input_plugin_t *this_gen, off_t offset,
+  int origin) {
+
+  mmap_input_plugin_t *this = (mmap_input_plugin_t *) this_gen;
+
+  switch (origin) {
+  case SEEK_CUR:
+    offset += this->pos;
+    break;
+  case SEEK_END:
+    offset += this->size;
+    break;
+  }
+
+  if ((offset < 0) || (offset > this->size))
+    return -1;
+
+  this->pos = offset;
+  return this->pos;
+}
+
+static off_t mmap_plugin_get_current_pos (input_plugin_t *this_gen){
+
+  mmap_input_plugin_t *this = (mmap_input_plugin_t *) this_gen;
+
+  return this->pos;
+}
+
+static off_t mmap_plugin_get_length (input_plugin_t *this_gen) {
+
+  mmap_input_plugin_t *this = (mmap_input_plugin_t *) this_gen;
+
+  return this->size;
+}
+
+static uint32_t mmap_plugin_get_blocksize (input_plugin_t *this_gen) {
+
+  return 0;
+}
+
+static char* mmap_plugin_get_mrl (input_plugin_t *this_gen) {
+  mmap_input_plugin_t *this = (mmap_input_plugin_t *) this_gen;
+
+  return this->mrl;
+}
+
+static int mmap_plugin_get_optional_data (input_plugin_t *this_gen,
+                                          void *data, int data_type) {
+
+  mmap_input_plugin_t *this = (mmap_input_plugin_t *) this_gen;
+  int preview_size;
+
+  if (data_type != INPUT_OPTIONAL_DATA_PREVIEW)
+    return INPUT_OPTIONAL_UNSUPPORTED;
+
+  preview_size = (this->size < MAX_PREVIEW_SIZE) ?
+    this->size : MAX_PREVIEW_SIZE;
+  memcpy(data, this->data, preview_size);
+  return preview_size;
+}
+
+static void mmap_plugin_dispose (input_plugin_t *this_gen ) {
+
+  mmap_input_plugin_t *this = (mmap_input_plugin_t *) this_gen;
+
+  /* the mapping goes away with the file */
+  fs_close(this->fd);
+
+  free(this->mrl);
+
+  free(this);
+}
+
+static input_plugin_t *open_plugin (input_class_t *cls_gen, xine_stream_t *stream,
+                                    const char *data) {
+
+  mmap_input_plugin_t *this;
+  file_t fd;
+  unsigned char *mapping;
+
+  /* qualify the MRL; only the romdisk and the RAM disk can be mapped */
+  if ((strncasecmp (data, "file://rd/", 10) != 0) &&
+      (strncasecmp (data, "file://ram/", 11) != 0))
+    return NULL;
+
+  /* skip to the filename, open the file and map it */
+  fd = fs_open(&data[6], O_RDONLY);
+  if (!fd)
+    return NULL;
+
+  mapping = (unsigned char *)fs_mmap(fd);
+  if (!mapping) {
+    fs_close(fd);
+    return NULL;
+  }
+
+  this = (mmap_input_plugin_t *) xine_xmalloc (sizeof (mmap_input_plugin_t));
+  this->stream = stream;
+
+  this->fd = fd;
+  this->data = mapping;
+  this->size = fs_total(fd);
+  this->pos = 0;
+
+  this->input_plugin.get_capabilities   = mmap_plugin_get_capabilities;
+  this->input_plugin.read               = mmap_plugin_read;
+  this->input_plugin.read_block         = mmap_plugin_read_block;
+  this->input_plugin.seek               = mmap_plugin_seek;
+  this->input_plugin.get_current_pos    = mmap_plugin_get_current_pos;
+  this->input_plugin.get_length         = mmap_plugin_get_length;
+  this->input_plugin.get_blocksize      = mmap_plugin_get_blocksize;
+  this->input_plugin.get_mrl            = mmap_plugin_get_mrl;
+  this->input_plugin.get_optional_data  = mmap_plugin_get_optional_data;
+  this->input_plugin.dispose            = mmap_plugin_dispose;
+  this->input_plugin.input_class        = cls_gen;
+
+  this->mrl = strdup(data);
+
+  return &this->input_plugin;
+}
+
+static char ** mmap_class_get_autoplay_list (input_class_t *this_gen,
+					    int *num_files) {
+
+  return NULL;
+}
+
+static char *mmap_class_get_identifier (input_class_t *this_gen) {
+
+  return "mmap";
+
+}
+
+static char *mmap_class_get_description (input_class_t *this_gen) {
+
+  return "KOS romdisk/RAM disk memory-mapped input";
+
+}
+
+static xine_mrl_t **mmap_class_get_dir (input_class_t *this_gen,
+                                          const char *filename, int *nFiles) {
+
+  return NULL;
+}
+
+static void mmap_class_dispose (input_class_t *this_gen) {
+
+  mmap_input_class_t  *this = (mmap_input_class_t *) this_gen;
+
+  free (this);
+}
+
+void *mmap_init_plugin (xine_t *xine, void *data) {
+
+  mmap_input_class_t  *this;
+
+  this = (mmap_input_class_t *) xine_xmalloc (sizeof (mmap_input_class_t));
+
+  this->xine   = xine;
+  this->config = xine->config;
+
+  this->input_class.open_plugin        = open_plugin;
+  this->input_class.get_identifier     = mmap_class_get_identifier;
+  this->input_class.get_description    = mmap_class_get_description;
+  this->input_class.get_dir            = mmap_class_get_dir;
+  this->input_class.get_autoplay_list  = mmap_class_get_autoplay_list;
+  this->input_class.dispose            = mmap_class_dispose;
+  this->input_class.eject_media        = NULL;
+
+  return this;
+}
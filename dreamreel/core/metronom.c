@@ -8,6 +8,7 @@
 
 #include "dreamreel.h"
 #include "metronom.h"
+#include "trace.h"
 
 /* total vblank counter */
 static int counter = 0;
@@ -41,6 +42,9 @@ counter++;
 
   if (metronom_started) {
 
+    trace_event(TRACE_RING_METRONOM, TRACE_VBLANK, TRACE_INSTANT,
+      (uint32_t)pts_counter, pts_counter >= next_video_pts);
+
     if (pts_counter >= next_video_pts) {
 //      next_video_pts = MAX_PTS;
       video_pts_callback();
@@ -62,6 +66,11 @@ debug_printf ("    metronon_set: %lld\n", new_pts);
   pts_counter = new_pts;
 }
 
+int64_t metronom_get(void) {
+
+  return pts_counter;
+}
+
 /* This function kicks off the periodic interrupt based on the refresh rate
  * and sets up the pts ISR. */
 void init_metronom(void) {
@@ -7,6 +7,7 @@ void init_metronom(void);
 void start_metronom(void);
 void stop_metronom(void);
 void metronom_set(int64_t new_pts);
+int64_t metronom_get(void);
 void set_next_video_pts(int64_t next_pts, void (*callback)(void));
 void set_next_audio_pts(int64_t next_pts, void (*callback)(void));
 
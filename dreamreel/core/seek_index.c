@@ -0,0 +1,493 @@
+/*
+ * seek_index.c
+ *
+ * This module keeps the seek indices that demuxers record for formats
+ * that do not carry one, cached per MRL. See seek_index.h.
+ *
+ * The saved form of the cache is a VMU package (the header the BIOS file
+ * manager reads, and one icon) around a run of variable-length numbers
+ * (7 bits per byte, low bits first, top bit set on all but the last byte).
+ * Entry positions are stored as the difference from the previous entry,
+ * so a typical entry takes 4 to 6 bytes:
+ *
+ *   "DRSI" version index_count
+ *   per index:
+ *     mrl_length mrl file_size complete end_pts end_offset end_info count
+ *     per entry: pts_delta offset_delta flags info
+ */
+
+#include <kos.h>
+
+#include "dreamreel.h"
+#include "seek_index.h"
+
+#define SEEK_INDEX_MAGIC "DRSI"
+#define SEEK_INDEX_VERSION 1
+
+/* what a VMU package takes besides the data: the header and one icon */
+#define SEEK_INDEX_PKG_BYTES (128 + 512)
+
+/* define DEBUG_SEEK_INDEX as 1 to follow the cache */
+#define DEBUG_SEEK_INDEX 0
+
+#if DEBUG_SEEK_INDEX
+#define debug_seek_index printf
+#else
+static inline void debug_seek_index(const char *format, ...) { }
+#endif
+
+/* the cache, most recently used first */
+static seek_index_t *cache;
+
+/* set when an index grows, so that an unchanged cache is not written
+ * back to the VMU */
+static int dirty;
+
+static void free_index(seek_index_t *index) {
+
+  free(index->mrl);
+  free(index->entries);
+  free(index);
+}
+
+/* drop unused indices from the tail of the list while the cache is over
+ * either of its limits */
+static void trim_cache(void) {
+
+  seek_index_t **link, **victim;
+  seek_index_t *index;
+  int mrls, entries;
+
+  for (;;) {
+    mrls = entries = 0;
+    victim = NULL;
+    for (link = &cache; *link; link = &(*link)->next) {
+      mrls++;
+      entries += (*link)->count;
+      if (!(*link)->users)
+        victim = link;
+    }
+
+    if (!victim ||
+        ((mrls <= SEEK_INDEX_MAX_MRLS) && (entries <= SEEK_INDEX_MAX_ENTRIES)))
+      break;
+
+    debug_seek_index("  seek_index: evicting %s (%d entries)\n",
+      (*victim)->mrl, (*victim)->count);
+    index = *victim;
+    *victim = index->next;
+    free_index(index);
+  }
+}
+
+static seek_index_t *new_index(const char *mrl, off_t file_size) {
+
+  seek_index_t *index = xine_xmalloc(sizeof(seek_index_t));
+
+  index->mrl = strdup(mrl);
+  index->file_size = file_size;
+  index->end_offset = -1;
+
+  return index;
+}
+
+static seek_index_t *find_index(const char *mrl) {
+
+  seek_index_t *index;
+
+  for (index = cache; index; index = index->next)
+    if (!strcmp(index->mrl, mrl))
+      break;
+
+  return index;
+}
+
+seek_index_t *seek_index_get(const char *mrl, off_t file_size) {
+
+  seek_index_t **link, *index;
+
+  for (link = &cache; *link; link = &(*link)->next)
+    if (!strcmp((*link)->mrl, mrl))
+      break;
+
+  index = *link;
+  if (index) {
+    *link = index->next;
+
+    /* the file has changed since the index was made */
+    if (index->file_size != file_size) {
+      debug_seek_index("  seek_index: %s changed size, starting over\n", mrl);
+      free_index(index);
+      index = NULL;
+    }
+  }
+
+  if (!index)
+    index = new_index(mrl, file_size);
+
+  debug_seek_index("  seek_index: %s has %d entries%s\n", mrl, index->count,
+    (index->complete) ? " (complete)" : "");
+
+  index->next = cache;
+  cache = index;
+  index->users++;
+  trim_cache();
+
+  return index;
+}
+
+void seek_index_release(seek_index_t *index) {
+
+  index->users--;
+  trim_cache();
+}
+
+void seek_index_add(seek_index_t *index, int64_t pts, off_t offset,
+                    uint32_t flags, uint32_t info) {
+
+  seek_index_entry_t *entry;
+
+  if (index->count) {
+    entry = &index->entries[index->count - 1];
+    if ((offset <= entry->offset) || (pts < entry->pts))
+      return;
+  }
+
+  if (index->count == index->allocated) {
+    index->allocated += 256;
+    index->entries = realloc(index->entries,
+      index->allocated * sizeof(seek_index_entry_t));
+  }
+
+  entry = &index->entries[index->count++];
+  entry->pts = pts;
+  entry->offset = offset;
+  entry->flags = flags;
+  entry->info = info;
+  dirty = 1;
+}
+
+/* binary search for the last entry that is not past the target, then
+ * step back to one with the flags */
+#define FIND_ENTRY(field, target)                                       \
+  int left, middle, right;                                              \
+                                                                        \
+  if (!index->count || (index->entries[0].field > target))              \
+    return NULL;                                                        \
+                                                                        \
+  left = 0;                                                             \
+  right = index->count - 1;                                             \
+  while (left < right) {                                                \
+    middle = (left + right + 1) / 2;                                    \
+    if (index->entries[middle].field > target)                          \
+      right = middle - 1;                                               \
+    else                                                                \
+      left = middle;                                                    \
+  }                                                                     \
+                                                                        \
+  for (; left >= 0; left--)                                             \
+    if ((index->entries[left].flags & flags) == flags)                  \
+      return &index->entries[left];                                     \
+                                                                        \
+  return NULL;
+
+seek_index_entry_t *seek_index_find_pts(seek_index_t *index, int64_t pts,
+                                        uint32_t flags) {
+  FIND_ENTRY(pts, pts)
+}
+
+seek_index_entry_t *seek_index_find_offset(seek_index_t *index,
+                                           off_t offset, uint32_t flags) {
+  FIND_ENTRY(offset, offset)
+}
+
+/**************************************************************************
+ * saving and loading
+ **************************************************************************/
+
+static int put_number(unsigned char *buf, int pos, int size, uint64_t n) {
+
+  do {
+    if (pos < size)
+      buf[pos] = (n & 0x7F) | ((n > 0x7F) ? 0x80 : 0);
+    pos++;
+    n >>= 7;
+  } while (n);
+
+  return pos;
+}
+
+/* returns 0 if the number runs past the end of buf */
+static int get_number(const unsigned char *buf, int *pos, int size,
+                      uint64_t *n) {
+
+  int shift = 0;
+
+  *n = 0;
+  do {
+    if ((*pos >= size) || (shift > 63))
+      return 0;
+    *n |= (uint64_t)(buf[*pos] & 0x7F) << shift;
+    shift += 7;
+  } while (buf[(*pos)++] & 0x80);
+
+  return 1;
+}
+
+int seek_index_serialize(unsigned char *buf, int size, int max_indices) {
+
+  seek_index_t *index;
+  seek_index_entry_t *entry;
+  int64_t pts;
+  off_t offset;
+  int pos, count, i, len;
+
+  count = 0;
+  for (index = cache; index && (count < max_indices); index = index->next)
+    count++;
+
+  pos = 4;
+  if (size >= 4)
+    memcpy(buf, SEEK_INDEX_MAGIC, 4);
+  pos = put_number(buf, pos, size, SEEK_INDEX_VERSION);
+  pos = put_number(buf, pos, size, count);
+
+  for (index = cache; count--; index = index->next) {
+    len = strlen(index->mrl);
+    pos = put_number(buf, pos, size, len);
+    for (i = 0; i < len; i++, pos++)
+      if (pos < size)
+        buf[pos] = index->mrl[i];
+    pos = put_number(buf, pos, size, index->file_size);
+    pos = put_number(buf, pos, size, index->complete);
+    pos = put_number(buf, pos, size, index->end_pts);
+    pos = put_number(buf, pos, size, index->end_offset + 1);
+    pos = put_number(buf, pos, size, index->end_info);
+    pos = put_number(buf, pos, size, index->count);
+
+    pts = 0;
+    offset = 0;
+    for (i = 0; i < index->count; i++) {
+      entry = &index->entries[i];
+      pos = put_number(buf, pos, size, entry->pts - pts);
+      pos = put_number(buf, pos, size, entry->offset - offset);
+      pos = put_number(buf, pos, size, entry->flags);
+      pos = put_number(buf, pos, size, entry->info);
+      pts = entry->pts;
+      offset = entry->offset;
+    }
+  }
+
+  return pos;
+}
+
+int seek_index_deserialize(const unsigned char *buf, int size) {
+
+  seek_index_t *loaded = NULL;
+  seek_index_t **tail = &loaded;
+  seek_index_t *index;
+  seek_index_entry_t *entry;
+  uint64_t version, count, n, file_size, complete, end_pts, end_offset;
+  uint64_t end_info, entries, d_pts, d_offset, flags, info;
+  char mrl[1024];
+  int pos = 4;
+  int i, j;
+
+  if ((size < 4) || memcmp(buf, SEEK_INDEX_MAGIC, 4) ||
+      !get_number(buf, &pos, size, &version) ||
+      (version != SEEK_INDEX_VERSION) ||
+      !get_number(buf, &pos, size, &count))
+    return 0;
+
+  for (i = 0; i < count; i++) {
+    if (!get_number(buf, &pos, size, &n) || (n >= sizeof(mrl)) ||
+        (pos + n > size))
+      goto fail;
+    memcpy(mrl, &buf[pos], n);
+    mrl[n] = 0;
+    pos += n;
+
+    if (!get_number(buf, &pos, size, &file_size) ||
+        !get_number(buf, &pos, size, &complete) ||
+        !get_number(buf, &pos, size, &end_pts) ||
+        !get_number(buf, &pos, size, &end_offset) ||
+        !get_number(buf, &pos, size, &end_info) ||
+        !get_number(buf, &pos, size, &entries) ||
+        (entries > SEEK_INDEX_MAX_ENTRIES))
+      goto fail;
+
+    index = new_index(mrl, file_size);
+    *tail = index;
+    tail = &index->next;
+    index->complete = complete;
+    index->end_pts = end_pts;
+    index->end_offset = (off_t)end_offset - 1;
+    index->end_info = end_info;
+
+    if (entries) {
+      index->allocated = entries;
+      index->entries = malloc(entries * sizeof(seek_index_entry_t));
+    }
+    for (j = 0; j < entries; j++) {
+      if (!get_number(buf, &pos, size, &d_pts) ||
+          !get_number(buf, &pos, size, &d_offset) ||
+          !get_number(buf, &pos, size, &flags) ||
+          !get_number(buf, &pos, size, &info))
+        goto fail;
+      entry = &index->entries[index->count++];
+      entry->pts = ((j) ? entry[-1].pts : 0) + d_pts;
+      entry->offset = ((j) ? entry[-1].offset : 0) + d_offset;
+      entry->flags = flags;
+      entry->info = info;
+    }
+  }
+
+  /* the loaded indices go behind the ones in use, which stay as they are */
+  for (tail = &cache; *tail; ) {
+    index = *tail;
+    if (index->users)
+      tail = &index->next;
+    else {
+      *tail = index->next;
+      free_index(index);
+    }
+  }
+  while (loaded) {
+    index = loaded;
+    loaded = index->next;
+    if (find_index(index->mrl))
+      free_index(index);
+    else {
+      index->next = NULL;
+      *tail = index;
+      tail = &index->next;
+    }
+  }
+  trim_cache();
+
+  dirty = 0;
+
+  debug_seek_index("  seek_index: loaded %d indices from %d bytes\n",
+    (int)count, size);
+
+  return 1;
+
+fail:
+  while (loaded) {
+    index = loaded;
+    loaded = index->next;
+    free_index(index);
+  }
+  return 0;
+}
+
+/* a plain square, for the BIOS file manager to show */
+static const uint16 icon_pal[16] = { 0xF36B };
+static const uint8 icon_data[512];
+
+int seek_index_save(const char *filename) {
+
+  vmu_pkg_t pkg;
+  uint8 *pkg_data;
+  unsigned char *buf;
+  file_t fd;
+  int size, pkg_size, count;
+  int ok;
+
+  if (!dirty) {
+    debug_seek_index("  seek_index: nothing new to save\n");
+    return 1;
+  }
+
+  /* leave out the least recently used indices until the rest fit */
+  count = SEEK_INDEX_MAX_MRLS;
+  while ((size = seek_index_serialize(NULL, 0, count)) >
+         SEEK_INDEX_SAVE_BLOCKS * 512 - SEEK_INDEX_PKG_BYTES)
+    count--;
+
+  buf = malloc(size);
+  if (!buf)
+    return 0;
+  seek_index_serialize(buf, size, count);
+
+  memset(&pkg, 0, sizeof(pkg));
+  strcpy(pkg.desc_short, "Dreamreel");
+  strcpy(pkg.desc_long, "Dreamreel seek indices");
+  strcpy(pkg.app_id, "Dreamreel");
+  pkg.icon_cnt = 1;
+  memcpy(pkg.icon_pal, icon_pal, sizeof(icon_pal));
+  pkg.icon_data = icon_data;
+  pkg.eyecatch_type = VMUPKG_EC_NONE;
+  pkg.data_len = size;
+  pkg.data = buf;
+  ok = (vmu_pkg_build(&pkg, &pkg_data, &pkg_size) == 0);
+  free(buf);
+  if (!ok)
+    return 0;
+
+  ok = 0;
+  fd = fs_open(filename, O_WRONLY | O_TRUNC);
+  if (fd) {
+    ok = (fs_write(fd, pkg_data, pkg_size) == pkg_size);
+    fs_close(fd);
+  }
+  free(pkg_data);
+
+  /* the VMU file system only writes a file out when it is closed, which
+   * cannot report that the VMU was full, so look for what was written */
+  if (ok) {
+    fd = fs_open(filename, O_RDONLY);
+    ok = fd && (fs_total(fd) >= pkg_size);
+    if (fd)
+      fs_close(fd);
+  }
+  if (ok)
+    dirty = 0;
+
+  debug_seek_index("  seek_index: %s %d of the indices in %d bytes to %s\n",
+    (ok) ? "saved" : "failed to save", count, pkg_size, filename);
+
+  return ok;
+}
+
+/* vmu_pkg_parse() trusts the lengths in the header, so check them
+ * against the size of the file first */
+static int pkg_fits(const uint8 *buf, int size) {
+
+  int icon_cnt, eyecatch_type, data_len;
+
+  if (size < SEEK_INDEX_PKG_BYTES)
+    return 0;
+  icon_cnt = buf[0x40] | (buf[0x41] << 8);
+  eyecatch_type = buf[0x44] | (buf[0x45] << 8);
+  data_len = buf[0x48] | (buf[0x49] << 8) | (buf[0x4A] << 16) |
+    (buf[0x4B] << 24);
+
+  return (icon_cnt == 1) && (eyecatch_type == VMUPKG_EC_NONE) &&
+    (data_len >= 0) && (data_len <= size - SEEK_INDEX_PKG_BYTES);
+}
+
+int seek_index_load(const char *filename) {
+
+  vmu_pkg_t pkg;
+  unsigned char *buf;
+  file_t fd;
+  int size;
+  int ok = 0;
+
+  fd = fs_open(filename, O_RDONLY);
+  if (!fd)
+    return 0;
+
+  /* the package knows how long its data is; the file is padded out to
+   * whole blocks */
+  size = fs_total(fd);
+  buf = malloc(size);
+  if (buf && (fs_read(fd, buf, size) == size) && pkg_fits(buf, size) &&
+      (vmu_pkg_parse(buf, &pkg) == 0))
+    ok = seek_index_deserialize(pkg.data, pkg.data_len);
+  fs_close(fd);
+  free(buf);
+
+  return ok;
+}
@@ -0,0 +1,92 @@
+#ifndef SEEK_INDEX_H
+#define SEEK_INDEX_H
+
+/*
+ * Seek index cache
+ *
+ * Demuxers for formats without an index of their own (FLI, Id CIN)
+ * record the positions they could restart playback from as they come
+ * across them. The indices are cached per MRL, least recently used
+ * first out, and the cache can be saved to and loaded from a small file
+ * on a VMU, so that a file played in an earlier run seeks without
+ * scanning it again. The file is a VMU package of at most
+ * SEEK_INDEX_SAVE_BLOCKS blocks; the least recently used indices are left
+ * out of it until the rest fit.
+ */
+
+#include <inttypes.h>
+#include <sys/types.h>
+
+/* the most MRLs and the most entries over all MRLs to keep */
+#define SEEK_INDEX_MAX_MRLS    8
+#define SEEK_INDEX_MAX_ENTRIES 16384
+
+/* the most VMU blocks (of 512 bytes) the saved cache may take, package
+ * header and icon included */
+#define SEEK_INDEX_SAVE_BLOCKS 16
+
+/* entry flags */
+#define SEEK_INDEX_KEYFRAME    0x01
+
+typedef struct {
+  int64_t              pts;
+  off_t                offset;
+  uint32_t             flags;
+  uint32_t             info;    /* for the demuxer's own use */
+} seek_index_entry_t;
+
+typedef struct seek_index_s seek_index_t;
+
+struct seek_index_s {
+  seek_index_t        *next;    /* more recently used first */
+  int                  users;   /* indices in use are never evicted */
+
+  char                *mrl;
+  off_t                file_size;
+
+  seek_index_entry_t  *entries; /* in ascending offset order */
+  int                  count;
+  int                  allocated;
+
+  /* where recording left off: the position of the next chunk that the
+   * demuxer has not looked at yet, and its state there */
+  int64_t              end_pts;
+  off_t                end_offset;
+  uint32_t             end_info;
+  int                  complete;
+};
+
+/* Returns the index for mrl, creating an empty one if it is not cached
+ * or if it was recorded for a file of another size. The index must be
+ * handed back with seek_index_release() when the demuxer is done. */
+seek_index_t *seek_index_get(const char *mrl, off_t file_size);
+void seek_index_release(seek_index_t *index);
+
+/* Appends an entry; entries must come in ascending offset order, and
+ * those that do not are ignored. */
+void seek_index_add(seek_index_t *index, int64_t pts, off_t offset,
+                    uint32_t flags, uint32_t info);
+
+/* Return the last entry at or before pts (or offset) that has all of
+ * the given flags, or NULL if there is none. */
+seek_index_entry_t *seek_index_find_pts(seek_index_t *index, int64_t pts,
+                                        uint32_t flags);
+seek_index_entry_t *seek_index_find_offset(seek_index_t *index,
+                                           off_t offset, uint32_t flags);
+
+/* Pack the max_indices most recently used indices in the cache into buf;
+ * returns the number of bytes needed, which may be more than size, in
+ * which case nothing useful was written. */
+int seek_index_serialize(unsigned char *buf, int size, int max_indices);
+
+/* Replace the unused indices in the cache with the ones in buf; returns 0
+ * if buf is not a valid blob. */
+int seek_index_deserialize(const unsigned char *buf, int size);
+
+/* Save the cache to or load it from a VMU package file; return 0 on
+ * failure. Saving does nothing, successfully, unless an index has grown
+ * since the cache was last loaded or saved. */
+int seek_index_save(const char *filename);
+int seek_index_load(const char *filename);
+
+#endif
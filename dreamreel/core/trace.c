@@ -0,0 +1,49 @@
+/*
+ * trace.c
+ *
+ * This module holds the per-thread event rings of the pipeline trace and
+ * writes them out. See trace.h.
+ */
+
+#include <kos.h>
+
+#include "dreamreel.h"
+#include "trace.h"
+
+#if TRACE_PIPELINE
+
+trace_ring_t trace_rings[TRACE_RING_COUNT];
+
+int trace_dump(const char *filename) {
+
+  trace_file_header_t header;
+  uint32_t head;
+  file_t fd;
+  int ok;
+  int i;
+
+  fd = fs_open(filename, O_WRONLY | O_TRUNC);
+  if (!fd)
+    return 0;
+
+  memcpy(header.magic, TRACE_MAGIC, 4);
+  header.version = TRACE_VERSION;
+  header.ring_count = TRACE_RING_COUNT;
+  header.ring_size = TRACE_RING_SIZE;
+  ok = (fs_write(fd, &header, sizeof(header)) == sizeof(header));
+
+  for (i = 0; ok && i < TRACE_RING_COUNT; i++) {
+    head = trace_rings[i].head;
+    ok = (fs_write(fd, &head, sizeof(head)) == sizeof(head)) &&
+      (fs_write(fd, trace_rings[i].events, sizeof(trace_rings[i].events)) ==
+       sizeof(trace_rings[i].events));
+  }
+  fs_close(fd);
+
+  debug_printf ("  trace: dumped %d rings to %s\n", TRACE_RING_COUNT,
+    filename);
+
+  return ok;
+}
+
+#endif
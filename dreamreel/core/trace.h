@@ -0,0 +1,130 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/*
+ * Pipeline trace
+ *
+ * Each thread that takes part in playback (and the metronom's vblank
+ * interrupt) appends fixed-size events to a ring of its own. A ring has
+ * exactly one writer, so writing an event takes no lock: the event goes
+ * into the slot after the last one and the head moves on. When a ring is
+ * full the oldest events are overwritten, so the rings always hold the
+ * last TRACE_RING_SIZE events of each thread.
+ *
+ * trace_dump() writes the rings out in the form below, for the host tool
+ * host/trace2json to turn into Chrome trace JSON (chrome://tracing):
+ *
+ *   trace_file_header_t
+ *   per ring: uint32_t head, trace_event_t events[TRACE_RING_SIZE]
+ *
+ * All fields are in the byte order of the machine that wrote the dump,
+ * which is little-endian on the Dreamcast and the usual hosts.
+ */
+
+#include <inttypes.h>
+
+/* define TRACE_PIPELINE as 1 to record events; otherwise the calls below
+ * compile to nothing (plain TRACE would turn on the bit reader tracing in
+ * libavcodec) */
+#ifndef TRACE_PIPELINE
+#define TRACE_PIPELINE 0
+#endif
+
+/* one ring per thread */
+enum {
+  TRACE_RING_DEMUX,
+  TRACE_RING_VIDEO_DECODER,
+  TRACE_RING_VIDEO_OUT,
+  TRACE_RING_AUDIO_DECODER,
+  TRACE_RING_METRONOM,
+  TRACE_RING_COUNT
+};
+
+#define TRACE_RING_NAMES { \
+  "demux", "video decoder", "video out", "audio decoder", "metronom" }
+
+/* events, with what their arguments hold */
+enum {
+  TRACE_BUFFER_PUT,      /* buffer type, bytes in the fifo */
+  TRACE_BUFFER_GET,      /* buffer type, bytes in the fifo */
+  TRACE_DECODE,          /* bytes */
+  TRACE_TWIDDLE,         /* texture width, texture height */
+  TRACE_DMA,             /* bytes, VRAM texture */
+  TRACE_FRAME_FLIP,      /* VRAM texture, pts (low 32 bits) */
+  TRACE_PALETTE_UPLOAD,  /* VRAM texture */
+  TRACE_VBLANK,          /* pts counter (low 32 bits), 1 if a frame is due */
+  TRACE_EVENT_COUNT
+};
+
+#define TRACE_EVENT_NAMES { \
+  "buffer put", "buffer get", "decode", "twiddle", "dma", "frame flip", \
+  "palette upload", "vblank" }
+
+/* phases, as Chrome names them */
+#define TRACE_INSTANT 'i'
+#define TRACE_BEGIN   'B'
+#define TRACE_END     'E'
+
+typedef struct {
+  uint32_t  time_us;   /* wraps after 71 minutes */
+  uint8_t   event;
+  uint8_t   phase;
+  uint16_t  reserved;
+  uint32_t  arg0;
+  uint32_t  arg1;
+} trace_event_t;
+
+/* events per ring; must be a power of 2 */
+#define TRACE_RING_SIZE 4096
+
+typedef struct {
+  volatile uint32_t  head;  /* the number of events ever written */
+  trace_event_t      events[TRACE_RING_SIZE];
+} trace_ring_t;
+
+#define TRACE_MAGIC "DRTR"
+#define TRACE_VERSION 1
+
+typedef struct {
+  char      magic[4];
+  uint32_t  version;
+  uint32_t  ring_count;
+  uint32_t  ring_size;
+} trace_file_header_t;
+
+#if TRACE_PIPELINE
+
+#include <kos.h>
+
+extern trace_ring_t trace_rings[TRACE_RING_COUNT];
+
+static inline void trace_event(int ring, int event, int phase,
+                               uint32_t arg0, uint32_t arg1) {
+
+  trace_ring_t *r = &trace_rings[ring];
+  trace_event_t *e = &r->events[r->head & (TRACE_RING_SIZE - 1)];
+
+  e->time_us = (uint32_t)timer_us_gettime64();
+  e->event = event;
+  e->phase = phase;
+  e->arg0 = arg0;
+  e->arg1 = arg1;
+
+  /* the event has to be in place before the head moves past it */
+  __asm__ __volatile__ ("" : : : "memory");
+  r->head++;
+}
+
+/* Write the rings to filename; returns 0 on failure. The dump is only
+ * consistent once the threads have stopped writing. */
+int trace_dump(const char *filename);
+
+#else
+
+static inline void trace_event(int ring, int event, int phase,
+                               uint32_t arg0, uint32_t arg1) { }
+static inline int trace_dump(const char *filename) { return 1; }
+
+#endif
+
+#endif
@@ -0,0 +1,213 @@
+/*
+ * twiddle.c
+ *
+ * This module converts images into the twiddled (Morton) order that the
+ * PVR reads textures in. It is kept apart from the video output so that
+ * the host build can run the same code.
+ */
+
+#include "twiddle.h"
+
+/* borrowing liberally from 
+ * kos/kernel/arch/dreamcast/hardware/pvr/pvr_texture.c
+ * for the texture twiddling */
+#define TWIDTAB(x) ( ((x)&1)|(((x)&2)<<1)|(((x)&4)<<2)|(((x)&8)<<3)| \
+        (((x)&16)<<4)|(((x)&32)<<5)|(((x)&64)<<6)|(((x)&128)<<7)| \
+        (((x)&256)<<8)|(((x)&512)<<9) )
+#define TWIDOUT(x, y) ( TWIDTAB((y)) | (TWIDTAB((x)) << 1) )
+#define MIN(a, b) ( (a)<(b)? (a):(b) )
+
+void twiddle_pal8(uint16_t *texture, const uint8_t *pixels,
+                  int width, int height) {
+
+  int x, y;
+  int min, mask, yout;
+
+  min = MIN(width, height);
+  mask = min - 1;
+  for (y = 0; y < height; y += 2) {
+    yout = y;
+    for (x = 0; x < width; x++) {
+#if 1
+      texture[TWIDOUT((yout & mask) / 2, x & mask) +
+        ((x / min + yout / min) * min * min / 2)] =
+        pixels[y * width + x] | (pixels[(y + 1) * width + x] << 8);
+#else
+      texture[TWIDOUT((yout & mask) / 2, x & mask) +
+        ((x + yout) * min / 2)] =
+        pixels[y * width + x] | (pixels[(y + 1) * width + x] << 8);
+#endif
+    }
+  }
+}
+
+void twiddle_16bpp(uint16_t *texture, const uint16_t *pixels,
+                   int width, int height) {
+
+  int x, y;
+  int min, mask;
+
+  min = MIN(width, height);
+  mask = min - 1;
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++)
+      texture[TWIDOUT(x & mask, y & mask) + (x / min + y / min) * min * min] =
+        pixels[y * width + x];
+}
+
+void pal8_lut_rgb565(uint16_t *lut, const uint32_t *palette) {
+
+  int i;
+
+  for (i = 0; i < 256; i++)
+    lut[i] = ((palette[i] >> 8) & 0xF800) | ((palette[i] >> 5) & 0x07E0) |
+      ((palette[i] >> 3) & 0x001F);
+}
+
+void pal8_lut_argb1555(uint16_t *lut, const uint32_t *palette) {
+
+  int i;
+
+  for (i = 0; i < 256; i++)
+    lut[i] = 0x8000 | ((palette[i] >> 9) & 0x7C00) |
+      ((palette[i] >> 6) & 0x03E0) | ((palette[i] >> 3) & 0x001F);
+}
+
+/* In a square tile of the twiddled order, the bits of y and x alternate
+ * in the texel index, y in the even bits and x in the odd, so the texels
+ * (x, y), (x, y + 1), (x + 1, y) and (x + 1, y + 1) of an even x and y are
+ * next to each other. Each pair of rows is written 2 columns, 8 bytes, at
+ * a time, moving to the next pair of columns by adding 1 to the x bits of
+ * the index above bit 1. A texture that is not square is a row or column
+ * of square tiles, one after the other. */
+void twiddle_pal8_16bpp(uint16_t *texture, const uint8_t *pixels,
+                        int width, int height, const uint16_t *lut) {
+
+  const uint8_t *row0, *row1;
+  uint32_t *tile;
+  uint32_t index, x_bits;
+  int x, y, end, min, tile_size;
+
+  min = MIN(width, height);
+  tile_size = min * min;
+  x_bits = (TWIDTAB(min - 1) << 1) & ~2;
+  for (y = 0; y < height; y += 2) {
+    row0 = pixels + y * width;
+    row1 = row0 + width;
+    for (x = 0; x < width; x = end) {
+      tile = (uint32_t *)(texture + TWIDTAB(y & (min - 1)) +
+        (x / min + y / min) * tile_size);
+      for (index = 0, end = x + min; x < end; x += 2) {
+        tile[index >> 1] = lut[row0[x]] | (lut[row1[x]] << 16);
+        tile[(index >> 1) + 1] = lut[row0[x + 1]] | (lut[row1[x + 1]] << 16);
+        index = ((index | ~x_bits) + 1) & x_bits;
+      }
+    }
+  }
+}
+
+void pack_yuv422(uint16_t *texture, int texture_width,
+                 uint8_t **planes, int linesize, int width, int height) {
+
+  uint32_t *out;
+  const uint8_t *y_plane, *u_plane, *v_plane;
+  int x, y;
+
+  for (y = 0; y < height; y++) {
+    out = (uint32_t *)&texture[y * texture_width];
+    y_plane = planes[0] + y * linesize;
+    u_plane = planes[1] + (y / 2) * (linesize / 2);
+    v_plane = planes[2] + (y / 2) * (linesize / 2);
+    for (x = 0; x < width / 2; x++)
+      out[x] = u_plane[x] | (y_plane[x * 2] << 8) |
+        (v_plane[x] << 16) | ((uint32_t)y_plane[x * 2 + 1] << 24);
+  }
+}
+
+/* pack_yuv422() of a source 2^shift times the size each way, each texel
+ * the rounded average of the box of 2^shift x 2^shift luma samples, and
+ * each chroma pair of the 2^shift x 2^(shift - 1) chroma samples, under
+ * it, as shrink22() in libavcodec/imgconvert.c averages; width and height
+ * are those of the texels. shift is a constant in each caller, so that
+ * the loops over the boxes unroll. */
+static inline void pack_yuv422_box(uint16_t *texture, int texture_width,
+                                   uint8_t **planes, int linesize,
+                                   int width, int height, const int shift) {
+
+  const int n = 1 << shift;
+  const int chroma_linesize = linesize / 2;
+  uint32_t *out;
+  const uint8_t *y_plane, *u_plane, *v_plane;
+  int x, y, i, j, y0, y1, u, v;
+
+  for (y = 0; y < height; y++) {
+    out = (uint32_t *)&texture[y * texture_width];
+    y_plane = planes[0] + (y << shift) * linesize;
+    u_plane = planes[1] + (y << (shift - 1)) * chroma_linesize;
+    v_plane = planes[2] + (y << (shift - 1)) * chroma_linesize;
+    for (x = 0; x < width / 2; x++) {
+      y0 = y1 = u = v = 0;
+      for (j = 0; j < n; j++)
+        for (i = 0; i < n; i++) {
+          y0 += y_plane[j * linesize + (x << (shift + 1)) + i];
+          y1 += y_plane[j * linesize + (x << (shift + 1)) + n + i];
+        }
+      for (j = 0; j < n / 2; j++)
+        for (i = 0; i < n; i++) {
+          u += u_plane[j * chroma_linesize + (x << shift) + i];
+          v += v_plane[j * chroma_linesize + (x << shift) + i];
+        }
+      y0 = (y0 + (n * n / 2)) >> (2 * shift);
+      y1 = (y1 + (n * n / 2)) >> (2 * shift);
+      u = (u + (n * n / 4)) >> (2 * shift - 1);
+      v = (v + (n * n / 4)) >> (2 * shift - 1);
+      out[x] = u | (y0 << 8) | (v << 16) | ((uint32_t)y1 << 24);
+    }
+  }
+}
+
+void pack_yuv422_shrunk(uint16_t *texture, int texture_width,
+                        uint8_t **planes, int linesize, int width, int height,
+                        int shift) {
+
+  if (shift == 1)
+    pack_yuv422_box(texture, texture_width, planes, linesize,
+      width >> 1, height >> 1, 1);
+  else
+    pack_yuv422_box(texture, texture_width, planes, linesize,
+      width >> 2, height >> 2, 2);
+}
+
+/* In the twiddled order the 2x2 square of texels under each texel of a
+ * texture half the size each way is 4 texels in a row, and the 4x4
+ * square under each texel of one a quarter the size is 16, so both
+ * shrinks are a single pass along the texture. Red and blue are summed
+ * together, and green apart, without the channels running into each
+ * other. */
+static inline void shrink_argb1555_box(uint16_t *texture,
+                                       const uint16_t *texels, int count,
+                                       const int shift) {
+
+  int n = 1 << (2 * shift), i, j;
+  uint32_t rb, g;
+
+  for (i = 0; i < count; i++) {
+    rb = (n / 2) * 0x0401;
+    g = (n / 2) << 5;
+    for (j = 0; j < n; j++, texels++) {
+      rb += *texels & 0x7C1F;
+      g += *texels & 0x03E0;
+    }
+    texture[i] = 0x8000 | ((rb >> (2 * shift)) & 0x7C1F) |
+      ((g >> (2 * shift)) & 0x03E0);
+  }
+}
+
+void shrink_argb1555(uint16_t *texture, const uint16_t *texels, int count,
+                     int shift) {
+
+  if (shift == 1)
+    shrink_argb1555_box(texture, texels, count, 1);
+  else
+    shrink_argb1555_box(texture, texels, count, 2);
+}
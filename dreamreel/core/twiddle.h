@@ -0,0 +1,51 @@
+#ifndef TWIDDLE_H
+#define TWIDDLE_H
+
+#include <inttypes.h>
+
+/* Rearrange a width x height image of 8-bit palette indices into the
+ * twiddled order of a PVR PAL8 texture; width and height must be powers
+ * of 2. The indices are written 2 to a 16-bit word. */
+void twiddle_pal8(uint16_t *texture, const uint8_t *pixels,
+                  int width, int height);
+
+/* Rearrange a width x height image of 16-bit texels into the twiddled
+ * order of a PVR 16bpp texture; width and height must be powers of 2. */
+void twiddle_16bpp(uint16_t *texture, const uint16_t *pixels,
+                   int width, int height);
+
+/* Fill a 256-entry lookup table with the RGB565 or ARGB1555 texel of each
+ * colour of a palette of 0xAARRGGBB words. ARGB1555 texels are opaque. */
+void pal8_lut_rgb565(uint16_t *lut, const uint32_t *palette);
+void pal8_lut_argb1555(uint16_t *lut, const uint32_t *palette);
+
+/* Look up each 8-bit palette index of a width x height image in lut and
+ * write the texels in the twiddled order of a PVR 16bpp texture, in one
+ * pass; the same as converting the image to 16 bits a pixel and then
+ * calling twiddle_16bpp(). Width and height must be powers of 2. */
+void twiddle_pal8_16bpp(uint16_t *texture, const uint8_t *pixels,
+                        int width, int height, const uint16_t *lut);
+
+/* Pack a width x height YUV420P image into a non-twiddled PVR YUV422
+ * texture that is texture_width texels across. Each pair of texels is
+ * written as U Y0 V Y1; the chroma rows are used twice. linesize is the
+ * stride of the Y plane, and half of it that of the U and V planes. */
+void pack_yuv422(uint16_t *texture, int texture_width,
+                 uint8_t **planes, int linesize, int width, int height);
+
+/* The same for a width x height YUV420P image that is 2 (shift 1) or 4
+ * (shift 2) times the size of the texels in each direction: each texel
+ * is the box average of the pixels it covers. The shrinking happens as
+ * the texels are packed, with no pass of its own. */
+void pack_yuv422_shrunk(uint16_t *texture, int texture_width,
+                        uint8_t **planes, int linesize, int width, int height,
+                        int shift);
+
+/* Shrink a twiddled ARGB1555 texture 2:1 (shift 1) or 4:1 (shift 2) each
+ * way into texture, which is count texels: each texel is the box average
+ * of the texels it covers, and stays opaque. It takes the place of
+ * copying the texture out, and reads the same texels. */
+void shrink_argb1555(uint16_t *texture, const uint16_t *texels, int count,
+                     int shift);
+
+#endif
@@ -1,5 +1,7 @@
 #include "dreamreel.h"
 #include "bswap.h"
+#include "trace.h"
+#include "metronom.h"
 
 #include "common.h"
 #include "avcodec.h"
@@ -11,6 +13,13 @@
 /* these are the actual dimensions of the image */
 int actual_width, actual_height;
 
+/* sources bigger than the screen are shrunk by 2^downscale_shift each
+ * way as they are packed into the texture, to scaled_width x
+ * scaled_height */
+#define MAX_DOWNSCALE_SHIFT 2
+int downscale_shift;
+int scaled_width, scaled_height;
+
 /* these are the texture dimensions of the image */
 int texture_width, texture_height;
 int log2_width, log2_height;
@@ -46,7 +55,8 @@ printf ("  allocating a buffer with %d bytes, %d stride\n",
 printf ("    get_buffer() allocated a buffer @ %p with stride %d\n", 
   av_frame->data[0], av_frame->linesize[0]);
     }
-  }
+  } else
+    ret = avcodec_default_get_buffer(context, av_frame);
 
   return ret;
 }
@@ -56,7 +66,8 @@ static void release_buffer(struct AVCodecContext *context, AVFrame *av_frame) {
   if (context->pix_fmt == PIX_FMT_PAL8) {
     free(av_frame->data[0]);
     av_frame->data[0] = NULL;
-  }
+  } else
+    avcodec_default_release_buffer(context, av_frame);
 
 }
 
@@ -74,6 +85,7 @@ int map_decoder(xine_stream_t *stream, buf_element_t *buf) {
         = strdup ("Autodesk Animator FLI/FLC");
     actual_width = LE_16(&buf->content[8]);
     actual_height = LE_16(&buf->content[10]);
+    pixel_format = PIX_FMT_PAL8;
     break;
 
   case BUF_VIDEO_IDCIN:
@@ -82,6 +94,41 @@ int map_decoder(xine_stream_t *stream, buf_element_t *buf) {
         = strdup ("Quake II Cinematic Video");
     actual_width = BE_16(&buf->content[0]);
     actual_height = BE_16(&buf->content[2]);
+    pixel_format = PIX_FMT_PAL8;
+    break;
+
+  case BUF_VIDEO_RPZA:
+    decoder = avcodec_find_decoder (CODEC_ID_RPZA);
+    stream->meta_info[XINE_META_INFO_VIDEOCODEC]
+        = strdup ("Apple Video (RPZA)");
+    actual_width = ((xine_bmiheader *)buf->content)->biWidth;
+    actual_height = ((xine_bmiheader *)buf->content)->biHeight;
+    pixel_format = PIX_FMT_RGB555;
+    break;
+
+  case BUF_VIDEO_MSVC:
+    /* only the 16-bit variant; there is no palette for the 8-bit one */
+    if (((xine_bmiheader *)buf->content)->biBitCount == 8) {
+      ret = 1;
+      debug_printf ("no decoder for palettized MS Video-1\n");
+      break;
+    }
+    decoder = avcodec_find_decoder (CODEC_ID_MSVIDEO1);
+    stream->meta_info[XINE_META_INFO_VIDEOCODEC]
+        = strdup ("Microsoft Video-1");
+    actual_width = ((xine_bmiheader *)buf->content)->biWidth;
+    actual_height = ((xine_bmiheader *)buf->content)->biHeight;
+    pixel_format = PIX_FMT_RGB555;
+    break;
+
+  case BUF_VIDEO_MPEG:
+    /* the header buffer carries the sequence header */
+    decoder = avcodec_find_decoder (CODEC_ID_MPEG1VIDEO);
+    stream->meta_info[XINE_META_INFO_VIDEOCODEC]
+        = strdup ("MPEG-1 Video");
+    actual_width = (buf->content[4] << 4) | (buf->content[5] >> 4);
+    actual_height = ((buf->content[5] & 0x0F) << 8) | buf->content[6];
+    pixel_format = PIX_FMT_YUV420P;
     break;
 
   default:
@@ -103,18 +150,40 @@ int init_video_parameters(void) {
   if (pixel_format > PIX_FMT_NB)
     return 1;
 
+  /* a YUV or RGB555 source bigger than the screen is shrunk 2:1 or 4:1
+   * until it fits; palette indices cannot be averaged, so PAL8 is left
+   * alone */
+  downscale_shift = 0;
+  if (pixel_format != PIX_FMT_PAL8)
+    while (downscale_shift < MAX_DOWNSCALE_SHIFT &&
+           ((actual_width >> downscale_shift) > 640 ||
+            (actual_height >> downscale_shift) > 480))
+      downscale_shift++;
+  scaled_width = actual_width >> downscale_shift;
+  scaled_height = actual_height >> downscale_shift;
+
+  /* RGB555 is shrunk from the decoder's whole texture, so the scaled
+   * size rounds up to land in the texture a 2^downscale_shift fraction
+   * of that one */
+  if (pixel_format == PIX_FMT_RGB555) {
+    scaled_width = (actual_width + (1 << downscale_shift) - 1) >>
+      downscale_shift;
+    scaled_height = (actual_height + (1 << downscale_shift) - 1) >>
+      downscale_shift;
+  }
+
   /* sanity check the dimensions */
-  if ((actual_width < 16) ||
-      (actual_width > 1024) ||
-      (actual_height < 16) ||
-      (actual_height > 1024))
+  if ((scaled_width < 16) ||
+      (scaled_width > 1024) ||
+      (scaled_height < 16) ||
+      (scaled_height > 1024))
     return 1;
 
   /* figure out the texture dimensions by working out the nearest power
    * of 2 */
   number_of_bits = log2_width = 0;
   for (i = 0; i < 31; i++)
-    if (actual_width & (1 << i)) {
+    if (scaled_width & (1 << i)) {
       number_of_bits++;
       log2_width = i;
     }
@@ -124,7 +193,7 @@ int init_video_parameters(void) {
 
   number_of_bits = log2_height = 0;
   for (i = 0; i < 31; i++)
-    if (actual_height & (1 << i)) {
+    if (scaled_height & (1 << i)) {
       number_of_bits++;
       log2_height = i;
     }
@@ -134,9 +203,57 @@ int init_video_parameters(void) {
 
   texture_size = texture_width * texture_height;
 
+  /* everything but palettized video goes out as 16-bit YUV422 or
+   * ARGB1555 */
+  if (pixel_format != PIX_FMT_PAL8)
+    texture_size *= 2;
+
   return 0;
 }
 
+/* the pts of the reference picture the decoder is holding back, for
+ * decoders that reorder pictures */
+static int64_t reference_pts;
+
+/* hands a decoded picture to the video output, which has a work texture
+ * locked for it */
+static void output_frame(AVFrame *av_frame, int64_t pts, int last_frame) {
+
+  if (pixel_format == PIX_FMT_PAL8) {
+    set_texture_palette(av_frame->new_palette, av_frame->palette);
+    draw_texture_slice(av_frame->data, texture_width, 0, texture_width,
+      texture_height);
+  } else if (pixel_format == PIX_FMT_RGB555)
+    /* the decoder drew the whole texture */
+    draw_texture_slice(av_frame->data, av_frame->linesize[0], 0,
+      texture_width, texture_height);
+  else
+    draw_texture_slice(av_frame->data, av_frame->linesize[0], 0,
+      actual_width, actual_height);
+
+debug_printf ("  video decoder sending out a frame with pts %lld...\n", pts);
+  send_texture(pts, pts, av_frame->new_palette, av_frame->palette,
+    last_frame);
+}
+
+/* gets the last reference picture out of a decoder that reorders
+ * pictures */
+static void flush_decoder(void) {
+
+  AVFrame av_frame;
+  int got_picture;
+
+  if (!context->has_b_frames)
+    return;
+
+  lock_twiddle_texture();
+  avcodec_decode_video (context, &av_frame, &got_picture, NULL, 0);
+  if (got_picture)
+    output_frame(&av_frame, reference_pts, 1);
+  else
+    unlock_twiddle_texture();
+}
+
 /**************************************************************************
  * video decoder thread
  **************************************************************************/
@@ -153,6 +270,7 @@ void video_decoder_thread(void *v) {
   int got_picture;
   int offset;
   int last_frame;
+  int64_t pts;
 
 debug_printf ("  *** this is the video decoder thread talking\n");
 
@@ -163,6 +281,9 @@ debug_printf ("  *** this is the video decoder thread talking\n");
   context->codec_tag = stream->stream_info[XINE_STREAM_INFO_VIDEO_FOURCC];
   context->get_buffer = get_buffer;
   context->release_buffer = release_buffer;
+  /* RGB555 decoders draw their pictures as textures, with no twiddling
+   * pass after */
+  context->flags |= CODEC_FLAG_TWIDDLED;
 
   while (!end_of_stream) {
 
@@ -174,18 +295,28 @@ debug_printf ("  video decoder received buffer, type %08X, %d bytes, flags: %08X
   stream->video_fifo->buf.type,
   stream->video_fifo->buffer_data_index,
   stream->video_fifo->buf.decoder_flags);
+    trace_event(TRACE_RING_VIDEO_DECODER, TRACE_BUFFER_GET, TRACE_INSTANT,
+      stream->video_fifo->buf.type, stream->video_fifo->buffer_data_index);
 
     last_frame = 
       stream->video_fifo->buf.decoder_flags & BUF_FLAG_END_USER;
     end_of_stream = 
       stream->video_fifo->buf.decoder_flags & BUF_FLAG_END_STREAM;
-    if (end_of_stream)
+    if (end_of_stream) {
+      if (stream->stream_info[XINE_STREAM_INFO_VIDEO_HANDLED])
+        flush_decoder();
       continue;
+    }
 
     /* handle the header */
     if (stream->video_fifo->buf.decoder_flags & BUF_FLAG_HEADER) {
 
-      map_decoder(stream, &stream->video_fifo->buf);
+      if (map_decoder(stream, &stream->video_fifo->buf) != 0) {
+        /* nothing to decode this video with; let the frames go by */
+        stream->stream_info[XINE_STREAM_INFO_VIDEO_HANDLED] = 0;
+        stream->video_fifo->clear(stream->video_fifo);
+        continue;
+      }
       context->width = actual_width;
       context->height = actual_height;
 
@@ -220,30 +351,49 @@ debug_printf ("  video decoder received buffer, type %08X, %d bytes, flags: %08X
       continue;
     }
 
-    /* handle any special buffers */
-    if (stream->video_fifo->buf.decoder_flags & BUF_FLAG_SPECIAL) {
+    /* handle any special buffers, and any frames that can not be
+     * decoded */
+    if ((stream->video_fifo->buf.decoder_flags & BUF_FLAG_SPECIAL) ||
+        !stream->stream_info[XINE_STREAM_INFO_VIDEO_HANDLED]) {
 
       /* finished processing this buffer; wait for the next one */
       stream->video_fifo->clear(stream->video_fifo);
       continue;
     }
 
-    /* decode the video */
+    /* decode the video; a decoder that can skip pictures may do so when
+     * this one is already late */
     lock_twiddle_texture();
 
+    pts = stream->video_fifo->buf.pts;
+    context->hurry_up = (metronom_get() > pts);
+
     offset = 0;
+    trace_event(TRACE_RING_VIDEO_DECODER, TRACE_DECODE, TRACE_BEGIN,
+      stream->video_fifo->buffer_data_index, 0);
     len = avcodec_decode_video (context, &av_frame,
       &got_picture, &stream->video_fifo->buffer_data[offset], 
       stream->video_fifo->buffer_data_index);
+    trace_event(TRACE_RING_VIDEO_DECODER, TRACE_DECODE, TRACE_END,
+      stream->video_fifo->buffer_data_index, 0);
+    stream->video_fifo->clear(stream->video_fifo);
 
-    draw_texture_slice(av_frame.data, 512, 0, 512, 256);
+    /* a reference picture comes out when the next one goes in, so it
+     * takes the pts that came in with it */
+    if (context->has_b_frames &&
+        (context->coded_frame->pict_type != FF_B_TYPE)) {
+      int64_t held_pts = reference_pts;
+      reference_pts = pts;
+      pts = held_pts;
+    }
 
-debug_printf ("  video decoder sending out a frame with pts %lld...\n", 
-    stream->video_fifo->buf.pts);
-    stream->video_fifo->clear(stream->video_fifo);
-    send_texture(stream->video_fifo->buf.pts,
-      stream->video_fifo->buf.pts, av_frame.new_palette, 
-      av_frame.palette, last_frame);
+    if (got_picture)
+      output_frame(&av_frame, pts, last_frame && !context->has_b_frames);
+    else
+      unlock_twiddle_texture();
+
+    if (last_frame)
+      flush_decoder();
   };
 
 debug_printf ("video decoder thread exit\n");
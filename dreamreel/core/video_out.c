@@ -4,6 +4,8 @@
 #include "video_out.h"
 #include "metronom.h"
 #include "gui.h"
+#include "twiddle.h"
+#include "trace.h"
 
 /**************************************************************************
  * global variables borrowed from video_decoder.c
@@ -12,6 +14,10 @@
 /* these are the actual dimensions of the image */
 extern int actual_width, actual_height;
 
+/* these are the dimensions it is shrunk to, by 2^downscale_shift */
+extern int downscale_shift;
+extern int scaled_width, scaled_height;
+
 /* these are the texture dimensions of the image */
 extern int texture_width, texture_height;
 extern int log2_width, log2_height;
@@ -45,6 +51,20 @@ static unsigned char *twiddle_textures[2];
 static mutex_t *twiddle_texture_mutex[2];
 static int active_twiddle_texture;
 
+/* The PVR has the one palette, loaded as each PAL8 frame is shown. Once
+ * the palette changes while frames in the old one are still queued, the
+ * rest of the stream goes out as twiddled RGB565 textures instead, with
+ * the colours looked up in pal8_lut as the frame is twiddled; the VRAM
+ * textures of a PAL8 stream are made big enough for that if at least
+ * MIN_RGB565_TEXTURES of them fit. */
+#define MIN_RGB565_TEXTURES 4
+static int pal8_rgb565_possible;
+static int pal8_rgb565;
+static uint16_t pal8_lut[256];
+
+/* the size of each VRAM and work texture */
+static int vram_texture_size;
+
 static volatile int thread_is_alive = 0;
 static volatile int deliver_next_frame;
 static kthread_t *this_thread;
@@ -52,6 +72,9 @@ static int frame_queued;
 
 static int64_t video_pts;
 
+/* when the decoder got hold of a work texture and started decoding */
+static uint64 decode_start;
+
 /*
  * 0 = stopped
  * 1 = play
@@ -71,6 +94,21 @@ static void video_output_callback(void) {
   thd_schedule_next(this_thread);
 }
 
+/* allocates as many VRAM textures of size bytes as will fit, up to
+ * MAX_VRAM_TEXTURES, and returns how many it got */
+static int alloc_vram_textures(int size) {
+
+  int i;
+
+  for (i = 0; i < MAX_VRAM_TEXTURES; i++) {
+    if ((vram_textures[i].base[0] = pvr_mem_malloc(size)) == NULL)
+      break;
+    vram_textures[i].pts = -1;
+  }
+
+  return i;
+}
+
 /* returns 0 if everything checked out */
 int init_video_out(void) {
 
@@ -84,9 +122,26 @@ int init_video_out(void) {
   /* reset the video output for good measure */
   reset_video_out();
 
-  /* allocate VRAM and main RAM work buffers */
-  twiddle_textures_unaligned[0] = malloc(texture_size + 32);
-  twiddle_textures_unaligned[1] = malloc(texture_size + 32);
+  /* allocate as many textures as available VRAM will allow, twice the
+   * size for a PAL8 stream if enough of them fit */
+  pal8_rgb565 = 0;
+  pal8_rgb565_possible = (pixel_format == PIX_FMT_PAL8);
+  vram_texture_size = pal8_rgb565_possible ? texture_size * 2 : texture_size;
+  vram_texture_count = alloc_vram_textures(vram_texture_size);
+  if (pal8_rgb565_possible && vram_texture_count < MIN_RGB565_TEXTURES) {
+    for (i = 0; i < vram_texture_count; i++) {
+      pvr_mem_free(vram_textures[i].base[0]);
+      vram_textures[i].base[0] = NULL;
+    }
+    pal8_rgb565_possible = 0;
+    vram_texture_size = texture_size;
+    vram_texture_count = alloc_vram_textures(vram_texture_size);
+  }
+  next_free_vram_texture = 0;
+
+  /* allocate the main RAM work buffers */
+  twiddle_textures_unaligned[0] = malloc(vram_texture_size + 32);
+  twiddle_textures_unaligned[1] = malloc(vram_texture_size + 32);
   if (!twiddle_textures_unaligned[0] || !twiddle_textures_unaligned[1])
     goto free_memory;
 
@@ -98,25 +153,25 @@ int init_video_out(void) {
       twiddle_textures[1] = twiddle_textures_unaligned[1] + i;
   }
 
-  /* allocate as many textures as available VRAM will allow */
-  for (i = 0; i < MAX_VRAM_TEXTURES; i++) {
-    if ((vram_textures[i].base[0] = pvr_mem_malloc(texture_size)) == NULL)
-      break;
-    vram_textures[i].pts = -1;
+  /* YUV frames smaller than the texture leave a border that is never
+   * drawn into; make it black rather than green */
+  if (pixel_format == PIX_FMT_YUV420P) {
+    for (i = 0; i < texture_size / 4; i++) {
+      ((uint32 *)twiddle_textures[0])[i] = 0x10801080;
+      ((uint32 *)twiddle_textures[1])[i] = 0x10801080;
+    }
   }
-  vram_texture_count = i;
-  next_free_vram_texture = 0;
 
   /* determine the boundaries of the texture */
-  width_ratio = 640.0 / actual_width;
-  height_ratio = 480.0 / actual_height;
+  width_ratio = 640.0 / scaled_width;
+  height_ratio = 480.0 / scaled_height;
 
   /* compute the stretched resolution */
   if (width_ratio < height_ratio) {
     ul_x = 0;
     br_x = (int)(width_ratio * texture_width);
 
-    ul_y = ((480 - width_ratio * actual_height) / 2);
+    ul_y = ((480 - width_ratio * scaled_height) / 2);
     br_y = ul_y + (int)(width_ratio * texture_height);
   } else {
   }
@@ -188,6 +243,17 @@ debug_printf ("    video_out: locking work texture...\n");
   next_free_vram_texture = (next_free_vram_texture + 1) % vram_texture_count;
 debug_printf ("    video_out: locked work texture %d and VRAM texture %d\n",
   active_twiddle_texture, current_vram_texture);
+
+  decode_start = timer_us_gettime64();
+}
+
+/* This function gives back the locked textures when the decoder turns out
+ * to have no frame to send, as when it skips a picture or holds one back
+ * to reorder it. */
+void unlock_twiddle_texture(void) {
+
+  mutex_unlock(twiddle_texture_mutex[active_twiddle_texture]);
+  next_free_vram_texture = current_vram_texture;
 }
 
 /* This function mimics the libavcodec draw_horiz_band() function:
@@ -197,46 +263,66 @@ debug_printf ("    video_out: locked work texture %d and VRAM texture %d\n",
  *  y is the starting Y axis position of the slice
  *  width is the actual width of the image data
  *  h is the height of the slice
+ * YUV data is shrunk by 2^downscale_shift each way as it is packed.
+ * RGB555 data is a whole texture, already twiddled by the decoder, and
+ * is shrunk as it is copied out.
  */
 
-/* borrowing liberally from 
- * kos/kernel/arch/dreamcast/hardware/pvr/pvr_texture.c
- * for the texture twiddling */
-#define TWIDTAB(x) ( (x&1)|((x&2)<<1)|((x&4)<<2)|((x&8)<<3)|((x&16)<<4)| \
-        ((x&32)<<5)|((x&64)<<6)|((x&128)<<7)|((x&256)<<8)|((x&512)<<9) )
-#define TWIDOUT(x, y) ( TWIDTAB((y)) | (TWIDTAB((x)) << 1) )
-#define MIN(a, b) ( (a)<(b)? (a):(b) )
-
 void draw_texture_slice(
   uint8_t **src_ptr, int linesize,
   int start_y, int width, int height) {
 
-  uint8 * pixels;
-  uint16 * vtex;
-  int x, y;
-  int min, mask, yout;
+  uint64 start = timer_us_gettime64();
 
 debug_printf ("    video_out: drawing work texture...\n");
+  HUD_AVERAGE(hud_stats.decode_us, start - decode_start);
+
+  /* twiddle the texture into a work frame in main RAM; this runs in the
+   * video decoder thread, as does send_texture() */
+  trace_event(TRACE_RING_VIDEO_DECODER, TRACE_TWIDDLE, TRACE_BEGIN,
+    width, height);
+  if (pixel_format == PIX_FMT_PAL8 && pal8_rgb565)
+    twiddle_pal8_16bpp((uint16_t *)twiddle_textures[active_twiddle_texture],
+      src_ptr[0], width, height, pal8_lut);
+  else if (pixel_format == PIX_FMT_PAL8)
+    twiddle_pal8((uint16_t *)twiddle_textures[active_twiddle_texture],
+      src_ptr[0], width, height);
+  else if (pixel_format == PIX_FMT_RGB555 && downscale_shift)
+    shrink_argb1555((uint16_t *)twiddle_textures[active_twiddle_texture],
+      (uint16_t *)src_ptr[0], texture_size / 2, downscale_shift);
+  else if (pixel_format == PIX_FMT_RGB555)
+    /* already twiddled; the decoder draws the next frame over it, so it
+     * is copied out for the DMA */
+    memcpy(twiddle_textures[active_twiddle_texture], src_ptr[0],
+      texture_size);
+  else if (downscale_shift)
+    pack_yuv422_shrunk((uint16_t *)twiddle_textures[active_twiddle_texture],
+      texture_width, src_ptr, linesize, width, height, downscale_shift);
+  else
+    pack_yuv422((uint16_t *)twiddle_textures[active_twiddle_texture],
+      texture_width, src_ptr, linesize, width, height);
+  trace_event(TRACE_RING_VIDEO_DECODER, TRACE_TWIDDLE, TRACE_END,
+    width, height);
+  HUD_AVERAGE(hud_stats.twiddle_us, timer_us_gettime64() - start);
+}
 
-  /* twiddle the texture into a work frame in main RAM */
-  min = MIN(width, height);
-  mask = min - 1;
-  pixels = src_ptr[0];
-  vtex = (uint16*)twiddle_textures[active_twiddle_texture];
-  for (y = 0; y < height; y += 2) {
-    yout = y;
-    for (x = 0; x < width; x++) {
-#if 1
-      vtex[TWIDOUT((yout & mask) / 2, x & mask) +
-        ((x / min + yout / min) * min * min / 2)] =
-        pixels[y * width + x] | (pixels[(y + 1) * width + x] << 8);
-#else
-      vtex[TWIDOUT((yout & mask) / 2, x & mask) +
-        ((x + yout) * min / 2)] =
-        pixels[y * width + x] | (pixels[(y + 1) * width + x] << 8);
-#endif
-    }
+/* This function is given the palette of each PAL8 frame before the frame
+ * is drawn, with new_palette set if it changed. It decides whether the
+ * frame goes out paletted or as RGB565 (see pal8_rgb565 above). */
+void set_texture_palette(int new_palette, int *palette) {
+
+  int i;
+
+  if (!new_palette)
+    return;
+
+  if (!pal8_rgb565 && pal8_rgb565_possible) {
+    for (i = 0; i < vram_texture_count; i++)
+      if (vram_textures[i].in_use)
+        pal8_rgb565 = 1;
   }
+  if (pal8_rgb565)
+    pal8_lut_rgb565(pal8_lut, (const uint32_t *)palette);
 }
 
 /* This function tells the video output module that the active texture is
@@ -246,7 +332,15 @@ debug_printf ("    video_out: drawing work texture...\n");
 void send_texture(int64_t pts, int64_t vpts, int new_palette, 
   int *palette, int last_frame) {
 
+  uint64 start;
+  int size;
+
 debug_printf ("    video_out: sending work texture...\n");
+  /* an RGB565 frame carries its colours in the texels */
+  if (pal8_rgb565)
+    new_palette = 0;
+  size = pal8_rgb565 ? texture_size * 2 : texture_size;
+  vram_textures[current_vram_texture].rgb565 = pal8_rgb565;
   vram_textures[current_vram_texture].pts = pts;
   vram_textures[current_vram_texture].vpts = vpts;
   vram_textures[current_vram_texture].last_frame = last_frame;
@@ -257,13 +351,19 @@ debug_printf ("    video_out: sending work texture...\n");
   /* send the twiddled texture out to VRAM */
 /* it's blocking right now */
 #if 1
+  start = timer_us_gettime64();
+  trace_event(TRACE_RING_VIDEO_DECODER, TRACE_DMA, TRACE_BEGIN,
+    size, current_vram_texture);
   pvr_txr_load_dma(twiddle_textures[active_twiddle_texture],
-    vram_textures[current_vram_texture].base[0], texture_size, 1);
+    vram_textures[current_vram_texture].base[0], size, 1);
+  trace_event(TRACE_RING_VIDEO_DECODER, TRACE_DMA, TRACE_END,
+    size, current_vram_texture);
+  HUD_AVERAGE(hud_stats.dma_us, timer_us_gettime64() - start);
 #else
   pvr_txr_load(
     twiddle_textures[active_twiddle_texture], 
     vram_textures[current_vram_texture].base[0],
-    texture_size);
+    size);
 #endif
 
   /* free the work frame */
@@ -398,6 +498,8 @@ printf (" trying to display logo...\n");
 
 void video_output_thread(void *v) {
 
+  xine_stream_t *stream = (xine_stream_t *)v;
+  int64_t late;
   int i;
   pvr_poly_cxt_t cxt;
   pvr_poly_hdr_t hdr;
@@ -441,9 +543,13 @@ debug_printf ("  *** this is the video output thread talking\n");
 debug_printf ("    video_out: delivering frame\n");
       /* if the palette needs to be reprogrammed, do it */
       if (vram_textures[next_output_vram_texture].new_palette) {
+        trace_event(TRACE_RING_VIDEO_OUT, TRACE_PALETTE_UPLOAD, TRACE_BEGIN,
+          next_output_vram_texture, 0);
         for (i = 0; i < 256; i++) {
           pvr_set_pal_entry(i, vram_textures[next_output_vram_texture].palette[i]);
         }
+        trace_event(TRACE_RING_VIDEO_OUT, TRACE_PALETTE_UPLOAD, TRACE_END,
+          next_output_vram_texture, 0);
       }
 
       /* program the PVR to display the next frame */
@@ -453,10 +559,25 @@ debug_printf ("    video_out: delivering frame\n");
 
       pvr_list_begin(PVR_LIST_OP_POLY);
 
-      pvr_poly_cxt_txr(&cxt, PVR_LIST_OP_POLY, PVR_TXRFMT_PAL8BPP, 
-        texture_width, texture_height,
-        vram_textures[next_output_vram_texture].base[0], PVR_FILTER_BILINEAR);
-      cxt.txr.format |= PVR_TXRFMT_8BPP_PAL(0);
+      if (pixel_format == PIX_FMT_PAL8 &&
+          vram_textures[next_output_vram_texture].rgb565)
+        pvr_poly_cxt_txr(&cxt, PVR_LIST_OP_POLY, PVR_TXRFMT_RGB565,
+          texture_width, texture_height,
+          vram_textures[next_output_vram_texture].base[0], PVR_FILTER_BILINEAR);
+      else if (pixel_format == PIX_FMT_PAL8) {
+        pvr_poly_cxt_txr(&cxt, PVR_LIST_OP_POLY, PVR_TXRFMT_PAL8BPP, 
+          texture_width, texture_height,
+          vram_textures[next_output_vram_texture].base[0], PVR_FILTER_BILINEAR);
+        cxt.txr.format |= PVR_TXRFMT_8BPP_PAL(0);
+      } else if (pixel_format == PIX_FMT_RGB555)
+        pvr_poly_cxt_txr(&cxt, PVR_LIST_OP_POLY, PVR_TXRFMT_ARGB1555,
+          texture_width, texture_height,
+          vram_textures[next_output_vram_texture].base[0], PVR_FILTER_BILINEAR);
+      else
+        pvr_poly_cxt_txr(&cxt, PVR_LIST_OP_POLY,
+          PVR_TXRFMT_YUV422 | PVR_TXRFMT_NONTWIDDLED,
+          texture_width, texture_height,
+          vram_textures[next_output_vram_texture].base[0], PVR_FILTER_BILINEAR);
       pvr_poly_compile(&hdr, &cxt);
       pvr_prim(&hdr, sizeof(hdr));
 
@@ -495,11 +616,25 @@ debug_printf ("    video_out: delivering frame\n");
 
       pvr_list_finish();
 
+      /* the statistics for the HUD that are known here */
+      late = metronom_get() - vram_textures[next_output_vram_texture].vpts;
+      if (late >= 90000 / 60)
+        hud_stats.frames_late++;
+      hud_stats.av_offset_ms = -late / 90;
+      hud_stats.vram_frames = vram_texture_count;
+      for (i = 0, hud_stats.frames_queued = 0; i < vram_texture_count; i++)
+        hud_stats.frames_queued += vram_textures[i].in_use;
+      hud_stats.video_fifo_bytes = stream->video_fifo->buffer_data_index;
+      hud_stats.audio_fifo_bytes = stream->audio_fifo->buffer_data_index;
+
       /* let the GUI draw whatever it needs to */
-//      gui_draw();
+      draw_elements();
 
       /* let the PVR do its thing */
       pvr_scene_finish();
+      trace_event(TRACE_RING_VIDEO_OUT, TRACE_FRAME_FLIP, TRACE_INSTANT,
+        next_output_vram_texture,
+        (uint32_t)vram_textures[next_output_vram_texture].pts);
 
       /* free the frame that was just displayed */
 /* NOTE: may not want to do this until PVR is finished */
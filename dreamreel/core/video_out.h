@@ -36,12 +36,18 @@ struct vo_frame_s {
    * needs to be loaded when this frame is displayed */
   int new_palette;
   unsigned int palette[256];
+
+  /* PAL8 only: if this variable is non-zero, the frame went out as a
+   * twiddled RGB565 texture and has no palette */
+  int rgb565;
 };
 
 /* functions for interfacing to the video output */
 int init_video_out(void);
 int reset_video_out(void);
 void lock_twiddle_texture(void);
+void unlock_twiddle_texture(void);
+void set_texture_palette(int new_palette, int *palette);
 void draw_texture_slice(
   uint8_t **src_ptr, int linesize,
   int y, int width, int height);
@@ -39,6 +39,7 @@
 #include "compat.h"
 #include "demux.h"
 #include "bswap.h"
+#include "film_index.h"
 
 #define FOURCC_TAG( ch0, ch1, ch2, ch3 )                                \
         ( (long)(unsigned char)(ch3) | ( (long)(unsigned char)(ch2) << 8 ) | \
@@ -49,15 +50,6 @@
 #define STAB_TAG FOURCC_TAG('S', 'T', 'A', 'B')
 #define CVID_TAG FOURCC_TAG('c', 'v', 'i', 'd')
 
-typedef struct {
-  int audio;  /* audio = 1, video = 0 */
-  off_t sample_offset;
-  unsigned int sample_size;
-  int64_t pts;
-  int64_t duration;
-  int keyframe;
-} film_sample_t;
-
 typedef struct {
 
   demux_plugin_t       demux_plugin;
@@ -96,11 +88,28 @@ typedef struct {
   /* playback information */
   unsigned int         frequency;
   unsigned int         sample_count;
-  film_sample_t       *sample_table;
+  film_index_t         sample_index;
   unsigned int         current_sample;
   unsigned int         last_sample;
   int                  total_time;
 
+  /* read-ahead window over the sample data */
+  unsigned char       *readahead;
+  off_t                readahead_start;
+  unsigned int         readahead_size;
+  off_t                input_pos;  /* where the input is, -1 if unknown */
+
+  /* the input holds the file in memory (INPUT_CAP_ZERO_COPY): samples
+   * that go out as they are in the file skip the read-ahead window and
+   * are handed over in place */
+  int                  zero_copy;
+
+  /* I/O statistics */
+  unsigned int         read_count;
+  unsigned int         seek_count;
+  unsigned int         seeks_skipped;
+  off_t                bytes_read;
+
   char                 last_mrl[1024];
 } demux_film_t ;
 
@@ -128,12 +137,129 @@ typedef struct {
 static inline void debug_film_load(const char *format, ...) { }
 #endif
 
+/* set DEBUG_FILM_STATS to report how many reads and seeks it took to
+ * dispatch the file */
+#define DEBUG_FILM_STATS 0
+
 #if DEBUG_FILM_DEMUX
 #define debug_film_demux printf
 #else
 static inline void debug_film_demux(const char *format, ...) { }
 #endif
 
+#if DEBUG_FILM_STATS
+#define debug_film_stats printf
+#else
+static inline void debug_film_stats(const char *format, ...) { }
+#endif
+
+/**************************************************************************
+ * sample data I/O
+ **************************************************************************/
+
+/*
+ * Seeking is the expensive part of reading from a CD, so sample data is
+ * not fetched one sample at a time. A miss in the read-ahead window loads
+ * a single span starting at the missing sample and running to the end of
+ * the furthest of the next few samples (in table order) that fit in the
+ * window. Samples that the table lists slightly out of file order are
+ * still found in the window, and the input is only repositioned when a
+ * read does not start where the previous one left off.
+ */
+#define FILM_READAHEAD_SIZE (64 * 1024)
+#define FILM_READAHEAD_SAMPLES 64
+
+static void film_seek_input(demux_film_t *this, off_t offset) {
+
+  if (offset != this->input_pos) {
+    this->input->seek(this->input, offset, SEEK_SET);
+    this->input_pos = offset;
+    this->seek_count++;
+  } else
+    this->seeks_skipped++;
+}
+
+static int film_read_input(demux_film_t *this, unsigned char *dest,
+  unsigned int size) {
+
+  off_t got = this->input->read(this->input, dest, size);
+
+  this->read_count++;
+  if (got > 0) {
+    this->input_pos += got;
+    this->bytes_read += got;
+  } else
+    this->input_pos = -1;
+
+  return (got > 0) ? got : 0;
+}
+
+/* copy size bytes of the file at offset into dest, starting with sample n;
+ * returns 1 on success, 0 on a short read */
+static int film_read(demux_film_t *this, unsigned int n,
+  unsigned char *dest, off_t offset, unsigned int size) {
+
+  film_sample_t *sample;
+  off_t end;
+  unsigned int j;
+
+  if ((offset < this->readahead_start) ||
+      (offset + size > this->readahead_start + this->readahead_size)) {
+
+    /* too big for the window; read it straight through */
+    if (size > FILM_READAHEAD_SIZE) {
+      film_seek_input(this, offset);
+      return (film_read_input(this, dest, size) == size);
+    }
+
+    end = offset + size;
+    for (j = n; (j < this->sample_count) &&
+                (j < n + FILM_READAHEAD_SAMPLES); j++) {
+      sample = film_index_get(&this->sample_index, j);
+      if (sample->sample_offset < offset)
+        continue;
+      if (sample->sample_offset + sample->sample_size >
+          offset + FILM_READAHEAD_SIZE)
+        break;
+      if (sample->sample_offset + sample->sample_size > end)
+        end = sample->sample_offset + sample->sample_size;
+    }
+
+    film_seek_input(this, offset);
+    this->readahead_start = offset;
+    this->readahead_size = film_read_input(this, this->readahead, end - offset);
+
+    debug_film_demux("  demux_film: read-ahead of %d bytes @ %llX\n",
+      this->readahead_size, offset);
+
+    if (this->readahead_size < size)
+      return 0;
+  }
+
+  memcpy(dest, &this->readahead[offset - this->readahead_start], size);
+
+  return 1;
+}
+
+/* hand over size bytes of the file at offset from a zero-copy input, in
+ * a single buffer pointing at the data; returns NULL on a short read */
+static buf_element_t *film_read_in_place(demux_film_t *this,
+  fifo_buffer_t *fifo, off_t offset, unsigned int size) {
+
+  buf_element_t *buf;
+
+  film_seek_input(this, offset);
+  buf = xine_demux_read_buffer(fifo, this->input, size);
+  this->read_count++;
+  if (buf) {
+    this->input_pos += buf->size;
+    this->bytes_read += buf->size;
+  } else
+    this->input_pos = -1;
+
+  return buf;
+}
+
 /* Open a FILM file
  * This function is called from the _open() function of this demuxer.
  * It returns 1 if FILM file was opened successfully. */
@@ -142,13 +268,14 @@ static int open_film_file(demux_film_t *film) {
   unsigned char *film_header;
   unsigned int film_header_size;
   unsigned char scratch[16];
-  unsigned char preview[MAX_PREVIEW_SIZE];
   unsigned int chunk_type;
   unsigned int chunk_size;
   unsigned int i, j;
   unsigned int audio_byte_count = 0;
   int64_t largest_pts = 0;
   unsigned int pts;
+  unsigned int duration;
+  film_sample_t sample;
 
   /* initialize structure fields */
   film->bih.biWidth = 0;
@@ -158,21 +285,9 @@ static int open_film_file(demux_film_t *film) {
   film->audio_bits = 0;
   film->audio_channels = 0;
 
-  if (film->input->get_capabilities(film->input) & INPUT_CAP_SEEKABLE) {
-    /* reset the file */
-    film->input->seek(film->input, 0, SEEK_SET);
-
-    /* get the signature, header length and file version */
-    if (film->input->read(film->input, scratch, 16) != 16) {
-      return 0;
-    }
-  } else {
-    film->input->get_optional_data(film->input, preview,
-      INPUT_OPTIONAL_DATA_PREVIEW);
-
-    /* copy over the header bytes for processing */
-    memcpy(scratch, preview, 16);
-  }
+  /* get the signature, header length and file version */
+  if (xine_demux_read_header(film->input, scratch, 16) != 16)
+    return 0;
 
   /* FILM signature correct? */
   if (strncmp(scratch, "FILM", 4)) {
@@ -180,11 +295,9 @@ static int open_film_file(demux_film_t *film) {
   }
   debug_film_load("  demux_film: found 'FILM' signature\n");
 
-  /* file is qualified; if the input was not seekable, skip over the header
-   * bytes in the stream */
-  if ((film->input->get_capabilities(film->input) & INPUT_CAP_SEEKABLE) == 0) {
-    film->input->seek(film->input, 16, SEEK_SET);
-  }
+  /* file is qualified; the header may have come from the preview, so
+   * position the input just past it */
+  film->input->seek(film->input, 16, SEEK_SET);
 
   /* header size = header size - 16-byte FILM signature */
   film_header_size = BE_32(&scratch[4]) - 16;
@@ -203,7 +316,7 @@ static int open_film_file(demux_film_t *film) {
   if (film->input->read(film->input, film_header, film_header_size) != 
     film_header_size) {
     free (film->interleave_buffer);
-    free (film->sample_table);
+    film_index_free(&film->sample_index);
     free (film_header);
     return 0;
   }
@@ -223,7 +336,7 @@ static int open_film_file(demux_film_t *film) {
       xine_log(film->stream->xine, XINE_LOG_MSG,
         _("invalid FILM chunk size\n"));
       free (film->interleave_buffer);
-      free (film->sample_table);
+      film_index_free(&film->sample_index);
       free (film_header);
       return 0;
     }
@@ -289,73 +402,95 @@ static int open_film_file(demux_film_t *film) {
       debug_film_load("  demux_film: parsing STAB chunk\n");
 
       /* load the sample table */
-      if (film->sample_table)
-        free(film->sample_table);
       film->frequency = BE_32(&film_header[i + 8]);
       film->sample_count = BE_32(&film_header[i + 12]);
-      film->sample_table =
-        xine_xmalloc(film->sample_count * sizeof(film_sample_t));
+      audio_byte_count = 0;
+      if (!film_index_init(&film->sample_index, film->sample_count,
+        film->frequency,
+        film->sample_rate * film->audio_channels * (film->audio_bits / 8))) {
+        free (film->interleave_buffer);
+        film_index_free(&film->sample_index);
+        free (film_header);
+        return 0;
+      }
       for (j = 0; j < film->sample_count; j++) {
 
-        film->sample_table[j].sample_offset = 
+        sample.sample_offset = 
           BE_32(&film_header[(i + 16) + j * 16 + 0])
           + film_header_size + 16;
-        film->sample_table[j].sample_size = 
+        sample.sample_size = 
           BE_32(&film_header[(i + 16) + j * 16 + 4]);
         pts = 
           BE_32(&film_header[(i + 16) + j * 16 + 8]);
-        film->sample_table[j].duration = 
+        duration = 
           BE_32(&film_header[(i + 16) + j * 16 + 12]);
+        sample.duration = duration;
+
+        if (!film_index_add(&film->sample_index, sample.sample_offset,
+          sample.sample_size, pts, duration)) {
+          free (film->interleave_buffer);
+          film_index_free(&film->sample_index);
+          free (film_header);
+          return 0;
+        }
 
         if (pts == 0xFFFFFFFF) {
 
-          film->sample_table[j].audio = 1;
-          film->sample_table[j].keyframe = 0;
+          sample.audio = 1;
+          sample.keyframe = 0;
 
           /* figure out audio pts */
-          film->sample_table[j].pts = audio_byte_count;
-          film->sample_table[j].pts *= 90000;
-          film->sample_table[j].pts /= 
-            (film->sample_rate * film->audio_channels * (film->audio_bits / 8));
-          audio_byte_count += film->sample_table[j].sample_size;
+          sample.pts = audio_byte_count;
+          sample.pts *= 90000;
+          if (film->sample_index.audio_bytes_per_second)
+            sample.pts /= film->sample_index.audio_bytes_per_second;
+          audio_byte_count += sample.sample_size;
 
         } else {
 
           /* figure out video pts, duration, and keyframe */
-          film->sample_table[j].audio = 0;
+          sample.audio = 0;
 
           /* keyframe if top bit of this field is 0 */
           if (pts & 0x80000000)
-            film->sample_table[j].keyframe = 0;
+            sample.keyframe = 0;
           else
-            film->sample_table[j].keyframe = 1;
+            sample.keyframe = 1;
  
           /* remove the keyframe bit */
-          film->sample_table[j].pts = pts & 0x7FFFFFFF;
+          sample.pts = pts & 0x7FFFFFFF;
 
           /* compute the pts */
-          film->sample_table[j].pts *= 90000;
-          film->sample_table[j].pts /= film->frequency;
+          sample.pts *= 90000;
+          sample.pts /= film->frequency;
 
           /* compute the frame duration */
-          film->sample_table[j].duration *= 90000;
-          film->sample_table[j].duration /= film->frequency;
+          sample.duration *= 90000;
+          sample.duration /= film->frequency;
 
         }
 
         /* use this to calculate the total running time of the file */
-        if (film->sample_table[j].pts > largest_pts)
-          largest_pts = film->sample_table[j].pts;
+        if (sample.pts > largest_pts)
+          largest_pts = sample.pts;
 
         debug_film_load("    sample %4d @ %8llX, %8X bytes, %s, pts %lld, duration %lld%s\n",
           j,
-          film->sample_table[j].sample_offset,
-          film->sample_table[j].sample_size,
-          (film->sample_table[j].audio) ? "audio" : "video",
-          film->sample_table[j].pts,
-          film->sample_table[j].duration,
-          (film->sample_table[j].keyframe) ? " (keyframe)" : "");
+          sample.sample_offset,
+          sample.sample_size,
+          (sample.audio) ? "audio" : "video",
+          sample.pts,
+          sample.duration,
+          (sample.keyframe) ? " (keyframe)" : "");
       }
+      film_index_finish(&film->sample_index);
+
+      debug_film_load("  demux_film: %d samples indexed in %d bytes (%d bytes unpacked)\n",
+        film->sample_count,
+        film->sample_index.data_size +
+          ((film->sample_count >> FILM_INDEX_GROUP_BITS) + 1) *
+          sizeof(film_index_state_t),
+        film->sample_count * sizeof(film_sample_t));
 
       /*
        * in some files, this chunk length does not account for the 16-byte
@@ -366,11 +501,11 @@ static int open_film_file(demux_film_t *film) {
 
       /* allocate enough space in the interleave preload buffer for the 
        * first chunk (which will be more than enough for successive chunks) */
-      if (film->audio_type) {
+      if (film->audio_type && film->sample_count) {
         if (film->interleave_buffer)
           free(film->interleave_buffer);
         film->interleave_buffer = 
-          xine_xmalloc(film->sample_table[0].sample_size);
+          xine_xmalloc(film_index_get(&film->sample_index, 0)->sample_size);
       }
       break;
 
@@ -378,7 +513,7 @@ static int open_film_file(demux_film_t *film) {
       xine_log(film->stream->xine, XINE_LOG_MSG,
         _("unrecognized FILM chunk\n"));
       free (film->interleave_buffer);
-      free (film->sample_table);
+      film_index_free(&film->sample_index);
       free (film_header);
       return 0;
     }
@@ -388,6 +523,12 @@ static int open_film_file(demux_film_t *film) {
 
   film->total_time = largest_pts / 90;
 
+  film->readahead = xine_xmalloc(FILM_READAHEAD_SIZE);
+  film->readahead_size = 0;
+  film->input_pos = film->input->get_current_pos(film->input);
+  film->zero_copy =
+    film->input->get_capabilities(film->input) & INPUT_CAP_ZERO_COPY;
+
   free (film_header);
 
   return 1;
@@ -403,30 +544,36 @@ static int demux_film_send_chunk(demux_plugin_t *this_gen) {
   unsigned int remaining_sample_bytes;
   int first_buf;
   int interleave_index;
+  off_t read_pos;
+  film_sample_t *sample, current;
 
   i = this->current_sample;
 
+  /* check if all the samples have been sent */
+  if (i >= this->sample_count) {
+    this->status = DEMUX_FINISHED;
+    return this->status;
+  }
+
+  /* work on a copy; reading ahead may unpack another part of the index */
+  current = *film_index_get(&this->sample_index, i);
+  sample = &current;
+
   /* if there is an incongruency between last and current sample, it
    * must be time to send a new pts */
   if (this->last_sample + 1 != this->current_sample) {
     /* send new pts */
-    xine_demux_control_newpts(this->stream, this->sample_table[i].pts,
-      (this->sample_table[i].pts) ? BUF_FLAG_SEEK : 0);
+    xine_demux_control_newpts(this->stream, sample->pts,
+      (sample->pts) ? BUF_FLAG_SEEK : 0);
   }
 
   this->last_sample = this->current_sample;
   this->current_sample++;
 
-  /* check if all the samples have been sent */
-  if (i >= this->sample_count) {
-    this->status = DEMUX_FINISHED;
-    return this->status;
-  }
-
   /* check if we're only sending audio samples until the next keyframe */
   if ((this->waiting_for_keyframe) && 
-      (!this->sample_table[i].audio)) {
-    if (this->sample_table[i].keyframe) {
+      (!sample->audio)) {
+    if (sample->keyframe) {
       this->waiting_for_keyframe = 0;
     } else {
       /* move on to the next sample */
@@ -436,33 +583,32 @@ static int demux_film_send_chunk(demux_plugin_t *this_gen) {
 
   debug_film_demux("  demux_film: dispatching frame...\n");
 
-  if ((!this->sample_table[i].audio) &&
+  if ((!sample->audio) &&
     (this->video_type == BUF_VIDEO_CINEPAK)) {
     /* do a special song and dance when loading CVID data */
     if (this->version[0])
-      cvid_chunk_size = this->sample_table[i].sample_size - 2;
+      cvid_chunk_size = sample->sample_size - 2;
     else
-      cvid_chunk_size = this->sample_table[i].sample_size - 6;
+      cvid_chunk_size = sample->sample_size - 6;
 
     /* reset flag */
     fixed_cvid_header = 0;
 
     remaining_sample_bytes = cvid_chunk_size;
-    this->input->seek(this->input, this->sample_table[i].sample_offset,
-      SEEK_SET);
+    read_pos = sample->sample_offset;
 
     while (remaining_sample_bytes) {
       buf = this->video_fifo->buffer_pool_alloc (this->video_fifo);
       buf->type = this->video_type;
       buf->extra_info->input_pos = 
-        this->sample_table[i].sample_offset - this->data_start;
+        sample->sample_offset - this->data_start;
       buf->extra_info->input_length = this->data_size;
-      buf->extra_info->input_time = this->sample_table[i].pts / 90;
-      buf->pts = this->sample_table[i].pts;
+      buf->extra_info->input_time = sample->pts / 90;
+      buf->pts = sample->pts;
 
       /* set the frame duration */
       buf->decoder_flags |= BUF_FLAG_FRAMERATE;
-      buf->decoder_info[0] = this->sample_table[i].duration;
+      buf->decoder_info[0] = sample->duration;
             
       if (remaining_sample_bytes > buf->max_size)
         buf->size = buf->max_size;
@@ -471,23 +617,23 @@ static int demux_film_send_chunk(demux_plugin_t *this_gen) {
       remaining_sample_bytes -= buf->size;
 
       if (!fixed_cvid_header) {
-        if (this->input->read(this->input, buf->content, 10) != 10) {
+        if (!film_read(this, i, buf->content, read_pos, 10)) {
           buf->free_buffer(buf);
           this->status = DEMUX_FINISHED;
           break;
         }
 
         /* skip over the extra non-spec CVID bytes */
-        this->input->seek(this->input, 
-          this->sample_table[i].sample_size - cvid_chunk_size, SEEK_CUR);
+        read_pos += 10 + sample->sample_size - cvid_chunk_size;
 
         /* load the rest of the chunk */
-        if (this->input->read(this->input, buf->content + 10, 
-          buf->size - 10) != buf->size - 10) {
+        if (!film_read(this, i, buf->content + 10, read_pos,
+          buf->size - 10)) {
           buf->free_buffer(buf);
           this->status = DEMUX_FINISHED;
           break;
         }
+        read_pos += buf->size - 10;
 
         /* adjust the length in the CVID data chunk */
         buf->content[1] = (cvid_chunk_size >> 16) & 0xFF;
@@ -496,15 +642,15 @@ static int demux_film_send_chunk(demux_plugin_t *this_gen) {
 
         fixed_cvid_header = 1;
       } else {
-        if (this->input->read(this->input, buf->content, buf->size) !=
-          buf->size) {
+        if (!film_read(this, i, buf->content, read_pos, buf->size)) {
           buf->free_buffer(buf);
           this->status = DEMUX_FINISHED;
           break;
         }
+        read_pos += buf->size;
       }
 
-      if (this->sample_table[i].keyframe)
+      if (sample->keyframe)
         buf->decoder_flags |= BUF_FLAG_KEYFRAME;
       if (!remaining_sample_bytes)
         buf->decoder_flags |= BUF_FLAG_FRAME_END;
@@ -514,40 +660,47 @@ static int demux_film_send_chunk(demux_plugin_t *this_gen) {
       this->video_fifo->put(this->video_fifo, buf);
     }
 
-  } else if (!this->sample_table[i].audio) {
+  } else if (!sample->audio) {
 
     /* load a non-cvid video chunk */
-    remaining_sample_bytes = this->sample_table[i].sample_size;
-    this->input->seek(this->input, this->sample_table[i].sample_offset,
-      SEEK_SET);
+    remaining_sample_bytes = sample->sample_size;
+    read_pos = sample->sample_offset;
 
     while (remaining_sample_bytes) {
-      buf = this->video_fifo->buffer_pool_alloc (this->video_fifo);
+      if (this->zero_copy) {
+        buf = film_read_in_place(this, this->video_fifo, read_pos,
+          remaining_sample_bytes);
+        if (!buf) {
+          this->status = DEMUX_FINISHED;
+          break;
+        }
+      } else {
+        buf = this->video_fifo->buffer_pool_alloc (this->video_fifo);
+        if (remaining_sample_bytes > buf->max_size)
+          buf->size = buf->max_size;
+        else
+          buf->size = remaining_sample_bytes;
+        if (!film_read(this, i, buf->content, read_pos, buf->size)) {
+          buf->free_buffer(buf);
+          this->status = DEMUX_FINISHED;
+          break;
+        }
+      }
+      remaining_sample_bytes -= buf->size;
+      read_pos += buf->size;
+
       buf->type = this->video_type;
       buf->extra_info->input_pos = 
-        this->sample_table[i].sample_offset - this->data_start;
+        sample->sample_offset - this->data_start;
       buf->extra_info->input_length = this->data_size;
-      buf->extra_info->input_time = this->sample_table[i].pts / 90;
-      buf->pts = this->sample_table[i].pts;
+      buf->extra_info->input_time = sample->pts / 90;
+      buf->pts = sample->pts;
 
       /* set the frame duration */
       buf->decoder_flags |= BUF_FLAG_FRAMERATE;
-      buf->decoder_info[0] = this->sample_table[i].duration;
-            
-      if (remaining_sample_bytes > buf->max_size)
-        buf->size = buf->max_size;
-      else
-        buf->size = remaining_sample_bytes;
-      remaining_sample_bytes -= buf->size;
+      buf->decoder_info[0] = sample->duration;
 
-      if (this->input->read(this->input, buf->content, buf->size) !=
-        buf->size) {
-        buf->free_buffer(buf);
-        this->status = DEMUX_FINISHED;
-        break;
-      }
-
-      if (this->sample_table[i].keyframe)
+      if (sample->keyframe)
         buf->decoder_flags |= BUF_FLAG_KEYFRAME;
       if (!remaining_sample_bytes)
         buf->decoder_flags |= BUF_FLAG_FRAME_END;
@@ -559,53 +712,57 @@ static int demux_film_send_chunk(demux_plugin_t *this_gen) {
   } else if(this->audio_fifo && this->audio_channels == 1) {
 
     /* load a mono audio sample and packetize it */
-    remaining_sample_bytes = this->sample_table[i].sample_size;
-    this->input->seek(this->input, this->sample_table[i].sample_offset,
-      SEEK_SET);
+    remaining_sample_bytes = sample->sample_size;
+    read_pos = sample->sample_offset;
 
     first_buf = 1;
     while (remaining_sample_bytes) {
 
-      buf = this->audio_fifo->buffer_pool_alloc (this->audio_fifo);
+      /* SEGA audio is rewritten below, so it cannot go out in place */
+      if (this->zero_copy && (this->video_type != BUF_VIDEO_SEGA)) {
+        buf = film_read_in_place(this, this->audio_fifo, read_pos,
+          remaining_sample_bytes);
+        if (!buf) {
+          this->status = DEMUX_FINISHED;
+          break;
+        }
+      } else {
+        buf = this->audio_fifo->buffer_pool_alloc (this->audio_fifo);
+        if (remaining_sample_bytes > buf->max_size)
+          buf->size = buf->max_size;
+        else
+          buf->size = remaining_sample_bytes;
+        if (!film_read(this, i, buf->content, read_pos, buf->size)) {
+          buf->free_buffer(buf);
+          this->status = DEMUX_FINISHED;
+          break;
+        }
+      }
+      remaining_sample_bytes -= buf->size;
+      read_pos += buf->size;
+
       buf->type = this->audio_type;
       buf->extra_info->input_pos = 
-        this->sample_table[i].sample_offset - this->data_start;
+        sample->sample_offset - this->data_start;
       buf->extra_info->input_length = this->data_size;
 
       /* special hack to accomodate linear PCM decoder: only the first
        * buffer gets the real pts */
       if (first_buf) {
-        buf->pts = this->sample_table[i].pts;
+        buf->pts = sample->pts;
         first_buf = 0;
       } else
         buf->pts = 0;
       buf->extra_info->input_time = buf->pts / 90;
 
-      if (remaining_sample_bytes > buf->max_size)
-        buf->size = buf->max_size;
-      else
-        buf->size = remaining_sample_bytes;
-      remaining_sample_bytes -= buf->size;
-
-      if (this->input->read(this->input, buf->content, buf->size) !=
-        buf->size) {
-        buf->free_buffer(buf);
-        this->status = DEMUX_FINISHED;
-        break;
-      }
-
+      /* 8-bit audio goes out signed, as it is in the file (see
+       * convert_pcm() in the audio decoder) */
       if (this->video_type == BUF_VIDEO_SEGA) {
         /* if the file uses the SEGA video codec, assume this is
          * sign/magnitude audio */
         for (j = 0; j < buf->size; j++)
-          if (buf->content[j] < 0x80)
-            buf->content[j] += 0x80;
-          else
-            buf->content[j] = -(buf->content[j] & 0x7F) + 0x80;
-      } else if (this->audio_bits == 8) {
-        /* convert 8-bit data from signed -> unsigned */
-        for (j = 0; j < buf->size; j++)
-          buf->content[j] += 0x80;
+          if (buf->content[j] >= 0x80)
+            buf->content[j] = -(buf->content[j] & 0x7F);
       }
 
       if (!remaining_sample_bytes)
@@ -621,14 +778,14 @@ static int demux_film_send_chunk(demux_plugin_t *this_gen) {
     /* load an entire stereo sample and interleave the channels */
 
     /* load the whole chunk into the buffer */
-    if (this->input->read(this->input, this->interleave_buffer,
-      this->sample_table[i].sample_size) != this->sample_table[i].sample_size) {
+    if (!film_read(this, i, this->interleave_buffer,
+      sample->sample_offset, sample->sample_size)) {
       this->status = DEMUX_FINISHED;
       return this->status;
     }
 
     /* proceed to de-interleave into individual buffers */
-    remaining_sample_bytes = this->sample_table[i].sample_size / 2;
+    remaining_sample_bytes = sample->sample_size / 2;
     interleave_index = 0;
     first_buf = 1;
     while (remaining_sample_bytes) {
@@ -636,13 +793,13 @@ static int demux_film_send_chunk(demux_plugin_t *this_gen) {
       buf = this->audio_fifo->buffer_pool_alloc (this->audio_fifo);
       buf->type = this->audio_type;
       buf->extra_info->input_pos = 
-        this->sample_table[i].sample_offset - this->data_start;
+        sample->sample_offset - this->data_start;
       buf->extra_info->input_length = this->data_size;
 
       /* special hack to accomodate linear PCM decoder: only the first
        * buffer gets the real pts */
       if (first_buf) {
-        buf->pts = this->sample_table[i].pts;
+        buf->pts = sample->pts;
         first_buf = 0;
       } else
         buf->pts = 0;
@@ -660,7 +817,7 @@ static int demux_film_send_chunk(demux_plugin_t *this_gen) {
           buf->content[j + 1] = this->interleave_buffer[k + 1];
         }
         for (j = 2, 
-             k = interleave_index + this->sample_table[i].sample_size / 2; 
+             k = interleave_index + sample->sample_size / 2; 
              j < buf->size; j += 4, k += 2) {
           buf->content[j] =     this->interleave_buffer[k];
           buf->content[j + 1] = this->interleave_buffer[k + 1];
@@ -671,7 +828,7 @@ static int demux_film_send_chunk(demux_plugin_t *this_gen) {
           buf->content[j] = this->interleave_buffer[k];
         }
         for (j = 1, 
-             k = interleave_index + this->sample_table[i].sample_size / 2; 
+             k = interleave_index + sample->sample_size / 2; 
              j < buf->size; j += 2, k += 1) {
           buf->content[j] = this->interleave_buffer[k];
         }
@@ -746,9 +903,8 @@ static int demux_film_seek (demux_plugin_t *this_gen,
                             off_t start_pos, int start_time) {
   demux_film_t *this = (demux_film_t *) this_gen;
   int best_index;
-  int left, middle, right;
-  int found;
   int64_t keyframe_pts;
+  film_sample_t *sample;
 
   this->waiting_for_keyframe = 1;
   this->status = DEMUX_OK;
@@ -764,7 +920,12 @@ static int demux_film_seek (demux_plugin_t *this_gen,
   if ((this->input->get_capabilities(this->input) & INPUT_CAP_SEEKABLE) == 0)
     return this->status;
 
-  /* perform a binary search on the sample table, testing the offset 
+  if (!this->sample_count) {
+    this->status = DEMUX_FINISHED;
+    return this->status;
+  }
+
+  /* perform a binary search on the sample index, testing the offset 
    * boundaries first */
   if (start_pos) {
     if (start_pos <= 0)
@@ -774,52 +935,25 @@ static int demux_film_seek (demux_plugin_t *this_gen,
       return this->status;
     } else {
       start_pos += this->data_start;
-      left = 0;
-      right = this->sample_count - 1;
-      found = 0;
-
-      while (!found) {
-        middle = (left + right) / 2;
-        if ((start_pos >= this->sample_table[middle].sample_offset) &&
-            (start_pos <= this->sample_table[middle].sample_offset + 
-             this->sample_table[middle].sample_size)) {
-          found = 1;
-        } else if (start_pos < this->sample_table[middle].sample_offset) {
-          right = middle;
-        } else {
-          left = middle;
-        }
-      }
-
-      best_index = middle;
+      best_index = film_index_find_offset(&this->sample_index, start_pos);
     }
   } else {
     int64_t pts = 90000 * start_time;
 
-    if (pts <= this->sample_table[0].pts)
+    if (pts <= film_index_get(&this->sample_index, 0)->pts)
       best_index = 0;
-    else if (pts >= this->sample_table[this->sample_count - 1].pts) {
+    else if (pts >= film_index_get(&this->sample_index,
+      this->sample_count - 1)->pts) {
       this->status = DEMUX_FINISHED;
       return this->status;
     } else {
-      left = 0;
-      right = this->sample_count - 1;
-      do {
-        middle = (left + right + 1) / 2;
-        if (pts < this->sample_table[middle].pts) {
-          right = (middle - 1);
-        } else {
-          left = middle;
-        }
-      } while (left < right);
-
-      best_index = left;
+      best_index = film_index_find_pts(&this->sample_index, pts);
     }
   }
 
-  /* search back in the table for the nearest keyframe */
+  /* search back in the index for the nearest keyframe */
   while (best_index) {
-    if (this->sample_table[best_index].keyframe) {
+    if (film_index_get(&this->sample_index, best_index)->keyframe) {
       break;
     }
     best_index--;
@@ -828,10 +962,10 @@ static int demux_film_seek (demux_plugin_t *this_gen,
   /* not done yet; now that the nearest keyframe has been found, seek
    * back to the first audio frame that has a pts less than or equal to
    * that of the keyframe */
-  keyframe_pts = this->sample_table[best_index].pts;
+  keyframe_pts = film_index_get(&this->sample_index, best_index)->pts;
   while (best_index) {
-    if ((this->sample_table[best_index].audio) &&
-        (this->sample_table[best_index].pts < keyframe_pts)) {
+    sample = film_index_get(&this->sample_index, best_index);
+    if ((sample->audio) && (sample->pts < keyframe_pts)) {
       break;
     }
     best_index--;
@@ -845,9 +979,13 @@ static int demux_film_seek (demux_plugin_t *this_gen,
 static void demux_film_dispose (demux_plugin_t *this_gen) {
   demux_film_t *this = (demux_film_t *) this_gen;
 
-  if (this->sample_table)
-    free(this->sample_table);
+  debug_film_stats("  demux_film: %d reads (%lld bytes), %d seeks, %d seeks skipped\n",
+    this->read_count, this->bytes_read, this->seek_count,
+    this->seeks_skipped);
+
+  film_index_free(&this->sample_index);
   free(this->interleave_buffer);
+  free(this->readahead);
   free(this);
 }
 
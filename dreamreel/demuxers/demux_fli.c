@@ -40,6 +40,7 @@
 #include "compat.h"
 #include "demux.h"
 #include "bswap.h"
+#include "seek_index.h"
 
 #define FLI_HEADER_SIZE 128
 #define FLI_HEADER_SIZE_MC 12  /* header size for Magic Carpet game FLIs */
@@ -50,6 +51,28 @@
 #define FLI_CHUNK_MAGIC_2 0xF5FA
 #define FLI_MC_PTS_INC 6000  /* pts increment for Magic Carpet game FLIs */
 
+#define FLI_FRAME_HEADER_SIZE 16
+#define FLI_CHUNK_HEADER_SIZE 6
+
+/* seek targets that do not constrain the keyframe search */
+#define FLI_ANY_PTS    ((int64_t)0x7FFFFFFFFFFFFFFFLL)
+#define FLI_ANY_OFFSET ((off_t)0x7FFFFFFF)
+
+/* the state of the palette while indexing, when some of it was set by a
+ * color chunk other than the last one that set all of it */
+#define FLI_PALETTE_MIXED ((off_t)-1)
+
+/* the most of a color chunk that can matter: the packet count, and 256
+ * packets of 1 color each */
+#define FLI_MAX_COLOR_DATA (2 + 256 * 5)
+
+/* the sub-chunk types that matter to the keyframe index */
+#define FLI_256_COLOR 4
+#define FLI_COLOR     11
+#define FLI_BLACK     13
+#define FLI_BRUN      15
+#define FLI_COPY      16
+
 typedef struct {
 
   demux_plugin_t       demux_plugin;
@@ -77,6 +100,23 @@ typedef struct {
   unsigned int         frame_pts_inc;
   unsigned int         frame_count;
   int64_t              pts_counter;
+  int                  seek_flag;
+
+  /* Keyframe index, with an entry for each frame that repaints the whole
+   * picture and where the whole palette can be set again after a seek:
+   * either the frame carries a whole palette of its own, or the last
+   * color chunk before it set the whole palette by itself. The info field
+   * of an entry is how far back that color chunk is, or 0 if the frame
+   * needs none. end_info is how far back from the end of the index the
+   * last color chunk that set the whole palette is, 0 if there has not
+   * been one, or 0xFFFFFFFF if a color chunk that did not has come
+   * since. */
+  seek_index_t        *index;
+  off_t                first_chunk;
+
+  /* color chunk that sets the whole palette, to splice into the next
+   * frame after a seek, or 0 */
+  off_t                replay_palette_offset;
 
   char                 last_mrl[1024];
 
@@ -93,13 +133,21 @@ typedef struct {
   config_values_t  *config;
 } demux_fli_class_t;
 
+/* define DEBUG_FLI_INDEX as 1 to follow the keyframe index */
+#define DEBUG_FLI_INDEX 0
+
+#if DEBUG_FLI_INDEX
+#define debug_fli_index printf
+#else
+static inline void debug_fli_index(const char *format, ...) { }
+#endif
+
 /* returns 1 if the FLI file was opened successfully, 0 otherwise */
 static int open_fli_file(demux_fli_t *this) {
 
   /* read the whole header */
-  this->input->seek(this->input, 0, SEEK_SET);
-  if (this->input->read(this->input, this->fli_header, FLI_HEADER_SIZE) !=
-    FLI_HEADER_SIZE)
+  if (xine_demux_read_header(this->input, this->fli_header,
+    FLI_HEADER_SIZE) != FLI_HEADER_SIZE)
     return 0;
 
   /* validate the file */
@@ -147,14 +195,279 @@ static int open_fli_file(demux_fli_t *this) {
     this->frame_pts_inc = FLI_MC_PTS_INC;
   }
 
+  /* a file that claims no time between frames gets the same treatment */
+  if (!this->frame_pts_inc)
+    this->frame_pts_inc = FLI_MC_PTS_INC;
+
   /* sanity check: the FLI file must have non-zero values for width, height,
    * and frame count */
   if ((!this->width) || (!this->height) || (!this->frame_count))
     return 0;
 
+  /* the first chunk follows the header */
+  if (this->magic_number == FLI_FILE_MAGIC_3)
+    this->first_chunk = FLI_HEADER_SIZE_MC;
+  else
+    this->first_chunk = FLI_HEADER_SIZE;
+  this->input->seek(this->input, this->first_chunk, SEEK_SET);
+
   return 1;
 }
 
+/*
+ * Returns 1 if the color chunk data in p (the chunk without its header)
+ * sets every entry of the palette. The packets are applied the way the
+ * decoder applies them: skip, then set count colors (0 meaning 256),
+ * wrapping around at the end of the palette.
+ */
+static int fli_whole_palette(unsigned char *p, unsigned int size) {
+
+  unsigned char set[256];
+  unsigned int packets, count;
+  unsigned int pos = 2;
+  int entry = 0;
+  int covered = 0;
+
+  if (size < 2)
+    return 0;
+  memset(set, 0, sizeof(set));
+
+  packets = LE_16(&p[0]);
+  while (packets-- && (pos + 2 <= size)) {
+    entry += p[pos++];
+    count = p[pos++];
+    if (!count)
+      count = 256;
+    if (pos + count * 3 > size)
+      break;
+    pos += count * 3;
+
+    while (count--) {
+      if (entry >= 256)
+        entry = 0;
+      if (!set[entry]) {
+        set[entry] = 1;
+        covered++;
+      }
+      entry++;
+    }
+  }
+
+  return (covered == 256);
+}
+
+/*
+ * Walk the sub-chunks of the frame chunk at offset, following the palette
+ * through its color chunks: palette_offset is the offset of the last
+ * color chunk that set the whole palette, 0 if there has not been one,
+ * or FLI_PALETTE_MIXED if another color chunk has come since. own_palette
+ * is set if the frame carries a whole palette itself. The first data_size
+ * bytes of the frame are in data; anything beyond those is read from the
+ * input, which is left where it was. Returns 1 if the frame repaints the
+ * whole picture.
+ */
+static int fli_scan_frame(demux_fli_t *this, off_t offset,
+                          unsigned char *data, unsigned int data_size,
+                          off_t *palette_offset, int *own_palette) {
+
+  unsigned char chunk_header[FLI_CHUNK_HEADER_SIZE];
+  unsigned char color_data[FLI_MAX_COLOR_DATA];
+  unsigned char *p;
+  unsigned int frame_size = LE_32(&data[0]);
+  unsigned int chunk_count = LE_16(&data[6]);
+  unsigned int pos = FLI_FRAME_HEADER_SIZE;
+  unsigned int chunk_size, color_size;
+  off_t resume_pos = -1;
+  int repaints = 0;
+
+  *own_palette = 0;
+
+  while (chunk_count-- && (pos + FLI_CHUNK_HEADER_SIZE <= frame_size)) {
+
+    if (pos + FLI_CHUNK_HEADER_SIZE <= data_size)
+      p = &data[pos];
+    else {
+      if (resume_pos == -1)
+        resume_pos = this->input->get_current_pos(this->input);
+      this->input->seek(this->input, offset + pos, SEEK_SET);
+      if (this->input->read(this->input, chunk_header,
+        FLI_CHUNK_HEADER_SIZE) != FLI_CHUNK_HEADER_SIZE)
+        break;
+      p = chunk_header;
+    }
+    chunk_size = LE_32(&p[0]);
+    if (chunk_size < FLI_CHUNK_HEADER_SIZE)
+      break;
+
+    switch (LE_16(&p[4])) {
+
+    case FLI_256_COLOR:
+    case FLI_COLOR:
+      color_size = chunk_size - FLI_CHUNK_HEADER_SIZE;
+      if (color_size > FLI_MAX_COLOR_DATA)
+        color_size = FLI_MAX_COLOR_DATA;
+      if (pos + FLI_CHUNK_HEADER_SIZE + color_size <= data_size)
+        p = &data[pos + FLI_CHUNK_HEADER_SIZE];
+      else {
+        if (resume_pos == -1)
+          resume_pos = this->input->get_current_pos(this->input);
+        this->input->seek(this->input, offset + pos + FLI_CHUNK_HEADER_SIZE,
+          SEEK_SET);
+        if (this->input->read(this->input, color_data, color_size) !=
+          color_size)
+          color_size = 0;
+        p = color_data;
+      }
+
+      if (fli_whole_palette(p, color_size)) {
+        *palette_offset = offset + pos;
+        *own_palette = 1;
+      } else
+        *palette_offset = FLI_PALETTE_MIXED;
+      break;
+
+    case FLI_BLACK:
+    case FLI_BRUN:
+    case FLI_COPY:
+      repaints = 1;
+      break;
+    }
+
+    pos += chunk_size;
+  }
+
+  if (resume_pos != -1)
+    this->input->seek(this->input, resume_pos, SEEK_SET);
+
+  return repaints;
+}
+
+/* add the chunk at the end of the index to it; data holds the first
+ * data_size bytes of the chunk */
+static void fli_index_chunk(demux_fli_t *this, unsigned char *data,
+                            unsigned int data_size) {
+
+  seek_index_t *index = this->index;
+  unsigned int chunk_size = LE_32(&data[0]);
+  unsigned int chunk_magic = LE_16(&data[4]);
+  off_t offset = index->end_offset;
+  off_t palette_offset = 0;
+  off_t previous_palette;
+  int own_palette;
+  int repaints;
+
+  if (chunk_size < FLI_CHUNK_HEADER_SIZE) {
+    index->complete = 1;
+    return;
+  }
+
+  if (index->end_info == 0xFFFFFFFF)
+    palette_offset = FLI_PALETTE_MIXED;
+  else if (index->end_info)
+    palette_offset = offset - index->end_info;
+
+  if ((chunk_magic == FLI_CHUNK_MAGIC_1) ||
+      (chunk_magic == FLI_CHUNK_MAGIC_2)) {
+
+    previous_palette = palette_offset;
+    repaints = fli_scan_frame(this, offset, data,
+      (data_size < chunk_size) ? data_size : chunk_size, &palette_offset,
+      &own_palette);
+
+    /* the first frame is where decoding starts anyway; any other frame
+     * needs the palette it starts with to be known as a whole, unless
+     * it sets all of it itself */
+    if (!index->count)
+      seek_index_add(index, index->end_pts, offset, SEEK_INDEX_KEYFRAME, 0);
+    else if (repaints && own_palette)
+      seek_index_add(index, index->end_pts, offset, SEEK_INDEX_KEYFRAME, 0);
+    else if (repaints && (previous_palette > 0))
+      seek_index_add(index, index->end_pts, offset, SEEK_INDEX_KEYFRAME,
+        offset - previous_palette);
+    index->end_pts += this->frame_pts_inc;
+  }
+
+  index->end_offset = offset + chunk_size;
+  if (palette_offset == FLI_PALETTE_MIXED)
+    index->end_info = 0xFFFFFFFF;
+  else if (palette_offset)
+    index->end_info = index->end_offset - palette_offset;
+  else
+    index->end_info = 0;
+}
+
+/* extend the index with a header-only scan until it reaches past pts or
+ * offset, or the end of the file */
+static void fli_extend_index(demux_fli_t *this, int64_t pts, off_t offset) {
+
+  seek_index_t *index = this->index;
+  unsigned char header[FLI_FRAME_HEADER_SIZE];
+
+  while (!index->complete &&
+         (index->end_pts <= pts) && (index->end_offset <= offset)) {
+
+    this->input->seek(this->input, index->end_offset, SEEK_SET);
+    if (this->input->read(this->input, header, FLI_FRAME_HEADER_SIZE) !=
+      FLI_FRAME_HEADER_SIZE) {
+      index->complete = 1;
+      break;
+    }
+    fli_index_chunk(this, header, FLI_FRAME_HEADER_SIZE);
+  }
+
+  debug_fli_index("  demux_fli: %d keyframes in the first %lld frames%s\n",
+    index->count, index->end_pts / this->frame_pts_inc,
+    (index->complete) ? " (complete)" : "");
+}
+
+/*
+ * After a seek, splice the color chunk that set the whole palette in
+ * effect at the keyframe into the keyframe itself, since the decoder has
+ * not seen the frame that carried it, and may still hold the colors of
+ * wherever it was before. Reads the header of the frame chunk at offset into dest,
+ * followed by the color chunk, and leaves the input just after the frame
+ * header. Returns the number of bytes placed in dest.
+ */
+static unsigned int fli_splice_palette(demux_fli_t *this, off_t offset,
+                                       unsigned char *dest) {
+
+  unsigned char *palette = &dest[FLI_FRAME_HEADER_SIZE];
+  unsigned int palette_size = 0;
+  unsigned int frame_size;
+  unsigned int chunk_count;
+
+  if (this->input->read(this->input, dest, FLI_FRAME_HEADER_SIZE) !=
+    FLI_FRAME_HEADER_SIZE)
+    return 0;
+
+  this->input->seek(this->input, this->replay_palette_offset, SEEK_SET);
+  this->replay_palette_offset = 0;
+  if (this->input->read(this->input, palette, FLI_CHUNK_HEADER_SIZE) ==
+    FLI_CHUNK_HEADER_SIZE) {
+    palette_size = LE_32(&palette[0]);
+    if ((palette_size < FLI_CHUNK_HEADER_SIZE) ||
+        (FLI_FRAME_HEADER_SIZE + palette_size > BUFFER_SIZE) ||
+        (this->input->read(this->input, &palette[FLI_CHUNK_HEADER_SIZE],
+          palette_size - FLI_CHUNK_HEADER_SIZE) !=
+          palette_size - FLI_CHUNK_HEADER_SIZE))
+      palette_size = 0;
+  }
+  this->input->seek(this->input, offset + FLI_FRAME_HEADER_SIZE, SEEK_SET);
+
+  if (palette_size) {
+    frame_size = LE_32(&dest[0]) + palette_size;
+    chunk_count = LE_16(&dest[6]) + 1;
+    dest[0] = frame_size & 0xFF;
+    dest[1] = (frame_size >> 8) & 0xFF;
+    dest[2] = (frame_size >> 16) & 0xFF;
+    dest[3] = (frame_size >> 24) & 0xFF;
+    dest[6] = chunk_count & 0xFF;
+    dest[7] = (chunk_count >> 8) & 0xFF;
+  }
+
+  return FLI_FRAME_HEADER_SIZE + palette_size;
+}
+
 static int demux_fli_send_chunk(demux_plugin_t *this_gen) {
 
   demux_fli_t *this = (demux_fli_t *) this_gen;
@@ -163,6 +476,12 @@ static int demux_fli_send_chunk(demux_plugin_t *this_gen) {
   unsigned int chunk_size;
   unsigned int chunk_magic;
   off_t current_file_pos;
+  int first_buf = 1;
+
+  if (this->seek_flag) {
+    this->seek_flag = 0;
+    xine_demux_control_newpts(this->stream, this->pts_counter, BUF_FLAG_SEEK);
+  }
 
   current_file_pos = this->input->get_current_pos(this->input);
   
@@ -173,6 +492,10 @@ static int demux_fli_send_chunk(demux_plugin_t *this_gen) {
   }
   chunk_size = LE_32(&fli_buf[0]);
   chunk_magic = LE_16(&fli_buf[4]);
+  if (chunk_size < FLI_CHUNK_HEADER_SIZE) {
+    this->status = DEMUX_FINISHED;
+    return this->status;
+  }
   
   /* rewind over the size and packetize the chunk */
   this->input->seek(this->input, -6, SEEK_CUR);
@@ -180,33 +503,47 @@ static int demux_fli_send_chunk(demux_plugin_t *this_gen) {
   if ((chunk_magic == FLI_CHUNK_MAGIC_1) || 
       (chunk_magic == FLI_CHUNK_MAGIC_2)) {
     while (chunk_size) {
-      buf = this->video_fifo->buffer_pool_alloc (this->video_fifo);
+      if (first_buf && this->replay_palette_offset &&
+          (chunk_size >= FLI_FRAME_HEADER_SIZE)) {
+        buf = this->video_fifo->buffer_pool_alloc (this->video_fifo);
+        buf->size = fli_splice_palette(this, current_file_pos, buf->content);
+        if (!buf->size) {
+          buf->free_buffer(buf);
+          this->status = DEMUX_FINISHED;
+          break;
+        }
+        chunk_size -= FLI_FRAME_HEADER_SIZE;
+      } else {
+        buf = xine_demux_read_buffer(this->video_fifo, this->input,
+          chunk_size);
+        if (!buf) {
+          this->status = DEMUX_FINISHED;
+          break;
+        }
+        chunk_size -= buf->size;
+
+        /* index the frame on the way past if it is next in line */
+        if (first_buf && (current_file_pos == this->index->end_offset))
+          fli_index_chunk(this, buf->content, buf->size);
+      }
+      first_buf = 0;
+
       buf->type = BUF_VIDEO_FLI;
       buf->extra_info->input_pos = current_file_pos;
       buf->extra_info->input_time = this->pts_counter / 90;
       buf->extra_info->input_length = this->stream_len;
       buf->pts = this->pts_counter;
   
-      if (chunk_size > buf->max_size)
-        buf->size = buf->max_size;
-      else
-        buf->size = chunk_size;
-      chunk_size -= buf->size;
-  
-      if (this->input->read(this->input, buf->content, buf->size) !=
-        buf->size) {
-        buf->free_buffer(buf);
-        this->status = DEMUX_FINISHED;
-        break;
-      }
-  
       if (!chunk_size)
         buf->decoder_flags |= BUF_FLAG_FRAME_END;
       this->video_fifo->put(this->video_fifo, buf);
     }
     this->pts_counter += this->frame_pts_inc;
-  } else
+  } else {
+    if (current_file_pos == this->index->end_offset)
+      fli_index_chunk(this, fli_buf, 6);
     this->input->seek(this->input, chunk_size, SEEK_CUR);
+  }
 
   return this->status;
 }
@@ -248,37 +585,61 @@ static int demux_fli_seek (demux_plugin_t *this_gen,
                            off_t start_pos, int start_time) {
 
   demux_fli_t *this = (demux_fli_t *) this_gen;
+  seek_index_t *index = this->index;
+  seek_index_entry_t *keyframe;
+  int64_t pts;
+
+  this->stream_len = this->input->get_length(this->input);
+
+  /* offset request has precedence over time request; either way, the
+   * index only needs to be scanned as far as the target */
+  if (start_pos) {
+    fli_extend_index(this, FLI_ANY_PTS, start_pos);
+    if (index->complete && (start_pos >= index->end_offset))
+      keyframe = NULL;
+    else
+      keyframe = seek_index_find_offset(index, start_pos, SEEK_INDEX_KEYFRAME);
+  } else {
+    pts = (int64_t)start_time * 90000;
+    pts -= pts % this->frame_pts_inc;
+    fli_extend_index(this, pts, FLI_ANY_OFFSET);
+    if (index->complete && (pts >= index->end_pts))
+      keyframe = NULL;
+    else
+      keyframe = seek_index_find_pts(index, pts, SEEK_INDEX_KEYFRAME);
+  }
 
-  /* if thread is not running, initialize demuxer */
-printf ("  check 1\n");
-//  if( !this->stream->demux_thread_running ) {
-{
-printf ("  check 2\n");
+  if (!keyframe) {
+    this->status = DEMUX_FINISHED;
+    return this->status;
+  }
 
-    /* send new pts */
-/*    xine_demux_control_newpts(this->stream, 0, 0);*/
+  debug_fli_index("  demux_fli: seeking to keyframe %lld at 0x%llX\n",
+    keyframe->pts / this->frame_pts_inc, (long long)keyframe->offset);
 
-    this->status = DEMUX_OK;
-  
-    /* make sure to start just after the header */
-/*
-    if (this->magic_number == FLI_FILE_MAGIC_3)
-      this->input->seek(this->input, FLI_HEADER_SIZE_MC, SEEK_SET);
-    else
-      this->input->seek(this->input, FLI_HEADER_SIZE, SEEK_SET);
-*/
-    this->stream_len = this->input->get_length(this->input);
+  this->input->seek(this->input, keyframe->offset, SEEK_SET);
+  this->pts_counter = keyframe->pts;
+  this->replay_palette_offset = 0;
+  if (keyframe->info)
+    this->replay_palette_offset = keyframe->offset - keyframe->info;
 
-    this->pts_counter = 0;
-  }
-  
-printf ("  check 3 (%d)\n", this->status);
-/*  return this->status;*/
-  return DEMUX_OK;
+  this->seek_flag = 1;
+  this->status = DEMUX_OK;
+
+  /*
+   * do only flush if already running (seeking).
+   * otherwise decoder_config is flushed too.
+   */
+  if(this->stream->demux_thread_running)
+    xine_demux_flush_engine(this->stream);
+
+  return this->status;
 }
 
-static void demux_fli_dispose (demux_plugin_t *this) {
+static void demux_fli_dispose (demux_plugin_t *this_gen) {
+  demux_fli_t *this = (demux_fli_t *) this_gen;
 
+  seek_index_release(this->index);
   free(this);
 }
 
@@ -289,8 +650,9 @@ static int demux_fli_get_status (demux_plugin_t *this_gen) {
 }
 
 static int demux_fli_get_stream_length (demux_plugin_t *this_gen) {
+  demux_fli_t *this = (demux_fli_t *) this_gen;
 
-  return 0;
+  return (int64_t)this->frame_count * this->frame_pts_inc / 90;
 }
 
 static uint32_t demux_fli_get_capabilities(demux_plugin_t *this_gen) {
@@ -378,6 +740,11 @@ static demux_plugin_t *open_plugin (demux_class_t *class_gen, xine_stream_t *str
 
   strncpy (this->last_mrl, input->get_mrl (input), 1024);
 
+  /* pick up where any earlier playback of the file left the index */
+  this->index = seek_index_get(this->last_mrl, input->get_length(input));
+  if (this->index->end_offset < this->first_chunk)
+    this->index->end_offset = this->first_chunk;
+
   return &this->demux_plugin;
 }
 
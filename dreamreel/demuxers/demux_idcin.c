@@ -81,11 +81,20 @@
 #include "compat.h"
 #include "demux.h"
 #include "bswap.h"
+#include "seek_index.h"
 
 #define IDCIN_HEADER_SIZE 20
 #define HUFFMAN_TABLE_SIZE 65536
 #define IDCIN_FRAME_PTS_INC  (90000 / 14)
 #define PALETTE_SIZE 256
+#define IDCIN_DATA_START (IDCIN_HEADER_SIZE + HUFFMAN_TABLE_SIZE)
+
+/* every frame is intra-coded; index one per second of them */
+#define IDCIN_INDEX_INTERVAL 14
+
+/* seek targets that do not constrain the search */
+#define IDCIN_ANY_PTS    ((int64_t)0x7FFFFFFFFFFFFFFFLL)
+#define IDCIN_ANY_OFFSET ((off_t)0x7FFFFFFF)
 
 typedef struct {
 
@@ -116,6 +125,15 @@ typedef struct {
 
   unsigned char        huffman_table[HUFFMAN_TABLE_SIZE];
   uint64_t             pts_counter;
+  int                  seek_flag;
+
+  /* Seek index. The info field of an entry is how far back the last
+   * palette before the frame is, or 0 if the frame loads its own or there
+   * has not been one; end_info is the same for the end of the index. */
+  seek_index_t        *index;
+
+  /* palette to load ahead of the next frame after a seek, or 0 */
+  off_t                replay_palette_offset;
 
   char                 last_mrl[1024];
 } demux_idcin_t;
@@ -140,17 +158,141 @@ typedef struct {
 static inline void debug_idcin(const char *format, ...) { }
 #endif
 
+/* read a 768-byte palette from the input and pass it to the decoder;
+ * returns 0 if the palette could not be read */
+static int idcin_send_palette(demux_idcin_t *this) {
+
+  buf_element_t *buf;
+  unsigned char disk_palette[PALETTE_SIZE * 3];
+  palette_entry_t palette[PALETTE_SIZE];
+  int i;
+  int scale_bits;
+
+  if (this->input->read(this->input, disk_palette, PALETTE_SIZE * 3) !=
+    PALETTE_SIZE * 3)
+    return 0;
+
+  /* scan the palette to figure out if it's 6- or 8-bit;
+   * assume 6-bit palette until a value > 63 is seen */
+  scale_bits = 2;
+  for (i = 0; i < PALETTE_SIZE * 3; i++)
+    if (disk_palette[i] > 63) {
+      scale_bits = 0;
+      break;
+    }
+
+  /* convert palette to internal structure */
+  for (i = 0; i < PALETTE_SIZE; i++) {
+    /* these are VGA color DAC values, which means they only range
+     * from 0..63; adjust as appropriate */
+    palette[i].r = disk_palette[i * 3 + 0] << scale_bits;
+    palette[i].g = disk_palette[i * 3 + 1] << scale_bits;
+    palette[i].b = disk_palette[i * 3 + 2] << scale_bits;
+  }
+
+  buf = this->video_fifo->buffer_pool_alloc (this->video_fifo);
+  buf->decoder_flags = BUF_FLAG_SPECIAL;
+  buf->decoder_info[1] = BUF_SPECIAL_PALETTE;
+  buf->decoder_info[2] = PALETTE_SIZE;
+  buf->decoder_info_ptr[2] = &palette;
+  buf->size = 0;
+  buf->type = BUF_VIDEO_IDCIN;
+  this->video_fifo->put (this->video_fifo, buf);
+
+  return 1;
+}
+
+/* returns the number of audio bytes that go with frame number frame */
+static unsigned int idcin_audio_chunk_size(demux_idcin_t *this,
+                                           unsigned int frame) {
+
+  if (!this->audio_sample_rate)
+    return 0;
+
+  return (frame & 1) ? this->audio_chunk_size2 : this->audio_chunk_size1;
+}
+
+/* add the frame at the end of the index, which starts with command and
+ * ends at next_offset, to it */
+static void idcin_index_frame(demux_idcin_t *this, unsigned int command,
+                              off_t next_offset) {
+
+  seek_index_t *index = this->index;
+  off_t offset = index->end_offset;
+  off_t palette_offset = 0;
+
+  if (command == 1)
+    palette_offset = offset;
+  else if (index->end_info)
+    palette_offset = offset - index->end_info;
+
+  if ((index->end_pts / IDCIN_FRAME_PTS_INC) % IDCIN_INDEX_INTERVAL == 0)
+    seek_index_add(index, index->end_pts, offset, SEEK_INDEX_KEYFRAME,
+      (palette_offset) ? offset - palette_offset : 0);
+
+  index->end_pts += IDCIN_FRAME_PTS_INC;
+  index->end_offset = next_offset;
+  index->end_info = (palette_offset) ? next_offset - palette_offset : 0;
+}
+
+/* extend the index by walking the frame headers until it reaches past pts
+ * or offset, or the end of the file */
+static void idcin_extend_index(demux_idcin_t *this, int64_t pts,
+                               off_t offset) {
+
+  seek_index_t *index = this->index;
+  unsigned char preamble[4];
+  unsigned int command;
+  off_t next_offset;
+
+  while (!index->complete &&
+         (index->end_pts <= pts) && (index->end_offset <= offset)) {
+
+    this->input->seek(this->input, index->end_offset, SEEK_SET);
+    if (this->input->read(this->input, preamble, 4) != 4) {
+      index->complete = 1;
+      break;
+    }
+    command = LE_32(&preamble[0]);
+    if (command == 2) {
+      index->complete = 1;
+      break;
+    }
+
+    next_offset = index->end_offset + 4;
+    if (command == 1)
+      next_offset += PALETTE_SIZE * 3;
+
+    /* the video chunk size counts itself and the 4 bytes after it */
+    this->input->seek(this->input, next_offset, SEEK_SET);
+    if (this->input->read(this->input, preamble, 4) != 4) {
+      index->complete = 1;
+      break;
+    }
+    next_offset += 4 + LE_32(&preamble[0]);
+    next_offset += idcin_audio_chunk_size(this,
+      index->end_pts / IDCIN_FRAME_PTS_INC);
+
+    idcin_index_frame(this, command, next_offset);
+  }
+}
+
 static int demux_idcin_send_chunk(demux_plugin_t *this_gen) {
 
   demux_idcin_t *this = (demux_idcin_t *) this_gen;
   buf_element_t *buf = NULL;
   unsigned int command;
   unsigned char preamble[8];
-  unsigned char disk_palette[PALETTE_SIZE * 3];
-  palette_entry_t palette[PALETTE_SIZE];
-  int i;
   unsigned int remaining_sample_bytes;
-  int scale_bits;
+  off_t frame_offset;
+  off_t input_pos;
+
+  if (this->seek_flag) {
+    this->seek_flag = 0;
+    xine_demux_control_newpts(this->stream, this->pts_counter, BUF_FLAG_SEEK);
+  }
+
+  frame_offset = this->input->get_current_pos(this->input);
 
   /* figure out what the next data is */
   if (this->input->read(this->input, (unsigned char *)&command, 4) != 4) {
@@ -162,45 +304,32 @@ static int demux_idcin_send_chunk(demux_plugin_t *this_gen) {
   debug_idcin("  demux_idcin: command %d: ", command);
   if (command == 2) {
     debug_idcin("demux finished\n");
+    if (frame_offset == this->index->end_offset)
+      this->index->complete = 1;
     this->status = DEMUX_FINISHED;
     return this->status;
   } else {
+
+    /* after a seek, load the palette that was in effect at this frame */
+    if (this->replay_palette_offset) {
+      if (command != 1) {
+        debug_idcin("reload palette, ");
+        this->input->seek(this->input, this->replay_palette_offset + 4,
+          SEEK_SET);
+        idcin_send_palette(this);
+        this->input->seek(this->input, frame_offset + 4, SEEK_SET);
+      }
+      this->replay_palette_offset = 0;
+    }
+
     if (command == 1) {
       debug_idcin("load palette\n");
 
       /* load a 768-byte palette and pass it to the demuxer */
-      if (this->input->read(this->input, disk_palette, PALETTE_SIZE * 3) !=
-        PALETTE_SIZE * 3) {
+      if (!idcin_send_palette(this)) {
         this->status = DEMUX_FINISHED;
         return this->status;
       }
-
-      /* scan the palette to figure out if it's 6- or 8-bit;
-       * assume 6-bit palette until a value > 63 is seen */
-      scale_bits = 2;
-      for (i = 0; i < PALETTE_SIZE * 3; i++)
-        if (disk_palette[i] > 63) {
-          scale_bits = 0;
-          break;
-        }
-
-      /* convert palette to internal structure */
-      for (i = 0; i < PALETTE_SIZE; i++) {
-        /* these are VGA color DAC values, which means they only range
-         * from 0..63; adjust as appropriate */
-        palette[i].r = disk_palette[i * 3 + 0] << scale_bits;
-        palette[i].g = disk_palette[i * 3 + 1] << scale_bits;
-        palette[i].b = disk_palette[i * 3 + 2] << scale_bits;
-      }
-
-      buf = this->video_fifo->buffer_pool_alloc (this->video_fifo);
-      buf->decoder_flags = BUF_FLAG_SPECIAL;
-      buf->decoder_info[1] = BUF_SPECIAL_PALETTE;
-      buf->decoder_info[2] = PALETTE_SIZE;
-      buf->decoder_info_ptr[2] = &palette;
-      buf->size = 0;
-      buf->type = BUF_VIDEO_IDCIN;
-      this->video_fifo->put (this->video_fifo, buf);
     } else
       debug_idcin("load video and audio\n");
   }
@@ -215,26 +344,21 @@ static int demux_idcin_send_chunk(demux_plugin_t *this_gen) {
   debug_idcin("  demux_idcin: dispatching %d video bytes\n",
     remaining_sample_bytes);
   while (remaining_sample_bytes) {
-    buf = this->video_fifo->buffer_pool_alloc (this->video_fifo);
+    input_pos = this->input->get_current_pos(this->input);
+    buf = xine_demux_read_buffer(this->video_fifo, this->input,
+      remaining_sample_bytes);
+    if (!buf) {
+      this->status = DEMUX_FINISHED;
+      break;
+    }
+    remaining_sample_bytes -= buf->size;
+
     buf->type = BUF_VIDEO_IDCIN;
-    buf->extra_info->input_pos = this->input->get_current_pos(this->input);
+    buf->extra_info->input_pos = input_pos;
     buf->extra_info->input_length = this->filesize;
     buf->extra_info->input_time = this->pts_counter / 90;
     buf->pts = this->pts_counter;
 
-    if (remaining_sample_bytes > buf->max_size)
-      buf->size = buf->max_size;
-    else
-      buf->size = remaining_sample_bytes;
-    remaining_sample_bytes -= buf->size;
-
-    if (this->input->read(this->input, buf->content, buf->size) !=
-      buf->size) {
-      buf->free_buffer(buf);
-      this->status = DEMUX_FINISHED;
-      break;
-    }
-
     /* all frames are intra-coded */
     buf->decoder_flags |= BUF_FLAG_KEYFRAME;
     if (!remaining_sample_bytes)
@@ -259,26 +383,21 @@ static int demux_idcin_send_chunk(demux_plugin_t *this_gen) {
     debug_idcin("  demux_idcin: dispatching %d audio bytes\n",
       remaining_sample_bytes);
     while (remaining_sample_bytes) {
-      buf = this->audio_fifo->buffer_pool_alloc (this->audio_fifo);
+      input_pos = this->input->get_current_pos(this->input);
+      buf = xine_demux_read_buffer(this->audio_fifo, this->input,
+        remaining_sample_bytes);
+      if (!buf) {
+        this->status = DEMUX_FINISHED;
+        break;
+      }
+      remaining_sample_bytes -= buf->size;
+
       buf->type = BUF_AUDIO_LPCM_LE;
-      buf->extra_info->input_pos = this->input->get_current_pos(this->input);
+      buf->extra_info->input_pos = input_pos;
       buf->extra_info->input_length = this->filesize;
       buf->extra_info->input_time = this->pts_counter / 90;
       buf->pts = this->pts_counter;
 
-      if (remaining_sample_bytes > buf->max_size)
-        buf->size = buf->max_size;
-      else
-        buf->size = remaining_sample_bytes;
-      remaining_sample_bytes -= buf->size;
-
-      if (this->input->read(this->input, buf->content, buf->size) !=
-        buf->size) {
-        buf->free_buffer(buf);
-        this->status = DEMUX_FINISHED;
-        break;
-      }
-
       if (!remaining_sample_bytes)
         buf->decoder_flags |= BUF_FLAG_FRAME_END;
 
@@ -290,6 +409,11 @@ static int demux_idcin_send_chunk(demux_plugin_t *this_gen) {
 
   debug_idcin("\n");
 
+  /* index the frame on the way past if it is next in line */
+  if ((this->status == DEMUX_OK) && (frame_offset == this->index->end_offset))
+    idcin_index_frame(this, command,
+      this->input->get_current_pos(this->input));
+
   this->pts_counter += IDCIN_FRAME_PTS_INC;
 
   return this->status;
@@ -299,20 +423,10 @@ static int demux_idcin_send_chunk(demux_plugin_t *this_gen) {
 static int open_idcin_file(demux_idcin_t *this) {
 
   unsigned char header[IDCIN_HEADER_SIZE];
-  unsigned char preview[MAX_PREVIEW_SIZE];
 
-  if (this->input->get_capabilities(this->input) & INPUT_CAP_SEEKABLE) {
-    this->input->seek(this->input, 0, SEEK_SET);
-    if (this->input->read(this->input, header, IDCIN_HEADER_SIZE) != 
-      IDCIN_HEADER_SIZE)
-      return 0;
-  } else {
-    this->input->get_optional_data(this->input, preview, 
-      INPUT_OPTIONAL_DATA_PREVIEW);
-
-    /* copy over the header bytes for processing */
-    memcpy(header, preview, IDCIN_HEADER_SIZE);
-  }
+  if (xine_demux_read_header(this->input, header, IDCIN_HEADER_SIZE) !=
+    IDCIN_HEADER_SIZE)
+    return 0;
 
   /*
    * This is what you could call a "probabilistic" file check: Id CIN
@@ -359,19 +473,35 @@ static int open_idcin_file(demux_idcin_t *this) {
     this->audio_channels,
     this->audio_bytes_per_sample * 8);
 
-  /* file is qualified; if the input was not seekable, read the header
-   * bytes out of the stream */
-  if ((this->input->get_capabilities(this->input) & INPUT_CAP_SEEKABLE) == 0) {
-    if (this->input->read(this->input, header, IDCIN_HEADER_SIZE) != 
-      IDCIN_HEADER_SIZE)
-      return 0;
-  }
+  /* file is qualified; the header may have come from the preview, so
+   * position the input just past it, reading it out of the stream if the
+   * input can not seek */
+  if (this->input->get_capabilities(this->input) & INPUT_CAP_SEEKABLE)
+    this->input->seek(this->input, IDCIN_HEADER_SIZE, SEEK_SET);
+  else if (this->input->read(this->input, header, IDCIN_HEADER_SIZE) !=
+    IDCIN_HEADER_SIZE)
+    return 0;
 
   /* read the Huffman table */
   if (this->input->read(this->input, this->huffman_table,
     HUFFMAN_TABLE_SIZE) != HUFFMAN_TABLE_SIZE)
     return 0;
 
+  /* initialize the audio chunk sizes, which alternate when the sample
+   * rate does not divide evenly between the frames */
+  if (this->audio_sample_rate % 14 != 0) {
+    this->audio_chunk_size1 = (this->audio_sample_rate / 14) *
+      this->audio_bytes_per_sample * this->audio_channels;
+    this->audio_chunk_size2 = (this->audio_sample_rate / 14 + 1) *
+      this->audio_bytes_per_sample * this->audio_channels;
+  } else {
+    this->audio_chunk_size1 = this->audio_chunk_size2 =
+      (this->audio_sample_rate / 14) * this->audio_bytes_per_sample *
+      this->audio_channels;
+  }
+  debug_idcin("  demux_idcin: audio_chunk_size[1,2] = %d, %d\n",
+    this->audio_chunk_size1, this->audio_chunk_size2);
+
   /* load stream information */
   this->stream->stream_info[XINE_STREAM_INFO_HAS_VIDEO] = 1;
   this->stream->stream_info[XINE_STREAM_INFO_HAS_AUDIO] = 
@@ -429,21 +559,6 @@ static void demux_idcin_send_headers(demux_plugin_t *this_gen) {
   this->video_fifo->put (this->video_fifo, buf);
 
   if (this->audio_fifo && this->audio_channels) {
-
-    /* initialize the chunk sizes */
-    if (this->audio_sample_rate % 14 != 0) {
-      this->audio_chunk_size1 = (this->audio_sample_rate / 14) *
-        this->audio_bytes_per_sample * this->audio_channels;
-      this->audio_chunk_size2 = (this->audio_sample_rate / 14 + 1) *
-        this->audio_bytes_per_sample * this->audio_channels;
-    } else {
-      this->audio_chunk_size1 = this->audio_chunk_size2 =
-        (this->audio_sample_rate / 14) * this->audio_bytes_per_sample *
-        this->audio_channels;
-    }
-    debug_idcin("  demux_idcin: audio_chunk_size[1,2] = %d, %d\n",
-      this->audio_chunk_size1, this->audio_chunk_size2);
-
     buf = this->audio_fifo->buffer_pool_alloc (this->audio_fifo);
     buf->type = BUF_AUDIO_LPCM_LE;
     buf->decoder_flags = BUF_FLAG_HEADER;
@@ -459,27 +574,58 @@ static int demux_idcin_seek (demux_plugin_t *this_gen,
                               off_t start_pos, int start_time) {
 
   demux_idcin_t *this = (demux_idcin_t *) this_gen;
+  seek_index_t *index = this->index;
+  seek_index_entry_t *entry;
+  int64_t pts;
+
+  /* offset request has precedence over time request; either way, the
+   * index only needs to be walked as far as the target */
+  if (start_pos) {
+    idcin_extend_index(this, IDCIN_ANY_PTS, start_pos);
+    if (index->complete && (start_pos >= index->end_offset))
+      entry = NULL;
+    else
+      entry = seek_index_find_offset(index, start_pos, SEEK_INDEX_KEYFRAME);
+  } else {
+    pts = (int64_t)start_time * 90000;
+    idcin_extend_index(this, pts, IDCIN_ANY_OFFSET);
+    if (index->complete && (pts >= index->end_pts))
+      entry = NULL;
+    else
+      entry = seek_index_find_pts(index, pts, SEEK_INDEX_KEYFRAME);
+  }
+
+  if (!entry) {
+    this->status = DEMUX_FINISHED;
+    return this->status;
+  }
+
+  this->status = DEMUX_OK;
+  this->input->seek(this->input, entry->offset, SEEK_SET);
+  this->pts_counter = entry->pts;
+  this->current_audio_chunk =
+    ((entry->pts / IDCIN_FRAME_PTS_INC) & 1) ? 2 : 1;
+  this->replay_palette_offset = 0;
+  if (entry->info)
+    this->replay_palette_offset = entry->offset - entry->info;
 
   /* if thread is not running, initialize demuxer */
   if( !this->stream->demux_thread_running ) {
 
     /* send new pts */
-    xine_demux_control_newpts(this->stream, 0, 0);
-
-    this->status = DEMUX_OK;
-  
-    /* reposition stream past the Huffman tables */
-    this->input->seek(this->input, 0x14 + 0x10000, SEEK_SET);
-
-    this->pts_counter = 0;
-    this->current_audio_chunk = 1;
+    xine_demux_control_newpts(this->stream, this->pts_counter, 0);
+  } else {
+    this->seek_flag = 1;
+    xine_demux_flush_engine(this->stream);
   }
 
   return this->status;
 }
 
-static void demux_idcin_dispose (demux_plugin_t *this) {
+static void demux_idcin_dispose (demux_plugin_t *this_gen) {
+  demux_idcin_t *this = (demux_idcin_t *) this_gen;
 
+  seek_index_release(this->index);
   free(this);
 }
 
@@ -490,6 +636,11 @@ static int demux_idcin_get_status (demux_plugin_t *this_gen) {
 }
 
 static int demux_idcin_get_stream_length (demux_plugin_t *this_gen) {
+  demux_idcin_t *this = (demux_idcin_t *) this_gen;
+
+  /* only known once the whole file has been indexed */
+  if (this->index->complete)
+    return this->index->end_pts / 90;
 
   return 0;
 }
@@ -526,6 +677,7 @@ static demux_plugin_t *open_plugin (demux_class_t *class_gen, xine_stream_t *str
   this->demux_plugin.demux_class       = class_gen;
 
   this->status = DEMUX_FINISHED;
+  this->current_audio_chunk = 1;
 
   switch (stream->content_detection_method) {
 
@@ -572,6 +724,11 @@ static demux_plugin_t *open_plugin (demux_class_t *class_gen, xine_stream_t *str
 
   strncpy (this->last_mrl, input->get_mrl (input), 1024);
 
+  /* pick up where any earlier playback of the file left the index */
+  this->index = seek_index_get(this->last_mrl, input->get_length(input));
+  if (this->index->end_offset < IDCIN_DATA_START)
+    this->index->end_offset = IDCIN_DATA_START;
+
   return &this->demux_plugin;
 }
 
@@ -0,0 +1,662 @@
+/*
+ * Copyright (C) 2000-2003 the xine project
+ *
+ * This file is part of xine, a free video player.
+ *
+ * xine is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * xine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA
+ *
+ * MPEG-1 Video Demuxer
+ * This demuxer handles MPEG-1 video elementary streams (files that start
+ * with a sequence header, 00 00 01 B3) and the video of MPEG-1 system
+ * streams (files that start with a pack header, 00 00 01 BA). Audio in a
+ * system stream is skipped.
+ *
+ * MPEG video has no frame sizes to go by, so the demuxer gathers the
+ * elementary stream and cuts it at the picture start codes: each unit it
+ * sends on carries one coded picture, along with the sequence and GOP
+ * headers that come in front of it. The picture's pts comes from its
+ * temporal reference, counted from the start of its GOP, so the units go
+ * out in coded order with display order pts; the decoder sorts them out.
+ * The pts in system stream packets are not used.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "xine_internal.h"
+#include "xineutils.h"
+#include "compat.h"
+#include "demux.h"
+#include "bswap.h"
+
+#define SEQ_START_CODE      0xB3
+#define SEQ_END_CODE        0xB7
+#define GOP_START_CODE      0xB8
+#define PICTURE_START_CODE  0x00
+#define PACK_START_CODE     0xBA
+#define SYSTEM_HEADER_CODE  0xBB
+#define VIDEO_STREAM_0      0xE0
+
+#define MPEG_READ_SIZE      (16 * 1024)
+#define MPEG_INITIAL_BUFFER (64 * 1024)
+/* how much of the file to look through for the first sequence header */
+#define MPEG_PROBE_SIZE     (256 * 1024)
+
+/* frame_rate_code, as num / den frames per second */
+static const int frame_rates[9][2] = {
+  {     0,    1 },
+  { 24000, 1001 },
+  {    24,    1 },
+  {    25,    1 },
+  { 30000, 1001 },
+  {    30,    1 },
+  {    50,    1 },
+  { 60000, 1001 },
+  {    60,    1 },
+};
+
+typedef struct {
+
+  demux_plugin_t       demux_plugin;
+
+  xine_stream_t       *stream;
+
+  config_values_t     *config;
+
+  fifo_buffer_t       *video_fifo;
+  fifo_buffer_t       *audio_fifo;
+
+  input_plugin_t      *input;
+
+  int                  thread_running;
+  int                  send_end_buffers;
+
+  off_t                data_size;
+  int                  status;
+
+  int                  system_stream;
+  int                  eof;
+
+  /* the sequence header, which goes out with the header buffer */
+  unsigned char        seq_header[12];
+  int                  width;
+  int                  height;
+  int                  rate_num;
+  int                  rate_den;
+
+  /* the elementary stream gathered so far; the unit being put together
+   * starts at the beginning */
+  unsigned char       *es;
+  int                  es_size;
+  int                  es_alloc;
+  int                  scan_pos;
+  int                  picture_seen;
+  int                  temporal_reference;
+
+  /* display order frame count at the start of the current GOP, and the
+   * highest temporal reference seen in it */
+  int64_t              gop_base;
+  int                  gop_max_tr;
+
+  /* for estimating times from file positions */
+  int64_t              bytes_sent;
+  int                  units_sent;
+
+  int                  seek_flag;
+
+  char                 last_mrl[1024];
+} demux_mpeg_t;
+
+typedef struct {
+
+  demux_class_t     demux_class;
+
+  /* class-wide, global variables here */
+
+  xine_t           *xine;
+  config_values_t  *config;
+} demux_mpeg_class_t;
+
+/* makes room for size more bytes at the end of the elementary stream
+ * buffer; returns 0 if there is no memory */
+static int mpeg_es_grow(demux_mpeg_t *this, int size) {
+
+  unsigned char *es;
+
+  if (this->es_size + size <= this->es_alloc)
+    return 1;
+
+  es = realloc(this->es, (this->es_size + size) * 2);
+  if (!es)
+    return 0;
+  this->es = es;
+  this->es_alloc = (this->es_size + size) * 2;
+
+  return 1;
+}
+
+/* reads a system stream packet; the payload of the first video stream
+ * goes onto the elementary stream. returns 0 at the end of the file */
+static int mpeg_read_packet(demux_mpeg_t *this) {
+
+  unsigned char header[12];
+  unsigned char *p;
+  int code, length, skip;
+
+  if (this->input->read(this->input, header, 4) != 4)
+    return 0;
+
+  /* look for the next start code if the packets lost their place */
+  while ((header[0] != 0) || (header[1] != 0) || (header[2] != 1)) {
+    memmove(&header[0], &header[1], 3);
+    if (this->input->read(this->input, &header[3], 1) != 1)
+      return 0;
+  }
+  code = header[3];
+
+  switch (code) {
+
+  case PACK_START_CODE:
+    /* MPEG-1 pack: SCR and mux rate */
+    return this->input->read(this->input, header, 8) == 8;
+
+  case 0xB9:  /* end of the program */
+    return 0;
+
+  default:
+    if (code < SYSTEM_HEADER_CODE)
+      return 1;
+    if (this->input->read(this->input, header, 2) != 2)
+      return 0;
+    length = BE_16(&header[0]);
+
+    if (code != VIDEO_STREAM_0) {
+      this->input->seek(this->input, length, SEEK_CUR);
+      return 1;
+    }
+
+    if (!mpeg_es_grow(this, length))
+      return 0;
+    p = &this->es[this->es_size];
+    if (this->input->read(this->input, p, length) != length)
+      return 0;
+
+    /* MPEG-1 packet header: stuffing, STD buffer size, then the time
+     * stamps */
+    skip = 0;
+    while ((skip < length) && (p[skip] == 0xFF))
+      skip++;
+    if ((skip < length) && ((p[skip] & 0xC0) == 0x40))
+      skip += 2;
+    if (skip < length) {
+      if ((p[skip] & 0xF0) == 0x20)
+        skip += 5;
+      else if ((p[skip] & 0xF0) == 0x30)
+        skip += 10;
+      else
+        skip += 1;
+    }
+    if (skip < length) {
+      memmove(p, p + skip, length - skip);
+      this->es_size += length - skip;
+    }
+    return 1;
+  }
+}
+
+/* adds more of the elementary stream; returns 0 at the end of the file */
+static int mpeg_fill(demux_mpeg_t *this) {
+
+  int start_size = this->es_size;
+  int size;
+
+  if (this->eof)
+    return 0;
+
+  if (this->system_stream) {
+    while (this->es_size == start_size)
+      if (!mpeg_read_packet(this)) {
+        this->eof = 1;
+        break;
+      }
+  } else {
+    if (!mpeg_es_grow(this, MPEG_READ_SIZE))
+      return 0;
+    size = this->input->read(this->input, &this->es[this->es_size],
+      MPEG_READ_SIZE);
+    if (size <= 0)
+      this->eof = 1;
+    else
+      this->es_size += size;
+  }
+
+  return this->es_size > start_size;
+}
+
+/* returns the offset of the next start code at or after pos, with at
+ * least 2 bytes after it in the buffer, or -1 */
+static int mpeg_find_start_code(demux_mpeg_t *this, int pos) {
+
+  unsigned char *es = this->es;
+
+  while (pos + 6 <= this->es_size) {
+    if (es[pos + 2] > 1)
+      pos += 3;
+    else if (es[pos + 1])
+      pos += 2;
+    else if (es[pos] || (es[pos + 2] != 1))
+      pos++;
+    else
+      return pos;
+  }
+
+  return -1;
+}
+
+/* drops the first size bytes of the elementary stream */
+static void mpeg_es_consume(demux_mpeg_t *this, int size) {
+
+  memmove(this->es, this->es + size, this->es_size - size);
+  this->es_size -= size;
+  this->scan_pos = 0;
+}
+
+/* returns 1 if the MPEG file was opened successfully, 0 otherwise */
+static int open_mpeg_file(demux_mpeg_t *this) {
+
+  unsigned char header[12];
+  int pos, rate;
+
+  if (xine_demux_read_header(this->input, header, 12) != 12)
+    return 0;
+
+  if ((header[0] != 0) || (header[1] != 0) || (header[2] != 1))
+    return 0;
+  if (header[3] == PACK_START_CODE) {
+    /* an MPEG-2 program stream has '01' where MPEG-1 has '0010' */
+    if ((header[4] & 0xF0) != 0x20)
+      return 0;
+    this->system_stream = 1;
+  } else if (header[3] != SEQ_START_CODE)
+    return 0;
+
+  if (!(this->input->get_capabilities(this->input) & INPUT_CAP_SEEKABLE))
+    return 0;
+  this->data_size = this->input->get_length(this->input);
+  this->input->seek(this->input, 0, SEEK_SET);
+
+  /* find the first sequence header in the video */
+  this->es_alloc = MPEG_INITIAL_BUFFER;
+  this->es = malloc(this->es_alloc);
+  if (!this->es)
+    return 0;
+  pos = -1;
+  while (this->input->get_current_pos(this->input) < MPEG_PROBE_SIZE) {
+    pos = mpeg_find_start_code(this, 0);
+    while ((pos >= 0) && (this->es[pos + 3] != SEQ_START_CODE))
+      pos = mpeg_find_start_code(this, pos + 3);
+    if ((pos >= 0) && (pos + 12 <= this->es_size))
+      break;
+    pos = -1;
+    if (!mpeg_fill(this))
+      break;
+  }
+  if (pos < 0)
+    return 0;
+
+  memcpy(this->seq_header, &this->es[pos], 12);
+  this->width = (this->seq_header[4] << 4) | (this->seq_header[5] >> 4);
+  this->height = ((this->seq_header[5] & 0x0F) << 8) | this->seq_header[6];
+  rate = this->seq_header[7] & 0x0F;
+  if (!this->width || !this->height || !rate || (rate > 8))
+    return 0;
+  this->rate_num = frame_rates[rate][0];
+  this->rate_den = frame_rates[rate][1];
+
+  /* start the stream at the sequence header */
+  mpeg_es_consume(this, pos);
+  this->gop_max_tr = -1;
+
+  return 1;
+}
+
+static int64_t mpeg_frame_pts(demux_mpeg_t *this, int64_t frame) {
+
+  return frame * 90000 * this->rate_den / this->rate_num;
+}
+
+static int demux_mpeg_send_chunk(demux_plugin_t *this_gen) {
+
+  demux_mpeg_t *this = (demux_mpeg_t *) this_gen;
+  buf_element_t *buf = NULL;
+  int pos, code, unit_size, offset;
+  int64_t pts;
+
+  /* gather one coded picture */
+  unit_size = 0;
+  while (!unit_size) {
+
+    pos = mpeg_find_start_code(this, this->scan_pos);
+    if (pos < 0) {
+      /* keep the last bytes; a start code may straddle the refill */
+      this->scan_pos = (this->es_size > 5) ? this->es_size - 5 : 0;
+      if (!mpeg_fill(this)) {
+        unit_size = this->picture_seen ? this->es_size : -1;
+        break;
+      }
+      continue;
+    }
+    this->scan_pos = pos + 3;
+    code = this->es[pos + 3];
+
+    if (this->seek_flag == 2) {
+      /* after a seek, start again at a sequence or GOP header */
+      if ((code == SEQ_START_CODE) || (code == GOP_START_CODE)) {
+        mpeg_es_consume(this, pos);
+        this->seek_flag = 1;
+      }
+      continue;
+    }
+
+    if (this->picture_seen &&
+        ((code == PICTURE_START_CODE) || (code == SEQ_START_CODE) ||
+         (code == GOP_START_CODE))) {
+      unit_size = pos;
+      break;
+    }
+
+    if (code == GOP_START_CODE) {
+      this->gop_base += this->gop_max_tr + 1;
+      this->gop_max_tr = -1;
+    } else if (code == PICTURE_START_CODE) {
+      this->picture_seen = 1;
+      this->temporal_reference =
+        (this->es[pos + 4] << 2) | (this->es[pos + 5] >> 6);
+      if (this->temporal_reference > this->gop_max_tr)
+        this->gop_max_tr = this->temporal_reference;
+    }
+  }
+
+  if (unit_size < 0) {
+    this->status = DEMUX_FINISHED;
+    return this->status;
+  }
+
+  pts = mpeg_frame_pts(this, this->gop_base + this->temporal_reference);
+
+  /* reset the pts after a seek */
+  if (this->seek_flag) {
+    xine_demux_control_newpts(this->stream, pts, BUF_FLAG_SEEK);
+    this->seek_flag = 0;
+  }
+
+  offset = 0;
+  while (offset < unit_size) {
+    buf = this->video_fifo->buffer_pool_alloc(this->video_fifo);
+    buf->size = unit_size - offset;
+    if (buf->size > buf->max_size)
+      buf->size = buf->max_size;
+    memcpy(buf->content, &this->es[offset], buf->size);
+    offset += buf->size;
+
+    buf->type = BUF_VIDEO_MPEG;
+    buf->extra_info->input_pos =
+      this->input->get_current_pos(this->input);
+    buf->extra_info->input_length = this->data_size;
+    buf->pts = pts;
+
+    if (offset == unit_size)
+      buf->decoder_flags |= BUF_FLAG_FRAME_END;
+    this->video_fifo->put(this->video_fifo, buf);
+  }
+
+  this->bytes_sent += unit_size;
+  this->units_sent++;
+  mpeg_es_consume(this, unit_size);
+  this->picture_seen = 0;
+
+  return this->status;
+}
+
+static void demux_mpeg_send_headers(demux_plugin_t *this_gen) {
+
+  demux_mpeg_t *this = (demux_mpeg_t *) this_gen;
+  buf_element_t *buf;
+
+  this->video_fifo  = this->stream->video_fifo;
+  this->audio_fifo  = this->stream->audio_fifo;
+
+  this->status = DEMUX_OK;
+
+  /* load stream information */
+  this->stream->stream_info[XINE_STREAM_INFO_HAS_VIDEO] = 1;
+  this->stream->stream_info[XINE_STREAM_INFO_HAS_AUDIO] = 0;
+  this->stream->stream_info[XINE_STREAM_INFO_VIDEO_WIDTH] = this->width;
+  this->stream->stream_info[XINE_STREAM_INFO_VIDEO_HEIGHT] = this->height;
+
+  /* send start buffers */
+  xine_demux_control_start(this->stream);
+
+  /* send init info to decoders */
+  buf = this->video_fifo->buffer_pool_alloc (this->video_fifo);
+  buf->decoder_flags = BUF_FLAG_HEADER;
+  buf->decoder_info[0] = 0;
+  buf->decoder_info[1] = mpeg_frame_pts(this, 1);  /* initial video_step */
+  memcpy(buf->content, this->seq_header, sizeof(this->seq_header));
+  buf->size = sizeof(this->seq_header);
+  buf->type = BUF_VIDEO_MPEG;
+  this->video_fifo->put (this->video_fifo, buf);
+}
+
+/* average bytes per picture so far, for turning positions into times */
+static int mpeg_unit_size(demux_mpeg_t *this) {
+
+  if (!this->units_sent)
+    return 0;
+  return (int)(this->bytes_sent / this->units_sent);
+}
+
+static int demux_mpeg_seek (demux_plugin_t *this_gen,
+                            off_t start_pos, int start_time) {
+
+  demux_mpeg_t *this = (demux_mpeg_t *) this_gen;
+  int unit_size;
+
+  if (this->input->get_capabilities(this->input) & INPUT_CAP_SEEKABLE) {
+
+    /* there is no index; go to the byte position and pick the stream up
+     * at the next sequence or GOP header. The frame count there can only
+     * be estimated from the pictures seen so far. */
+    this->input->seek(this->input, start_pos, SEEK_SET);
+    this->es_size = this->scan_pos = 0;
+    this->picture_seen = 0;
+    this->eof = 0;
+    unit_size = mpeg_unit_size(this);
+    this->gop_base = unit_size ? start_pos / unit_size : 0;
+    this->gop_max_tr = -1;
+    this->seek_flag = 2;
+  }
+
+  this->status = DEMUX_OK;
+  xine_demux_flush_engine (this->stream);
+
+  /* if thread is not running, initialize demuxer */
+  if( !this->stream->demux_thread_running ) {
+
+    /* send new pts */
+    xine_demux_control_newpts(this->stream, 0, 0);
+
+    this->status = DEMUX_OK;
+  }
+
+  return this->status;
+}
+
+static void demux_mpeg_dispose (demux_plugin_t *this_gen) {
+
+  demux_mpeg_t *this = (demux_mpeg_t *) this_gen;
+
+  free(this->es);
+  free(this);
+}
+
+static int demux_mpeg_get_status (demux_plugin_t *this_gen) {
+  demux_mpeg_t *this = (demux_mpeg_t *) this_gen;
+
+  return this->status;
+}
+
+static int demux_mpeg_get_stream_length (demux_plugin_t *this_gen) {
+
+  demux_mpeg_t *this = (demux_mpeg_t *) this_gen;
+  int unit_size = mpeg_unit_size(this);
+
+  if (!unit_size)
+    return 0;
+
+  return (int)(mpeg_frame_pts(this, this->data_size / unit_size) / 90);
+}
+
+static uint32_t demux_mpeg_get_capabilities(demux_plugin_t *this_gen) {
+  return DEMUX_CAP_NOCAP;
+}
+
+static int demux_mpeg_get_optional_data(demux_plugin_t *this_gen,
+					void *data, int data_type) {
+  return DEMUX_OPTIONAL_UNSUPPORTED;
+}
+
+static demux_plugin_t *open_plugin (demux_class_t *class_gen, xine_stream_t *stream,
+                                    input_plugin_t *input_gen) {
+
+  input_plugin_t *input = (input_plugin_t *) input_gen;
+  demux_mpeg_t *this;
+
+  this         = xine_xmalloc (sizeof (demux_mpeg_t));
+  this->stream = stream;
+  this->input  = input;
+
+  this->demux_plugin.send_headers      = demux_mpeg_send_headers;
+  this->demux_plugin.send_chunk        = demux_mpeg_send_chunk;
+  this->demux_plugin.seek              = demux_mpeg_seek;
+  this->demux_plugin.dispose           = demux_mpeg_dispose;
+  this->demux_plugin.get_status        = demux_mpeg_get_status;
+  this->demux_plugin.get_stream_length = demux_mpeg_get_stream_length;
+  this->demux_plugin.get_video_frame   = NULL;
+  this->demux_plugin.got_video_frame_cb= NULL;
+  this->demux_plugin.get_capabilities  = demux_mpeg_get_capabilities;
+  this->demux_plugin.get_optional_data = demux_mpeg_get_optional_data;
+  this->demux_plugin.demux_class       = class_gen;
+
+  this->status = DEMUX_FINISHED;
+
+  switch (stream->content_detection_method) {
+
+  case METHOD_BY_CONTENT:
+  case METHOD_EXPLICIT:
+
+    if (!open_mpeg_file(this)) {
+      demux_mpeg_dispose (&this->demux_plugin);
+      return NULL;
+    }
+
+  break;
+
+  case METHOD_BY_EXTENSION: {
+    char *ending, *mrl;
+
+    mrl = input->get_mrl (input);
+
+    ending = strrchr(mrl, '.');
+
+    if (!ending) {
+      free (this);
+      return NULL;
+    }
+
+    if (strncasecmp (ending, ".mpg", 4) &&
+        strncasecmp (ending, ".mpeg", 5) &&
+        strncasecmp (ending, ".m1v", 4) &&
+        strncasecmp (ending, ".mpv", 4)) {
+      free (this);
+      return NULL;
+    }
+
+    if (!open_mpeg_file(this)) {
+      demux_mpeg_dispose (&this->demux_plugin);
+      return NULL;
+    }
+
+  }
+
+  break;
+
+  default:
+    free (this);
+    return NULL;
+  }
+
+  strncpy (this->last_mrl, input->get_mrl (input), 1024);
+
+  return &this->demux_plugin;
+}
+
+static char *get_description (demux_class_t *this_gen) {
+  return "MPEG-1 video demux plugin";
+}
+
+static char *get_identifier (demux_class_t *this_gen) {
+  return "MPEG";
+}
+
+static char *get_extensions (demux_class_t *this_gen) {
+  return "mpg mpeg m1v mpv";
+}
+
+static char *get_mimetypes (demux_class_t *this_gen) {
+  return NULL;
+}
+
+static void class_dispose (demux_class_t *this_gen) {
+
+  demux_mpeg_class_t *this = (demux_mpeg_class_t *) this_gen;
+
+  free (this);
+}
+
+void *demux_mpeg_init_plugin (xine_t *xine, void *data) {
+
+  demux_mpeg_class_t     *this;
+
+  this         = xine_xmalloc (sizeof (demux_mpeg_class_t));
+  this->config = xine->config;
+  this->xine   = xine;
+
+  this->demux_class.open_plugin     = open_plugin;
+  this->demux_class.get_description = get_description;
+  this->demux_class.get_identifier  = get_identifier;
+  this->demux_class.get_mimetypes   = get_mimetypes;
+  this->demux_class.get_extensions  = get_extensions;
+  this->demux_class.dispose         = class_dispose;
+
+  return this;
+}
@@ -24,10 +24,13 @@
  * functional flow:
  *  create_qt_info
  *  open_qt_file
+ *   moov_stream_open
  *   parse_moov_atom
  *    parse_mvhd_atom
  *    parse_trak_atom
+ *     parse_stsd_atom
  *    build_frame_table
+ *   moov_stream_close
  *  free_qt_info
  *
  * $Id: demux_qt.c,v 1.155 2003/04/07 21:28:33 guenter Exp $
@@ -84,6 +87,17 @@ typedef unsigned int qt_atom;
 #define TKHD_ATOM QT_ATOM('t', 'k', 'h', 'd')
 #define MDHD_ATOM QT_ATOM('m', 'd', 'h', 'd')
 #define ELST_ATOM QT_ATOM('e', 'l', 's', 't')
+#define HDLR_ATOM QT_ATOM('h', 'd', 'l', 'r')
+
+/* containers within a trak */
+#define EDTS_ATOM QT_ATOM('e', 'd', 't', 's')
+#define MDIA_ATOM QT_ATOM('m', 'd', 'i', 'a')
+#define MINF_ATOM QT_ATOM('m', 'i', 'n', 'f')
+#define STBL_ATOM QT_ATOM('s', 't', 'b', 'l')
+
+/* media handler types */
+#define VIDE_HANDLER QT_ATOM('v', 'i', 'd', 'e')
+#define SOUN_HANDLER QT_ATOM('s', 'o', 'u', 'n')
 
 /* atoms in a sample table */
 #define STSD_ATOM QT_ATOM('s', 't', 's', 'd')
@@ -99,15 +113,23 @@ typedef unsigned int qt_atom;
 
 #define IMA4_FOURCC QT_ATOM('i', 'm', 'a', '4')
 #define MP4A_FOURCC QT_ATOM('m', 'p', '4', 'a')
-#define TWOS_FOURCC QT_ATOM('t', 'w', 'o', 's')
-#define SOWT_FOURCC QT_ATOM('s', 'o', 'w', 't')
-#define RAW_FOURCC  QT_ATOM('r', 'a', 'w', ' ')
+/* the PCM fourccs are compared with codec_fourcc, which is read in
+ * machine order (ME_32), so they are built in machine order too */
+#ifdef WORDS_BIGENDIAN
+#define ME_FOURCC( ch0, ch1, ch2, ch3 ) QT_ATOM(ch0, ch1, ch2, ch3)
+#else
+#define ME_FOURCC( ch0, ch1, ch2, ch3 ) QT_ATOM(ch3, ch2, ch1, ch0)
+#endif
+#define TWOS_FOURCC ME_FOURCC('t', 'w', 'o', 's')
+#define SOWT_FOURCC ME_FOURCC('s', 'o', 'w', 't')
+#define RAW_FOURCC  ME_FOURCC('r', 'a', 'w', ' ')
 
 #define UDTA_ATOM QT_ATOM('u', 'd', 't', 'a')
 #define CPY_ATOM QT_ATOM(0xA9, 'c', 'p', 'y')
 #define DES_ATOM QT_ATOM(0xA9, 'd', 'e', 's')
 #define CMT_ATOM QT_ATOM(0xA9, 'c', 'm', 't')
 
+#define RMRA_ATOM QT_ATOM('r', 'm', 'r', 'a')
 #define RMDA_ATOM QT_ATOM('r', 'm', 'd', 'a')
 #define RDRF_ATOM QT_ATOM('r', 'd', 'r', 'f')
 #define RMDR_ATOM QT_ATOM('r', 'm', 'd', 'r')
@@ -122,6 +144,27 @@ typedef unsigned int qt_atom;
 
 #define MAX_PTS_DIFF 100000
 
+/* Frames are read ahead into a stage buffer of QT_STAGE_BYTES, up to
+ * QT_STAGE_FRAMES per trak and QT_STAGE_PTS_WINDOW past the earliest
+ * pending frame, in file offset order; see qt_stage_frames(). */
+#define QT_STAGE_BYTES (256 * 1024)
+#define QT_STAGE_FRAMES 64
+#define QT_STAGE_PTS_WINDOW MAX_PTS_DIFF
+#define QT_STAGE_VIDEO 0
+#define QT_STAGE_AUDIO 1
+#define QT_NOT_STAGED 0xFFFFFFFF
+
+/* number of frame table entries generated at a time */
+#define QT_FRAME_WINDOW 64
+
+/* the moov atom is parsed through a window of this many bytes; atoms that
+ * are loaded whole (stsd, udta, rmra) may be at most QT_MAX_LOADED_ATOM */
+#define QT_MOOV_WINDOW 8192
+#define QT_MAX_LOADED_ATOM (256 * 1024)
+
+/* bytes in front of the zlib data of a compressed moov */
+#define CMOV_HEADER_SIZE 0x28
+
 /* network bandwidth, cribbed from src/input/input_mms.c */
 const int64_t bandwidths[]={14400,19200,28800,33600,34430,57600,
                             115200,262200,393216,524300,1544000,10485800};
@@ -177,6 +220,43 @@ typedef struct {
   int qtim_version;
 } reference_t;
 
+/* the state needed to generate the frame table from the sample tables,
+ * positioned at frame number 'frame' */
+typedef struct {
+  unsigned int frame;
+
+  /* sample-to-chunk position */
+  unsigned int stsc_index;
+  unsigned int chunk;
+  unsigned int chunk_samples_left;
+  int64_t offset;
+
+  /* time-to-sample position */
+  unsigned int stts_index;
+  unsigned int stts_countdown;
+  int64_t media_time;
+
+  /* sync sample position */
+  unsigned int stss_index;
+
+  /* edit list position */
+  int edit_list_index;
+  unsigned int edit_list_media_time;
+  int64_t edit_list_duration;
+  int64_t edit_list_pts_counter;
+  int64_t frame_duration;
+
+  /* total audio frames in the chunks before this one */
+  unsigned int audio_frame_counter;
+} qt_frame_cursor;
+
+/* a frame that has been looked ahead at for dispatch */
+typedef struct {
+  qt_frame frame;
+  unsigned int stage_offset;  /* where its data is in the stage buffer, or
+                               * QT_NOT_STAGED if it was not read ahead */
+} qt_staged_frame;
+
 typedef union {
 
   struct {
@@ -234,10 +314,17 @@ typedef struct {
   /* this is the current properties atom in use */
   properties_t *properties;
 
-  /* internal frame table corresponding to this trak */
+  /* internal frame table corresponding to this trak; only a window of
+   * QT_FRAME_WINDOW frames exists at a time, generated from the sample
+   * tables starting at one of the checkpoints */
   qt_frame *frames;
   unsigned int frame_count;
   unsigned int current_frame;
+  unsigned int window_first;
+  unsigned int window_count;
+  qt_frame_cursor *checkpoints;
+  unsigned int checkpoint_count;
+  unsigned int global_timescale;
 
   /* trak timescale */
   unsigned int timescale;
@@ -253,8 +340,8 @@ typedef struct {
   int             stsd_size;
   unsigned char  *stsd;
 
-  /****************************************/
-  /* temporary tables for loading a chunk */
+  /*******************************************************/
+  /* sample tables; the frame table is generated from them */
 
   /* edit list table */
   unsigned int edit_list_count;
@@ -283,6 +370,26 @@ typedef struct {
 
 } qt_trak;
 
+/* the moov atom as it streams in, decompressed if needed */
+typedef struct {
+  input_plugin_t *input;
+  int seekable;
+  int64_t input_left;  /* bytes of the atom not yet read from the input */
+  int64_t pos;  /* bytes of the (uncompressed) moov handed out so far */
+
+  unsigned char *window;
+  unsigned int window_pos;
+  unsigned int window_size;
+
+  /* for a compressed moov */
+  int compressed;
+  int z_done;
+  z_stream z_state;
+  unsigned char *z_buffer;
+
+  qt_error error;
+} qt_moov_stream;
+
 typedef struct {
   int compressed_header;  /* 1 if there was a compressed moov; just FYI */
 
@@ -341,6 +448,24 @@ typedef struct {
 
   int64_t              bandwidth;
 
+  /* dispatch staging; frames current_frame .. stage_end - 1 of each trak
+   * have been looked ahead at and sit in the staged rings */
+  unsigned char       *stage;
+  unsigned int         stage_used;
+  unsigned int         stage_end[2];
+  qt_staged_frame      staged[2][QT_STAGE_FRAMES];
+  off_t                input_pos;  /* where the input is, -1 if unknown */
+
+  /* the input holds the file in memory (INPUT_CAP_ZERO_COPY): nothing is
+   * staged, and frames are handed over in place */
+  int                  zero_copy;
+
+  /* I/O statistics */
+  unsigned int         read_count;
+  unsigned int         seek_count;
+  unsigned int         staged_count;
+  off_t                bytes_read;
+
   char                 last_mrl[1024];
 } demux_qt_t;
 
@@ -378,6 +503,10 @@ typedef struct {
  * demuxer is sending off to the audio decoder */
 #define DEBUG_AUDIO_DEMUX 0
 
+/* define DEBUG_DISPATCH_STATS as 1 to report how many reads and seeks it
+ * took to dispatch the file */
+#define DEBUG_DISPATCH_STATS 0
+
 /* Define DEBUG_DUMP_MOOV as 1 to dump the raw moov atom to disk. This is
  * particularly useful in debugging a file with a compressed moov (cmov)
  * atom. The atom will be dumped to the filename specified as 
@@ -415,6 +544,12 @@ static inline void debug_video_demux(const char *format, ...) { }
 static inline void debug_audio_demux(const char *format, ...) { }
 #endif
 
+#if DEBUG_DISPATCH_STATS
+#define debug_dispatch_stats printf
+#else
+static inline void debug_dispatch_stats(const char *format, ...) { }
+#endif
+
 static void hexdump (char *buf, int length) {
 
   int i;
@@ -446,18 +581,21 @@ static void hexdump (char *buf, int length) {
   printf ("\n");
 }
 
-static inline void dump_moov_atom(unsigned char *moov_atom, int moov_atom_size) {
+/* the moov atom is dumped in pieces as it streams in; append is 0 for the
+ * first piece */
+static inline void dump_moov_atom(unsigned char *moov_atom, int moov_atom_size,
+                                  int append) {
 #if DEBUG_DUMP_MOOV
 
   FILE *f;
 
-  f = fopen(RAW_MOOV_FILENAME, "w");
+  f = fopen(RAW_MOOV_FILENAME, (append) ? "a" : "w");
   if (!f) {
     perror(RAW_MOOV_FILENAME);
     return;
   }
 
-  if (fwrite(moov_atom, moov_atom_size, 1, f) != 1)
+  if (moov_atom_size && (fwrite(moov_atom, moov_atom_size, 1, f) != 1))
     printf ("  qt debug: could not write moov atom to disk\n");
 
   fclose(f);
@@ -478,6 +616,20 @@ static inline void dump_moov_atom(unsigned char *moov_atom, int moov_atom_size)
  * Note: Do not count on the input stream being positioned anywhere in
  * particular when this function is finished.
  */
+/* returns 1 if the atom is one of the QT atoms that may appear at the top
+ * level of a file besides the moov atom */
+static int is_top_level_atom(qt_atom atom) {
+
+  return ((atom == FREE_ATOM) ||
+          (atom == JUNK_ATOM) ||
+          (atom == MDAT_ATOM) ||
+          (atom == PNOT_ATOM) ||
+          (atom == SKIP_ATOM) ||
+          (atom == WIDE_ATOM) ||
+          (atom == PICT_ATOM) ||
+          (atom == FTYP_ATOM));
+}
+
 static void find_moov_atom(input_plugin_t *input, off_t *moov_offset,
   int64_t *moov_size) {
 
@@ -532,14 +684,7 @@ static void find_moov_atom(input_plugin_t *input, off_t *moov_offset,
 
     /* if this atom is not the moov atom, make sure that it is at least one
      * of the other top-level QT atom */
-    if ((atom != FREE_ATOM) &&
-        (atom != JUNK_ATOM) &&
-        (atom != MDAT_ATOM) &&
-        (atom != PNOT_ATOM) &&
-        (atom != SKIP_ATOM) &&
-        (atom != WIDE_ATOM) &&
-        (atom != PICT_ATOM) &&
-        (atom != FTYP_ATOM))
+    if (!is_top_level_atom(atom))
       break;
 
     /* 64-bit length special case */
@@ -599,6 +744,49 @@ qt_info *create_qt_info(void) {
   return info;
 }
 
+/* release everything a trak has loaded and reset it to an empty trak */
+static void free_trak_tables(qt_trak *trak) {
+
+  free(trak->frames);
+  free(trak->checkpoints);
+  free(trak->edit_list_table);
+  free(trak->chunk_offset_table);
+  /* this pointer might have been set to -1 as a special case */
+  if (trak->sample_size_table != (void *)-1)
+    free(trak->sample_size_table);
+  free(trak->sync_sample_table);
+  free(trak->sample_to_chunk_table);
+  free(trak->time_to_sample_table);
+  free(trak->decoder_config);
+  free(trak->stsd);
+  free(trak->stsd_atoms);
+
+  trak->frames = NULL;
+  trak->frame_count = 0;
+  trak->window_count = 0;
+  trak->checkpoints = NULL;
+  trak->checkpoint_count = 0;
+  trak->edit_list_count = 0;
+  trak->edit_list_table = NULL;
+  trak->chunk_offset_count = 0;
+  trak->chunk_offset_table = NULL;
+  trak->sample_size_count = 0;
+  trak->sample_size_table = NULL;
+  trak->sync_sample_count = 0;
+  trak->sync_sample_table = NULL;
+  trak->sample_to_chunk_count = 0;
+  trak->sample_to_chunk_table = NULL;
+  trak->time_to_sample_count = 0;
+  trak->time_to_sample_table = NULL;
+  trak->decoder_config = NULL;
+  trak->decoder_config_len = 0;
+  trak->stsd = NULL;
+  trak->stsd_size = 0;
+  trak->stsd_atoms = NULL;
+  trak->stsd_atoms_count = 0;
+  trak->properties = NULL;
+}
+
 /* release a qt_info structure and associated data */
 void free_qt_info(qt_info *info) {
 
@@ -606,19 +794,8 @@ void free_qt_info(qt_info *info) {
 
   if(info) {
     if(info->traks) {
-      for (i = 0; i < info->trak_count; i++) {
-        free(info->traks[i].frames);
-        free(info->traks[i].edit_list_table);
-        free(info->traks[i].chunk_offset_table);
-        /* this pointer might have been set to -1 as a special case */
-        if (info->traks[i].sample_size_table != (void *)-1)
-          free(info->traks[i].sample_size_table);
-        free(info->traks[i].sync_sample_table);
-        free(info->traks[i].sample_to_chunk_table);
-        free(info->traks[i].time_to_sample_table);
-        free(info->traks[i].decoder_config);
-        free(info->traks[i].stsd);
-      }
+      for (i = 0; i < info->trak_count; i++)
+        free_trak_tables(&info->traks[i]);
       free(info->traks);
     }
     if(info->references) {
@@ -642,18 +819,22 @@ static int is_qt_file(input_plugin_t *qt_file) {
   int64_t moov_atom_size = -1;
   int i;
   unsigned char atom_preamble[ATOM_PREAMBLE_SIZE];
-  unsigned char preview[MAX_PREVIEW_SIZE];
-  int len;
+  qt_atom atom;
+
+  /* the first atom must be one that find_moov_atom() would accept; check
+   * that before going through the file */
+  if (xine_demux_read_header(qt_file, atom_preamble, ATOM_PREAMBLE_SIZE) !=
+    ATOM_PREAMBLE_SIZE)
+    return 0;
+  atom = BE_32(&atom_preamble[4]);
 
   /* if the input is non-seekable, be much more stringent about qualifying
    * a QT file: In this case, the moov must be the first atom in the file */
-  if ((qt_file->get_capabilities(qt_file) & INPUT_CAP_SEEKABLE) == 0) {
-    len = qt_file->get_optional_data(qt_file, preview, INPUT_OPTIONAL_DATA_PREVIEW);
-    if (BE_32(&preview[4]) == MOOV_ATOM)
-      return 1;
-    else
-      return 0;
-  }
+  if ((qt_file->get_capabilities(qt_file) & INPUT_CAP_SEEKABLE) == 0)
+    return (atom == MOOV_ATOM);
+
+  if ((atom != MOOV_ATOM) && !is_top_level_atom(atom))
+    return 0;
 
   find_moov_atom(qt_file, &moov_atom_offset, &moov_atom_size);
   if (moov_atom_offset == -1) {
@@ -674,13 +855,331 @@ static int is_qt_file(input_plugin_t *qt_file) {
   }
 }
 
-/* fetch interesting information from the movie header atom */
-static void parse_mvhd_atom(qt_info *info, unsigned char *mvhd_atom) {
+/*
+ * The moov atom is never held in memory as a whole. It is pulled through
+ * a QT_MOOV_WINDOW byte window, inflating a compressed (cmov) atom on the
+ * fly, and the parser walks the atom tree sequentially, converting sample
+ * tables entry by entry as they pass through the window.
+ */
+static qt_error moov_stream_open(qt_moov_stream *s, input_plugin_t *input,
+                                 int64_t moov_atom_size) {
+
+  unsigned int header_size;
+
+  s->input = input;
+  s->seekable = input->get_capabilities(input) & INPUT_CAP_SEEKABLE;
+  s->input_left = moov_atom_size;
+  s->pos = 0;
+  s->window_pos = 0;
+  s->window_size = 0;
+  s->compressed = 0;
+  s->z_done = 0;
+  s->z_buffer = NULL;
+  s->error = QT_OK;
+
+  s->window = (unsigned char *)malloc(QT_MOOV_WINDOW);
+  if (!s->window)
+    return QT_NO_MEMORY;
+
+  /* the fixed size header of a compressed moov: moov/free + cmov + dcom
+   * atom preambles, then the cmvd atom with the uncompressed size */
+  header_size = (moov_atom_size < CMOV_HEADER_SIZE) ?
+    moov_atom_size : CMOV_HEADER_SIZE;
+  if (input->read(input, s->window, header_size) != header_size)
+    return QT_FILE_READ_ERROR;
+  s->input_left -= header_size;
+
+  if ((header_size == CMOV_HEADER_SIZE) &&
+      (BE_32(&s->window[12]) == CMOV_ATOM)) {
+
+    debug_atom_load("  qt: compressed moov, %d bytes uncompressed\n",
+      BE_32(&s->window[0x24]));
+
+    s->compressed = 1;
+    dump_moov_atom(s->window, 0, 0);
+    s->z_buffer = (unsigned char *)malloc(QT_MOOV_WINDOW);
+    if (!s->z_buffer)
+      return QT_NO_MEMORY;
+
+    s->z_state.next_in = s->z_buffer;
+    s->z_state.avail_in = 0;
+    s->z_state.zalloc = (alloc_func)0;
+    s->z_state.zfree = (free_func)0;
+    s->z_state.opaque = (voidpf)0;
+    if (inflateInit(&s->z_state) != Z_OK) {
+      free(s->z_buffer);
+      s->z_buffer = NULL;
+      return QT_ZLIB_ERROR;
+    }
+  } else {
+    /* the header bytes are already the start of a plain moov */
+    s->window_size = header_size;
+    dump_moov_atom(s->window, header_size, 0);
+  }
+
+  return QT_OK;
+}
+
+static void moov_stream_close(qt_moov_stream *s) {
+
+  if (s->z_buffer)
+    inflateEnd(&s->z_state);
+  free(s->z_buffer);
+  free(s->window);
+  s->z_buffer = NULL;
+  s->window = NULL;
+}
+
+/* make at least n (<= QT_MOOV_WINDOW) unread bytes available in the window;
+ * returns 0 if the moov ends first or on error */
+static int moov_stream_fill(qt_moov_stream *s, unsigned int n) {
+
+  unsigned int have = s->window_size - s->window_pos;
+  unsigned int want;
+  int z_ret_code;
+
+  if (have >= n)
+    return 1;
+  if (s->error != QT_OK)
+    return 0;
+
+  /* slide the unread bytes down to the start of the window */
+  memmove(s->window, &s->window[s->window_pos], have);
+  s->window_pos = 0;
+  s->window_size = have;
+
+  while (s->window_size < n) {
+
+    if (!s->compressed) {
+
+      want = QT_MOOV_WINDOW - s->window_size;
+      if (want > s->input_left)
+        want = s->input_left;
+      if (!want)
+        return 0;
+      if (s->input->read(s->input, &s->window[s->window_size], want) != want) {
+        s->error = QT_FILE_READ_ERROR;
+        return 0;
+      }
+      dump_moov_atom(&s->window[s->window_size], want, 1);
+      s->window_size += want;
+      s->input_left -= want;
+
+    } else {
+
+      if (s->z_done)
+        return 0;
+
+      /* feed the inflater another slice of the compressed atom */
+      if (!s->z_state.avail_in) {
+        want = QT_MOOV_WINDOW;
+        if (want > s->input_left)
+          want = s->input_left;
+        if (!want) {
+          s->error = QT_ZLIB_ERROR;
+          return 0;
+        }
+        if (s->input->read(s->input, s->z_buffer, want) != want) {
+          s->error = QT_FILE_READ_ERROR;
+          return 0;
+        }
+        s->input_left -= want;
+        s->z_state.next_in = s->z_buffer;
+        s->z_state.avail_in = want;
+      }
+
+      want = QT_MOOV_WINDOW - s->window_size;
+      s->z_state.next_out = &s->window[s->window_size];
+      s->z_state.avail_out = want;
+      z_ret_code = inflate(&s->z_state, Z_NO_FLUSH);
+      if (z_ret_code == Z_STREAM_END)
+        s->z_done = 1;
+      else if (z_ret_code != Z_OK) {
+        s->error = QT_ZLIB_ERROR;
+        return 0;
+      }
+      want -= s->z_state.avail_out;
+      dump_moov_atom(&s->window[s->window_size], want, 1);
+      s->window_size += want;
+    }
+  }
+
+  return 1;
+}
+
+/* returns a pointer to the next n (<= QT_MOOV_WINDOW) bytes of the moov,
+ * valid until the next stream call, or NULL if they are not there */
+static unsigned char *moov_stream_get(qt_moov_stream *s, unsigned int n) {
+
+  unsigned char *p;
+
+  if (!moov_stream_fill(s, n))
+    return NULL;
 
-  info->creation_time = BE_32(&mvhd_atom[0x0C]);
-  info->modification_time = BE_32(&mvhd_atom[0x10]);
-  info->timescale = BE_32(&mvhd_atom[0x14]);
-  info->duration = BE_32(&mvhd_atom[0x18]);
+  p = &s->window[s->window_pos];
+  s->window_pos += n;
+  s->pos += n;
+
+  return p;
+}
+
+static int moov_stream_read(qt_moov_stream *s, unsigned char *dest,
+                            int64_t n) {
+
+  unsigned int chunk;
+  unsigned char *p;
+
+  while (n > 0) {
+    chunk = (n > QT_MOOV_WINDOW) ? QT_MOOV_WINDOW : n;
+    p = moov_stream_get(s, chunk);
+    if (!p)
+      return 0;
+    memcpy(dest, p, chunk);
+    dest += chunk;
+    n -= chunk;
+  }
+
+  return 1;
+}
+
+static int moov_stream_skip(qt_moov_stream *s, int64_t n) {
+
+  unsigned int have = s->window_size - s->window_pos;
+  unsigned int chunk;
+
+  if (n <= have) {
+    s->window_pos += n;
+    s->pos += n;
+    return 1;
+  }
+
+  s->window_pos = s->window_size;
+  s->pos += have;
+  n -= have;
+
+  /* plain atoms on a seekable input can be stepped over without reading */
+  if (!s->compressed && s->seekable && !DEBUG_DUMP_MOOV) {
+    if (n > s->input_left)
+      return 0;
+    if (s->input->seek(s->input, n, SEEK_CUR) < 0) {
+      s->error = QT_FILE_READ_ERROR;
+      return 0;
+    }
+    s->input_left -= n;
+    s->pos += n;
+    return 1;
+  }
+
+  while (n > 0) {
+    chunk = (n > QT_MOOV_WINDOW) ? QT_MOOV_WINDOW : n;
+    if (!moov_stream_get(s, chunk))
+      return 0;
+    n -= chunk;
+  }
+
+  return 1;
+}
+
+/*
+ * Read the preamble of the next child of a container atom that has *left
+ * bytes remaining. On success, *atom and *atom_size hold the child's type
+ * and payload size, and *left no longer counts the child. Returns 0 when
+ * there are no more well-formed children.
+ */
+static int next_child_atom(qt_moov_stream *s, int64_t *left,
+                           qt_atom *atom, int64_t *atom_size) {
+
+  unsigned char *p;
+  int64_t size;
+  int preamble_size = ATOM_PREAMBLE_SIZE;
+
+  if (*left < ATOM_PREAMBLE_SIZE)
+    return 0;
+  p = moov_stream_get(s, ATOM_PREAMBLE_SIZE);
+  if (!p)
+    return 0;
+  *left -= ATOM_PREAMBLE_SIZE;
+
+  size = BE_32(&p[0]);
+  *atom = BE_32(&p[4]);
+
+  if (size == 1) {
+    /* 64-bit length special case */
+    if (*left < ATOM_PREAMBLE_SIZE)
+      return 0;
+    p = moov_stream_get(s, ATOM_PREAMBLE_SIZE);
+    if (!p)
+      return 0;
+    *left -= ATOM_PREAMBLE_SIZE;
+    preamble_size += ATOM_PREAMBLE_SIZE;
+    size = BE_32(&p[0]);
+    size <<= 32;
+    size |= BE_32(&p[4]);
+  } else if (size == 0) {
+    /* the atom extends to the end of its container */
+    size = *left + preamble_size;
+  }
+
+  /* a runt atom terminates the container (udta atoms often end with a
+   * 32-bit 0); an oversized one is clipped to the container */
+  if (size < preamble_size)
+    return 0;
+  size -= preamble_size;
+  if (size > *left)
+    size = *left;
+
+  *atom_size = size;
+  *left -= size;
+
+  return 1;
+}
+
+/* load a small atom whole, preamble included; returns NULL if it is too
+ * large to be worth loading or on error */
+static unsigned char *load_atom(qt_moov_stream *s, qt_atom atom,
+                                int64_t atom_size) {
+
+  unsigned char *buf;
+
+  if (atom_size > QT_MAX_LOADED_ATOM - ATOM_PREAMBLE_SIZE) {
+    debug_atom_load("  qt: %c%c%c%c atom is %lld bytes, skipping\n",
+      atom >> 24, atom >> 16, atom >> 8, atom, atom_size);
+    moov_stream_skip(s, atom_size);
+    return NULL;
+  }
+
+  buf = (unsigned char *)malloc(atom_size + ATOM_PREAMBLE_SIZE);
+  if (!buf) {
+    s->error = QT_NO_MEMORY;
+    return NULL;
+  }
+
+  buf[0] = (atom_size + ATOM_PREAMBLE_SIZE) >> 24;
+  buf[1] = (atom_size + ATOM_PREAMBLE_SIZE) >> 16;
+  buf[2] = (atom_size + ATOM_PREAMBLE_SIZE) >> 8;
+  buf[3] = (atom_size + ATOM_PREAMBLE_SIZE) >> 0;
+  buf[4] = atom >> 24;
+  buf[5] = atom >> 16;
+  buf[6] = atom >> 8;
+  buf[7] = atom >> 0;
+  if (!moov_stream_read(s, &buf[ATOM_PREAMBLE_SIZE], atom_size)) {
+    if (s->error == QT_OK)
+      s->error = QT_HEADER_TROUBLE;
+    free(buf);
+    return NULL;
+  }
+
+  return buf;
+}
+
+/* fetch interesting information from the movie header atom; mvhd points
+ * just past the preamble */
+static void parse_mvhd_atom(qt_info *info, unsigned char *mvhd) {
+
+  info->creation_time = BE_32(&mvhd[0x04]);
+  info->modification_time = BE_32(&mvhd[0x08]);
+  info->timescale = BE_32(&mvhd[0x0C]);
+  info->duration = BE_32(&mvhd[0x10]);
 
   debug_atom_load("  qt: timescale = %d, duration = %d (%d seconds)\n",
     info->timescale, info->duration,
@@ -691,7 +1190,7 @@ static void parse_mvhd_atom(qt_info *info, unsigned char *mvhd_atom) {
 static int mp4_read_descr_len(unsigned char *s, uint32_t *length) {
   uint8_t b;
   uint8_t numBytes = 0;
-  
+
   *length = 0;
 
   do {
@@ -704,20 +1203,16 @@ static int mp4_read_descr_len(unsigned char *s, uint32_t *length) {
 }
 
 /*
- * This function traverses through a trak atom searching for the sample
- * table atoms, which it loads into an internal trak structure.
+ * This function decodes the properties atoms in the trak's copy of the
+ * stsd atom. The copy starts at the 'stsd' type field.
  */
-static qt_error parse_trak_atom (qt_trak *trak,
-				 unsigned char *trak_atom) {
+static qt_error parse_stsd_atom(qt_trak *trak) {
 
+  unsigned char *stsd = trak->stsd;
   int i, j, k;
-  unsigned int trak_atom_size = BE_32(&trak_atom[0]);
-  qt_atom current_atom;
-  unsigned int current_atom_size;
   unsigned int atom_pos;
   unsigned int properties_offset;
   unsigned int current_stsd_atom_size;
-  qt_error last_error = QT_OK;
 
   /* for palette traversal */
   int color_depth;
@@ -730,622 +1225,692 @@ static qt_error parse_trak_atom (qt_trak *trak,
   int color_greyscale;
   unsigned char *color_table;
 
-  /* initialize trak structure */
-  trak->edit_list_count = 0;
-  trak->edit_list_table = NULL;
-  trak->chunk_offset_count = 0;
-  trak->chunk_offset_table = NULL;
-  trak->sample_size = 0;
-  trak->sample_size_count = 0;
-  trak->sample_size_table = NULL;
-  trak->sync_sample_table = 0;
-  trak->sync_sample_table = NULL;
-  trak->sample_to_chunk_count = 0;
-  trak->sample_to_chunk_table = NULL;
-  trak->time_to_sample_count = 0;
-  trak->time_to_sample_table = NULL;
-  trak->frames = NULL;
-  trak->frame_count = 0;
-  trak->current_frame = 0;
-  trak->timescale = 0;
-  trak->flags = 0;
-  trak->decoder_config = NULL;
-  trak->decoder_config_len = 0;
-  trak->stsd = NULL;
-  trak->stsd_size = 0;
-  trak->stsd_atoms_count = 0;
-  trak->stsd_atoms = NULL;
+  debug_atom_load ("demux_qt: stsd atom\n");
+#if DEBUG_ATOM_LOAD
+  hexdump (stsd, trak->stsd_size);
+#endif
 
-  /* default type */
-  trak->type = MEDIA_OTHER;
+  /* allocate space for each of the properties unions */
+  trak->stsd_atoms_count = BE_32(&stsd[8]);
+  if (trak->stsd_atoms_count > trak->stsd_size / 0x10)
+    return QT_HEADER_TROUBLE;
+  trak->stsd_atoms = xine_xmalloc(trak->stsd_atoms_count * sizeof(properties_t));
+  if (!trak->stsd_atoms)
+    return QT_NO_MEMORY;
+  memset(trak->stsd_atoms, 0, trak->stsd_atoms_count * sizeof(properties_t));
+
+  atom_pos = 0x10;
+  properties_offset = 0x0C;
+  for (k = 0; k < trak->stsd_atoms_count; k++) {
+
+    /* the whole properties atom has to be in the copy */
+    current_stsd_atom_size = BE_32(&stsd[atom_pos - 4]);
+    if ((current_stsd_atom_size < 0x10) ||
+        (atom_pos - 4 + current_stsd_atom_size > trak->stsd_size))
+      break;
 
-  /* search for media type atoms */
-  for (i = ATOM_PREAMBLE_SIZE; i < trak_atom_size - 4; i++) {
-    current_atom = BE_32(&trak_atom[i]);
+    if (trak->type == MEDIA_VIDEO) {
 
-    if (current_atom == VMHD_ATOM) {
-      trak->type = MEDIA_VIDEO;
-      break;
-    } else if (current_atom == SMHD_ATOM) {
-      trak->type = MEDIA_AUDIO;
-      break;
-    }
-  }
-  
-  debug_atom_load("  qt: parsing %s trak atom\n",
-    (trak->type == MEDIA_VIDEO) ? "video" :
-      (trak->type == MEDIA_AUDIO) ? "audio" : "other");
+      trak->stsd_atoms[k].video.media_id = k + 1;
+      trak->stsd_atoms[k].video.properties_offset = properties_offset;
 
-  /* search for the useful atoms */
-  for (i = ATOM_PREAMBLE_SIZE; i < trak_atom_size - 4; i++) {
-    current_atom_size = BE_32(&trak_atom[i - 4]);	
-    current_atom = BE_32(&trak_atom[i]);
-
-    if (current_atom == TKHD_ATOM) {
-      trak->flags = BE_16(&trak_atom[i + 6]);
-#if 0
-      if (trak->type == MEDIA_VIDEO) {
-        /* fetch display parameters */
-        if( !trak->stsd_atoms[j].video.width ||
-            !trak->stsd_atoms[j].video.height ) {
-
-          trak->stsd_atoms[j].video.width =
-            BE_16(&trak_atom[i + 0x50]);
-          trak->stsd_atoms[j].video.height =
-            BE_16(&trak_atom[i + 0x54]); 
-        }
-      }
-#endif
-    } else if (current_atom == ELST_ATOM) {
+      /* initialize to sane values */
+      trak->stsd_atoms[k].video.width = 0;
+      trak->stsd_atoms[k].video.height = 0;
+      trak->stsd_atoms[k].video.depth = 0;
 
-      /* there should only be one edit list table */
-      if (trak->edit_list_table) {
-        last_error = QT_HEADER_TROUBLE;
-        goto free_trak;
+      /* assume no palette at first */
+      trak->stsd_atoms[k].video.palette_count = 0;
+
+      /* fetch video parameters */
+      if( BE_16(&stsd[atom_pos + 0x1C]) && 
+          BE_16(&stsd[atom_pos + 0x1E]) ) {
+        trak->stsd_atoms[k].video.width =
+          BE_16(&stsd[atom_pos + 0x1C]);
+        trak->stsd_atoms[k].video.height =
+          BE_16(&stsd[atom_pos + 0x1E]);
       }
+      trak->stsd_atoms[k].video.codec_fourcc =
+        ME_32(&stsd[atom_pos + 0x00]);
+
+      /* figure out the palette situation */
+      color_depth = stsd[atom_pos + 0x4F];
+      trak->stsd_atoms[k].video.depth = color_depth;
+      color_greyscale = color_depth & 0x20;
+      color_depth &= 0x1F;
+
+      /* if the depth is 2, 4, or 8 bpp, file is palettized */
+      if ((color_depth == 2) || (color_depth == 4) || (color_depth == 8)) {
+
+        color_flag = BE_16(&stsd[atom_pos + 0x50]);
+
+        if (color_greyscale) {
+
+          trak->stsd_atoms[k].video.palette_count =
+            1 << color_depth;
+
+          /* compute the greyscale palette */
+          color_index = 255;
+          color_dec = 256 / 
+            (trak->stsd_atoms[k].video.palette_count - 1);
+          for (j = 0; 
+               j < trak->stsd_atoms[k].video.palette_count;
+               j++) {
+
+            trak->stsd_atoms[k].video.palette[j].r = color_index;
+            trak->stsd_atoms[k].video.palette[j].g = color_index;
+            trak->stsd_atoms[k].video.palette[j].b = color_index;
+            color_index -= color_dec;
+            if (color_index < 0)
+              color_index = 0;
+          }
 
-      trak->edit_list_count = BE_32(&trak_atom[i + 8]);
+        } else if (color_flag & 0x08) {
 
-      debug_atom_load("    qt elst atom (edit list atom): %d entries\n",
-        trak->edit_list_count);
+          /* if flag bit 3 is set, load the default palette */
+          trak->stsd_atoms[k].video.palette_count =
+            1 << color_depth;
 
-      trak->edit_list_table = (edit_list_table_t *)xine_xmalloc(
-        trak->edit_list_count * sizeof(edit_list_table_t));
-      if (!trak->edit_list_table) {
-        last_error = QT_NO_MEMORY;
-        goto free_trak;
-      }
+          if (color_depth == 2)
+            color_table = qt_default_palette_4;
+          else if (color_depth == 4)
+            color_table = qt_default_palette_16;
+          else
+            color_table = qt_default_palette_256;
+
+          for (j = 0; 
+            j < trak->stsd_atoms[k].video.palette_count;
+            j++) {
 
-      /* load the edit list table */
-      for (j = 0; j < trak->edit_list_count; j++) {
-        trak->edit_list_table[j].track_duration =
-          BE_32(&trak_atom[i + 12 + j * 12 + 0]);
-        trak->edit_list_table[j].media_time =
-          BE_32(&trak_atom[i + 12 + j * 12 + 4]);
-        debug_atom_load("      %d: track duration = %d, media time = %d\n",
+            trak->stsd_atoms[k].video.palette[j].r =
+              color_table[j * 4 + 0];
+            trak->stsd_atoms[k].video.palette[j].g =
+              color_table[j * 4 + 1];
+            trak->stsd_atoms[k].video.palette[j].b =
+              color_table[j * 4 + 2];
+
+          }
+
+        } else {
+
+          /* load the palette from the file */
+          color_start = BE_32(&stsd[atom_pos + 0x52]);
+          color_count = BE_16(&stsd[atom_pos + 0x56]);
+          color_end = BE_16(&stsd[atom_pos + 0x58]);
+          trak->stsd_atoms[k].video.palette_count =
+            color_end + 1;
+
+          for (j = color_start; j <= color_end; j++) {
+
+            color_index = BE_16(&stsd[atom_pos + 0x5A + j * 8]);
+            if (color_count & 0x8000)
+              color_index = j;
+            if (color_index < 
+              trak->stsd_atoms[k].video.palette_count) {
+              trak->stsd_atoms[k].video.palette[color_index].r =
+                stsd[atom_pos + 0x5A + j * 8 + 2];
+              trak->stsd_atoms[k].video.palette[color_index].g =
+                stsd[atom_pos + 0x5A + j * 8 + 4];
+              trak->stsd_atoms[k].video.palette[color_index].b =
+                stsd[atom_pos + 0x5A + j * 8 + 6];
+            }
+          }
+        }
+      } else
+        trak->stsd_atoms[k].video.palette_count = 0;
+
+      debug_atom_load("    video properties atom #%d\n", k + 1);
+      debug_atom_load("      %dx%d, video fourcc = '%c%c%c%c' (%02X%02X%02X%02X)\n",
+        trak->stsd_atoms[k].video.width,
+        trak->stsd_atoms[k].video.height,
+        stsd[atom_pos + 0x0],
+        stsd[atom_pos + 0x1],
+        stsd[atom_pos + 0x2],
+        stsd[atom_pos + 0x3],
+        stsd[atom_pos + 0x0],
+        stsd[atom_pos + 0x1],
+        stsd[atom_pos + 0x2],
+        stsd[atom_pos + 0x3]);
+      debug_atom_load("      %d RGB colors\n",
+        trak->stsd_atoms[k].video.palette_count);
+      for (j = 0; j < trak->stsd_atoms[k].video.palette_count;
+           j++)
+        debug_atom_load("        %d: %3d %3d %3d\n",
           j,
-          trak->edit_list_table[j].track_duration,
-          trak->edit_list_table[j].media_time);
+          trak->stsd_atoms[k].video.palette[j].r,
+          trak->stsd_atoms[k].video.palette[j].g,
+          trak->stsd_atoms[k].video.palette[j].b);
+
+    } else if (trak->type == MEDIA_AUDIO) {
+
+      trak->stsd_atoms[k].audio.media_id = k + 1;
+      trak->stsd_atoms[k].audio.properties_offset = properties_offset;
+
+      /* fetch audio parameters */
+      trak->stsd_atoms[k].audio.codec_fourcc =
+        ME_32(&stsd[atom_pos + 0x0]);
+      trak->stsd_atoms[k].audio.sample_rate =
+        BE_16(&stsd[atom_pos + 0x1C]);
+      trak->stsd_atoms[k].audio.channels = stsd[atom_pos + 0x15];
+      trak->stsd_atoms[k].audio.bits = stsd[atom_pos + 0x17];
+
+      /* assume uncompressed audio parameters */
+      trak->stsd_atoms[k].audio.bytes_per_sample =
+        trak->stsd_atoms[k].audio.bits / 8;
+      trak->stsd_atoms[k].audio.samples_per_frame =
+        trak->stsd_atoms[k].audio.channels;
+      trak->stsd_atoms[k].audio.bytes_per_frame = 
+        trak->stsd_atoms[k].audio.bytes_per_sample * 
+        trak->stsd_atoms[k].audio.samples_per_frame;
+      trak->stsd_atoms[k].audio.samples_per_packet = 
+        trak->stsd_atoms[k].audio.samples_per_frame;
+      trak->stsd_atoms[k].audio.bytes_per_packet = 
+        trak->stsd_atoms[k].audio.bytes_per_sample;
+
+      /* special case time: some ima4-encoded files don't have the
+       * extra header; compensate */
+      if (BE_32(&stsd[atom_pos + 0x0]) == IMA4_FOURCC) {
+        trak->stsd_atoms[k].audio.samples_per_packet = 64;
+        trak->stsd_atoms[k].audio.bytes_per_packet = 34;
+        trak->stsd_atoms[k].audio.bytes_per_frame = 34 * 
+          trak->stsd_atoms[k].audio.channels;
+        trak->stsd_atoms[k].audio.bytes_per_sample = 2;
+        trak->stsd_atoms[k].audio.samples_per_frame = 64 *
+          trak->stsd_atoms[k].audio.channels;
       }
 
-    } else if (current_atom == MDHD_ATOM)
-      trak->timescale = BE_32(&trak_atom[i + 0x10]);
-    else if (current_atom == STSD_ATOM) {
+      /* it's time to dig a little deeper to determine the real audio
+       * properties; if a the stsd compressor atom has 0x24 bytes, it
+       * appears to be a handler for uncompressed data; if there are an
+       * extra 0x10 bytes, there are some more useful decoding params;
+       * further, do not do load these parameters if the audio is just
+       * PCM ('raw ', 'twos', or 'sowt') */
+      if ((current_stsd_atom_size > 0x24) &&
+          (trak->stsd_atoms[k].audio.codec_fourcc != TWOS_FOURCC) &&
+          (trak->stsd_atoms[k].audio.codec_fourcc != SOWT_FOURCC) &&
+          (trak->stsd_atoms[k].audio.codec_fourcc != RAW_FOURCC)) {
+
+        if (BE_32(&stsd[atom_pos + 0x20]))
+          trak->stsd_atoms[k].audio.samples_per_packet = 
+            BE_32(&stsd[atom_pos + 0x20]);
+        if (BE_32(&stsd[atom_pos + 0x24]))
+          trak->stsd_atoms[k].audio.bytes_per_packet = 
+            BE_32(&stsd[atom_pos + 0x24]);
+        if (BE_32(&stsd[atom_pos + 0x28]))
+          trak->stsd_atoms[k].audio.bytes_per_frame = 
+            BE_32(&stsd[atom_pos + 0x28]);
+        if (BE_32(&stsd[atom_pos + 0x2C]))
+          trak->stsd_atoms[k].audio.bytes_per_sample = 
+            BE_32(&stsd[atom_pos + 0x2C]);
+        trak->stsd_atoms[k].audio.samples_per_frame =
+          (trak->stsd_atoms[k].audio.bytes_per_frame / 
+           trak->stsd_atoms[k].audio.bytes_per_packet) *
+           trak->stsd_atoms[k].audio.samples_per_packet;
+      }
 
-      debug_atom_load ("demux_qt: stsd atom\n");
-#if DEBUG_ATOM_LOAD
-      hexdump (&trak_atom[i], current_atom_size);
-#endif
+      /* see if the trak deserves a promotion to VBR */
+      if (BE_16(&stsd[atom_pos + 0x18]) == 0xFFFE)
+        trak->stsd_atoms[k].audio.vbr = 1;
+      else
+        trak->stsd_atoms[k].audio.vbr = 0;
+
+      /* if this is MP4 audio, mark the trak as VBR */
+      if (BE_32(&stsd[atom_pos + 0x0]) == MP4A_FOURCC)
+        trak->stsd_atoms[k].audio.vbr = 1;
+
+      /* check for a MS-style WAVE format header */
+      if ((trak->stsd_size >= 0x48) && 
+          (BE_32(&stsd[atom_pos + 0x34]) == WAVE_ATOM)) {
+        trak->stsd_atoms[k].audio.wave_present = 1;
+        memcpy(&trak->stsd_atoms[k].audio.wave, 
+          &stsd[atom_pos + 0x4C],
+          sizeof(trak->stsd_atoms[k].audio.wave));
+        xine_waveformatex_le2me(&trak->stsd_atoms[k].audio.wave);
+      } else {
+        trak->stsd_atoms[k].audio.wave_present = 0;
+      }
 
-      /* copy whole stsd atom so it can later be sent to the decoder */
-      trak->stsd_size = current_atom_size;
-      trak->stsd = xine_xmalloc(current_atom_size);
-      memset (trak->stsd, 0, current_atom_size);
-      memcpy (trak->stsd, &trak_atom[i], current_atom_size);
-
-      /* allocate space for each of the properties unions */
-      trak->stsd_atoms_count = BE_32(&trak_atom[i + 8]);
-      trak->stsd_atoms = xine_xmalloc(trak->stsd_atoms_count * sizeof(properties_t));
-      if (!trak->stsd_atoms) {
-        last_error = QT_NO_MEMORY;
-        goto free_trak;
+      debug_atom_load("    audio properties atom #%d\n", k + 1);
+      debug_atom_load("      %d Hz, %d bits, %d channels, %saudio fourcc = '%c%c%c%c' (%02X%02X%02X%02X)\n",
+        trak->stsd_atoms[k].audio.sample_rate,
+        trak->stsd_atoms[k].audio.bits,
+        trak->stsd_atoms[k].audio.channels,
+        (trak->stsd_atoms[k].audio.vbr) ? "vbr, " : "",
+        stsd[atom_pos + 0x0],
+        stsd[atom_pos + 0x1],
+        stsd[atom_pos + 0x2],
+        stsd[atom_pos + 0x3],
+        stsd[atom_pos + 0x0],
+        stsd[atom_pos + 0x1],
+        stsd[atom_pos + 0x2],
+        stsd[atom_pos + 0x3]);
+      if (current_stsd_atom_size > 0x24) {
+        debug_atom_load("      %d samples/packet, %d bytes/packet, %d bytes/frame\n",
+          trak->stsd_atoms[k].audio.samples_per_packet,
+          trak->stsd_atoms[k].audio.bytes_per_packet,
+          trak->stsd_atoms[k].audio.bytes_per_frame);
+        debug_atom_load("      %d bytes/sample (%d samples/frame)\n",
+          trak->stsd_atoms[k].audio.bytes_per_sample,
+          trak->stsd_atoms[k].audio.samples_per_frame);
       }
-      memset(trak->stsd_atoms, 0, trak->stsd_atoms_count * sizeof(properties_t));
+    }
 
-      atom_pos = i + 0x10;
-      properties_offset = 0x0C;
-      for (k = 0; k < trak->stsd_atoms_count; k++) {
+    /* use first audio properties atom for now */
+    trak->properties = &trak->stsd_atoms[0];
 
-        current_stsd_atom_size = BE_32(&trak_atom[atom_pos - 4]);      
-        if (trak->type == MEDIA_VIDEO) {
+    /* forward to the next atom */
+    atom_pos += current_stsd_atom_size;
+    properties_offset += current_stsd_atom_size;
+  }
 
-          trak->stsd_atoms[k].video.media_id = k + 1;
-          trak->stsd_atoms[k].video.properties_offset = properties_offset;
+  /* look for an esds atom inside the properties atoms */
+  for (i = 0; i < trak->stsd_size - 4; i++) {
 
-          /* initialize to sane values */
-          trak->stsd_atoms[k].video.width = 0;
-          trak->stsd_atoms[k].video.height = 0;
-          trak->stsd_atoms[k].video.depth = 0;
+    uint32_t len;
 
-          /* assume no palette at first */
-          trak->stsd_atoms[k].video.palette_count = 0;
+    if (BE_32(&stsd[i]) != ESDS_ATOM)
+      continue;
 
-          /* fetch video parameters */
-          if( BE_16(&trak_atom[atom_pos + 0x1C]) && 
-              BE_16(&trak_atom[atom_pos + 0x1E]) ) {
-            trak->stsd_atoms[k].video.width =
-              BE_16(&trak_atom[atom_pos + 0x1C]);
-            trak->stsd_atoms[k].video.height =
-              BE_16(&trak_atom[atom_pos + 0x1E]);
-          }
-          trak->stsd_atoms[k].video.codec_fourcc =
-            ME_32(&trak_atom[atom_pos + 0x00]);
-
-          /* figure out the palette situation */
-          color_depth = trak_atom[atom_pos + 0x4F];
-          trak->stsd_atoms[k].video.depth = color_depth;
-          color_greyscale = color_depth & 0x20;
-          color_depth &= 0x1F;
-
-          /* if the depth is 2, 4, or 8 bpp, file is palettized */
-          if ((color_depth == 2) || (color_depth == 4) || (color_depth == 8)) {
-
-            color_flag = BE_16(&trak_atom[atom_pos + 0x50]);
-
-            if (color_greyscale) {
-
-              trak->stsd_atoms[k].video.palette_count =
-                1 << color_depth;
-
-              /* compute the greyscale palette */
-              color_index = 255;
-              color_dec = 256 / 
-                (trak->stsd_atoms[k].video.palette_count - 1);
-              for (j = 0; 
-                   j < trak->stsd_atoms[k].video.palette_count;
-                   j++) {
-
-                trak->stsd_atoms[k].video.palette[j].r = color_index;
-                trak->stsd_atoms[k].video.palette[j].g = color_index;
-                trak->stsd_atoms[k].video.palette[j].b = color_index;
-                color_index -= color_dec;
-                if (color_index < 0)
-                  color_index = 0;
-              }
-
-            } else if (color_flag & 0x08) {
-
-              /* if flag bit 3 is set, load the default palette */
-              trak->stsd_atoms[k].video.palette_count =
-                1 << color_depth;
-
-              if (color_depth == 2)
-                color_table = qt_default_palette_4;
-              else if (color_depth == 4)
-                color_table = qt_default_palette_16;
-              else
-                color_table = qt_default_palette_256;
-
-              for (j = 0; 
-                j < trak->stsd_atoms[k].video.palette_count;
-                j++) {
-
-                trak->stsd_atoms[k].video.palette[j].r =
-                  color_table[j * 4 + 0];
-                trak->stsd_atoms[k].video.palette[j].g =
-                  color_table[j * 4 + 1];
-                trak->stsd_atoms[k].video.palette[j].b =
-                  color_table[j * 4 + 2];
-
-              }
-
-            } else {
-
-              /* load the palette from the file */
-              color_start = BE_32(&trak_atom[atom_pos + 0x52]);
-              color_count = BE_16(&trak_atom[atom_pos + 0x56]);
-              color_end = BE_16(&trak_atom[atom_pos + 0x58]);
-              trak->stsd_atoms[k].video.palette_count =
-                color_end + 1;
-
-              for (j = color_start; j <= color_end; j++) {
-
-                color_index = BE_16(&trak_atom[atom_pos + 0x5A + j * 8]);
-                if (color_count & 0x8000)
-                  color_index = j;
-                if (color_index < 
-                  trak->stsd_atoms[k].video.palette_count) {
-                  trak->stsd_atoms[k].video.palette[color_index].r =
-                    trak_atom[atom_pos + 0x5A + j * 8 + 2];
-                  trak->stsd_atoms[k].video.palette[color_index].g =
-                    trak_atom[atom_pos + 0x5A + j * 8 + 4];
-                  trak->stsd_atoms[k].video.palette[color_index].b =
-                    trak_atom[atom_pos + 0x5A + j * 8 + 6];
-                }
-              }
-            }
-          } else
-            trak->stsd_atoms[k].video.palette_count = 0;
-
-          debug_atom_load("    video properties atom #%d\n", k + 1);
-          debug_atom_load("      %dx%d, video fourcc = '%c%c%c%c' (%02X%02X%02X%02X)\n",
-            trak->stsd_atoms[k].video.width,
-            trak->stsd_atoms[k].video.height,
-            trak_atom[atom_pos + 0x0],
-            trak_atom[atom_pos + 0x1],
-            trak_atom[atom_pos + 0x2],
-            trak_atom[atom_pos + 0x3],
-            trak_atom[atom_pos + 0x0],
-            trak_atom[atom_pos + 0x1],
-            trak_atom[atom_pos + 0x2],
-            trak_atom[atom_pos + 0x3]);
-          debug_atom_load("      %d RGB colors\n",
-            trak->stsd_atoms[k].video.palette_count);
-          for (j = 0; j < trak->stsd_atoms[k].video.palette_count;
-               j++)
-            debug_atom_load("        %d: %3d %3d %3d\n",
-              j,
-              trak->stsd_atoms[k].video.palette[j].r,
-              trak->stsd_atoms[k].video.palette[j].g,
-              trak->stsd_atoms[k].video.palette[j].b);
-
-        } else if (trak->type == MEDIA_AUDIO) {
-
-          trak->stsd_atoms[k].audio.media_id = k + 1;
-          trak->stsd_atoms[k].audio.properties_offset = properties_offset;
-
-          /* fetch audio parameters */
-          trak->stsd_atoms[k].audio.codec_fourcc =
-            ME_32(&trak_atom[atom_pos + 0x0]);
-          trak->stsd_atoms[k].audio.sample_rate =
-            BE_16(&trak_atom[atom_pos + 0x1C]);
-          trak->stsd_atoms[k].audio.channels = trak_atom[atom_pos + 0x15];
-          trak->stsd_atoms[k].audio.bits = trak_atom[atom_pos + 0x17];
-
-          /* assume uncompressed audio parameters */
-          trak->stsd_atoms[k].audio.bytes_per_sample =
-            trak->stsd_atoms[k].audio.bits / 8;
-          trak->stsd_atoms[k].audio.samples_per_frame =
-            trak->stsd_atoms[k].audio.channels;
-          trak->stsd_atoms[k].audio.bytes_per_frame = 
-            trak->stsd_atoms[k].audio.bytes_per_sample * 
-            trak->stsd_atoms[k].audio.samples_per_frame;
-          trak->stsd_atoms[k].audio.samples_per_packet = 
-            trak->stsd_atoms[k].audio.samples_per_frame;
-          trak->stsd_atoms[k].audio.bytes_per_packet = 
-            trak->stsd_atoms[k].audio.bytes_per_sample;
-
-          /* special case time: some ima4-encoded files don't have the
-           * extra header; compensate */
-          if (BE_32(&trak_atom[atom_pos + 0x0]) == IMA4_FOURCC) {
-            trak->stsd_atoms[k].audio.samples_per_packet = 64;
-            trak->stsd_atoms[k].audio.bytes_per_packet = 34;
-            trak->stsd_atoms[k].audio.bytes_per_frame = 34 * 
-              trak->stsd_atoms[k].audio.channels;
-            trak->stsd_atoms[k].audio.bytes_per_sample = 2;
-            trak->stsd_atoms[k].audio.samples_per_frame = 64 *
-              trak->stsd_atoms[k].audio.channels;
-          }
+    debug_atom_load("    qt/mpeg-4 esds atom\n");
 
-          /* it's time to dig a little deeper to determine the real audio
-           * properties; if a the stsd compressor atom has 0x24 bytes, it
-           * appears to be a handler for uncompressed data; if there are an
-           * extra 0x10 bytes, there are some more useful decoding params;
-           * further, do not do load these parameters if the audio is just
-           * PCM ('raw ', 'twos', or 'sowt') */
-          if ((current_stsd_atom_size > 0x24) &&
-              (trak->stsd_atoms[k].audio.codec_fourcc != TWOS_FOURCC) &&
-              (trak->stsd_atoms[k].audio.codec_fourcc != SOWT_FOURCC) &&
-              (trak->stsd_atoms[k].audio.codec_fourcc != RAW_FOURCC)) {
-
-            if (BE_32(&trak_atom[atom_pos + 0x20]))
-              trak->stsd_atoms[k].audio.samples_per_packet = 
-                BE_32(&trak_atom[atom_pos + 0x20]);
-            if (BE_32(&trak_atom[atom_pos + 0x24]))
-              trak->stsd_atoms[k].audio.bytes_per_packet = 
-                BE_32(&trak_atom[atom_pos + 0x24]);
-            if (BE_32(&trak_atom[atom_pos + 0x28]))
-              trak->stsd_atoms[k].audio.bytes_per_frame = 
-                BE_32(&trak_atom[atom_pos + 0x28]);
-            if (BE_32(&trak_atom[atom_pos + 0x2C]))
-              trak->stsd_atoms[k].audio.bytes_per_sample = 
-                BE_32(&trak_atom[atom_pos + 0x2C]);
-            trak->stsd_atoms[k].audio.samples_per_frame =
-              (trak->stsd_atoms[k].audio.bytes_per_frame / 
-               trak->stsd_atoms[k].audio.bytes_per_packet) *
-               trak->stsd_atoms[k].audio.samples_per_packet;
-          }
+    j = i + 8;
+    if( stsd[j++] == 0x03 ) {
+      j += mp4_read_descr_len( &stsd[j], &len );
+      j++;
+    }
+    j += 2;
+    if( stsd[j++] == 0x04 ) {
+      j += mp4_read_descr_len( &stsd[j], &len );
+      j += 13;
+      if( stsd[j++] == 0x05 ) {
+        j += mp4_read_descr_len( &stsd[j], &len );
+        debug_atom_load("      decoder config is %d (0x%X) bytes long\n",
+          len, len);
+        if (j + len > trak->stsd_size)
+          return QT_HEADER_TROUBLE;
+        trak->decoder_config = realloc(trak->decoder_config, len);
+        trak->decoder_config_len = len;
+        memcpy(trak->decoder_config,&stsd[j],len);
+      }
+    }
+  }
 
-          /* see if the trak deserves a promotion to VBR */
-          if (BE_16(&trak_atom[atom_pos + 0x18]) == 0xFFFE)
-            trak->stsd_atoms[k].audio.vbr = 1;
-          else
-            trak->stsd_atoms[k].audio.vbr = 0;
-
-          /* if this is MP4 audio, mark the trak as VBR */
-          if (BE_32(&trak_atom[atom_pos + 0x0]) == MP4A_FOURCC)
-            trak->stsd_atoms[k].audio.vbr = 1;
-
-          /* check for a MS-style WAVE format header */
-          if ((current_atom_size >= 0x48) && 
-              (BE_32(&trak_atom[atom_pos + 0x34]) == WAVE_ATOM)) {
-            trak->stsd_atoms[k].audio.wave_present = 1;
-            memcpy(&trak->stsd_atoms[k].audio.wave, 
-              &trak_atom[atom_pos + 0x4C],
-              sizeof(trak->stsd_atoms[k].audio.wave));
-            xine_waveformatex_le2me(&trak->stsd_atoms[k].audio.wave);
-          } else {
-            trak->stsd_atoms[k].audio.wave_present = 0;
-          }
+  return QT_OK;
+}
 
-          debug_atom_load("    audio properties atom #%d\n", k + 1);
-          debug_atom_load("      %d Hz, %d bits, %d channels, %saudio fourcc = '%c%c%c%c' (%02X%02X%02X%02X)\n",
-            trak->stsd_atoms[k].audio.sample_rate,
-            trak->stsd_atoms[k].audio.bits,
-            trak->stsd_atoms[k].audio.channels,
-            (trak->stsd_atoms[k].audio.vbr) ? "vbr, " : "",
-            trak_atom[atom_pos + 0x0],
-            trak_atom[atom_pos + 0x1],
-            trak_atom[atom_pos + 0x2],
-            trak_atom[atom_pos + 0x3],
-            trak_atom[atom_pos + 0x0],
-            trak_atom[atom_pos + 0x1],
-            trak_atom[atom_pos + 0x2],
-            trak_atom[atom_pos + 0x3]);
-          if (current_stsd_atom_size > 0x24) {
-            debug_atom_load("      %d samples/packet, %d bytes/packet, %d bytes/frame\n",
-              trak->stsd_atoms[k].audio.samples_per_packet,
-              trak->stsd_atoms[k].audio.bytes_per_packet,
-              trak->stsd_atoms[k].audio.bytes_per_frame);
-            debug_atom_load("      %d bytes/sample (%d samples/frame)\n",
-              trak->stsd_atoms[k].audio.bytes_per_sample,
-              trak->stsd_atoms[k].audio.samples_per_frame);
-          }
-        }
+/* read the version/flags and entry count that open most sample table
+ * atoms and check that the entries fit in the atom */
+static qt_error start_table(qt_moov_stream *s, int64_t atom_size,
+                            unsigned int entry_size, unsigned int *count) {
 
-        /* use first audio properties atom for now */
-        trak->properties = &trak->stsd_atoms[0];
+  unsigned char *p;
 
-        /* forward to the next atom */
-        atom_pos += current_stsd_atom_size;
-        properties_offset += current_stsd_atom_size;
-      }
+  if (atom_size < 8)
+    return QT_HEADER_TROUBLE;
+  p = moov_stream_get(s, 8);
+  if (!p)
+    return QT_FILE_READ_ERROR;
+  *count = BE_32(&p[4]);
+  if ((int64_t)*count * entry_size > atom_size - 8)
+    return QT_HEADER_TROUBLE;
 
-    } else if (current_atom == ESDS_ATOM) {
+  return QT_OK;
+}
 
-      uint32_t len;
-      
-      debug_atom_load("    qt/mpeg-4 esds atom\n");
+/*
+ * This function converts one sample table atom, entry by entry as it is
+ * streamed in, into the internal trak structure. Returns QT_OK for atoms
+ * that are not sample tables.
+ */
+static qt_error load_sample_table(qt_trak *trak, qt_moov_stream *s,
+                                  qt_atom current_atom, int64_t atom_size) {
 
-      if ((trak->type == MEDIA_VIDEO) || 
-          (trak->type == MEDIA_AUDIO)) {
-        
-        j = i + 8;
-        if( trak_atom[j++] == 0x03 ) {
-          j += mp4_read_descr_len( &trak_atom[j], &len );
-          j++;
-        }
-        j += 2;
-        if( trak_atom[j++] == 0x04 ) {
-          j += mp4_read_descr_len( &trak_atom[j], &len );
-          j += 13;
-          if( trak_atom[j++] == 0x05 ) {
-            j += mp4_read_descr_len( &trak_atom[j], &len );
-            debug_atom_load("      decoder config is %d (0x%X) bytes long\n",
-              len, len);
-            trak->decoder_config = realloc(trak->decoder_config, len);
-            trak->decoder_config_len = len;
-            memcpy(trak->decoder_config,&trak_atom[j],len);
-          }
-        }
-      }
+  unsigned int j;
+  unsigned char *p;
+  qt_error last_error;
 
-    } else if (current_atom == STSZ_ATOM) {
+  if (current_atom == ELST_ATOM) {
 
-      /* there should only be one of these atoms */
-      if (trak->sample_size_table) {
-        last_error = QT_HEADER_TROUBLE;
-        goto free_trak;
-      }
+    /* there should only be one edit list table */
+    if (trak->edit_list_table)
+      return QT_HEADER_TROUBLE;
 
-      trak->sample_size = BE_32(&trak_atom[i + 8]);
-      trak->sample_size_count = BE_32(&trak_atom[i + 12]);
+    last_error = start_table(s, atom_size, 12, &trak->edit_list_count);
+    if (last_error != QT_OK)
+      return last_error;
 
-      debug_atom_load("    qt stsz atom (sample size atom): sample size = %d, %d entries\n",
-        trak->sample_size, trak->sample_size_count);
+    debug_atom_load("    qt elst atom (edit list atom): %d entries\n",
+      trak->edit_list_count);
 
-      /* allocate space and load table only if sample size is 0 */
-      if (trak->sample_size == 0) {
-        trak->sample_size_table = (unsigned int *)malloc(
-          trak->sample_size_count * sizeof(unsigned int));
-        if (!trak->sample_size_table) {
-          last_error = QT_NO_MEMORY;
-          goto free_trak;
-        }
-        /* load the sample size table */
-        for (j = 0; j < trak->sample_size_count; j++) {
-          trak->sample_size_table[j] =
-            BE_32(&trak_atom[i + 16 + j * 4]);
-          debug_atom_load("      sample size %d: %d\n",
-            j, trak->sample_size_table[j]);
-        }
-      } else
-        /* set the pointer to non-NULL to indicate that the atom type has
-         * already been seen for this trak atom */
-        trak->sample_size_table = (void *)-1;
+    trak->edit_list_table = (edit_list_table_t *)xine_xmalloc(
+      trak->edit_list_count * sizeof(edit_list_table_t));
+    if (!trak->edit_list_table)
+      return QT_NO_MEMORY;
 
-    } else if (current_atom == STSS_ATOM) {
+    /* load the edit list table */
+    for (j = 0; j < trak->edit_list_count; j++) {
+      p = moov_stream_get(s, 12);
+      if (!p)
+        return QT_FILE_READ_ERROR;
+      trak->edit_list_table[j].track_duration = BE_32(&p[0]);
+      trak->edit_list_table[j].media_time = BE_32(&p[4]);
+      debug_atom_load("      %d: track duration = %d, media time = %d\n",
+        j,
+        trak->edit_list_table[j].track_duration,
+        trak->edit_list_table[j].media_time);
+    }
 
-      /* there should only be one of these atoms */
-      if (trak->sync_sample_table) {
-        last_error = QT_HEADER_TROUBLE;
-        goto free_trak;
+  } else if (current_atom == STSZ_ATOM) {
+
+    /* there should only be one of these atoms */
+    if (trak->sample_size_table || (atom_size < 12))
+      return QT_HEADER_TROUBLE;
+
+    p = moov_stream_get(s, 12);
+    if (!p)
+      return QT_FILE_READ_ERROR;
+    trak->sample_size = BE_32(&p[4]);
+    trak->sample_size_count = BE_32(&p[8]);
+
+    debug_atom_load("    qt stsz atom (sample size atom): sample size = %d, %d entries\n",
+      trak->sample_size, trak->sample_size_count);
+
+    /* allocate space and load table only if sample size is 0 */
+    if (trak->sample_size == 0) {
+      if ((int64_t)trak->sample_size_count * 4 > atom_size - 12)
+        return QT_HEADER_TROUBLE;
+      trak->sample_size_table = (unsigned int *)malloc(
+        trak->sample_size_count * sizeof(unsigned int));
+      if (!trak->sample_size_table)
+        return QT_NO_MEMORY;
+      /* load the sample size table */
+      for (j = 0; j < trak->sample_size_count; j++) {
+        p = moov_stream_get(s, 4);
+        if (!p)
+          return QT_FILE_READ_ERROR;
+        trak->sample_size_table[j] = BE_32(&p[0]);
+        debug_atom_load("      sample size %d: %d\n",
+          j, trak->sample_size_table[j]);
       }
+    } else
+      /* set the pointer to non-NULL to indicate that the atom type has
+       * already been seen for this trak atom */
+      trak->sample_size_table = (void *)-1;
 
-      trak->sync_sample_count = BE_32(&trak_atom[i + 8]);
+  } else if (current_atom == STSS_ATOM) {
 
-      debug_atom_load("    qt stss atom (sample sync atom): %d sync samples\n",
-        trak->sync_sample_count);
+    /* there should only be one of these atoms */
+    if (trak->sync_sample_table)
+      return QT_HEADER_TROUBLE;
 
-      trak->sync_sample_table = (unsigned int *)malloc(
-        trak->sync_sample_count * sizeof(unsigned int));
-      if (!trak->sync_sample_table) {
-        last_error = QT_NO_MEMORY;
-        goto free_trak;
-      }
+    last_error = start_table(s, atom_size, 4, &trak->sync_sample_count);
+    if (last_error != QT_OK)
+      return last_error;
 
-      /* load the sync sample table */
-      for (j = 0; j < trak->sync_sample_count; j++) {
-        trak->sync_sample_table[j] =
-          BE_32(&trak_atom[i + 12 + j * 4]);
-        debug_atom_load("      sync sample %d: sample %d (%d) is a keyframe\n",
-          j, trak->sync_sample_table[j],
-          trak->sync_sample_table[j] - 1);
-      }
+    debug_atom_load("    qt stss atom (sample sync atom): %d sync samples\n",
+      trak->sync_sample_count);
 
-    } else if (current_atom == STCO_ATOM) {
+    trak->sync_sample_table = (unsigned int *)malloc(
+      trak->sync_sample_count * sizeof(unsigned int));
+    if (!trak->sync_sample_table)
+      return QT_NO_MEMORY;
 
-      /* there should only be one of either stco or co64 */
-      if (trak->chunk_offset_table) {
-        last_error = QT_HEADER_TROUBLE;
-        goto free_trak;
-      }
+    /* load the sync sample table */
+    for (j = 0; j < trak->sync_sample_count; j++) {
+      p = moov_stream_get(s, 4);
+      if (!p)
+        return QT_FILE_READ_ERROR;
+      trak->sync_sample_table[j] = BE_32(&p[0]);
+      debug_atom_load("      sync sample %d: sample %d (%d) is a keyframe\n",
+        j, trak->sync_sample_table[j],
+        trak->sync_sample_table[j] - 1);
+    }
 
-      trak->chunk_offset_count = BE_32(&trak_atom[i + 8]);
+  } else if ((current_atom == STCO_ATOM) || (current_atom == CO64_ATOM)) {
 
-      debug_atom_load("    qt stco atom (32-bit chunk offset atom): %d chunk offsets\n",
-        trak->chunk_offset_count);
+    unsigned int entry_size = (current_atom == STCO_ATOM) ? 4 : 8;
 
-      trak->chunk_offset_table = (int64_t *)malloc(
-        trak->chunk_offset_count * sizeof(int64_t));
-      if (!trak->chunk_offset_table) {
-        last_error = QT_NO_MEMORY;
-        goto free_trak;
-      }
+    /* there should only be one of either stco or co64 */
+    if (trak->chunk_offset_table)
+      return QT_HEADER_TROUBLE;
 
-      /* load the chunk offset table */
-      for (j = 0; j < trak->chunk_offset_count; j++) {
-        trak->chunk_offset_table[j] =
-          BE_32(&trak_atom[i + 12 + j * 4]);
-        debug_atom_load("      chunk %d @ 0x%llX\n",
-          j, trak->chunk_offset_table[j]);
-      }
+    last_error = start_table(s, atom_size, entry_size,
+      &trak->chunk_offset_count);
+    if (last_error != QT_OK)
+      return last_error;
 
-    } else if (current_atom == CO64_ATOM) {
+    debug_atom_load("    qt %s atom (%d-bit chunk offset atom): %d chunk offsets\n",
+      (entry_size == 4) ? "stco" : "co64", entry_size * 8,
+      trak->chunk_offset_count);
 
-      /* there should only be one of either stco or co64 */
-      if (trak->chunk_offset_table) {
-        last_error = QT_HEADER_TROUBLE;
-        goto free_trak;
+    trak->chunk_offset_table = (int64_t *)malloc(
+      trak->chunk_offset_count * sizeof(int64_t));
+    if (!trak->chunk_offset_table)
+      return QT_NO_MEMORY;
+
+    /* load the chunk offset table */
+    for (j = 0; j < trak->chunk_offset_count; j++) {
+      p = moov_stream_get(s, entry_size);
+      if (!p)
+        return QT_FILE_READ_ERROR;
+      trak->chunk_offset_table[j] = BE_32(&p[0]);
+      if (entry_size == 8) {
+        trak->chunk_offset_table[j] <<= 32;
+        trak->chunk_offset_table[j] |= BE_32(&p[4]);
       }
+      debug_atom_load("      chunk %d @ 0x%llX\n",
+        j, trak->chunk_offset_table[j]);
+    }
 
-      trak->chunk_offset_count = BE_32(&trak_atom[i + 8]);
+  } else if (current_atom == STSC_ATOM) {
 
-      debug_atom_load("    qt co64 atom (64-bit chunk offset atom): %d chunk offsets\n",
-        trak->chunk_offset_count);
+    /* there should only be one of these atoms */
+    if (trak->sample_to_chunk_table)
+      return QT_HEADER_TROUBLE;
 
-      trak->chunk_offset_table = (int64_t *)malloc(
-        trak->chunk_offset_count * sizeof(int64_t));
-      if (!trak->chunk_offset_table) {
-        last_error = QT_NO_MEMORY;
-        goto free_trak;
-      }
+    last_error = start_table(s, atom_size, 12, &trak->sample_to_chunk_count);
+    if (last_error != QT_OK)
+      return last_error;
 
-      /* load the 64-bit chunk offset table */
-      for (j = 0; j < trak->chunk_offset_count; j++) {
-        trak->chunk_offset_table[j] =
-          BE_32(&trak_atom[i + 12 + j * 8 + 0]);
-        trak->chunk_offset_table[j] <<= 32;
-        trak->chunk_offset_table[j] |=
-          BE_32(&trak_atom[i + 12 + j * 8 + 4]);
-        debug_atom_load("      chunk %d @ 0x%llX\n",
-          j, trak->chunk_offset_table[j]);
-      }
+    debug_atom_load("    qt stsc atom (sample-to-chunk atom): %d entries\n",
+      trak->sample_to_chunk_count);
 
-    } else if (current_atom == STSC_ATOM) {
+    trak->sample_to_chunk_table = (sample_to_chunk_table_t *)malloc(
+      trak->sample_to_chunk_count * sizeof(sample_to_chunk_table_t));
+    if (!trak->sample_to_chunk_table)
+      return QT_NO_MEMORY;
 
-      /* there should only be one of these atoms */
-      if (trak->sample_to_chunk_table) {
-        last_error = QT_HEADER_TROUBLE;
-        goto free_trak;
-      }
+    /* load the sample to chunk table */
+    for (j = 0; j < trak->sample_to_chunk_count; j++) {
+      p = moov_stream_get(s, 12);
+      if (!p)
+        return QT_FILE_READ_ERROR;
+      trak->sample_to_chunk_table[j].first_chunk = BE_32(&p[0]);
+      trak->sample_to_chunk_table[j].samples_per_chunk = BE_32(&p[4]);
+      trak->sample_to_chunk_table[j].media_id = BE_32(&p[8]);
+      debug_atom_load("      %d: %d samples/chunk starting at chunk %d (%d) for media id %d\n",
+        j, trak->sample_to_chunk_table[j].samples_per_chunk,
+        trak->sample_to_chunk_table[j].first_chunk,
+        trak->sample_to_chunk_table[j].first_chunk - 1,
+        trak->sample_to_chunk_table[j].media_id);
+    }
 
-      trak->sample_to_chunk_count = BE_32(&trak_atom[i + 8]);
+  } else if (current_atom == STTS_ATOM) {
 
-      debug_atom_load("    qt stsc atom (sample-to-chunk atom): %d entries\n",
-        trak->sample_to_chunk_count);
+    /* there should only be one of these atoms */
+    if (trak->time_to_sample_table)
+      return QT_HEADER_TROUBLE;
 
-      trak->sample_to_chunk_table = (sample_to_chunk_table_t *)malloc(
-        trak->sample_to_chunk_count * sizeof(sample_to_chunk_table_t));
-      if (!trak->sample_to_chunk_table) {
-        last_error = QT_NO_MEMORY;
-        goto free_trak;
-      }
+    last_error = start_table(s, atom_size, 8, &trak->time_to_sample_count);
+    if (last_error != QT_OK)
+      return last_error;
 
-      /* load the sample to chunk table */
-      for (j = 0; j < trak->sample_to_chunk_count; j++) {
-        trak->sample_to_chunk_table[j].first_chunk =
-          BE_32(&trak_atom[i + 12 + j * 12 + 0]);
-        trak->sample_to_chunk_table[j].samples_per_chunk =
-          BE_32(&trak_atom[i + 12 + j * 12 + 4]);
-        trak->sample_to_chunk_table[j].media_id =
-          BE_32(&trak_atom[i + 12 + j * 12 + 8]);
-        debug_atom_load("      %d: %d samples/chunk starting at chunk %d (%d) for media id %d\n",
-          j, trak->sample_to_chunk_table[j].samples_per_chunk,
-          trak->sample_to_chunk_table[j].first_chunk,
-          trak->sample_to_chunk_table[j].first_chunk - 1,
-          trak->sample_to_chunk_table[j].media_id);
-      }
+    debug_atom_load("    qt stts atom (time-to-sample atom): %d entries\n",
+      trak->time_to_sample_count);
 
-    } else if (current_atom == STTS_ATOM) {
+    trak->time_to_sample_table = (time_to_sample_table_t *)malloc(
+      (trak->time_to_sample_count+1) * sizeof(time_to_sample_table_t));
+    if (!trak->time_to_sample_table)
+      return QT_NO_MEMORY;
 
-      /* there should only be one of these atoms */
-      if (trak->time_to_sample_table) {
-        last_error = QT_HEADER_TROUBLE;
-        goto free_trak;
-      }
+    /* load the time to sample table */
+    for (j = 0; j < trak->time_to_sample_count; j++) {
+      p = moov_stream_get(s, 8);
+      if (!p)
+        return QT_FILE_READ_ERROR;
+      trak->time_to_sample_table[j].count = BE_32(&p[0]);
+      trak->time_to_sample_table[j].duration = BE_32(&p[4]);
+      debug_atom_load("      %d: count = %d, duration = %d\n",
+        j, trak->time_to_sample_table[j].count,
+        trak->time_to_sample_table[j].duration);
+    }
+    trak->time_to_sample_table[j].count = 0; /* terminate with zero */
+  }
+
+  return QT_OK;
+}
+
+/*
+ * This function walks the children of a trak atom (or of one of the
+ * containers inside it), loading the headers and sample tables into the
+ * internal trak structure. The tables of traks whose handler is neither
+ * video nor sound are skipped without being loaded.
+ */
+static qt_error parse_trak_children(qt_trak *trak, qt_moov_stream *s,
+                                    int64_t left, qt_atom *handler) {
+
+  qt_atom current_atom;
+  int64_t current_atom_size;
+  int64_t atom_start;
+  unsigned char *p;
+  qt_error last_error = QT_OK;
+
+  while (next_child_atom(s, &left, &current_atom, &current_atom_size)) {
+
+    atom_start = s->pos;
+
+    if ((current_atom == EDTS_ATOM) ||
+        (current_atom == MDIA_ATOM) ||
+        (current_atom == MINF_ATOM) ||
+        (current_atom == STBL_ATOM)) {
+
+      last_error = parse_trak_children(trak, s, current_atom_size, handler);
+
+    } else if (current_atom == TKHD_ATOM) {
+
+      if ((current_atom_size >= 4) && (p = moov_stream_get(s, 4)))
+        trak->flags = BE_16(&p[2]);
 
-      trak->time_to_sample_count = BE_32(&trak_atom[i + 8]);
+    } else if (current_atom == MDHD_ATOM) {
 
-      debug_atom_load("    qt stts atom (time-to-sample atom): %d entries\n",
-        trak->time_to_sample_count);
+      if ((current_atom_size >= 16) && (p = moov_stream_get(s, 16)))
+        trak->timescale = BE_32(&p[12]);
 
-      trak->time_to_sample_table = (time_to_sample_table_t *)malloc(
-        (trak->time_to_sample_count+1) * sizeof(time_to_sample_table_t));
-      if (!trak->time_to_sample_table) {
-        last_error = QT_NO_MEMORY;
-        goto free_trak;
+    } else if (current_atom == HDLR_ATOM) {
+
+      /* only the media handler, which precedes the data handler, counts */
+      if (!*handler && (current_atom_size >= 12) &&
+          (p = moov_stream_get(s, 12)))
+        *handler = BE_32(&p[8]);
+
+    } else if (current_atom == VMHD_ATOM) {
+
+      trak->type = MEDIA_VIDEO;
+
+    } else if (current_atom == SMHD_ATOM) {
+
+      trak->type = MEDIA_AUDIO;
+
+    } else if ((trak->type == MEDIA_OTHER) && *handler &&
+               (*handler != VIDE_HANDLER) && (*handler != SOUN_HANDLER)) {
+
+      /* not a trak that will ever be played; leave its tables be */
+
+    } else if (current_atom == STSD_ATOM) {
+
+      if (trak->stsd) {
+        last_error = QT_HEADER_TROUBLE;
+        break;
       }
 
-      /* load the time to sample table */
-      for (j = 0; j < trak->time_to_sample_count; j++) {
-        trak->time_to_sample_table[j].count =
-          BE_32(&trak_atom[i + 12 + j * 8 + 0]);
-        trak->time_to_sample_table[j].duration =
-          BE_32(&trak_atom[i + 12 + j * 8 + 4]);
-        debug_atom_load("      %d: count = %d, duration = %d\n",
-          j, trak->time_to_sample_table[j].count,
-          trak->time_to_sample_table[j].duration);
+      /* keep a copy, starting at the type field and with the original's
+       * size, so it can later be sent to the decoder */
+      trak->stsd = load_atom(s, current_atom, current_atom_size);
+      if (trak->stsd) {
+        trak->stsd_size = current_atom_size + ATOM_PREAMBLE_SIZE;
+        memmove(trak->stsd, &trak->stsd[4], trak->stsd_size - 4);
+        memset(&trak->stsd[trak->stsd_size - 4], 0, 4);
       }
-      trak->time_to_sample_table[j].count = 0; /* terminate with zero */
+
+    } else {
+
+      last_error = load_sample_table(trak, s, current_atom, current_atom_size);
     }
+
+    if (last_error != QT_OK)
+      break;
+    if (s->error != QT_OK)
+      return s->error;
+
+    /* step over whatever part of the atom was not consumed */
+    if (!moov_stream_skip(s, current_atom_size - (s->pos - atom_start)))
+      return (s->error != QT_OK) ? s->error : QT_HEADER_TROUBLE;
   }
 
-  return QT_OK;
+  if (last_error == QT_OK && s->error != QT_OK)
+    last_error = s->error;
 
-  /* jump here to make sure everything is free'd and avoid leaking memory */
-free_trak:
-  free(trak->edit_list_table);
-  free(trak->chunk_offset_table);
-  /* this pointer might have been set to -1 as a special case */
-  if (trak->sample_size_table != (void *)-1)
-    free(trak->sample_size_table);
-  free(trak->sync_sample_table);
-  free(trak->sample_to_chunk_table);
-  free(trak->time_to_sample_table);
-  free(trak->decoder_config);
-  free(trak->stsd);
-  free(trak->stsd_atoms);
+  return last_error;
+}
+
+/*
+ * This function streams through a trak atom of trak_atom_size payload
+ * bytes searching for the sample table atoms, which it loads into an
+ * internal trak structure.
+ */
+static qt_error parse_trak_atom (qt_trak *trak, qt_moov_stream *s,
+                                 int64_t trak_atom_size) {
+
+  qt_atom handler = 0;
+  qt_error last_error;
+
+  /* initialize trak structure */
+  trak->sample_size = 0;
+  trak->current_frame = 0;
+  trak->window_first = 0;
+  trak->global_timescale = 0;
+  trak->timescale = 0;
+  trak->flags = 0;
+  trak->sample_size_table = NULL;
+  trak->edit_list_table = NULL;
+  trak->chunk_offset_table = NULL;
+  trak->sync_sample_table = NULL;
+  trak->sample_to_chunk_table = NULL;
+  trak->time_to_sample_table = NULL;
+  trak->frames = NULL;
+  trak->checkpoints = NULL;
+  trak->decoder_config = NULL;
+  trak->stsd = NULL;
+  trak->stsd_atoms = NULL;
+  /* with nothing loaded yet, this just zeroes the rest */
+  free_trak_tables(trak);
+
+  /* default type */
+  trak->type = MEDIA_OTHER;
+
+  last_error = parse_trak_children(trak, s, trak_atom_size, &handler);
+
+  debug_atom_load("  qt: parsed %s trak atom\n",
+    (trak->type == MEDIA_VIDEO) ? "video" :
+      (trak->type == MEDIA_AUDIO) ? "audio" : "other");
+
+  /* the properties atoms can only be decoded once the media type is known */
+  if ((last_error == QT_OK) && trak->stsd)
+    last_error = parse_stsd_atom(trak);
+
+  /* make sure everything is free'd and avoid leaking memory */
+  if (last_error != QT_OK)
+    free_trak_tables(trak);
 
   return last_error;
 }
@@ -1417,74 +1982,284 @@ static qt_error parse_reference_atom (reference_t *ref,
         }
       }
     }
-  }
+  }
+
+  return QT_OK;
+}
+
+/* This is a little support function used to process the edit list when
+ * building a frame table. */
+#define MAX_DURATION 0x7FFFFFFFFFFFFFFF
+static void get_next_edit_list_entry(qt_trak *trak, 
+  int *edit_list_index,
+  unsigned int *edit_list_media_time, 
+  int64_t *edit_list_duration,
+  unsigned int global_timescale) {
+
+  /* if there is no edit list, set to max duration and get out */
+  if (!trak->edit_list_table) {
+
+    *edit_list_media_time = 0;
+    *edit_list_duration = MAX_DURATION;
+    debug_edit_list("  qt: no edit list table, initial = %d, %lld\n", *edit_list_media_time, *edit_list_duration);
+    return;
+
+  } else while (*edit_list_index < trak->edit_list_count) {
+
+    /* otherwise, find an edit list entries whose media time != -1 */
+    if (trak->edit_list_table[*edit_list_index].media_time != -1) {
+
+      *edit_list_media_time = 
+        trak->edit_list_table[*edit_list_index].media_time;
+      *edit_list_duration = 
+        trak->edit_list_table[*edit_list_index].track_duration;
+
+      /* duration is in global timescale units; convert to trak timescale */
+      *edit_list_duration *= trak->timescale;
+      if (global_timescale)
+        *edit_list_duration /= global_timescale;
+
+      *edit_list_index = *edit_list_index + 1;
+      break;
+    }
+
+    *edit_list_index = *edit_list_index + 1;
+  }
+
+  /* on the way out, check if this is the last edit list entry; if so, 
+   * don't let the duration expire (so set it to an absurdly large value) 
+   */
+  if (*edit_list_index == trak->edit_list_count)
+    *edit_list_duration = MAX_DURATION;
+  debug_edit_list("  qt: edit list table exists, initial = %d, %lld\n", *edit_list_media_time, *edit_list_duration);
+}
+
+/* The frame table is never built in full. Instead, a trak keeps a cursor
+ * checkpoint every QT_FRAME_WINDOW frames and generates a window of frames
+ * on demand by running a cursor forward through the sample tables. Any
+ * checkpoints past the furthest position reached so far are filled in on
+ * the way. */
+
+/* returns the chunk number (1-based) that ends sample-to-chunk entry i */
+static unsigned int stsc_chunk_end(qt_trak *trak, unsigned int i) {
+
+  if (i < trak->sample_to_chunk_count - 1)
+    return trak->sample_to_chunk_table[i + 1].first_chunk;
+  else
+    /* if the first chunk is in the last table entry, iterate to the
+       final chunk number (the number of offsets in stco table) */
+    return trak->chunk_offset_count + 1;
+}
+
+/* move the cursor to the first usable chunk at or after cursor->chunk;
+ * leaves stsc_index at sample_to_chunk_count if the chunks ran out */
+static void start_chunk(qt_trak *trak, qt_frame_cursor *cursor) {
+
+  while (cursor->stsc_index < trak->sample_to_chunk_count) {
+
+    if ((cursor->chunk + 1 < stsc_chunk_end(trak, cursor->stsc_index)) &&
+        (cursor->chunk < trak->chunk_offset_count)) {
+      cursor->chunk_samples_left =
+        trak->sample_to_chunk_table[cursor->stsc_index].samples_per_chunk;
+      cursor->offset = trak->chunk_offset_table[cursor->chunk];
+      return;
+    }
+
+    cursor->stsc_index++;
+    if (cursor->stsc_index < trak->sample_to_chunk_count)
+      cursor->chunk =
+        trak->sample_to_chunk_table[cursor->stsc_index].first_chunk - 1;
+  }
+}
+
+static void reset_frame_cursor(qt_trak *trak, qt_frame_cursor *cursor) {
+
+  memset(cursor, 0, sizeof(qt_frame_cursor));
+
+  if (trak->time_to_sample_count)
+    cursor->stts_countdown = trak->time_to_sample_table[0].count;
+
+  if ((trak->type == MEDIA_VIDEO) || (trak->properties->audio.vbr)) {
+    if (trak->sample_to_chunk_count) {
+      cursor->chunk = trak->sample_to_chunk_table[0].first_chunk - 1;
+      start_chunk(trak, cursor);
+    }
+
+    get_next_edit_list_entry(trak, &cursor->edit_list_index,
+      &cursor->edit_list_media_time, &cursor->edit_list_duration,
+      trak->global_timescale);
+  }
+}
+
+/* generate the frame at the cursor and advance the cursor */
+static void next_frame(qt_trak *trak, qt_frame_cursor *cursor,
+  qt_frame *frame) {
+
+  sample_to_chunk_table_t *stsc;
+  unsigned int i = cursor->frame++;
+  unsigned int duration = 0;
+  int64_t media_time;
+
+  if ((trak->type == MEDIA_VIDEO) || (trak->properties->audio.vbr)) {
+
+    /* in this case, there is one frame per sample; move on to the next
+     * chunk once the current one runs out of samples */
+    while (!cursor->chunk_samples_left &&
+           (cursor->stsc_index < trak->sample_to_chunk_count)) {
+      cursor->chunk++;
+      start_chunk(trak, cursor);
+    }
+
+    /* media id accounting; frames that fall outside of the stsc table
+     * get media id 0 and will not be dispatched */
+    frame->media_id = 0;
+    if (cursor->stsc_index < trak->sample_to_chunk_count) {
+      stsc = &trak->sample_to_chunk_table[cursor->stsc_index];
+      if (stsc->media_id <= trak->stsd_atoms_count)
+        frame->media_id = stsc->media_id;
+      cursor->chunk_samples_left--;
+    }
+
+    /* figure out the offset and size */
+    frame->offset = cursor->offset;
+    if (trak->sample_size)
+      frame->size = trak->sample_size;
+    else if (i < trak->sample_size_count)
+      frame->size = trak->sample_size_table[i];
+    else
+      frame->size = 0;
+    cursor->offset += frame->size;
+
+    /* if there is no stss (sample sync) table, make all of the frames
+     * keyframes */
+    if (trak->sync_sample_table) {
+      while ((cursor->stss_index < trak->sync_sample_count) &&
+             (trak->sync_sample_table[cursor->stss_index] < i + 1))
+        cursor->stss_index++;
+      frame->keyframe =
+        (cursor->stss_index < trak->sync_sample_count) &&
+        (trak->sync_sample_table[cursor->stss_index] == i + 1);
+    } else
+      frame->keyframe = 1;
+
+    /* figure out the pts situation */
+    media_time = cursor->media_time;
+    if (cursor->stts_index < trak->time_to_sample_count) {
+      duration = trak->time_to_sample_table[cursor->stts_index].duration;
+      cursor->media_time += duration;
+      cursor->stts_countdown--;
+      /* time to refresh countdown? */
+      if (!cursor->stts_countdown) {
+        cursor->stts_index++;
+        cursor->stts_countdown =
+          trak->time_to_sample_table[cursor->stts_index].count;
+      }
+    }
+
+    /* fix up pts information w.r.t. the edit list table */
+    if (media_time < cursor->edit_list_media_time)
+      frame->pts = cursor->edit_list_pts_counter;
+    else {
+      /* the duration is the pts diff to the next frame; the last frame
+       * keeps the duration of the one before it */
+      if (i < trak->frame_count - 1)
+        cursor->frame_duration = duration;
+
+      frame->pts = cursor->edit_list_pts_counter;
+      cursor->edit_list_pts_counter += cursor->frame_duration;
+      cursor->edit_list_duration -= cursor->frame_duration;
+    }
 
-  return QT_OK;
-}
+    /* reload media time and duration */
+    if (cursor->edit_list_duration <= 0) {
+      get_next_edit_list_entry(trak, &cursor->edit_list_index,
+        &cursor->edit_list_media_time, &cursor->edit_list_duration,
+        trak->global_timescale);
+    }
 
-/* This is a little support function used to process the edit list when
- * building a frame table. */
-#define MAX_DURATION 0x7FFFFFFFFFFFFFFF
-static void get_next_edit_list_entry(qt_trak *trak, 
-  int *edit_list_index,
-  unsigned int *edit_list_media_time, 
-  int64_t *edit_list_duration,
-  unsigned int global_timescale) {
+  } else {
 
-  /* if there is no edit list, set to max duration and get out */
-  if (!trak->edit_list_table) {
+    /* in this case, there is one frame per chunk */
+    frame->offset = (i < trak->chunk_offset_count) ?
+      trak->chunk_offset_table[i] : 0;
+    frame->keyframe = 0;
+    frame->media_id = 0;
+    frame->size = 0;
+
+    /* find the stsc entry covering this chunk */
+    while ((cursor->stsc_index < trak->sample_to_chunk_count) &&
+           (i + 1 >= stsc_chunk_end(trak, cursor->stsc_index)))
+      cursor->stsc_index++;
+
+    /* figure out the pts for this chunk */
+    frame->pts = cursor->audio_frame_counter;
+
+    if ((cursor->stsc_index < trak->sample_to_chunk_count) &&
+        (i + 1 >= trak->sample_to_chunk_table[cursor->stsc_index].first_chunk)) {
+      stsc = &trak->sample_to_chunk_table[cursor->stsc_index];
+
+      if (stsc->media_id <= trak->stsd_atoms_count)
+        frame->media_id = stsc->media_id;
+
+      /* the chunk size is actually the audio frame count */
+      cursor->audio_frame_counter += stsc->samples_per_chunk;
+
+      /* compute the actual chunk size */
+      if (trak->properties->audio.samples_per_frame)
+        frame->size =
+          (stsc->samples_per_chunk *
+           trak->properties->audio.channels) /
+           trak->properties->audio.samples_per_frame *
+           trak->properties->audio.bytes_per_frame;
+    }
+  }
 
-    *edit_list_media_time = 0;
-    *edit_list_duration = MAX_DURATION;
-    debug_edit_list("  qt: no edit list table, initial = %d, %lld\n", *edit_list_media_time, *edit_list_duration);
-    return;
+  /* compute final pts value */
+  frame->pts *= 90000;
+  if (trak->timescale)
+    frame->pts /= trak->timescale;
+}
 
-  } else while (*edit_list_index < trak->edit_list_count) {
+/* generate the window of frames that contains frame n */
+static void load_frame_window(qt_trak *trak, unsigned int n) {
 
-    /* otherwise, find an edit list entries whose media time != -1 */
-    if (trak->edit_list_table[*edit_list_index].media_time != -1) {
+  unsigned int window = n / QT_FRAME_WINDOW;
+  qt_frame_cursor cursor;
+  unsigned int i;
 
-      *edit_list_media_time = 
-        trak->edit_list_table[*edit_list_index].media_time;
-      *edit_list_duration = 
-        trak->edit_list_table[*edit_list_index].track_duration;
+  /* run forward from the furthest checkpoint if necessary */
+  while (trak->checkpoint_count <= window) {
+    cursor = trak->checkpoints[trak->checkpoint_count - 1];
+    for (i = 0; i < QT_FRAME_WINDOW; i++)
+      next_frame(trak, &cursor, &trak->frames[i]);
+    trak->checkpoints[trak->checkpoint_count++] = cursor;
+  }
 
-      /* duration is in global timescale units; convert to trak timescale */
-      *edit_list_duration *= trak->timescale;
-      *edit_list_duration /= global_timescale;
+  cursor = trak->checkpoints[window];
+  trak->window_first = window * QT_FRAME_WINDOW;
+  trak->window_count = trak->frame_count - trak->window_first;
+  if (trak->window_count > QT_FRAME_WINDOW)
+    trak->window_count = QT_FRAME_WINDOW;
+  for (i = 0; i < trak->window_count; i++)
+    next_frame(trak, &cursor, &trak->frames[i]);
+}
 
-      *edit_list_index = *edit_list_index + 1;
-      break;
-    }
+/* Fetch frame n (which must be < frame_count) of a trak. The pointer is
+ * only good until the next call; frames nearby in either direction are
+ * usually served without regenerating anything. */
+static qt_frame *get_frame(qt_trak *trak, unsigned int n) {
 
-    *edit_list_index = *edit_list_index + 1;
-  }
+  if (n - trak->window_first >= trak->window_count)
+    load_frame_window(trak, n);
 
-  /* on the way out, check if this is the last edit list entry; if so, 
-   * don't let the duration expire (so set it to an absurdly large value) 
-   */
-  if (*edit_list_index == trak->edit_list_count)
-    *edit_list_duration = MAX_DURATION;
-  debug_edit_list("  qt: edit list table exists, initial = %d, %lld\n", *edit_list_media_time, *edit_list_duration);
+  return &trak->frames[n - trak->window_first];
 }
 
 static qt_error build_frame_table(qt_trak *trak,
 				  unsigned int global_timescale) {
 
-  int i, j;
-  unsigned int frame_counter;
+  unsigned int i;
   unsigned int chunk_start, chunk_end;
-  unsigned int samples_per_chunk;
-  uint64_t current_offset;
-  int64_t current_pts;
-  unsigned int pts_index;
-  unsigned int pts_index_countdown;
-  unsigned int audio_frame_counter = 0;
-  unsigned int edit_list_media_time;
-  int64_t edit_list_duration;
-  int64_t frame_duration = 0;
-  unsigned int edit_list_index;
-  unsigned int edit_list_pts_counter;
   int atom_to_use;
 
   /* maintain counters for each of the subtracks within the trak */
@@ -1494,6 +2269,13 @@ static qt_error build_frame_table(qt_trak *trak,
       (trak->type != MEDIA_AUDIO))
     return QT_OK;
 
+  /* a trak without properties or sample tables cannot be played */
+  if (!trak->properties || !trak->chunk_offset_table ||
+      !trak->sample_to_chunk_table)
+    return QT_OK;
+
+  trak->global_timescale = global_timescale;
+
   /* AUDIO and OTHER frame types follow the same rules; VIDEO and vbr audio
    * frame types follow a different set */
   if ((trak->type == MEDIA_VIDEO) || 
@@ -1502,141 +2284,28 @@ static qt_error build_frame_table(qt_trak *trak,
     /* in this case, the total number of frames is equal to the number of
      * entries in the sample size table */
     trak->frame_count = trak->sample_size_count;
-    trak->frames = (qt_frame *)malloc(
-      trak->frame_count * sizeof(qt_frame));
-    if (!trak->frames)
-      return QT_NO_MEMORY;
-    trak->current_frame = 0;
-
-    /* initialize more accounting variables */
-    frame_counter = 0;
-    current_pts = 0;
-    pts_index = 0;
-    pts_index_countdown =
-      trak->time_to_sample_table[pts_index].count;
 
     media_id_counts = xine_xmalloc(trak->stsd_atoms_count * sizeof(int));
     if (!media_id_counts)
       return QT_NO_MEMORY;
     memset(media_id_counts, 0, trak->stsd_atoms_count * sizeof(int));
 
-    /* iterate through each start chunk in the stsc table */
+    /* count the samples for each media id straight from the stsc table */
     for (i = 0; i < trak->sample_to_chunk_count; i++) {
-      /* iterate from the first chunk of the current table entry to
-       * the first chunk of the next table entry */
       chunk_start = trak->sample_to_chunk_table[i].first_chunk;
-      if (i < trak->sample_to_chunk_count - 1)
-        chunk_end =
-          trak->sample_to_chunk_table[i + 1].first_chunk;
-      else
-        /* if the first chunk is in the last table entry, iterate to the
-           final chunk number (the number of offsets in stco table) */
-        chunk_end = trak->chunk_offset_count + 1;
-
-      /* iterate through each sample in a chunk */
-      for (j = chunk_start - 1; j < chunk_end - 1; j++) {
-
-        samples_per_chunk =
+      chunk_end = stsc_chunk_end(trak, i);
+      if (chunk_end <= chunk_start)
+        continue;
+
+      if ((trak->sample_to_chunk_table[i].media_id == 0) ||
+          (trak->sample_to_chunk_table[i].media_id > trak->stsd_atoms_count)) {
+        printf ("QT: help! media ID out of range! (%d > %d)\n",
+          trak->sample_to_chunk_table[i].media_id,
+          trak->stsd_atoms_count);
+      } else
+        media_id_counts[trak->sample_to_chunk_table[i].media_id - 1] +=
+          (chunk_end - chunk_start) *
           trak->sample_to_chunk_table[i].samples_per_chunk;
-        current_offset = trak->chunk_offset_table[j];
-        while (samples_per_chunk > 0) {
-
-          /* media id accounting */
-          if (trak->sample_to_chunk_table[i].media_id > trak->stsd_atoms_count) {
-            printf ("QT: help! media ID out of range! (%d > %d)\n",
-              trak->sample_to_chunk_table[i].media_id,
-              trak->stsd_atoms_count);
-            trak->frames[frame_counter].media_id = 0;
-          } else {
-            trak->frames[frame_counter].media_id = 
-              trak->sample_to_chunk_table[i].media_id;
-            media_id_counts[trak->sample_to_chunk_table[i].media_id - 1]++;
-          }
-
-          /* figure out the offset and size */
-          trak->frames[frame_counter].offset = current_offset;
-          if (trak->sample_size) {
-            trak->frames[frame_counter].size =
-              trak->sample_size;
-            current_offset += trak->sample_size;
-          } else {
-            trak->frames[frame_counter].size =
-              trak->sample_size_table[frame_counter];
-            current_offset +=
-              trak->sample_size_table[frame_counter];
-          }
-
-          /* if there is no stss (sample sync) table, make all of the frames
-           * keyframes; otherwise, clear the keyframe bits for now */
-          if (trak->sync_sample_table)
-            trak->frames[frame_counter].keyframe = 0;
-          else
-            trak->frames[frame_counter].keyframe = 1;
-
-          /* figure out the pts situation */
-          trak->frames[frame_counter].pts = current_pts;
-          current_pts +=
-            trak->time_to_sample_table[pts_index].duration;
-          pts_index_countdown--;
-          /* time to refresh countdown? */
-          if (!pts_index_countdown) {
-            pts_index++;
-            pts_index_countdown =
-              trak->time_to_sample_table[pts_index].count;
-          }
-
-          samples_per_chunk--;
-          frame_counter++;
-        }
-      }
-    }
-
-    /* fill in the keyframe information */
-    if (trak->sync_sample_table) {
-      for (i = 0; i < trak->sync_sample_count; i++)
-        trak->frames[trak->sync_sample_table[i] - 1].keyframe = 1;
-    }
-
-    /* initialize edit list considerations */
-    edit_list_index = 0;
-    get_next_edit_list_entry(trak, &edit_list_index,
-      &edit_list_media_time, &edit_list_duration, global_timescale);
-
-    /* fix up pts information w.r.t. the edit list table */
-    edit_list_pts_counter = 0;
-    for (i = 0; i < trak->frame_count; i++) {
-
-      debug_edit_list("    %d: (before) pts = %lld...", i, trak->frames[i].pts);
-
-      if (trak->frames[i].pts < edit_list_media_time) 
-        trak->frames[i].pts = edit_list_pts_counter;
-      else {
-        if (i < trak->frame_count - 1)
-          frame_duration = 
-            (trak->frames[i + 1].pts - trak->frames[i].pts);
-
-        debug_edit_list("duration = %lld...", frame_duration);
-        trak->frames[i].pts = edit_list_pts_counter;
-        edit_list_pts_counter += frame_duration;
-        edit_list_duration -= frame_duration;
-      }
-
-      debug_edit_list("(fixup) pts = %lld...", trak->frames[i].pts);
-
-      /* reload media time and duration */
-      if (edit_list_duration <= 0) {
-        get_next_edit_list_entry(trak, &edit_list_index,
-          &edit_list_media_time, &edit_list_duration, global_timescale);
-      }
-
-      debug_edit_list("(after) pts = %lld...\n", trak->frames[i].pts);
-    }
-
-    /* compute final pts values */
-    for (i = 0; i < trak->frame_count; i++) {
-      trak->frames[i].pts *= 90000;
-      trak->frames[i].pts /= trak->timescale;
-      debug_edit_list("  final pts for sample %d = %lld\n", i, trak->frames[i].pts);
     }
 
     /* decide which video properties atom to use */
@@ -1647,7 +2316,7 @@ static qt_error build_frame_table(qt_trak *trak,
     trak->properties = &trak->stsd_atoms[atom_to_use];
 
     /* adjust the stsd atom as needed */
-    memcpy(trak->stsd + 12,
+    memmove(trak->stsd + 12,
       &trak->stsd[trak->properties->video.properties_offset],
       BE_32(&trak->stsd[trak->properties->video.properties_offset]));
 
@@ -1658,152 +2327,150 @@ static qt_error build_frame_table(qt_trak *trak,
     /* in this case, the total number of frames is equal to the number of
      * chunks */
     trak->frame_count = trak->chunk_offset_count;
-    trak->frames = (qt_frame *)malloc(
-      trak->frame_count * sizeof(qt_frame));
-    if (!trak->frames)
-      return QT_NO_MEMORY;
-
-    if (trak->type == MEDIA_AUDIO) {
-      /* iterate through each start chunk in the stsc table */
-      for (i = 0; i < trak->sample_to_chunk_count; i++) {
-        /* iterate from the first chunk of the current table entry to
-         * the first chunk of the next table entry */
-        chunk_start = trak->sample_to_chunk_table[i].first_chunk;
-        if (i < trak->sample_to_chunk_count - 1)
-          chunk_end =
-            trak->sample_to_chunk_table[i + 1].first_chunk;
-        else
-          /* if the first chunk is in the last table entry, iterate to the
-             final chunk number (the number of offsets in stco table) */
-          chunk_end = trak->chunk_offset_count + 1;
-
-        /* iterate through each sample in a chunk and fill in size and
-         * pts information */
-        for (j = chunk_start - 1; j < chunk_end - 1; j++) {
-
-          /* figure out the pts for this chunk */
-          trak->frames[j].pts = audio_frame_counter;
-          trak->frames[j].pts *= 90000;
-          trak->frames[j].pts /= trak->timescale;
-
-          /* fetch the alleged chunk size according to the QT header */
-          trak->frames[j].size =
-            trak->sample_to_chunk_table[i].samples_per_chunk;
-
-          /* media id accounting */
-          if (trak->sample_to_chunk_table[i].media_id > trak->stsd_atoms_count) {
-            printf ("QT: help! media ID out of range! (%d > %d)\n",
-              trak->sample_to_chunk_table[i].media_id,
-              trak->stsd_atoms_count);
-            trak->frames[j].media_id = 0;
-          } else {
-            trak->frames[j].media_id = 
-              trak->sample_to_chunk_table[i].media_id;
-          }
-
-          /* the chunk size is actually the audio frame count */
-          audio_frame_counter += trak->frames[j].size;
+  }
 
-          /* compute the actual chunk size */
-          trak->frames[j].size =
-            (trak->frames[j].size *
-             trak->properties->audio.channels) /
-             trak->properties->audio.samples_per_frame *
-             trak->properties->audio.bytes_per_frame;
-        }
-      }
-    }
+  if (!trak->frame_count)
+    return QT_OK;
 
-    /* fill in the rest of the information for the audio samples */
-    for (i = 0; i < trak->frame_count; i++) {
-      trak->frames[i].offset = trak->chunk_offset_table[i];
-      trak->frames[i].keyframe = 0;
-      if (trak->type != MEDIA_AUDIO)
-        trak->frames[i].pts = 0;
-    }
+  /* allocate the frame window and room for every checkpoint */
+  trak->frames = (qt_frame *)malloc(QT_FRAME_WINDOW * sizeof(qt_frame));
+  trak->checkpoints = (qt_frame_cursor *)malloc(
+    (trak->frame_count / QT_FRAME_WINDOW + 1) * sizeof(qt_frame_cursor));
+  if (!trak->frames || !trak->checkpoints) {
+    trak->frame_count = 0;
+    return QT_NO_MEMORY;
   }
 
+  reset_frame_cursor(trak, &trak->checkpoints[0]);
+  trak->checkpoint_count = 1;
+  trak->current_frame = 0;
+  load_frame_window(trak, 0);
+
   return QT_OK;
 }
 
+/* copy one of the user data strings out of a udta atom */
+static void load_udta_string(char **string, unsigned char *udta_atom,
+                             int i, unsigned int udta_atom_size) {
+
+  int string_size = BE_16(&udta_atom[i + 4]) + 1;
+
+  if (i + 8 + string_size - 1 > udta_atom_size)
+    return;
+
+  *string = realloc (*string, string_size);
+  strncpy(*string, &udta_atom[i + 8], string_size - 1);
+  (*string)[string_size - 1] = 0;
+}
+
 /*
- * This function takes a pointer to a qt_info structure and a pointer to
- * a buffer containing an uncompressed moov atom. When the function
- * finishes successfully, qt_info will have a list of qt_frame objects,
- * ordered by offset.
+ * This function takes a pointer to a qt_info structure and a moov stream
+ * positioned at the start of an uncompressed moov atom. When the function
+ * finishes successfully, qt_info will have a frame table generator for
+ * each of the chosen audio and video traks.
  */
-static void parse_moov_atom(qt_info *info, unsigned char *moov_atom,
+static void parse_moov_atom(qt_info *info, qt_moov_stream *s,
                             int64_t bandwidth) {
-  int i, j;
-  unsigned int moov_atom_size = BE_32(&moov_atom[0]);
+  int i;
+#if DEBUG_FRAME_TABLE
+  int j;
+#endif
+  unsigned char *p;
+  unsigned char *atom;
   qt_atom current_atom;
-  int string_size;
+  int64_t current_atom_size;
+  int64_t atom_start;
+  int64_t left;
+  unsigned int atom_size;
   unsigned int max_video_frames = 0;
   unsigned int max_audio_frames = 0;
 
   /* make sure this is actually a moov atom */
-  if (BE_32(&moov_atom[4]) != MOOV_ATOM) {
+  p = moov_stream_get(s, ATOM_PREAMBLE_SIZE);
+  if (!p || (BE_32(&p[4]) != MOOV_ATOM)) {
     info->last_error = QT_NO_MOOV_ATOM;
     return;
   }
+  left = BE_32(&p[0]) - ATOM_PREAMBLE_SIZE;
+
+  /* walk the top level of the moov atom looking for very specific targets */
+  while (next_child_atom(s, &left, &current_atom, &current_atom_size)) {
 
-  /* prowl through the moov atom looking for very specific targets */
-  for (i = ATOM_PREAMBLE_SIZE; i < moov_atom_size - 4; i++) {
-    current_atom = BE_32(&moov_atom[i]);
+    atom_start = s->pos;
 
     if (current_atom == MVHD_ATOM) {
-      parse_mvhd_atom(info, &moov_atom[i - 4]);
-      if (info->last_error != QT_OK)
-        return;
-      i += BE_32(&moov_atom[i - 4]) - 4;
+
+      if ((current_atom_size >= 0x14) && (p = moov_stream_get(s, 0x14)))
+        parse_mvhd_atom(info, p);
+
     } else if (current_atom == TRAK_ATOM) {
 
       /* create a new trak structure */
       info->trak_count++;
-      info->traks = (qt_trak *)realloc(info->traks, 
+      info->traks = (qt_trak *)realloc(info->traks,
         info->trak_count * sizeof(qt_trak));
 
-      parse_trak_atom (&info->traks[info->trak_count - 1], &moov_atom[i - 4]);
+      info->last_error = parse_trak_atom (&info->traks[info->trak_count - 1],
+        s, current_atom_size);
       if (info->last_error != QT_OK) {
         info->trak_count--;
         return;
       }
-      i += BE_32(&moov_atom[i - 4]) - 4;
-
-    } else if (current_atom == CPY_ATOM) {
 
-      string_size = BE_16(&moov_atom[i + 4]) + 1;
-      info->copyright = realloc (info->copyright, string_size);
-      strncpy(info->copyright, &moov_atom[i + 8], string_size - 1);
-      info->copyright[string_size - 1] = 0;
+    } else if (current_atom == UDTA_ATOM) {
 
-    } else if (current_atom == DES_ATOM) {
+      atom = load_atom(s, current_atom, current_atom_size);
+      if (atom) {
+        atom_size = current_atom_size + ATOM_PREAMBLE_SIZE;
+        for (i = ATOM_PREAMBLE_SIZE; i < atom_size - 4; i++) {
+          current_atom = BE_32(&atom[i]);
 
-      string_size = BE_16(&moov_atom[i + 4]) + 1;
-      info->description = realloc (info->description, string_size);
-      strncpy(info->description, &moov_atom[i + 8], string_size - 1);
-      info->description[string_size - 1] = 0;
-
-    } else if (current_atom == CMT_ATOM) {
+          if (current_atom == CPY_ATOM)
+            load_udta_string(&info->copyright, atom, i, atom_size);
+          else if (current_atom == DES_ATOM)
+            load_udta_string(&info->description, atom, i, atom_size);
+          else if (current_atom == CMT_ATOM)
+            load_udta_string(&info->comment, atom, i, atom_size);
+        }
+        free(atom);
+      }
 
-      string_size = BE_16(&moov_atom[i + 4]) + 1;
-      info->comment = realloc (info->comment, string_size);
-      strncpy(info->comment, &moov_atom[i + 8], string_size - 1);
-      info->comment[string_size - 1] = 0;
+    } else if (current_atom == RMRA_ATOM) {
 
-    } else if (current_atom == RMDA_ATOM) {
+      atom = load_atom(s, current_atom, current_atom_size);
+      if (atom) {
+        atom_size = current_atom_size + ATOM_PREAMBLE_SIZE;
+        for (i = ATOM_PREAMBLE_SIZE; i < atom_size - 4; i++) {
+          if (BE_32(&atom[i]) != RMDA_ATOM)
+            continue;
 
-      /* create a new reference structure */
-      info->reference_count++;
-      info->references = (reference_t *)realloc(info->references,
-        info->reference_count * sizeof(reference_t));
+          /* create a new reference structure */
+          info->reference_count++;
+          info->references = (reference_t *)realloc(info->references,
+            info->reference_count * sizeof(reference_t));
 
-      parse_reference_atom(&info->references[info->reference_count - 1],
-        &moov_atom[i - 4], info->base_mrl);
+          parse_reference_atom(&info->references[info->reference_count - 1],
+            &atom[i - 4], info->base_mrl);
+        }
+        free(atom);
+      }
+    }
 
+    if (s->error != QT_OK) {
+      info->last_error = s->error;
+      return;
     }
+
+    /* step over whatever part of the atom was not consumed */
+    if (!moov_stream_skip(s, current_atom_size - (s->pos - atom_start)))
+      break;
   }
-  debug_atom_load("  qt: finished parsing moov atom\n");
+  if (s->error != QT_OK) {
+    info->last_error = s->error;
+    return;
+  }
+  debug_atom_load("  qt: finished parsing moov atom, %lld bytes through a %d byte window\n",
+    s->pos, QT_MOOV_WINDOW);
 
   /* build frame tables corresponding to each trak */
   debug_frame_table("  qt: preparing to build %d frame tables\n",
@@ -1812,17 +2479,38 @@ static void parse_moov_atom(qt_info *info, unsigned char *moov_atom,
 
     debug_frame_table("    qt: building frame table #%d (%s)\n", i,
       (info->traks[i].type == MEDIA_VIDEO) ? "video" : "audio");
-    build_frame_table(&info->traks[i], info->timescale);
+    if (build_frame_table(&info->traks[i], info->timescale) != QT_OK) {
+      info->last_error = QT_NO_MEMORY;
+      return;
+    }
 
+#if DEBUG_FRAME_TABLE
     /* dump the frame table in debug mode */
-    for (j = 0; j < info->traks[i].frame_count; j++)
+    for (j = 0; j < info->traks[i].frame_count; j++) {
+      qt_frame *frame = get_frame(&info->traks[i], j);
       debug_frame_table("      %d: %8X bytes @ %llX, %lld pts, media id %d%s\n",
         j,
-        info->traks[i].frames[j].size,
-        info->traks[i].frames[j].offset,
-        info->traks[i].frames[j].pts,
-        info->traks[i].frames[j].media_id,
-        (info->traks[i].frames[j].keyframe) ? " (keyframe)" : "");
+        frame->size,
+        frame->offset,
+        frame->pts,
+        frame->media_id,
+        (frame->keyframe) ? " (keyframe)" : "");
+    }
+
+    /* compare the footprint with what a full frame table would take */
+    debug_frame_table("    qt: %d frames, %d bytes of sample tables, %d bytes of frame window and checkpoints (a full table would be %d bytes)\n",
+      info->traks[i].frame_count,
+      info->traks[i].sample_size_count * 4 +
+        info->traks[i].chunk_offset_count * sizeof(int64_t) +
+        info->traks[i].sync_sample_count * 4 +
+        info->traks[i].sample_to_chunk_count * sizeof(sample_to_chunk_table_t) +
+        info->traks[i].time_to_sample_count * sizeof(time_to_sample_table_t),
+      (info->traks[i].frame_count) ?
+        QT_FRAME_WINDOW * sizeof(qt_frame) +
+        (info->traks[i].frame_count / QT_FRAME_WINDOW + 1) *
+        sizeof(qt_frame_cursor) : 0,
+      info->traks[i].frame_count * sizeof(qt_frame));
+#endif
 
     /* decide which audio trak and which video trak has the most frames */
     if ((info->traks[i].type == MEDIA_VIDEO) &&
@@ -1839,6 +2527,12 @@ static void parse_moov_atom(qt_info *info, unsigned char *moov_atom,
     }
   }
 
+  /* only the winning traks are ever demuxed; drop the tables the others
+   * loaded */
+  for (i = 0; i < info->trak_count; i++)
+    if ((i != info->video_trak) && (i != info->audio_trak))
+      free_trak_tables(&info->traks[i]);
+
   /* check for references */
   if (info->reference_count > 0) {
 
@@ -1868,15 +2562,10 @@ static void parse_moov_atom(qt_info *info, unsigned char *moov_atom,
 static qt_error open_qt_file(qt_info *info, input_plugin_t *input,
                              int64_t bandwidth) {
 
-  unsigned char *moov_atom = NULL;
   off_t moov_atom_offset = -1;
   int64_t moov_atom_size = -1;
   unsigned char preview[MAX_PREVIEW_SIZE];
-
-  /* zlib stuff */
-  z_stream z_state;
-  int z_ret_code;
-  unsigned char *unzip_buffer;
+  qt_moov_stream moov_stream;
 
   /* extract the base MRL if this is a http MRL */
   if (strncmp(input->get_mrl(input), "http://", 7) == 0) {
@@ -1909,94 +2598,320 @@ static qt_error open_qt_file(qt_info *info, input_plugin_t *input,
   }
   info->moov_first_offset = moov_atom_offset;
 
-  moov_atom = (unsigned char *)malloc(moov_atom_size);
-  if (moov_atom == NULL) {
-    info->last_error = QT_NO_MEMORY;
-    return info->last_error;
-  }
-
   /* seek to the start of moov atom */
   if (input->seek(input, info->moov_first_offset, SEEK_SET) !=
     info->moov_first_offset) {
-    free(moov_atom);
     info->last_error = QT_FILE_READ_ERROR;
     return info->last_error;
   }
-  if (input->read(input, moov_atom, moov_atom_size) != 
-    moov_atom_size) {
-    free(moov_atom);
-    info->last_error = QT_FILE_READ_ERROR;
-    return info->last_error;
+
+  /* take apart the moov atom as it streams in */
+  info->last_error = moov_stream_open(&moov_stream, input, moov_atom_size);
+  info->compressed_header = moov_stream.compressed;
+  if (info->last_error == QT_OK)
+    parse_moov_atom(info, &moov_stream, bandwidth);
+  moov_stream_close(&moov_stream);
+
+  return info->last_error;
+}
+
+/**********************************************************************
+ * dispatch staging
+ *
+ * Frames are dispatched to the decoders in the order decided by
+ * demux_qt_send_chunk(), which alternates between the audio and video
+ * traks by pts. On a badly interleaved file, reading each frame as it is
+ * dispatched sends the read head back and forth between the two traks'
+ * data. Instead, when the next frame has not been read yet, the upcoming
+ * frames of both traks are read ahead in ascending file offset, with
+ * neighbouring frames coalesced into single reads, and held in the stage
+ * buffer until their turn comes.
+ **********************************************************************/
+
+static void qt_seek_input(demux_qt_t *this, off_t offset) {
+
+  if (offset != this->input_pos) {
+    this->input->seek(this->input, offset, SEEK_SET);
+    this->input_pos = offset;
+    this->seek_count++;
   }
+}
 
-  /* check if moov is compressed */
-  if (BE_32(&moov_atom[12]) == CMOV_ATOM) {
+/* returns 1 if all size bytes were read */
+static int qt_read_input(demux_qt_t *this, unsigned char *dest,
+                         unsigned int size) {
 
-    info->compressed_header = 1;
+  off_t got = this->input->read(this->input, dest, size);
 
-    z_state.next_in = &moov_atom[0x28];
-    z_state.avail_in = moov_atom_size - 0x28;
-    z_state.avail_out = BE_32(&moov_atom[0x24]);
-    unzip_buffer = (unsigned char *)malloc(BE_32(&moov_atom[0x24]));
-    if (!unzip_buffer) {
-      free(moov_atom);
-      info->last_error = QT_NO_MEMORY;
-      return info->last_error;
+  this->read_count++;
+  if (got > 0) {
+    this->input_pos += got;
+    this->bytes_read += got;
+  } else
+    this->input_pos = -1;
+
+  return (got == size);
+}
+
+/* hand over the next size bytes of a zero-copy input in a single buffer
+ * pointing at the data; returns NULL on a short read */
+static buf_element_t *qt_read_in_place(demux_qt_t *this,
+                                       fifo_buffer_t *fifo,
+                                       unsigned int size) {
+
+  buf_element_t *buf = xine_demux_read_buffer(fifo, this->input, size);
+
+  this->read_count++;
+  if (buf) {
+    this->input_pos += buf->size;
+    this->bytes_read += buf->size;
+  } else
+    this->input_pos = -1;
+
+  return buf;
+}
+
+static qt_trak *stage_trak(demux_qt_t *this, int t) {
+
+  int trak = (t == QT_STAGE_VIDEO) ? this->qt->video_trak :
+    this->qt->audio_trak;
+
+  return (trak == -1) ? NULL : &this->qt->traks[trak];
+}
+
+/* forget everything staged; called whenever the traks are repositioned */
+static void qt_stage_reset(demux_qt_t *this) {
+
+  qt_trak *trak;
+  int t;
+
+  for (t = QT_STAGE_VIDEO; t <= QT_STAGE_AUDIO; t++) {
+    trak = stage_trak(this, t);
+    this->stage_end[t] = (trak) ? trak->current_frame : 0;
+  }
+  this->stage_used = 0;
+}
+
+/* returns the staged entry for frame n of a trak, or NULL */
+static qt_staged_frame *staged_frame(demux_qt_t *this, int t,
+                                     unsigned int n) {
+
+  qt_trak *trak = stage_trak(this, t);
+
+  if (!trak || (n < trak->current_frame) || (n >= this->stage_end[t]))
+    return NULL;
+
+  return &this->staged[t][n % QT_STAGE_FRAMES];
+}
+
+/* like get_frame(), but without disturbing the frame window for frames
+ * that are already staged */
+static qt_frame *peek_frame(demux_qt_t *this, int t, unsigned int n) {
+
+  qt_staged_frame *staged = staged_frame(this, t, n);
+
+  if (staged)
+    return &staged->frame;
+
+  return get_frame(stage_trak(this, t), n);
+}
+
+/* frames that will be skipped at dispatch are never read */
+static int wants_data(demux_qt_t *this, int t, qt_frame *frame) {
+
+  qt_trak *trak = stage_trak(this, t);
+
+  if (t == QT_STAGE_AUDIO)
+    return this->audio_fifo &&
+      (frame->media_id == trak->properties->audio.media_id);
+
+  return (frame->media_id == trak->properties->video.media_id);
+}
+
+/* move the data of the frames that are still pending to the front of the
+ * stage buffer */
+static void qt_stage_compact(demux_qt_t *this) {
+
+  qt_staged_frame *live[2 * QT_STAGE_FRAMES];
+  qt_staged_frame *staged;
+  qt_trak *trak;
+  unsigned int n, used;
+  int count = 0;
+  int t, i, j;
+
+  for (t = QT_STAGE_VIDEO; t <= QT_STAGE_AUDIO; t++) {
+    trak = stage_trak(this, t);
+    if (!trak)
+      continue;
+    for (n = trak->current_frame; n < this->stage_end[t]; n++) {
+      staged = &this->staged[t][n % QT_STAGE_FRAMES];
+      if (staged->stage_offset == QT_NOT_STAGED)
+        continue;
+
+      /* keep the list sorted by position in the buffer */
+      for (i = count; i > 0; i--) {
+        if (live[i - 1]->stage_offset < staged->stage_offset)
+          break;
+        live[i] = live[i - 1];
+      }
+      live[i] = staged;
+      count++;
     }
+  }
 
-    z_state.next_out = unzip_buffer;
-    z_state.zalloc = (alloc_func)0;
-    z_state.zfree = (free_func)0;
-    z_state.opaque = (voidpf)0;
+  used = 0;
+  for (j = 0; j < count; j++) {
+    if (live[j]->stage_offset != used)
+      memmove(&this->stage[used], &this->stage[live[j]->stage_offset],
+        live[j]->frame.size);
+    live[j]->stage_offset = used;
+    used += live[j]->frame.size;
+  }
+  this->stage_used = used;
+}
 
-    z_ret_code = inflateInit (&z_state);
-    if (Z_OK != z_ret_code) {
-      free(unzip_buffer);
-      free(moov_atom);
-      info->last_error = QT_ZLIB_ERROR;
-      return info->last_error;
+/*
+ * Look ahead from frame current_frame of trak 'needed', which must not be
+ * staged yet. Frames from both traks are taken in pts order up to
+ * QT_STAGE_PTS_WINDOW past the earliest pending frame, as long as they fit
+ * the stage buffer, and are then read in ascending file offset.
+ */
+static void qt_stage_frames(demux_qt_t *this, int needed) {
+
+  qt_staged_frame *chosen[2 * QT_STAGE_FRAMES];
+  qt_staged_frame *staged;
+  qt_trak *trak;
+  qt_frame *frame;
+  unsigned int next[2];
+  unsigned int budget, run_size;
+  int64_t pts, pts_limit, best_pts = 0;
+  int count = 0;
+  int t, i, j, k;
+
+  if (!this->stage) {
+    this->stage = (unsigned char *)malloc(QT_STAGE_BYTES);
+    if (!this->stage)
+      return;
+  }
+
+  qt_stage_compact(this);
+  budget = QT_STAGE_BYTES - this->stage_used;
+
+  /* the window opens at the earliest frame still to be dispatched */
+  pts_limit = -1;
+  for (t = QT_STAGE_VIDEO; t <= QT_STAGE_AUDIO; t++) {
+    trak = stage_trak(this, t);
+    if (!trak)
+      continue;
+    if (this->stage_end[t] < trak->current_frame)
+      this->stage_end[t] = trak->current_frame;
+    next[t] = this->stage_end[t];
+    if (trak->current_frame >= trak->frame_count)
+      continue;
+    pts = peek_frame(this, t, trak->current_frame)->pts;
+    if ((pts_limit == -1) || (pts < pts_limit))
+      pts_limit = pts;
+  }
+  pts_limit += QT_STAGE_PTS_WINDOW;
+
+  t = needed;
+  while (t != -1) {
+
+    trak = stage_trak(this, t);
+    staged = &this->staged[t][next[t] % QT_STAGE_FRAMES];
+    staged->frame = *get_frame(trak, next[t]);
+    staged->stage_offset = QT_NOT_STAGED;
+    if (wants_data(this, t, &staged->frame)) {
+      if (staged->frame.size > budget)
+        break;
+      budget -= staged->frame.size;
+      chosen[count++] = staged;
+    }
+    this->stage_end[t] = ++next[t];
+
+    /* continue with whichever trak's next frame comes first */
+    t = -1;
+    for (i = QT_STAGE_VIDEO; i <= QT_STAGE_AUDIO; i++) {
+      trak = stage_trak(this, i);
+      if (!trak || (next[i] >= trak->frame_count) ||
+          (next[i] - trak->current_frame >= QT_STAGE_FRAMES))
+        continue;
+      frame = get_frame(trak, next[i]);
+      if (frame->pts > pts_limit)
+        continue;
+      if ((t == -1) || (frame->pts < best_pts)) {
+        t = i;
+        best_pts = frame->pts;
+      }
     }
+  }
 
-    z_ret_code = inflate(&z_state, Z_NO_FLUSH);
-    if ((z_ret_code != Z_OK) && (z_ret_code != Z_STREAM_END)) {
-      free(unzip_buffer);
-      free(moov_atom);
-      info->last_error = QT_ZLIB_ERROR;
-      return info->last_error;
+  /* sort the reads by file offset */
+  for (i = 1; i < count; i++) {
+    staged = chosen[i];
+    for (j = i; j > 0; j--) {
+      if (chosen[j - 1]->frame.offset <= staged->frame.offset)
+        break;
+      chosen[j] = chosen[j - 1];
     }
+    chosen[j] = staged;
+  }
 
-    z_ret_code = inflateEnd(&z_state);
-    if (Z_OK != z_ret_code) {
-      free(unzip_buffer);
-      free(moov_atom);
-      info->last_error = QT_ZLIB_ERROR;
-      return info->last_error;
+  /* read runs of back-to-back frames in one go; the frames of a failed
+   * read stay unstaged and are read again at dispatch */
+  for (i = 0; i < count; i = j) {
+    run_size = chosen[i]->frame.size;
+    for (j = i + 1; j < count; j++) {
+      if (chosen[j]->frame.offset !=
+          chosen[j - 1]->frame.offset + chosen[j - 1]->frame.size)
+        break;
+      run_size += chosen[j]->frame.size;
     }
 
-    /* replace the compressed moov atom with the decompressed atom */
-    free (moov_atom);
-    moov_atom = unzip_buffer;
-    moov_atom_size = BE_32(&moov_atom[0]);
-  }
+    qt_seek_input(this, chosen[i]->frame.offset);
+    if (!qt_read_input(this, &this->stage[this->stage_used], run_size))
+      continue;
 
-  if (!moov_atom) {
-    info->last_error = QT_NO_MOOV_ATOM;
-    return info->last_error;
+    for (k = i; k < j; k++) {
+      chosen[k]->stage_offset = this->stage_used;
+      this->stage_used += chosen[k]->frame.size;
+      this->staged_count++;
+    }
   }
+}
 
-  /* write moov atom to disk if debugging option is turned on */
-  dump_moov_atom(moov_atom, moov_atom_size);
+/* returns a frame to dispatch and, if it was read ahead, where its data
+ * is; frames that were not are read directly from the input */
+static qt_frame take_frame(demux_qt_t *this, int t, unsigned char **data) {
 
-  /* take apart the moov atom */
-  parse_moov_atom(info, moov_atom, bandwidth);
-  if (info->last_error != QT_OK) {
-    free(moov_atom);
-    return info->last_error;
+  qt_trak *trak = stage_trak(this, t);
+  qt_staged_frame *staged;
+  qt_frame frame;
+
+  /* a zero-copy input costs nothing to seek around in */
+  if (this->zero_copy) {
+    *data = NULL;
+    return *get_frame(trak, trak->current_frame++);
   }
 
-  free(moov_atom);
+  staged = staged_frame(this, t, trak->current_frame);
+  if (!staged) {
+    qt_stage_frames(this, t);
+    staged = staged_frame(this, t, trak->current_frame);
+  }
 
-  return QT_OK;
+  *data = NULL;
+  if (staged) {
+    frame = staged->frame;
+    if (staged->stage_offset != QT_NOT_STAGED)
+      *data = &this->stage[staged->stage_offset];
+  } else
+    frame = *get_frame(trak, trak->current_frame);
+
+  /* the data stays put until the next look ahead */
+  trak->current_frame++;
+
+  return frame;
 }
 
 /**********************************************************************
@@ -2014,9 +2929,12 @@ static int demux_qt_send_chunk(demux_plugin_t *this_gen) {
   qt_trak *video_trak = NULL;
   qt_trak *audio_trak = NULL;
   int dispatch_audio;  /* boolean for deciding which trak to dispatch */
+  int in_place;
   int64_t pts_diff;
   xine_event_t uevent;
   xine_mrl_reference_data_t *data;
+  qt_frame frame;
+  unsigned char *frame_data;
 
   /* check if it's time to send a reference up to the UI */
   if (this->qt->chosen_reference != -1) {
@@ -2056,13 +2974,15 @@ static int demux_qt_send_chunk(demux_plugin_t *this_gen) {
 
     /* if audio is present, send pts of current audio frame, otherwise
      * send current video frame pts */
-    if (audio_trak)
+    if (audio_trak &&
+        (audio_trak->current_frame < audio_trak->frame_count))
       xine_demux_control_newpts(this->stream, 
-        audio_trak->frames[audio_trak->current_frame].pts, 
+        get_frame(audio_trak, audio_trak->current_frame)->pts, 
         BUF_FLAG_SEEK);
-    else
+    else if (video_trak &&
+             (video_trak->current_frame < video_trak->frame_count))
       xine_demux_control_newpts(this->stream, 
-        video_trak->frames[video_trak->current_frame].pts, 
+        get_frame(video_trak, video_trak->current_frame)->pts, 
         BUF_FLAG_SEEK);
   }
 
@@ -2112,8 +3032,9 @@ static int demux_qt_send_chunk(demux_plugin_t *this_gen) {
 
       /* at this point, it is certain that both traks still have frames
        * yet to be dispatched */
-      pts_diff  = audio_trak->frames[audio_trak->current_frame].pts;
-      pts_diff -= video_trak->frames[video_trak->current_frame].pts;
+      frame = *peek_frame(this, QT_STAGE_AUDIO, audio_trak->current_frame);
+      pts_diff  = frame.pts;
+      pts_diff -= peek_frame(this, QT_STAGE_VIDEO, video_trak->current_frame)->pts;
 
       if (pts_diff > MAX_PTS_DIFF) {
         /* if diff is +max_diff, audio is too far ahead of video */
@@ -2121,8 +3042,8 @@ static int demux_qt_send_chunk(demux_plugin_t *this_gen) {
       } else if (pts_diff < -MAX_PTS_DIFF) {
         /* if diff is -max_diff, video is too far ahead of audio */
         dispatch_audio = 1;
-      } else if (audio_trak->frames[audio_trak->current_frame].offset <
-                 video_trak->frames[video_trak->current_frame].offset) {
+      } else if (frame.offset <
+                 peek_frame(this, QT_STAGE_VIDEO, video_trak->current_frame)->offset) {
         /* pts diff is not too wide, decide based on earlier offset */
         dispatch_audio = 1;
       } else {
@@ -2132,22 +3053,23 @@ static int demux_qt_send_chunk(demux_plugin_t *this_gen) {
   }
 
   if (!dispatch_audio) {
-    i = video_trak->current_frame++;
+    i = video_trak->current_frame;
+    frame = take_frame(this, QT_STAGE_VIDEO, &frame_data);
 
-    if (video_trak->frames[i].media_id != video_trak->properties->video.media_id) {
+    if (frame.media_id != video_trak->properties->video.media_id) {
       this->status = DEMUX_OK;
       return this->status;
     }
 
-    remaining_sample_bytes = video_trak->frames[i].size;
-    this->input->seek(this->input, video_trak->frames[i].offset,
-      SEEK_SET);
+    remaining_sample_bytes = frame.size;
+    if (!frame_data)
+      qt_seek_input(this, frame.offset);
 
     if (i + 1 < video_trak->frame_count) {
       /* frame duration is the pts diff between this video frame and
        * the next video frame */
-      frame_duration  = video_trak->frames[i + 1].pts;
-      frame_duration -= video_trak->frames[i].pts;
+      frame_duration  = peek_frame(this, QT_STAGE_VIDEO, i + 1)->pts;
+      frame_duration -= frame.pts;
     } else {
       /* give the last frame some fixed duration */
       frame_duration = 12000;
@@ -2170,36 +3092,47 @@ static int demux_qt_send_chunk(demux_plugin_t *this_gen) {
 
     debug_video_demux("  qt: sending off video frame %d from offset 0x%llX, %d bytes, media id %d, %lld pts\n",
       i, 
-      video_trak->frames[i].offset,
-      video_trak->frames[i].size,
-      video_trak->frames[i].media_id,
-      video_trak->frames[i].pts);
+      frame.offset,
+      frame.size,
+      frame.media_id,
+      frame.pts);
 
     while (remaining_sample_bytes) {
-      buf = this->video_fifo->buffer_pool_alloc (this->video_fifo);
+      if (this->zero_copy) {
+        buf = qt_read_in_place(this, this->video_fifo,
+          remaining_sample_bytes);
+        if (!buf) {
+          this->status = DEMUX_FINISHED;
+          break;
+        }
+      } else {
+        buf = this->video_fifo->buffer_pool_alloc (this->video_fifo);
+        if (remaining_sample_bytes > buf->max_size)
+          buf->size = buf->max_size;
+        else
+          buf->size = remaining_sample_bytes;
+
+        if (frame_data) {
+          memcpy(buf->content, frame_data, buf->size);
+          frame_data += buf->size;
+        } else if (!qt_read_input(this, buf->content, buf->size)) {
+          buf->free_buffer(buf);
+          this->status = DEMUX_FINISHED;
+          break;
+        }
+      }
+      remaining_sample_bytes -= buf->size;
+
       buf->type = video_trak->properties->video.codec_buftype;
-      buf->extra_info->input_pos = video_trak->frames[i].offset - this->data_start;
+      buf->extra_info->input_pos = frame.offset - this->data_start;
       buf->extra_info->input_length = this->data_size;
-      buf->extra_info->input_time = video_trak->frames[i].pts / 90;
-      buf->pts = video_trak->frames[i].pts;
+      buf->extra_info->input_time = frame.pts / 90;
+      buf->pts = frame.pts;
 
       buf->decoder_flags |= BUF_FLAG_FRAMERATE;
       buf->decoder_info[0] = frame_duration;
 
-      if (remaining_sample_bytes > buf->max_size)
-        buf->size = buf->max_size;
-      else
-        buf->size = remaining_sample_bytes;
-      remaining_sample_bytes -= buf->size;
-
-      if (this->input->read(this->input, buf->content, buf->size) !=
-        buf->size) {
-        buf->free_buffer(buf);
-        this->status = DEMUX_FINISHED;
-        break;
-      }
-
-      if (video_trak->frames[i].keyframe)
+      if (frame.keyframe)
         buf->decoder_flags |= BUF_FLAG_KEYFRAME;
       if (!remaining_sample_bytes)
         buf->decoder_flags |= BUF_FLAG_FRAME_END;
@@ -2209,9 +3142,10 @@ static int demux_qt_send_chunk(demux_plugin_t *this_gen) {
 
   } else {
     /* load an audio sample and packetize it */
-    i = audio_trak->current_frame++;
+    i = audio_trak->current_frame;
+    frame = take_frame(this, QT_STAGE_AUDIO, &frame_data);
 
-    if (audio_trak->frames[i].media_id != audio_trak->properties->audio.media_id) {
+    if (frame.media_id != audio_trak->properties->audio.media_id) {
       this->status = DEMUX_OK;
       return this->status;
     }
@@ -2220,22 +3154,52 @@ static int demux_qt_send_chunk(demux_plugin_t *this_gen) {
     if (!this->audio_fifo)
       return this->status;
 
-    remaining_sample_bytes = audio_trak->frames[i].size;
-    this->input->seek(this->input, audio_trak->frames[i].offset,
-      SEEK_SET);
+    remaining_sample_bytes = frame.size;
+    if (!frame_data)
+      qt_seek_input(this, frame.offset);
 
     debug_audio_demux("  qt: sending off audio frame %d from offset 0x%llX, %d bytes, media id %d, %lld pts\n",
       i, 
-      audio_trak->frames[i].offset,
-      audio_trak->frames[i].size,
-      audio_trak->frames[i].media_id,
-      audio_trak->frames[i].pts);
+      frame.offset,
+      frame.size,
+      frame.media_id,
+      frame.pts);
+
+    /* 8-bit 'sowt' data is rewritten below, so it cannot go out in
+     * place */
+    in_place = this->zero_copy &&
+      ((audio_trak->properties->audio.bits != 8) ||
+       (audio_trak->properties->audio.codec_fourcc != SOWT_FOURCC));
 
     first_buf = 1;
     while (remaining_sample_bytes) {
-      buf = this->audio_fifo->buffer_pool_alloc (this->audio_fifo);
+      if (in_place) {
+        buf = qt_read_in_place(this, this->audio_fifo,
+          remaining_sample_bytes);
+        if (!buf) {
+          this->status = DEMUX_FINISHED;
+          break;
+        }
+      } else {
+        buf = this->audio_fifo->buffer_pool_alloc (this->audio_fifo);
+        if (remaining_sample_bytes > buf->max_size)
+          buf->size = buf->max_size;
+        else
+          buf->size = remaining_sample_bytes;
+
+        if (frame_data) {
+          memcpy(buf->content, frame_data, buf->size);
+          frame_data += buf->size;
+        } else if (!qt_read_input(this, buf->content, buf->size)) {
+          buf->free_buffer(buf);
+          this->status = DEMUX_FINISHED;
+          break;
+        }
+      }
+      remaining_sample_bytes -= buf->size;
+
       buf->type = audio_trak->properties->audio.codec_buftype;
-      buf->extra_info->input_pos = audio_trak->frames[i].offset - this->data_start;
+      buf->extra_info->input_pos = frame.offset - this->data_start;
       buf->extra_info->input_length = this->data_size;
       /* The audio chunk is often broken up into multiple 8K buffers when
        * it is sent to the audio decoder. Only attach the proper timestamp
@@ -2246,36 +3210,23 @@ static int demux_qt_send_chunk(demux_plugin_t *this_gen) {
       if ((buf->type == BUF_AUDIO_LPCM_BE) || 
           (buf->type == BUF_AUDIO_LPCM_LE)) { 
         if (first_buf) {
-          buf->extra_info->input_time = audio_trak->frames[i].pts / 90;
-          buf->pts = audio_trak->frames[i].pts;
+          buf->extra_info->input_time = frame.pts / 90;
+          buf->pts = frame.pts;
           first_buf = 0;
         } else {
           buf->extra_info->input_time = 0;
           buf->pts = 0;
         }
       } else {
-        buf->extra_info->input_time = audio_trak->frames[i].pts / 90;
-        buf->pts = audio_trak->frames[i].pts;
-      }
-
-      if (remaining_sample_bytes > buf->max_size)
-        buf->size = buf->max_size;
-      else
-        buf->size = remaining_sample_bytes;
-      remaining_sample_bytes -= buf->size;
-
-      if (this->input->read(this->input, buf->content, buf->size) !=
-        buf->size) {
-        buf->free_buffer(buf);
-        this->status = DEMUX_FINISHED;
-        break;
+        buf->extra_info->input_time = frame.pts / 90;
+        buf->pts = frame.pts;
       }
 
-      /* Special case alert: If this is signed, 8-bit data, transform
-       * the data to unsigned. */
+      /* Special case alert: 8-bit little endian PCM is taken to be
+       * unsigned, so transform signed 8-bit 'sowt' data to unsigned.
+       * 'twos' data is big endian and goes out signed, as it is. */
       if ((audio_trak->properties->audio.bits == 8) && 
-          ((audio_trak->properties->audio.codec_fourcc == TWOS_FOURCC) ||
-           (audio_trak->properties->audio.codec_fourcc == SOWT_FOURCC)))
+          (audio_trak->properties->audio.codec_fourcc == SOWT_FOURCC))
         for (j = 0; j < buf->size; j++)
           buf->content[j] += 0x80;
 
@@ -2311,26 +3262,27 @@ static void demux_qt_send_headers(demux_plugin_t *this_gen) {
   /* figure out where the data begins and ends */
   if (this->qt->video_trak != -1) {
     video_trak = &this->qt->traks[this->qt->video_trak];
-    first_video_offset = video_trak->frames[0].offset;
-    last_video_offset = video_trak->frames[video_trak->frame_count - 1].size +
-      video_trak->frames[video_trak->frame_count - 1].offset;
+    first_video_offset = get_frame(video_trak, 0)->offset;
+    last_video_offset = get_frame(video_trak, video_trak->frame_count - 1)->size +
+      get_frame(video_trak, video_trak->frame_count - 1)->offset;
   }
   if (this->qt->audio_trak != -1) {
     audio_trak = &this->qt->traks[this->qt->audio_trak];
-    first_audio_offset = audio_trak->frames[0].offset;
-    last_audio_offset = audio_trak->frames[audio_trak->frame_count - 1].size +
-      audio_trak->frames[audio_trak->frame_count - 1].offset;
+    first_audio_offset = get_frame(audio_trak, 0)->offset;
+    last_audio_offset = get_frame(audio_trak, audio_trak->frame_count - 1)->size +
+      get_frame(audio_trak, audio_trak->frame_count - 1)->offset;
   }
 
-  if (first_video_offset < first_audio_offset)
+  if ((first_audio_offset == -1) ||
+      ((first_video_offset != -1) && (first_video_offset < first_audio_offset)))
     this->data_start = first_video_offset;
   else
     this->data_start = first_audio_offset;
 
   if (last_video_offset > last_audio_offset)
-    this->data_size = last_video_offset - this->data_size;
+    this->data_size = last_video_offset - this->data_start;
   else
-    this->data_size = last_audio_offset - this->data_size;
+    this->data_size = last_audio_offset - this->data_start;
 
   /* sort out the A/V information */
   if (this->qt->video_trak != -1) {
@@ -2507,47 +3459,44 @@ static int binary_seek(qt_trak *trak, off_t start_pos, int start_time) {
 
   int best_index;
   int left, middle, right;
-  int found;
+
+  if (!trak->frame_count)
+    return DEMUX_FINISHED;
 
   /* perform a binary search on the trak, testing the offset
    * boundaries first; offset request has precedent over time request */
   if (start_pos) {
-    if (start_pos <= trak->frames[0].offset)
+    if (start_pos <= get_frame(trak, 0)->offset)
       best_index = 0;
-    else if (start_pos >= trak->frames[trak->frame_count - 1].offset)
+    else if (start_pos >= get_frame(trak, trak->frame_count - 1)->offset)
       return DEMUX_FINISHED;
     else {
       left = 0;
       right = trak->frame_count - 1;
-      found = 0;
-
-      while (!found) {
+      do {
 	middle = (left + right + 1) / 2;
-        if ((start_pos >= trak->frames[middle].offset) &&
-            (start_pos < trak->frames[middle + 1].offset)) {
-          found = 1;
-        } else if (start_pos < trak->frames[middle].offset) {
-          right = middle - 1;
-        } else {
-          left = middle;
-        }
-      }
+	if (start_pos < get_frame(trak, middle)->offset) {
+	  right = (middle - 1);
+	} else {
+	  left = middle;
+	}
+      } while (left < right);
 
-      best_index = middle;
+      best_index = left;
     }
   } else {
     int64_t pts = 90000 * start_time;
 
-    if (pts <= trak->frames[0].pts)
+    if (pts <= get_frame(trak, 0)->pts)
       best_index = 0;
-    else if (pts >= trak->frames[trak->frame_count - 1].pts)
+    else if (pts >= get_frame(trak, trak->frame_count - 1)->pts)
       return DEMUX_FINISHED;
     else {
       left = 0;
       right = trak->frame_count - 1;
       do {
 	middle = (left + right + 1) / 2;
-	if (pts < trak->frames[middle].pts) {
+	if (pts < get_frame(trak, middle)->pts) {
 	  right = (middle - 1);
 	} else {
 	  left = middle;
@@ -2598,7 +3547,7 @@ static int demux_qt_seek (demux_plugin_t *this_gen,
   /* search back in the video trak for the nearest keyframe */
   if (video_trak)
     while (video_trak->current_frame) {
-      if (video_trak->frames[video_trak->current_frame].keyframe) {
+      if (get_frame(video_trak, video_trak->current_frame)->keyframe) {
         break;
       }
       video_trak->current_frame--;
@@ -2609,15 +3558,17 @@ static int demux_qt_seek (demux_plugin_t *this_gen,
    * that of the keyframe; do not go through with this process there is
    * no video trak */
   if (audio_trak && video_trak) {
-    keyframe_pts = video_trak->frames[video_trak->current_frame].pts;
+    keyframe_pts = get_frame(video_trak, video_trak->current_frame)->pts;
     while (audio_trak->current_frame) {
-      if (audio_trak->frames[audio_trak->current_frame].pts < keyframe_pts) {
+      if (get_frame(audio_trak, audio_trak->current_frame)->pts < keyframe_pts) {
         break;
       }
       audio_trak->current_frame--;
     }
   }
 
+  qt_stage_reset(this);
+
   this->qt->seek_flag = 1;
   this->status = DEMUX_OK;
 
@@ -2634,7 +3585,13 @@ static int demux_qt_seek (demux_plugin_t *this_gen,
 static void demux_qt_dispose (demux_plugin_t *this_gen) {
   demux_qt_t *this = (demux_qt_t *) this_gen;
 
+  debug_dispatch_stats("  demux_qt: %d reads (%lld bytes), %d seeks (%lld bytes/seek), %d frames read ahead\n",
+    this->read_count, this->bytes_read, this->seek_count,
+    (this->seek_count) ? this->bytes_read / this->seek_count : 0,
+    this->staged_count);
+
   free_qt_info(this->qt);
+  free(this->stage);
   free(this);
 }
 
@@ -2648,6 +3605,9 @@ static int demux_qt_get_stream_length (demux_plugin_t *this_gen) {
 
   demux_qt_t *this = (demux_qt_t *) this_gen;
 
+  if (!this->qt->timescale)
+    return 0;
+
   return (int)((int64_t) 1000 * this->qt->duration / this->qt->timescale);
 }
 
@@ -2674,6 +3634,8 @@ static demux_plugin_t *open_plugin (demux_class_t *class_gen, xine_stream_t *str
   this         = xine_xmalloc (sizeof (demux_qt_t));
   this->stream = stream;
   this->input  = input;
+  this->input_pos = -1;
+  this->zero_copy = input->get_capabilities(input) & INPUT_CAP_ZERO_COPY;
 
   /* fetch bandwidth config */
   this->bandwidth = 0x7FFFFFFFFFFFFFFF;  /* assume infinite bandwidth */
@@ -93,28 +93,14 @@ typedef struct {
 static int open_yuv4mpeg2_file(demux_yuv4mpeg2_t *this) {
 
   unsigned char header[Y4M_HEADER_BYTES];
-  unsigned char preview[MAX_PREVIEW_SIZE];
   int i;
 
   this->bih.biWidth = this->bih.biHeight = this->fps = this->data_start = 0;
 
-  if (this->input->get_capabilities(this->input) & INPUT_CAP_SEEKABLE) {
-
-    /* back to the start */
-    this->input->seek(this->input, 0, SEEK_SET);
-
-    /* read a chunk of bytes that should contain all the header info */
-    if (this->input->read(this->input, header, Y4M_HEADER_BYTES) !=
-      Y4M_HEADER_BYTES)
-      return 0;
-
-  } else {
-    this->input->get_optional_data(this->input, preview,
-      INPUT_OPTIONAL_DATA_PREVIEW);
-
-    /* copy over the header bytes for processing */
-    memcpy(header, preview, Y4M_HEADER_BYTES);
-  }
+  /* read a chunk of bytes that should contain all the header info */
+  if (xine_demux_read_header(this->input, header, Y4M_HEADER_BYTES) !=
+    Y4M_HEADER_BYTES)
+    return 0;
 
   /* check for the Y4M signature */
   if (memcmp(header, Y4M_SIGNATURE, Y4M_SIGNATURE_SIZE) != 0)
@@ -173,17 +159,8 @@ static int open_yuv4mpeg2_file(demux_yuv4mpeg2_t *this) {
       !this->fps || !this->data_start)
     return 0;
 
-  /* file is qualified; if the input was not seekable, read the header
-   * bytes out of the stream */
-  if ((this->input->get_capabilities(this->input) & INPUT_CAP_SEEKABLE) == 0) {
-
-    this->input->seek(this->input, this->data_start, SEEK_SET);
-
-  } else {
-
-    /* seek to first frame */
-    this->input->seek(this->input, this->data_start, SEEK_SET);
-  }
+  /* file is qualified; seek to the first frame */
+  this->input->seek(this->input, this->data_start, SEEK_SET);
 
   return 1;
 }
@@ -224,25 +201,19 @@ static int demux_yuv4mpeg2_send_chunk(demux_plugin_t *this_gen) {
   }
 
   while(bytes_remaining) {
-    buf = this->video_fifo->buffer_pool_alloc (this->video_fifo);
+    buf = xine_demux_read_buffer(this->video_fifo, this->input,
+      bytes_remaining);
+    if (!buf) {
+      this->status = DEMUX_FINISHED;
+      break;
+    }
+    bytes_remaining -= buf->size;
+
     buf->type = BUF_VIDEO_YV12;
     buf->extra_info->input_pos = current_file_pos;
     buf->extra_info->input_length = this->data_size;
     buf->pts = pts;
 
-    if (bytes_remaining > buf->max_size)
-      buf->size = buf->max_size;
-    else
-      buf->size = bytes_remaining;
-    bytes_remaining -= buf->size;
-
-    if (this->input->read(this->input, buf->content, buf->size) !=
-      buf->size) {
-      buf->free_buffer(buf);
-      this->status = DEMUX_FINISHED;
-      break;
-    }
-
     if (!bytes_remaining)
       buf->decoder_flags |= BUF_FLAG_FRAME_END;
     this->video_fifo->put(this->video_fifo, buf);
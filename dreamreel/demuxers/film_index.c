@@ -0,0 +1,259 @@
+/*
+ * Copyright (C) 2000-2002 the xine project
+ *
+ * This file is part of xine, a free video player.
+ *
+ * xine is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * xine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA
+ *
+ * The packed sample table of the FILM demuxer. See film_index.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "film_index.h"
+
+#define FILM_ENTRY_AUDIO         0x01
+#define FILM_ENTRY_KEYFRAME      0x02
+#define FILM_ENTRY_GAP           0x04
+#define FILM_ENTRY_NEW_DURATION  0x08
+
+static inline unsigned char *put_varint(unsigned char *p, unsigned int v) {
+
+  while (v >= 0x80) {
+    *p++ = (v & 0x7F) | 0x80;
+    v >>= 7;
+  }
+  *p++ = v;
+
+  return p;
+}
+
+static inline unsigned int get_varint(unsigned char **pp) {
+
+  unsigned char *p = *pp;
+  unsigned int v = 0;
+  int shift = 0;
+
+  do {
+    v |= (*p & 0x7F) << shift;
+    shift += 7;
+  } while (*p++ & 0x80);
+  *pp = p;
+
+  return v;
+}
+
+/* signed deltas are zigzag coded so that small negative values stay small */
+static inline unsigned int zigzag(int v) {
+  return ((unsigned int)v << 1) ^ (unsigned int)(v >> 31);
+}
+
+static inline int get_signed_varint(unsigned char **pp) {
+  unsigned int v = get_varint(pp);
+  return (int)(v >> 1) ^ -(int)(v & 1);
+}
+
+int film_index_init(film_index_t *index, unsigned int count,
+  unsigned int frequency, unsigned int audio_bytes_per_second) {
+
+  free(index->data);
+  free(index->checkpoints);
+  memset(index, 0, sizeof(film_index_t));
+
+  index->frequency = frequency;
+  index->audio_bytes_per_second = audio_bytes_per_second;
+  index->capacity = count;
+  index->group = -1;
+
+  /* most entries pack into 4 bytes or fewer; grow as needed */
+  index->data_alloc = count * 4 + 16;
+  index->data = malloc(index->data_alloc);
+  index->checkpoints = malloc(
+    ((count >> FILM_INDEX_GROUP_BITS) + 1) * sizeof(film_index_state_t));
+  if (!index->data || !index->checkpoints)
+    return 0;
+
+  return 1;
+}
+
+int film_index_add(film_index_t *index, off_t offset,
+  unsigned int size, unsigned int pts, unsigned int duration) {
+
+  film_index_state_t *state = &index->build_state;
+  unsigned char *p;
+  unsigned char *flags;
+  int audio = (pts == 0xFFFFFFFF);
+
+  if (index->count >= index->capacity)
+    return 0;
+
+  /* 1 flags byte + at most 4 5-byte varints */
+  if (index->data_size + 21 > index->data_alloc) {
+    index->data_alloc = index->data_alloc * 2 + 21;
+    p = realloc(index->data, index->data_alloc);
+    if (!p)
+      return 0;
+    index->data = p;
+  }
+
+  state->data_pos = index->data_size;
+  if ((index->count & (FILM_INDEX_GROUP - 1)) == 0)
+    index->checkpoints[index->count >> FILM_INDEX_GROUP_BITS] = *state;
+
+  p = &index->data[index->data_size];
+  flags = p++;
+  *flags = 0;
+  p = put_varint(p, size);
+
+  if (offset != state->next_offset) {
+    *flags |= FILM_ENTRY_GAP;
+    p = put_varint(p, zigzag(offset - state->next_offset));
+  }
+  state->next_offset = offset + size;
+
+  if (audio) {
+    *flags |= FILM_ENTRY_AUDIO;
+    state->audio_bytes += size;
+  } else {
+    /* keyframe if top bit of the pts is 0 */
+    if (!(pts & 0x80000000))
+      *flags |= FILM_ENTRY_KEYFRAME;
+    pts &= 0x7FFFFFFF;
+    p = put_varint(p, zigzag(pts - state->video_ticks));
+    state->video_ticks = pts;
+  }
+
+  if (duration != state->duration[audio]) {
+    *flags |= FILM_ENTRY_NEW_DURATION;
+    p = put_varint(p, duration);
+    state->duration[audio] = duration;
+  }
+
+  index->data_size = p - index->data;
+  index->count++;
+
+  return 1;
+}
+
+void film_index_finish(film_index_t *index) {
+
+  unsigned char *p;
+
+  p = realloc(index->data, index->data_size + 1);
+  if (p) {
+    index->data = p;
+    index->data_alloc = index->data_size + 1;
+  }
+}
+
+void film_index_free(film_index_t *index) {
+
+  free(index->data);
+  free(index->checkpoints);
+  index->data = NULL;
+  index->checkpoints = NULL;
+  index->count = 0;
+}
+
+void film_index_load_group(film_index_t *index, int group) {
+
+  film_index_state_t state = index->checkpoints[group];
+  film_sample_t *sample;
+  unsigned char *p = &index->data[state.data_pos];
+  unsigned int first = group << FILM_INDEX_GROUP_BITS;
+  unsigned int i, flags, ticks;
+
+  index->group = group;
+  index->group_count = index->count - first;
+  if (index->group_count > FILM_INDEX_GROUP)
+    index->group_count = FILM_INDEX_GROUP;
+
+  for (i = 0; i < index->group_count; i++) {
+    sample = &index->samples[i];
+    flags = *p++;
+
+    sample->sample_size = get_varint(&p);
+    sample->sample_offset = state.next_offset;
+    if (flags & FILM_ENTRY_GAP)
+      sample->sample_offset += get_signed_varint(&p);
+    state.next_offset = sample->sample_offset + sample->sample_size;
+
+    sample->audio = (flags & FILM_ENTRY_AUDIO) ? 1 : 0;
+    sample->keyframe = (flags & FILM_ENTRY_KEYFRAME) ? 1 : 0;
+
+    if (sample->audio) {
+      /* figure out audio pts */
+      sample->pts = state.audio_bytes;
+      sample->pts *= 90000;
+      if (index->audio_bytes_per_second)
+        sample->pts /= index->audio_bytes_per_second;
+      state.audio_bytes += sample->sample_size;
+    } else {
+      ticks = state.video_ticks + get_signed_varint(&p);
+      state.video_ticks = ticks;
+
+      /* compute the pts */
+      sample->pts = ticks;
+      sample->pts *= 90000;
+      if (index->frequency)
+        sample->pts /= index->frequency;
+    }
+
+    if (flags & FILM_ENTRY_NEW_DURATION)
+      state.duration[sample->audio] = get_varint(&p);
+    sample->duration = state.duration[sample->audio];
+
+    /* compute the frame duration */
+    if (!sample->audio) {
+      sample->duration *= 90000;
+      if (index->frequency)
+        sample->duration /= index->frequency;
+    }
+  }
+}
+
+/* binary search over the groups for the last one whose first sample
+ * satisfies first->field <= key, then finish with a linear scan; returns
+ * the last sample n with field <= key (or 0) */
+#define FILM_INDEX_SEARCH(name, field, type)                            \
+unsigned int name(film_index_t *index, type key) {                      \
+                                                                        \
+  int left, right, middle;                                              \
+  unsigned int n, last;                                                 \
+                                                                        \
+  left = 0;                                                             \
+  right = (index->count - 1) >> FILM_INDEX_GROUP_BITS;                  \
+  while (left < right) {                                                \
+    middle = (left + right + 1) / 2;                                    \
+    if (key < film_index_get(index,                                     \
+      middle << FILM_INDEX_GROUP_BITS)->field)                          \
+      right = middle - 1;                                               \
+    else                                                                \
+      left = middle;                                                    \
+  }                                                                     \
+                                                                        \
+  last = n = left << FILM_INDEX_GROUP_BITS;                             \
+  for (; n < index->count; n++) {                                       \
+    if (film_index_get(index, n)->field > key)                          \
+      break;                                                            \
+    last = n;                                                           \
+  }                                                                     \
+                                                                        \
+  return last;                                                          \
+}
+
+FILM_INDEX_SEARCH(film_index_find_offset, sample_offset, off_t)
+FILM_INDEX_SEARCH(film_index_find_pts, pts, int64_t)
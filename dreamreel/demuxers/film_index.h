@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2000-2002 the xine project
+ *
+ * This file is part of xine, a free video player.
+ *
+ * xine is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * xine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA
+ *
+ * The packed sample table of the FILM demuxer, kept apart from the
+ * demuxer so that the host benchmarks can check it (bench/film_index_bench)
+ */
+
+#ifndef FILM_INDEX_H
+#define FILM_INDEX_H
+
+#include <inttypes.h>
+#include <sys/types.h>
+
+typedef struct {
+  int audio;  /* audio = 1, video = 0 */
+  off_t sample_offset;
+  unsigned int sample_size;
+  int64_t pts;
+  int64_t duration;
+  int keyframe;
+} film_sample_t;
+
+/*
+ * Long FILM files carry tens of thousands of samples, which is a lot of
+ * main RAM to spend on film_sample_t structures. Instead, the sample table
+ * is kept in a packed form:
+ *
+ *  - each sample is a flags byte followed by variable-length fields:
+ *    the sample size, the distance from the end of the previous sample
+ *    (only when it is not 0), the video pts delta in FILM ticks, and the
+ *    raw duration (only when it differs from the previous sample's)
+ *  - every FILM_INDEX_GROUP samples, a checkpoint records the decoder
+ *    state so that any group can be unpacked without starting from 0
+ *  - one group is kept unpacked as film_sample_t structures; sequential
+ *    playback and short backwards scans are served straight from it
+ */
+#define FILM_INDEX_GROUP_BITS 5
+#define FILM_INDEX_GROUP (1 << FILM_INDEX_GROUP_BITS)
+
+typedef struct {
+  off_t                next_offset;  /* end of the previous sample */
+  unsigned int         video_ticks;  /* raw pts of the previous video sample */
+  unsigned int         audio_bytes;  /* audio bytes before this point */
+  unsigned int         duration[2];  /* previous raw [video, audio] duration */
+  unsigned int         data_pos;     /* offset into the packed entries */
+} film_index_state_t;
+
+typedef struct {
+  unsigned char       *data;
+  unsigned int         data_size;
+  unsigned int         data_alloc;
+  unsigned int         count;
+  unsigned int         capacity;
+
+  film_index_state_t  *checkpoints;
+  film_index_state_t   build_state;
+
+  /* pts conversion parameters */
+  unsigned int         frequency;
+  unsigned int         audio_bytes_per_second;
+
+  /* the currently unpacked group */
+  int                  group;
+  unsigned int         group_count;
+  film_sample_t        samples[FILM_INDEX_GROUP];
+} film_index_t;
+
+/* returns 1 if the index was set up for count samples, 0 otherwise */
+int film_index_init(film_index_t *index, unsigned int count,
+  unsigned int frequency, unsigned int audio_bytes_per_second);
+
+/* append a sample in the same terms as a STAB entry: a pts of 0xFFFFFFFF
+ * marks an audio sample; returns 0 if memory ran out */
+int film_index_add(film_index_t *index, off_t offset,
+  unsigned int size, unsigned int pts, unsigned int duration);
+
+/* release the slack left over from building the index */
+void film_index_finish(film_index_t *index);
+void film_index_free(film_index_t *index);
+
+/* unpack a whole group into the sample cache */
+void film_index_load_group(film_index_t *index, int group);
+
+/* fetch sample n; neighbouring samples in either direction are cheap */
+static inline film_sample_t *film_index_get(film_index_t *index,
+  unsigned int n) {
+
+  int group = n >> FILM_INDEX_GROUP_BITS;
+
+  if (group != index->group)
+    film_index_load_group(index, group);
+
+  return &index->samples[n & (FILM_INDEX_GROUP - 1)];
+}
+
+/* return the last sample n whose offset (or pts) is <= key, or 0 */
+unsigned int film_index_find_offset(film_index_t *index, off_t key);
+unsigned int film_index_find_pts(film_index_t *index, int64_t key);
+
+#endif
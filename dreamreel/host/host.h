@@ -0,0 +1,18 @@
+#ifndef DREAMREEL_HOST_H
+#define DREAMREEL_HOST_H
+
+#include <stdint.h>
+
+/* what the null video output saw of the stream */
+typedef struct {
+  int      frames;
+  int      rgb565_frames;   /* PAL8 frames that went out as RGB565 */
+  int64_t  last_pts;
+  uint64_t first_frame_ns;  /* timer_ns_gettime64() at the first frame */
+  uint64_t decode_ns;
+  uint64_t twiddle_ns;
+} video_out_stats_t;
+
+void video_out_null_get_stats(video_out_stats_t *stats);
+
+#endif
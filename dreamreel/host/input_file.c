@@ -0,0 +1,218 @@
+/*
+ * POSIX File Input Plugin for the Dreamreel host build
+ *
+ * Takes the same file:// MRLs as the CD input (the path starts at the
+ * slash after "file:/") as well as plain paths.
+ */
+
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "dreamreel.h"
+
+typedef struct {
+  input_plugin_t       input_plugin;
+
+  xine_stream_t       *stream;
+
+  int fd;
+  char *mrl;
+
+  unsigned char preview[MAX_PREVIEW_SIZE];
+  int preview_size;
+
+} file_input_plugin_t;
+
+typedef struct {
+
+  input_class_t        input_class;
+
+  xine_t              *xine;
+  config_values_t     *config;
+
+} file_input_class_t;
+
+static uint32_t file_plugin_get_capabilities (input_plugin_t *this_gen) {
+
+  return INPUT_CAP_SEEKABLE | INPUT_CAP_PREVIEW;
+}
+
+static off_t file_plugin_read (input_plugin_t *this_gen, char *buf,
+  off_t len) {
+
+  file_input_plugin_t *this = (file_input_plugin_t *) this_gen;
+  off_t total = 0;
+  ssize_t n;
+
+  /* a regular file only comes up short at the end, but read() may still
+   * return less than asked for */
+  while (total < len) {
+    n = read(this->fd, &buf[total], len - total);
+    if (n <= 0)
+      break;
+    total += n;
+  }
+
+  return total;
+}
+
+static buf_element_t *file_plugin_read_block (input_plugin_t *this_gen,
+  fifo_buffer_t *fifo, off_t nlen) {
+
+  return NULL;
+}
+
+static off_t file_plugin_seek (input_plugin_t *this_gen, off_t offset,
+  int origin) {
+
+  file_input_plugin_t *this = (file_input_plugin_t *) this_gen;
+
+  return lseek(this->fd, offset, origin);
+}
+
+static off_t file_plugin_get_current_pos (input_plugin_t *this_gen){
+
+  file_input_plugin_t *this = (file_input_plugin_t *) this_gen;
+
+  return lseek(this->fd, 0, SEEK_CUR);
+}
+
+static off_t file_plugin_get_length (input_plugin_t *this_gen) {
+
+  file_input_plugin_t *this = (file_input_plugin_t *) this_gen;
+  struct stat st;
+
+  if (fstat(this->fd, &st) < 0)
+    return 0;
+  return st.st_size;
+}
+
+static uint32_t file_plugin_get_blocksize (input_plugin_t *this_gen) {
+
+  return 0;
+}
+
+static char* file_plugin_get_mrl (input_plugin_t *this_gen) {
+  file_input_plugin_t *this = (file_input_plugin_t *) this_gen;
+
+  return this->mrl;
+}
+
+static int file_plugin_get_optional_data (input_plugin_t *this_gen,
+                                          void *data, int data_type) {
+
+  file_input_plugin_t *this = (file_input_plugin_t *) this_gen;
+
+  if (data_type != INPUT_OPTIONAL_DATA_PREVIEW)
+    return INPUT_OPTIONAL_UNSUPPORTED;
+
+  memcpy(data, this->preview, this->preview_size);
+  return this->preview_size;
+}
+
+static void file_plugin_dispose (input_plugin_t *this_gen ) {
+
+  file_input_plugin_t *this = (file_input_plugin_t *) this_gen;
+
+  close(this->fd);
+
+  free(this->mrl);
+
+  free(this);
+}
+
+static input_plugin_t *open_plugin (input_class_t *cls_gen, xine_stream_t *stream,
+                                    const char *data) {
+
+  file_input_plugin_t *this;
+  const char *filename;
+  int fd;
+
+  /* qualify the MRL; anything without a scheme is taken as a path */
+  if (strncasecmp (data, "file://", 7) == 0)
+    filename = &data[6];
+  else if (!strstr (data, "://"))
+    filename = data;
+  else
+    return NULL;
+
+  fd = open(filename, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+
+  this = (file_input_plugin_t *) xine_xmalloc (sizeof (file_input_plugin_t));
+  this->stream = stream;
+
+  this->fd = fd;
+
+  this->input_plugin.get_capabilities   = file_plugin_get_capabilities;
+  this->input_plugin.read               = file_plugin_read;
+  this->input_plugin.read_block         = file_plugin_read_block;
+  this->input_plugin.seek               = file_plugin_seek;
+  this->input_plugin.get_current_pos    = file_plugin_get_current_pos;
+  this->input_plugin.get_length         = file_plugin_get_length;
+  this->input_plugin.get_blocksize      = file_plugin_get_blocksize;
+  this->input_plugin.get_mrl            = file_plugin_get_mrl;
+  this->input_plugin.get_optional_data  = file_plugin_get_optional_data;
+  this->input_plugin.dispose            = file_plugin_dispose;
+  this->input_plugin.input_class        = cls_gen;
+
+  this->mrl = strdup(data);
+
+  this->preview_size = file_plugin_read(&this->input_plugin, this->preview,
+    MAX_PREVIEW_SIZE);
+  lseek(fd, 0, SEEK_SET);
+
+  return &this->input_plugin;
+}
+
+static char ** file_class_get_autoplay_list (input_class_t *this_gen,
+					    int *num_files) {
+
+  return NULL;
+}
+
+static char *file_class_get_identifier (input_class_t *this_gen) {
+
+  return "file";
+
+}
+
+static char *file_class_get_description (input_class_t *this_gen) {
+
+  return "POSIX file input for the host build";
+
+}
+
+static xine_mrl_t **file_class_get_dir (input_class_t *this_gen,
+                                          const char *filename, int *nFiles) {
+
+  return NULL;
+}
+
+static void file_class_dispose (input_class_t *this_gen) {
+
+  file_input_class_t  *this = (file_input_class_t *) this_gen;
+
+  free (this);
+}
+
+void *host_file_init_plugin (xine_t *xine, void *data) {
+
+  file_input_class_t  *this;
+
+  this = (file_input_class_t *) xine_xmalloc (sizeof (file_input_class_t));
+
+  this->xine   = xine;
+  this->config = xine->config;
+
+  this->input_class.open_plugin        = open_plugin;
+  this->input_class.get_identifier     = file_class_get_identifier;
+  this->input_class.get_description    = file_class_get_description;
+  this->input_class.get_dir            = file_class_get_dir;
+  this->input_class.get_autoplay_list  = file_class_get_autoplay_list;
+  this->input_class.dispose            = file_class_dispose;
+  this->input_class.eject_media        = NULL;
+
+  return this;
+}
@@ -0,0 +1,111 @@
+/*
+ * Dreamreel host platform shim
+ *
+ * This header stands in for <kos.h> in the host build. It covers only the
+ * parts of KOS that the engine uses outside of the console front end and
+ * the PVR video output: files, VMU packages, threads, mutexes and the
+ * millisecond timer. Threads are POSIX threads; the rest is implemented
+ * in kos_shim.c.
+ */
+
+#ifndef DREAMREEL_HOST_KOS_H
+#define DREAMREEL_HOST_KOS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <sys/types.h>
+
+typedef uint8_t  uint8;
+typedef uint16_t uint16;
+typedef uint32_t uint32;
+typedef uint64_t uint64;
+
+/* there is no VRAM on the host; textures live in main memory */
+typedef void *pvr_ptr_t;
+
+/**************************************************************************
+ * files
+ **************************************************************************/
+
+/* as with KOS, 0 is never a valid handle */
+typedef int file_t;
+
+file_t fs_open(const char *fn, int mode);
+void   fs_close(file_t fd);
+ssize_t fs_read(file_t fd, void *buffer, size_t count);
+ssize_t fs_write(file_t fd, const void *buffer, size_t count);
+off_t  fs_seek(file_t fd, off_t offset, int whence);
+off_t  fs_tell(file_t fd);
+size_t fs_total(file_t fd);
+void  *fs_mmap(file_t fd);
+
+/**************************************************************************
+ * VMU packages
+ **************************************************************************/
+
+/* the header that the BIOS file manager reads from a VMU file, built and
+ * parsed the way KOS does it */
+#define VMUPKG_EC_NONE 0
+
+typedef struct {
+  char         desc_short[20];
+  char         desc_long[36];
+  char         app_id[20];
+  int          icon_cnt;
+  int          icon_anim_speed;
+  int          eyecatch_type;
+  int          data_len;
+  uint16       icon_pal[16];
+  const uint8 *icon_data;
+  const uint8 *eyecatch_data;
+  const uint8 *data;
+} vmu_pkg_t;
+
+int vmu_pkg_build(vmu_pkg_t *src, uint8 **dst, int *dst_size);
+int vmu_pkg_parse(uint8 *data, vmu_pkg_t *pkg);
+
+/**************************************************************************
+ * threads
+ **************************************************************************/
+
+typedef struct kthread_s kthread_t;
+
+kthread_t *thd_create(void (*routine)(void *param), void *param);
+void thd_set_label(kthread_t *thd, const char *label);
+int  thd_wait(kthread_t *thd);
+void thd_pass(void);
+void thd_schedule_next(kthread_t *thd);
+
+/* The engine polls: a thread that has nothing to do calls thd_pass()
+ * until there is. The time a thread spends in there is counted so that
+ * the busy time of a pipeline stage can be told from its waiting. */
+uint64_t thd_wait_ns(void);
+
+/**************************************************************************
+ * mutexes
+ **************************************************************************/
+
+/* KOS mutexes double as flags in the engine: one thread locks a fifo and
+ * another one unlocks it, which POSIX mutexes do not allow. */
+typedef struct {
+  volatile int locked;
+} mutex_t;
+
+mutex_t *mutex_create(void);
+void mutex_destroy(mutex_t *m);
+void mutex_lock(mutex_t *m);
+int  mutex_trylock(mutex_t *m);
+void mutex_unlock(mutex_t *m);
+int  mutex_is_locked(mutex_t *m);
+
+/**************************************************************************
+ * timer
+ **************************************************************************/
+
+uint64_t timer_ms_gettime64(void);
+uint64_t timer_us_gettime64(void);
+uint64_t timer_ns_gettime64(void);
+
+#endif
@@ -0,0 +1,328 @@
+/*
+ * kos_shim.c
+ *
+ * The host side of the KOS calls that the engine makes. See kos.h.
+ */
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "kos.h"
+
+/**************************************************************************
+ * files
+ **************************************************************************/
+
+file_t fs_open(const char *fn, int mode) {
+
+  int fd;
+
+  if (mode & (O_WRONLY | O_RDWR))
+    mode |= O_CREAT;
+  fd = open(fn, mode, 0644);
+
+  return (fd < 0) ? 0 : fd + 1;
+}
+
+void fs_close(file_t fd) {
+
+  close(fd - 1);
+}
+
+ssize_t fs_read(file_t fd, void *buffer, size_t count) {
+
+  return read(fd - 1, buffer, count);
+}
+
+ssize_t fs_write(file_t fd, const void *buffer, size_t count) {
+
+  return write(fd - 1, buffer, count);
+}
+
+off_t fs_seek(file_t fd, off_t offset, int whence) {
+
+  return lseek(fd - 1, offset, whence);
+}
+
+off_t fs_tell(file_t fd) {
+
+  return lseek(fd - 1, 0, SEEK_CUR);
+}
+
+size_t fs_total(file_t fd) {
+
+  struct stat st;
+
+  if (fstat(fd - 1, &st) < 0)
+    return 0;
+  return st.st_size;
+}
+
+/* the mapping stays until the process exits, the way a romdisk would */
+void *fs_mmap(file_t fd) {
+
+  size_t size = fs_total(fd);
+  void *data;
+
+  if (!size)
+    return NULL;
+  data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd - 1, 0);
+
+  return (data == MAP_FAILED) ? NULL : data;
+}
+
+/**************************************************************************
+ * VMU packages
+ **************************************************************************/
+
+/* the header as it is laid out in the file, little endian */
+#define PKG_HEADER_SIZE 128
+#define PKG_ICON_SIZE   512
+
+static int pkg_eyecatch_size(int eyecatch_type) {
+
+  switch (eyecatch_type) {
+  case 1: return 8064;
+  case 2: return 4544;
+  case 3: return 2048;
+  default: return 0;
+  }
+}
+
+static int pkg_crc(const uint8 *buf, int size) {
+
+  int i, c, n;
+
+  for (i = 0, n = 0; i < size; i++) {
+    n ^= buf[i] << 8;
+    for (c = 0; c < 8; c++)
+      n = (n & 0x8000) ? (n << 1) ^ 4129 : n << 1;
+  }
+
+  return n & 0xFFFF;
+}
+
+static void put_le(uint8 *p, uint32 v, int bytes) {
+
+  while (bytes--) {
+    *p++ = v;
+    v >>= 8;
+  }
+}
+
+static uint32 get_le(const uint8 *p, int bytes) {
+
+  uint32 v = 0;
+
+  while (bytes--)
+    v = (v << 8) | p[bytes];
+
+  return v;
+}
+
+/* strings are space padded and not terminated */
+static void put_string(uint8 *p, const char *s, int size) {
+
+  int len = strlen(s);
+
+  memset(p, ' ', size);
+  memcpy(p, s, (len < size) ? len : size);
+}
+
+int vmu_pkg_build(vmu_pkg_t *src, uint8 **dst, int *dst_size) {
+
+  int icons = src->icon_cnt * PKG_ICON_SIZE;
+  int eyecatch = pkg_eyecatch_size(src->eyecatch_type);
+  int size = PKG_HEADER_SIZE + icons + eyecatch + src->data_len;
+  uint8 *p;
+  int i;
+
+  p = calloc(1, size);
+  if (!p)
+    return -1;
+
+  put_string(p + 0x00, src->desc_short, 16);
+  put_string(p + 0x10, src->desc_long, 32);
+  put_string(p + 0x30, src->app_id, 16);
+  put_le(p + 0x40, src->icon_cnt, 2);
+  put_le(p + 0x42, src->icon_anim_speed, 2);
+  put_le(p + 0x44, src->eyecatch_type, 2);
+  put_le(p + 0x48, src->data_len, 4);
+  for (i = 0; i < 16; i++)
+    put_le(p + 0x60 + i * 2, src->icon_pal[i], 2);
+  memcpy(p + PKG_HEADER_SIZE, src->icon_data, icons);
+  memcpy(p + PKG_HEADER_SIZE + icons, src->eyecatch_data, eyecatch);
+  memcpy(p + PKG_HEADER_SIZE + icons + eyecatch, src->data, src->data_len);
+  put_le(p + 0x46, pkg_crc(p, size), 2);
+
+  *dst = p;
+  *dst_size = size;
+
+  return 0;
+}
+
+int vmu_pkg_parse(uint8 *data, vmu_pkg_t *pkg) {
+
+  int icons, eyecatch, size, crc, i;
+
+  memset(pkg, 0, sizeof(vmu_pkg_t));
+  memcpy(pkg->desc_short, data + 0x00, 16);
+  memcpy(pkg->desc_long, data + 0x10, 32);
+  memcpy(pkg->app_id, data + 0x30, 16);
+  pkg->icon_cnt = get_le(data + 0x40, 2);
+  pkg->icon_anim_speed = get_le(data + 0x42, 2);
+  pkg->eyecatch_type = get_le(data + 0x44, 2);
+  pkg->data_len = get_le(data + 0x48, 4);
+  for (i = 0; i < 16; i++)
+    pkg->icon_pal[i] = get_le(data + 0x60 + i * 2, 2);
+
+  icons = pkg->icon_cnt * PKG_ICON_SIZE;
+  eyecatch = pkg_eyecatch_size(pkg->eyecatch_type);
+  size = PKG_HEADER_SIZE + icons + eyecatch + pkg->data_len;
+  pkg->icon_data = data + PKG_HEADER_SIZE;
+  pkg->eyecatch_data = data + PKG_HEADER_SIZE + icons;
+  pkg->data = data + PKG_HEADER_SIZE + icons + eyecatch;
+
+  /* the CRC is taken with its own field zeroed */
+  crc = get_le(data + 0x46, 2);
+  put_le(data + 0x46, 0, 2);
+  i = pkg_crc(data, size);
+  put_le(data + 0x46, crc, 2);
+
+  return (i == crc) ? 0 : -1;
+}
+
+/**************************************************************************
+ * threads
+ **************************************************************************/
+
+struct kthread_s {
+  pthread_t thread;
+  void (*routine)(void *param);
+  void *param;
+  char label[64];
+};
+
+static __thread uint64_t wait_ns;
+
+static uint64_t now_ns(void) {
+
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void *thread_start(void *v) {
+
+  kthread_t *thd = (kthread_t *)v;
+
+  thd->routine(thd->param);
+  return NULL;
+}
+
+kthread_t *thd_create(void (*routine)(void *param), void *param) {
+
+  kthread_t *thd = calloc(1, sizeof(kthread_t));
+
+  thd->routine = routine;
+  thd->param = param;
+  if (pthread_create(&thd->thread, NULL, thread_start, thd) != 0) {
+    free(thd);
+    return NULL;
+  }
+
+  return thd;
+}
+
+void thd_set_label(kthread_t *thd, const char *label) {
+
+  strncpy(thd->label, label, sizeof(thd->label) - 1);
+  pthread_setname_np(thd->thread, thd->label);
+}
+
+int thd_wait(kthread_t *thd) {
+
+  pthread_join(thd->thread, NULL);
+  free(thd);
+
+  return 0;
+}
+
+void thd_pass(void) {
+
+  uint64_t start = now_ns();
+
+  sched_yield();
+  wait_ns += now_ns() - start;
+}
+
+/* the host scheduler does not take hints */
+void thd_schedule_next(kthread_t *thd) {
+}
+
+uint64_t thd_wait_ns(void) {
+
+  return wait_ns;
+}
+
+/**************************************************************************
+ * mutexes
+ **************************************************************************/
+
+mutex_t *mutex_create(void) {
+
+  return calloc(1, sizeof(mutex_t));
+}
+
+void mutex_destroy(mutex_t *m) {
+
+  free(m);
+}
+
+void mutex_lock(mutex_t *m) {
+
+  while (mutex_trylock(m) != 0)
+    thd_pass();
+}
+
+/* as with KOS, returns 0 if the mutex was taken and -1 if it was not */
+int mutex_trylock(mutex_t *m) {
+
+  return __sync_bool_compare_and_swap(&m->locked, 0, 1) ? 0 : -1;
+}
+
+void mutex_unlock(mutex_t *m) {
+
+  __sync_lock_release(&m->locked);
+}
+
+int mutex_is_locked(mutex_t *m) {
+
+  return m->locked;
+}
+
+/**************************************************************************
+ * timer
+ **************************************************************************/
+
+uint64_t timer_ms_gettime64(void) {
+
+  return now_ns() / 1000000;
+}
+
+uint64_t timer_us_gettime64(void) {
+
+  return now_ns() / 1000;
+}
+
+uint64_t timer_ns_gettime64(void) {
+
+  return now_ns();
+}
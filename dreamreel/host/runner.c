@@ -0,0 +1,149 @@
+/*
+ * runner.c
+ *
+ * Headless Dreamreel for the host: plays one MRL through the demux,
+ * decode and twiddle stages as fast as they will go and reports how
+ * long each stage was busy.
+ *
+ *   ./dreamreel-host file://path/to/movie.flc
+ *
+ * Each stage runs in its own thread, as it does on the console. Time a
+ * thread spends polling for work (in thd_pass()) does not count as busy.
+ */
+
+#include "dreamreel.h"
+#include "trace.h"
+#include "host.h"
+
+void demux_thread(void *v);
+void demux_thread_start(void);
+void video_decoder_thread(void *v);
+void audio_decoder_thread(void *v);
+
+void init_xine_t(xine_t *xine);
+void init_xine_stream_t(xine_stream_t *stream);
+void init_modules(xine_t *xine);
+void find_input_module(xine_stream_t *stream, char *mrl);
+void find_demux_module(xine_stream_t *stream, char *mrl);
+void register_decoders(void);
+
+typedef struct {
+  const char  *name;
+  void       (*routine)(void *v);
+  void        *param;
+  kthread_t   *thread;
+  uint64_t     busy_ns;
+} stage_t;
+
+static void run_stage(void *v) {
+
+  stage_t *stage = (stage_t *)v;
+  uint64_t start = timer_ns_gettime64();
+
+  stage->routine(stage->param);
+  stage->busy_ns = timer_ns_gettime64() - start - thd_wait_ns();
+}
+
+static void start_stage(stage_t *stage, const char *name,
+                        void (*routine)(void *v), void *param) {
+
+  stage->name = name;
+  stage->routine = routine;
+  stage->param = param;
+  stage->busy_ns = 0;
+  stage->thread = thd_create(run_stage, stage);
+  thd_set_label(stage->thread, name);
+}
+
+/* frames per second are only given for the stages that handle video */
+static void print_stage(const char *name, uint64_t ns, int frames) {
+
+  double ms = ns / 1000000.0;
+
+  if (ns && frames)
+    printf ("  %-14s %10.2f ms %10.1f fps\n", name, ms,
+      frames * 1000.0 / ms);
+  else
+    printf ("  %-14s %10.2f ms\n", name, ms);
+}
+
+int main(int argc, char *argv[]) {
+
+  xine_t xine;
+  xine_stream_t stream;
+  stage_t demux, video, audio;
+  video_out_stats_t stats;
+  uint64_t open_start, play_start, play_end;
+  char *mrl;
+
+  if (argc != 2) {
+    fprintf (stderr, "usage: %s MRL\n", argv[0]);
+    return 1;
+  }
+  mrl = argv[1];
+
+  memset(&xine, 0, sizeof(xine));
+  memset(&stream, 0, sizeof(stream));
+
+  register_decoders();
+  init_xine_t(&xine);
+  init_xine_stream_t(&stream);
+  init_modules(&xine);
+
+  open_start = timer_ns_gettime64();
+  find_input_module(&stream, mrl);
+  if (!stream.input) {
+    fprintf (stderr, "%s: no input plugin could open %s\n", argv[0], mrl);
+    return 1;
+  }
+  find_demux_module(&stream, mrl);
+  if (!stream.demux) {
+    fprintf (stderr, "%s: no demuxer recognized %s\n", argv[0], mrl);
+    return 1;
+  }
+
+  /* the demux thread waits for the start signal before it sends the
+   * headers, so the decoders are in place by then */
+  play_start = timer_ns_gettime64();
+  start_stage(&demux, "demux", demux_thread, &stream);
+  start_stage(&video, "video decoder", video_decoder_thread, &stream);
+  start_stage(&audio, "audio decoder", audio_decoder_thread, &stream);
+  demux_thread_start();
+
+  thd_wait(demux.thread);
+  thd_wait(video.thread);
+  thd_wait(audio.thread);
+  play_end = timer_ns_gettime64();
+
+  video_out_null_get_stats(&stats);
+
+  printf ("%s\n", mrl);
+  printf ("  demuxer: %s\n",
+    stream.demux->demux_class->get_description(stream.demux->demux_class));
+  printf ("  video: %d x %d, %s, %d frames\n",
+    stream.stream_info[XINE_STREAM_INFO_VIDEO_WIDTH],
+    stream.stream_info[XINE_STREAM_INFO_VIDEO_HEIGHT],
+    stream.stream_info[XINE_STREAM_INFO_VIDEO_HANDLED] ?
+      "decoded" : "not decoded",
+    stats.frames);
+  if (stats.rgb565_frames)
+    printf ("  %d PAL8 frames went out as RGB565\n", stats.rgb565_frames);
+  printf ("  opened in %.2f ms, first frame after %.2f ms\n",
+    (play_start - open_start) / 1000000.0,
+    stats.frames ? (stats.first_frame_ns - play_start) / 1000000.0 : 0.0);
+
+  print_stage("demux", demux.busy_ns, stats.frames);
+  print_stage("video decoder", video.busy_ns, stats.frames);
+  print_stage("  decode", stats.decode_ns, stats.frames);
+  print_stage("  twiddle", stats.twiddle_ns, stats.frames);
+  print_stage("audio decoder", audio.busy_ns, 0);
+  print_stage("wall", play_end - play_start, stats.frames);
+
+  if (TRACE_PIPELINE && trace_dump("dreamreel.trace"))
+    printf ("  trace written to dreamreel.trace\n");
+
+  stream.demux->dispose(stream.demux);
+  stream.input->dispose(stream.input);
+
+  return 0;
+}
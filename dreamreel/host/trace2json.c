@@ -0,0 +1,106 @@
+/*
+ * trace2json.c
+ *
+ * Turns a pipeline trace dump (see core/trace.h) into Chrome trace JSON,
+ * for chrome://tracing or Perfetto:
+ *
+ *   ./trace2json dreamreel.trace > dreamreel.json
+ *
+ * Every ring becomes a thread of its own. Timestamps start at the first
+ * event of the dump.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+
+static const char *ring_names[] = TRACE_RING_NAMES;
+static const char *event_names[] = TRACE_EVENT_NAMES;
+
+typedef struct {
+  uint32_t        head;
+  trace_event_t  *events;
+  uint32_t        first;  /* the oldest event that is still in the ring */
+} ring_t;
+
+int main(int argc, char *argv[]) {
+
+  trace_file_header_t header;
+  ring_t *rings;
+  trace_event_t *e;
+  FILE *f;
+  uint64_t base, time, last;
+  uint32_t i, j;
+  int first = 1;
+
+  if (argc != 2) {
+    fprintf (stderr, "usage: %s TRACE-DUMP\n", argv[0]);
+    return 1;
+  }
+  f = fopen(argv[1], "rb");
+  if (!f) {
+    perror(argv[1]);
+    return 1;
+  }
+  if (fread(&header, sizeof(header), 1, f) != 1 ||
+      memcmp(header.magic, TRACE_MAGIC, 4) ||
+      header.version != TRACE_VERSION ||
+      header.ring_count != TRACE_RING_COUNT ||
+      !header.ring_size || (header.ring_size & (header.ring_size - 1))) {
+    fprintf (stderr, "%s: not a trace dump this tool understands\n", argv[1]);
+    return 1;
+  }
+
+  rings = calloc(header.ring_count, sizeof(ring_t));
+  for (i = 0; i < header.ring_count; i++) {
+    rings[i].events = malloc(header.ring_size * sizeof(trace_event_t));
+    if (fread(&rings[i].head, sizeof(uint32_t), 1, f) != 1 ||
+        fread(rings[i].events, sizeof(trace_event_t), header.ring_size, f) !=
+          header.ring_size) {
+      fprintf (stderr, "%s: truncated\n", argv[1]);
+      return 1;
+    }
+    rings[i].first = (rings[i].head > header.ring_size) ?
+      rings[i].head - header.ring_size : 0;
+  }
+  fclose(f);
+
+  /* the earliest event of all rings is time 0 */
+  base = ~(uint64_t)0;
+  for (i = 0; i < header.ring_count; i++)
+    if (rings[i].head) {
+      e = &rings[i].events[rings[i].first & (header.ring_size - 1)];
+      if (e->time_us < base)
+        base = e->time_us;
+    }
+
+  printf ("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  for (i = 0; i < header.ring_count; i++) {
+    printf ("%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+      "\"args\":{\"name\":\"%s\"}}", first ? "" : ",\n", i, ring_names[i]);
+    first = 0;
+
+    /* the timer is 32 bits of microseconds; carry over wraps */
+    last = 0;
+    for (j = rings[i].first; j != rings[i].head; j++) {
+      e = &rings[i].events[j & (header.ring_size - 1)];
+      time = (last & ~(uint64_t)0xFFFFFFFF) | e->time_us;
+      if (time < last)
+        time += (uint64_t)1 << 32;
+      last = time;
+
+      printf (",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu,\"pid\":1,"
+        "\"tid\":%u", e->event < TRACE_EVENT_COUNT ?
+          event_names[e->event] : "unknown",
+        e->phase, (unsigned long long)(time - base), i);
+      if (e->phase == TRACE_INSTANT)
+        printf (",\"s\":\"t\"");
+      printf (",\"args\":{\"arg0\":%u,\"arg1\":%u}}", e->arg0, e->arg1);
+    }
+  }
+  printf ("\n]}\n");
+
+  return 0;
+}
@@ -0,0 +1,144 @@
+/*
+ * video_out_null.c
+ *
+ * The video output of the host build. It takes the place of video_out.c:
+ * frames are twiddled exactly as they are for the PVR but never shown,
+ * and nothing waits on a display clock, so the decoder runs as fast as it
+ * can. For the same reason it also stands in for the vblank metronom.
+ * Along the way it times the stages it can see from here:
+ *
+ *   decode   from lock_twiddle_texture() to draw_texture_slice(), which
+ *            the decoder spends in avcodec_decode_video()
+ *   twiddle  draw_texture_slice()
+ */
+
+#include "dreamreel.h"
+#include "metronom.h"
+#include "twiddle.h"
+#include "trace.h"
+#include "host.h"
+
+/* these are the texture dimensions of the image, from video_decoder.c */
+extern int texture_width, texture_height;
+extern int texture_size;
+extern int actual_width, actual_height;
+extern int downscale_shift;
+extern enum PixelFormat pixel_format;
+
+static unsigned char *twiddle_texture;
+
+/* PAL8 frames go out as RGB565 after a palette change, as they do on the
+ * console: the decoder keeps frames queued ahead of the display there,
+ * so any change after the first frame finds old ones still in flight */
+static int pal8_rgb565;
+static uint16_t pal8_lut[256];
+
+static video_out_stats_t stats;
+static uint64_t decode_start;
+
+int init_video_out(void) {
+
+  reset_video_out();
+
+  pal8_rgb565 = 0;
+  if (pixel_format == PIX_FMT_PAL8)
+    twiddle_texture = malloc(texture_size * 2);
+  else
+    twiddle_texture = malloc(texture_size);
+  if (!twiddle_texture)
+    return 1;
+
+  return 0;
+}
+
+int reset_video_out(void) {
+
+  free(twiddle_texture);
+  twiddle_texture = NULL;
+
+  return 0;
+}
+
+void lock_twiddle_texture(void) {
+
+  decode_start = timer_ns_gettime64();
+}
+
+void unlock_twiddle_texture(void) {
+}
+
+void set_texture_palette(int new_palette, int *palette) {
+
+  if (new_palette && stats.frames)
+    pal8_rgb565 = 1;
+  if (new_palette && pal8_rgb565)
+    pal8_lut_rgb565(pal8_lut, (const uint32_t *)palette);
+}
+
+void draw_texture_slice(
+  uint8_t **src_ptr, int linesize,
+  int start_y, int width, int height) {
+
+  uint64_t start = timer_ns_gettime64();
+
+  stats.decode_ns += start - decode_start;
+  trace_event(TRACE_RING_VIDEO_DECODER, TRACE_TWIDDLE, TRACE_BEGIN,
+    width, height);
+  if (pixel_format == PIX_FMT_PAL8 && pal8_rgb565)
+    twiddle_pal8_16bpp((uint16_t *)twiddle_texture, src_ptr[0], width, height,
+      pal8_lut);
+  else if (pixel_format == PIX_FMT_PAL8)
+    twiddle_pal8((uint16_t *)twiddle_texture, src_ptr[0], width, height);
+  else if (pixel_format == PIX_FMT_RGB555 && downscale_shift)
+    shrink_argb1555((uint16_t *)twiddle_texture, (uint16_t *)src_ptr[0],
+      texture_size / 2, downscale_shift);
+  else if (pixel_format == PIX_FMT_RGB555)
+    memcpy(twiddle_texture, src_ptr[0], texture_size);
+  else if (downscale_shift)
+    pack_yuv422_shrunk((uint16_t *)twiddle_texture, texture_width, src_ptr,
+      linesize, width, height, downscale_shift);
+  else
+    pack_yuv422((uint16_t *)twiddle_texture, texture_width, src_ptr,
+      linesize, width, height);
+  trace_event(TRACE_RING_VIDEO_DECODER, TRACE_TWIDDLE, TRACE_END,
+    width, height);
+  stats.twiddle_ns += timer_ns_gettime64() - start;
+}
+
+void send_texture(int64_t pts, int64_t vpts, int new_palette,
+  int *palette, int last_frame) {
+
+  if (!stats.frames)
+    stats.first_frame_ns = timer_ns_gettime64();
+  stats.frames++;
+  stats.rgb565_frames += pal8_rgb565;
+  stats.last_pts = pts;
+}
+
+void stop_video_out_thread(void) {
+}
+
+int all_video_frames_ready(void) {
+
+  return 1;
+}
+
+void start_video_playback(void) {
+}
+
+void stop_video_playback(void) {
+}
+
+void metronom_set(int64_t new_pts) {
+}
+
+/* there is no display clock to fall behind, so no frame is ever late */
+int64_t metronom_get(void) {
+
+  return 0;
+}
+
+void video_out_null_get_stats(video_out_stats_t *out) {
+
+  *out = stats;
+}
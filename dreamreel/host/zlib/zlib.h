@@ -0,0 +1,3 @@
+/* the host has zlib in the standard place; this stands in for the KOS
+ * addon header that demux_qt.c includes */
+#include <zlib.h>
@@ -53,6 +53,8 @@ enum CodecID {
     CODEC_ID_INDEO3,
     CODEC_ID_FLIC,
     CODEC_ID_IDCIN,
+    CODEC_ID_RPZA,
+    CODEC_ID_MSVIDEO1,
 
     /* various pcm "codecs" */
     CODEC_ID_PCM_S16LE,
@@ -171,6 +173,9 @@ static const int Motion_Est_QTab[] = { ME_ZERO, ME_PHODS, ME_LOG,
 /* Fx : Flag for h263+ extra options */
 #define CODEC_FLAG_H263P_AIC      0x01000000 ///< Advanced intra coding 
 #define CODEC_FLAG_H263P_UMV      0x02000000 ///< Unlimited motion vector  
+/* a decoder that can draw its 16-bit pictures straight into the twiddled order
+   of a PVR texture, the next power of 2 up in each direction */
+#define CODEC_FLAG_TWIDDLED       0x04000000
 /* For advanced prediction mode, we reuse the 4MV flag */
 /* Unsupported options :
  * 		Syntax Arithmetic coding (SAC)
@@ -830,6 +835,7 @@ typedef struct AVCodecContext {
 #define FF_IDCT_MLIB         6
 #define FF_IDCT_ARM          7
 #define FF_IDCT_ALTIVEC      8
+#define FF_IDCT_FTRV         9
 
     /**
      * slice count.
@@ -864,12 +870,13 @@ typedef struct AVCodecContext {
     unsigned dsp_mask;
 #define FF_MM_FORCE	0x80000000 /* force usage of selected flags (OR) */
     /* lower 16 bits - CPU features */
-#ifdef HAVE_MMX
+#if defined(HAVE_MMX) || defined(__i386__) || defined(__x86_64__)
 #define FF_MM_MMX	0x0001 /* standard MMX */
 #define FF_MM_3DNOW	0x0004 /* AMD 3DNOW */
 #define FF_MM_MMXEXT	0x0002 /* SSE integer functions or AMD MMX ext */
 #define FF_MM_SSE	0x0008 /* SSE functions */
 #define FF_MM_SSE2	0x0010 /* PIV SSE2 functions */
+#define FF_MM_AVX2	0x0020 /* AVX2 functions */
 #endif /* HAVE_MMX */
 
     /**
@@ -1194,6 +1201,8 @@ extern AVCodec h264_decoder;
 extern AVCodec indeo3_decoder;
 extern AVCodec flic_decoder;
 extern AVCodec idcin_decoder;
+extern AVCodec rpza_decoder;
+extern AVCodec msvideo1_decoder;
 
 /* pcm codecs */
 #define PCM_CODEC(id, name) \
@@ -1229,8 +1238,17 @@ struct ReSampleContext;
 
 typedef struct ReSampleContext ReSampleContext;
 
-ReSampleContext *audio_resample_init(int output_channels, int input_channels, 
+#define RESAMPLE_QUALITY_LINEAR  0 ///< 2-tap linear interpolation
+#define RESAMPLE_QUALITY_MEDIUM  1 ///< 8-tap, 64-phase polyphase filter
+#define RESAMPLE_QUALITY_HIGH    2 ///< 16-tap, 128-phase polyphase filter
+#define RESAMPLE_QUALITY_DEFAULT RESAMPLE_QUALITY_MEDIUM
+
+ReSampleContext *audio_resample_init(int output_channels, int input_channels,
                                      int output_rate, int input_rate);
+ReSampleContext *audio_resample_init_quality(int output_channels,
+                                             int input_channels,
+                                             int output_rate, int input_rate,
+                                             int quality);
 int audio_resample(ReSampleContext *s, short *output, short *input, int nb_samples);
 void audio_resample_close(ReSampleContext *s);
 
@@ -1261,9 +1279,24 @@ const char *avcodec_get_pix_fmt_name(int pix_fmt);
 
 /* convert among pixel formats */
 int img_convert(AVPicture *dst, int dst_pix_fmt,
-                AVPicture *src, int pix_fmt, 
+                AVPicture *src, int pix_fmt,
                 int width, int height);
 
+/* the same, with the route between the formats planned once and its
+   intermediate pictures kept, for a stream of pictures */
+
+struct ImgConvertContext;
+
+typedef struct ImgConvertContext ImgConvertContext;
+
+ImgConvertContext *img_convert_init(int dst_pix_fmt, int pix_fmt,
+                                    int width, int height);
+
+int img_convert_frame(ImgConvertContext *s,
+                      AVPicture *dst, AVPicture *src);
+
+void img_convert_close(ImgConvertContext *s);
+
 /* deinterlace a picture */
 int avpicture_deinterlace(AVPicture *dst, AVPicture *src,
                           int pix_fmt, int width, int height);
@@ -184,14 +184,18 @@ int check_marker(GetBitContext *s, const char *msg)
 static int alloc_table(VLC *vlc, int size)
 {
     int index;
+    VLC_TYPE (*table)[2];
+
     index = vlc->table_size;
     vlc->table_size += size;
     if (vlc->table_size > vlc->table_allocated) {
         vlc->table_allocated += (1 << vlc->bits);
-        vlc->table = av_realloc(vlc->table,
-                                sizeof(VLC_TYPE) * 2 * vlc->table_allocated);
-        if (!vlc->table)
+        table = av_realloc(vlc->table,
+                           sizeof(VLC_TYPE) * 2 * vlc->table_allocated);
+        /* keep the old table for init_vlc() to free */
+        if (!table)
             return -1;
+        vlc->table = table;
     }
     return index;
 }
@@ -243,9 +247,10 @@ static int build_table(VLC *vlc, int table_nb_bits,
                     printf("%4x: code=%d n=%d\n",
                            j, i, n);
 #endif
+                    /* two codes overlap */
                     if (table[j][1] /*bits*/ != 0) {
                         fprintf(stderr, "incorrect codes\n");
-                        exit(1);
+                        return -1;
                     }
                     table[j][1] = n; //bits
                     table[j][0] = i; //code
@@ -312,6 +317,10 @@ static int build_table(VLC *vlc, int table_nb_bits,
 
    'wrap' and 'size' allows to use any memory configuration and types
    (byte/word/long) to store the 'bits' and 'codes' tables.  
+
+   Returns -1, with nothing left allocated, if memory runs out or two
+   codes overlap. Codecs whose codes never change can have the tables
+   built at compile time by tablegen/vlcgen.c instead.
 */
 int init_vlc(VLC *vlc, int nb_bits, int nb_codes,
              const void *bits, int bits_wrap, int bits_size,
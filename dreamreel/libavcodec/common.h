@@ -13,9 +13,22 @@
 //#define ALT_BITSTREAM_WRITER
 //#define ALIGNED_BITSTREAM_WRITER
 
-#define ALT_BITSTREAM_READER
-//#define LIBMPEG2_BITSTREAM_READER
-//#define A32_BITSTREAM_READER
+/* a codec chooses its bitstream reader by defining one of these before
+ * it first includes common.h; ALT is the default. The cached reader reads
+ * the least significant bit of each byte first if BITSTREAM_READER_LE is
+ * defined as well. */
+#if !defined(LIBMPEG2_BITSTREAM_READER) && !defined(A32_BITSTREAM_READER) && \
+    !defined(CACHED_BITSTREAM_READER)
+#    define ALT_BITSTREAM_READER
+#endif
+
+/* the cached reader keeps its cache in one 64 bit register where there
+ * are such, in two 32 bit ones elsewhere or if CACHED_BITSTREAM_READER_32
+ * is defined */
+#if defined(CACHED_BITSTREAM_READER) && defined(__LP64__) && \
+    !defined(CACHED_BITSTREAM_READER_32)
+#    define CACHED_BITSTREAM_READER_64
+#endif
 
 #ifdef HAVE_AV_CONFIG_H
 /* only include the following when compiling package */
@@ -59,14 +72,6 @@
 #define AVOPTION_SUB(ptr) { .name = NULL, .help = (const char*)ptr }
 #define AVOPTION_END() AVOPTION_SUB(NULL)
 
-struct AVOption;
-#ifdef HAVE_MMX
-extern const struct AVOption avoptions_common[3 + 5];
-#else
-extern const struct AVOption avoptions_common[3];
-#endif
-extern const struct AVOption avoptions_workaround_bug[11];
-
 #endif /* HAVE_AV_CONFIG_H */
 
 /* Suppress restrict if it was not defined in config.h.  */
@@ -260,6 +265,14 @@ typedef struct GetBitContext {
     uint32_t cache0;
     uint32_t cache1;
     int bit_count;
+#elif defined CACHED_BITSTREAM_READER
+    const uint32_t *buffer_ptr;     ///< next word to load, always aligned
+#    ifdef CACHED_BITSTREAM_READER_64
+    uint64_t cache;
+#    else
+    uint32_t cache0, cache1;
+#    endif
+    int bits_left;                  ///< bits in the cache
 #endif
     int size_in_bits;
 } GetBitContext;
@@ -628,6 +641,131 @@ static inline int get_bits_count(GetBitContext *s){
     return ((uint8_t*)s->buffer_ptr - s->buffer)*8 - 32 + s->bit_count;
 }
 
+#elif defined CACHED_BITSTREAM_READER
+/* loads whole aligned words, and only when the cache runs low, so a
+ * refill is one load and, for the byte order that is not the machine's,
+ * one swap. Skips must be shorter than 32 bits. */
+#   define MIN_CACHE_BITS 32
+
+#   ifdef CACHED_BITSTREAM_READER_64
+#       define CACHE_DECLARE(name, gb)\
+        uint64_t name##_cache= (gb)->cache;\
+
+#       define CACHE_STORE(name, gb)\
+        (gb)->cache= name##_cache;\
+
+#       ifdef BITSTREAM_READER_LE
+#           define CACHE_LOAD(name, word)\
+        name##_cache |= (uint64_t)(word) << name##_bits_left;\
+
+#           define CACHE_SHIFT(name, num)\
+        name##_cache >>= (num);\
+
+#           define CACHE_WORD(name) ((uint32_t)name##_cache)
+#       else
+#           define CACHE_LOAD(name, word)\
+        name##_cache |= (uint64_t)(word) << (32 - name##_bits_left);\
+
+#           define CACHE_SHIFT(name, num)\
+        name##_cache <<= (num);\
+
+#           define CACHE_WORD(name) ((uint32_t)(name##_cache >> 32))
+#       endif
+#   else
+#       define CACHE_DECLARE(name, gb)\
+        uint32_t name##_cache0= (gb)->cache0;\
+        uint32_t name##_cache1= (gb)->cache1;\
+
+#       define CACHE_STORE(name, gb)\
+        (gb)->cache0= name##_cache0;\
+        (gb)->cache1= name##_cache1;\
+
+/* the double shifts keep shift counts below 32 for 0 <= num < 32 */
+#       ifdef BITSTREAM_READER_LE
+#           define CACHE_LOAD(name, word)\
+        name##_cache0 |= (word) << name##_bits_left;\
+        name##_cache1 = (word) >> 1 >> (31 - name##_bits_left);\
+
+#           define CACHE_SHIFT(name, num)\
+        name##_cache0 = (name##_cache0 >> (num)) | (name##_cache1 << 1 << (31 - (num)));\
+        name##_cache1 >>= (num);\
+
+#       else
+#           define CACHE_LOAD(name, word)\
+        name##_cache0 |= (word) >> name##_bits_left;\
+        name##_cache1 = (word) << 1 << (31 - name##_bits_left);\
+
+#           define CACHE_SHIFT(name, num)\
+        name##_cache0 = (name##_cache0 << (num)) | (name##_cache1 >> 1 >> (31 - (num)));\
+        name##_cache1 <<= (num);\
+
+#       endif
+#       define CACHE_WORD(name) (name##_cache0)
+#   endif
+
+#   define OPEN_READER(name, gb)\
+        CACHE_DECLARE(name, gb)\
+        int name##_bits_left= (gb)->bits_left;\
+        const uint32_t *name##_buffer_ptr= (gb)->buffer_ptr;\
+
+#   define CLOSE_READER(name, gb)\
+        CACHE_STORE(name, gb)\
+        (gb)->bits_left= name##_bits_left;\
+        (gb)->buffer_ptr= name##_buffer_ptr;\
+
+/* past the end of the buffer the cache fills with zeros */
+#   ifdef BITSTREAM_READER_LE
+#       define CACHE_NEXT_WORD(word) le2me_32(word)
+#   else
+#       define CACHE_NEXT_WORD(word) be2me_32(word)
+#   endif
+#   define UPDATE_CACHE(name, gb)\
+    if(name##_bits_left < 32){\
+        uint32_t name##_next= 0;\
+        if((const uint8_t *)name##_buffer_ptr < (gb)->buffer_end)\
+            name##_next= CACHE_NEXT_WORD(*name##_buffer_ptr);\
+        CACHE_LOAD(name, name##_next)\
+        name##_buffer_ptr++;\
+        name##_bits_left += 32;\
+    }\
+
+#   define SKIP_CACHE(name, gb, num)\
+        CACHE_SHIFT(name, num)\
+
+#   define SKIP_COUNTER(name, gb, num)\
+        name##_bits_left -= (num);\
+
+#   define SKIP_BITS(name, gb, num)\
+        {\
+            SKIP_CACHE(name, gb, num)\
+            SKIP_COUNTER(name, gb, num)\
+        }\
+
+#   define LAST_SKIP_BITS(name, gb, num) SKIP_BITS(name, gb, num)
+#   define LAST_SKIP_CACHE(name, gb, num) SKIP_CACHE(name, gb, num)
+
+#   ifdef BITSTREAM_READER_LE
+#       define SHOW_UBITS(name, gb, num)\
+        ((CACHE_WORD(name) << (32 - (num))) >> (32 - (num)))
+
+#       define SHOW_SBITS(name, gb, num)\
+        (((int32_t)(CACHE_WORD(name) << (32 - (num)))) >> (32 - (num)))
+#   else
+#       define SHOW_UBITS(name, gb, num)\
+        NEG_USR32(CACHE_WORD(name), num)
+
+#       define SHOW_SBITS(name, gb, num)\
+        NEG_SSR32(CACHE_WORD(name), num)
+#   endif
+
+/* the next 32 bits; for the LE reader the next bit is the LSB */
+#   define GET_CACHE(name, gb)\
+        CACHE_WORD(name)
+
+static inline int get_bits_count(GetBitContext *s){
+    return ((const uint8_t*)s->buffer_ptr - s->buffer)*8 - s->bits_left;
+}
+
 #endif
 
 static inline unsigned int get_bits(GetBitContext *s, int n){
@@ -680,11 +818,71 @@ static inline void skip_bits1(GetBitContext *s){
     skip_bits(s, 1);
 }
 
+#ifndef ALT_BITSTREAM_READER
+/* common.c is built with the ALT reader, and the context of any other
+ * is laid out differently, so these are compiled into each codec that
+ * picks another */
+static inline void init_get_bits(GetBitContext *s,
+                                 const uint8_t *buffer, int bit_size)
+{
+    const int buffer_size= (bit_size+7)>>3;
+
+    s->buffer= buffer;
+    s->size_in_bits= bit_size;
+    s->buffer_end= buffer + buffer_size;
+#    ifdef LIBMPEG2_BITSTREAM_READER
+    s->buffer_ptr = (uint8_t*)buffer;
+    s->bit_count = 16;
+    s->cache = 0;
+#    elif defined A32_BITSTREAM_READER
+    s->buffer_ptr = (uint32_t*)buffer;
+    s->bit_count = 32;
+    s->cache0 = 0;
+    s->cache1 = 0;
+#    elif defined CACHED_BITSTREAM_READER
+    /* start from the word the buffer starts in, and skip what is in
+     * front of the buffer */
+    s->buffer_ptr= (const uint32_t *)(buffer - ((long)buffer & 3));
+    s->bits_left= 0;
+#        ifdef CACHED_BITSTREAM_READER_64
+    s->cache= 0;
+#        else
+    s->cache0= s->cache1= 0;
+#        endif
+#    endif
+    {
+        OPEN_READER(re, s)
+        UPDATE_CACHE(re, s)
+#    ifdef CACHED_BITSTREAM_READER
+        SKIP_BITS(re, s, ((long)buffer & 3)*8)
+#    endif
+        CLOSE_READER(re, s)
+    }
+#    ifdef A32_BITSTREAM_READER
+    s->cache1 = 0;
+#    endif
+}
+
+static inline void align_get_bits(GetBitContext *s)
+{
+    int n= (-get_bits_count(s)) & 7;
+    if(n) skip_bits(s, n);
+}
+
+static inline int check_marker(GetBitContext *s, const char *msg)
+{
+    int bit= get_bits1(s);
+    if(!bit) printf("Marker bit missing %s\n", msg);
+
+    return bit;
+}
+#else
 void init_get_bits(GetBitContext *s,
                    const uint8_t *buffer, int buffer_size);
 
 int check_marker(GetBitContext *s, const char *msg);
 void align_get_bits(GetBitContext *s);
+#endif
 int init_vlc(VLC *vlc, int nb_bits, int nb_codes,
              const void *bits, int bits_wrap, int bits_size,
              const void *codes, int codes_wrap, int codes_size);
@@ -772,7 +970,7 @@ static inline int get_vlc(GetBitContext *s, VLC *vlc)
  *                  read the longest vlc code 
  *                  = (max_vlc_length + bits - 1) / bits
  */
-static always_inline int get_vlc2(GetBitContext *s, VLC_TYPE (*table)[2],
+static always_inline int get_vlc2(GetBitContext *s, const VLC_TYPE (*table)[2],
                                   int bits, int max_depth)
 {
     int code;
@@ -807,7 +1005,7 @@ static inline int get_bits_trace(GetBitContext *s, int n, char *file, char *func
     printf("%5d %2d %3d bit @%5d in %s %s:%d\n", r, n, r, get_bits_count(s)-n, file, func, line);
     return r;
 }
-static inline int get_vlc_trace(GetBitContext *s, VLC_TYPE (*table)[2], int bits, int max_depth, char *file, char *func, int line){
+static inline int get_vlc_trace(GetBitContext *s, const VLC_TYPE (*table)[2], int bits, int max_depth, char *file, char *func, int line){
     int show= show_bits(s, 24);
     int pos= get_bits_count(s);
     int r= get_vlc2(s, table, bits, max_depth);
@@ -2489,10 +2489,48 @@ static void ff_jref_idct_add(uint8_t *dest, int line_size, DCTELEM *block)
     add_pixels_clamped_c(block, dest, line_size);
 }
 
+static void ff_idct_ftrv_put(uint8_t *dest, int line_size, DCTELEM *block)
+{
+    ff_idct_ftrv (block);
+    put_pixels_clamped_c(block, dest, line_size);
+}
+static void ff_idct_ftrv_add(uint8_t *dest, int line_size, DCTELEM *block)
+{
+    ff_idct_ftrv (block);
+    add_pixels_clamped_c(block, dest, line_size);
+}
+
+void ff_init_idct_permutation(uint8_t *idct_permutation, int idct_permutation_type)
+{
+    int i;
+
+    switch(idct_permutation_type){
+    case FF_NO_IDCT_PERM:
+        for(i=0; i<64; i++)
+            idct_permutation[i]= i;
+        break;
+    case FF_LIBMPEG2_IDCT_PERM:
+        for(i=0; i<64; i++)
+            idct_permutation[i]= (i & 0x38) | ((i & 6) >> 1) | ((i & 1) << 2);
+        break;
+    case FF_SIMPLE_IDCT_PERM:
+        for(i=0; i<64; i++)
+            idct_permutation[i]= simple_mmx_permutation[i];
+        break;
+    case FF_TRANSPOSE_IDCT_PERM:
+        for(i=0; i<64; i++)
+            idct_permutation[i]= ((i&7)<<3) | (i>>3);
+        break;
+    default:
+        fprintf(stderr, "Internal error, IDCT permutation not set\n");
+    }
+}
+
 void dsputil_init(DSPContext* c, AVCodecContext *avctx)
 {
     static int init_done = 0;
     int i;
+    int idct_algo;
 
     if (!init_done) {
 	for(i=0;i<256;i++) cropTbl[i + MAX_NEG_CROP] = i;
@@ -2517,10 +2555,18 @@ void dsputil_init(DSPContext* c, AVCodecContext *avctx)
         c->fdct = ff_jpeg_fdct_islow; //slow/accurate/default
 #endif //CONFIG_ENCODERS
 
-    if(avctx->idct_algo==FF_IDCT_INT){
+    idct_algo = avctx->idct_algo;
+    if(idct_algo==FF_IDCT_AUTO)
+        idct_algo = ff_idct_auto();
+
+    if(idct_algo==FF_IDCT_INT){
         c->idct_put= ff_jref_idct_put;
         c->idct_add= ff_jref_idct_add;
         c->idct_permutation_type= FF_LIBMPEG2_IDCT_PERM;
+    }else if(idct_algo==FF_IDCT_FTRV){
+        c->idct_put= ff_idct_ftrv_put;
+        c->idct_add= ff_idct_ftrv_add;
+        c->idct_permutation_type= FF_NO_IDCT_PERM;
     }else{ //accurate/default
         c->idct_put= simple_idct_put;
         c->idct_add= simple_idct_add;
@@ -2660,26 +2706,10 @@ void dsputil_init(DSPContext* c, AVCodecContext *avctx)
 #ifdef HAVE_MMI
     dsputil_init_mmi(c, avctx);
 #endif
+#ifdef HAVE_X86_SIMD
+    dsputil_init_x86(c, avctx);
+#endif
 
-    switch(c->idct_permutation_type){
-    case FF_NO_IDCT_PERM:
-        for(i=0; i<64; i++)
-            c->idct_permutation[i]= i;
-        break;
-    case FF_LIBMPEG2_IDCT_PERM:
-        for(i=0; i<64; i++)
-            c->idct_permutation[i]= (i & 0x38) | ((i & 6) >> 1) | ((i & 1) << 2);
-        break;
-    case FF_SIMPLE_IDCT_PERM:
-        for(i=0; i<64; i++)
-            c->idct_permutation[i]= simple_mmx_permutation[i];
-        break;
-    case FF_TRANSPOSE_IDCT_PERM:
-        for(i=0; i<64; i++)
-            c->idct_permutation[i]= ((i&7)<<3) | (i>>3);
-        break;
-    default:
-        fprintf(stderr, "Internal error, IDCT permutation not set\n");
-    }
+    ff_init_idct_permutation(c->idct_permutation, c->idct_permutation_type);
 }
 
@@ -38,6 +38,8 @@ void fdct_ifast (DCTELEM *data);
 void ff_jpeg_fdct_islow (DCTELEM *data);
 
 void j_rev_dct (DCTELEM *data);
+void ff_idct_ftrv(DCTELEM *data);
+void ff_idct_ftrv_c(DCTELEM *data);
 
 void ff_fdct_mmx(DCTELEM *block);
 
@@ -247,6 +249,68 @@ typedef struct DSPContext {
 
 void dsputil_init(DSPContext* p, AVCodecContext *avctx);
 
+/**
+ * fills in the idct input permutation for one of the FF_*_IDCT_PERM types.
+ */
+void ff_init_idct_permutation(uint8_t *idct_permutation, int idct_permutation_type);
+
+/* idct selection and accuracy testing, see idct_auto.c */
+
+/**
+ * how far an idct strays from the IEEE 1180 reference; the errors are
+ * test - reference, per output pixel.
+ */
+typedef struct IDCTAccuracy {
+    int peak_error;            ///< largest |error| anywhere
+    double peak_mse;           ///< largest mean squared error of a pixel position
+    double overall_mse;        ///< mean squared error over all positions
+    double peak_mean_error;    ///< largest |mean error| of a pixel position
+    double overall_mean_error; ///< |mean error| over all positions
+} IDCTAccuracy;
+
+/**
+ * looks up the bare 8x8 idct behind an FF_IDCT_* choice and its input
+ * permutation.
+ * @return 0, or -1 if there is no such idct in this build
+ */
+int ff_idct_get(int idct_algo, void (**idct)(DCTELEM *block), uint8_t *permutation);
+
+/**
+ * the double precision IEEE 1180 reference idct, rounded and clipped to
+ * -256..255. The block is in natural order.
+ */
+void ff_idct_reference(DCTELEM *block);
+
+/**
+ * makes a block of coefficients the IEEE 1180 way: random pixel values in
+ * -low..high (negated if sign < 0), forward transformed, rounded and
+ * clipped to -2048..2047. The block is in natural order.
+ */
+void ff_idct_random_block(DCTELEM *block, int low, int high, int sign, unsigned int *seed);
+
+/**
+ * makes a block like the ones a decoder sees, by keeping only the first
+ * few coefficients in zigzag order of a random block; how many depends
+ * on n. The block is in natural order.
+ */
+void ff_idct_sparse_block(DCTELEM *block, int n, unsigned int *seed);
+
+/**
+ * runs an idct over blocks random blocks with pixel values in -range..range.
+ * @return 1 if it is within the IEEE 1180 bounds, 0 if not, -1 if there is
+ *         no such idct
+ */
+int ff_idct_test(int idct_algo, int blocks, int range, int sign, IDCTAccuracy *acc);
+
+/**
+ * the idct that FF_IDCT_AUTO stands for: the fastest one on this machine
+ * that passes a short accuracy test. It is measured the first time it is
+ * asked for, which takes a while on the console; save the answer and hand
+ * it to ff_idct_set_auto() on the next start to skip that.
+ */
+int ff_idct_auto(void);
+void ff_idct_set_auto(int idct_algo);
+
 /**
  * permute block according to permuatation.
  * @param last last non zero element in scantable order
@@ -343,6 +407,15 @@ void dsputil_init_mmi(DSPContext* c, AVCodecContext *avctx);
 
 #endif
 
+#if !defined(HAVE_MMX) && (defined(__i386__) || defined(__x86_64__))
+
+/* SSE2 and AVX2 for host builds, picked at run time */
+#define HAVE_X86_SIMD
+
+void dsputil_init_x86(DSPContext* c, AVCodecContext *avctx);
+
+#endif
+
 #ifdef __GNUC__
 
 struct unaligned_64 { uint64_t l; } __attribute__((packed));
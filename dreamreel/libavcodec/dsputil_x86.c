@@ -0,0 +1,433 @@
+/*
+ * DSP utils, SSE2 and AVX2 versions for x86 hosts
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * @file dsputil_x86.c
+ * DSP utils, SSE2 and AVX2 versions for x86 hosts.
+ *
+ * The console never runs these; they are for the host build, to make
+ * benchmarks and offline decodes quicker. Every function gives exactly
+ * what its _c counterpart in dsputil.c does, for every input the _c one
+ * is defined for. The instruction sets are chosen per function, so the
+ * file builds with the default compiler flags, and dsputil_init_x86()
+ * picks what the CPU can run.
+ */
+
+#include "avcodec.h"
+#include "dsputil.h"
+
+#ifdef HAVE_X86_SIMD
+
+#include <immintrin.h>
+
+#define SSE2 __attribute__((target("sse2")))
+#define AVX2 __attribute__((target("avx2")))
+#define INLINE_SSE2 static always_inline SSE2
+#define INLINE_AVX2 static always_inline AVX2
+
+/* a register holds one row of 16 pixels, or two rows of 8 */
+#define ROWS(w) ((w) == 16 ? 1 : 2)
+
+INLINE_SSE2 __m128i load_rows(const uint8_t *p, int line_size, int w)
+{
+    if (w == 16)
+        return _mm_loadu_si128((const __m128i *)p);
+    return _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)p),
+                              _mm_loadl_epi64((const __m128i *)(p + line_size)));
+}
+
+INLINE_SSE2 void store_rows(uint8_t *p, int line_size, __m128i v, int w)
+{
+    if (w == 16) {
+        _mm_storeu_si128((__m128i *)p, v);
+    } else {
+        _mm_storel_epi64((__m128i *)p, v);
+        _mm_storel_epi64((__m128i *)(p + line_size), _mm_unpackhi_epi64(v, v));
+    }
+}
+
+/* (a + b + 1) >> 1, or (a + b) >> 1 without rounding */
+INLINE_SSE2 __m128i avg2(__m128i a, __m128i b, int rnd)
+{
+    __m128i v = _mm_avg_epu8(a, b);
+
+    if (!rnd)
+        v = _mm_sub_epi8(v, _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1)));
+    return v;
+}
+
+/* (a + b + c + d + 2) >> 2, or + 1 without rounding */
+INLINE_SSE2 __m128i avg4(__m128i a, __m128i b, __m128i c, __m128i d, int rnd)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i bias = _mm_set1_epi16(rnd ? 2 : 1);
+    __m128i lo, hi;
+
+    lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+    lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(c, zero));
+    lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(d, zero));
+    lo = _mm_srli_epi16(_mm_add_epi16(lo, bias), 2);
+    hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+    hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(c, zero));
+    hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(d, zero));
+    hi = _mm_srli_epi16(_mm_add_epi16(hi, bias), 2);
+    return _mm_packus_epi16(lo, hi);
+}
+
+/* a register of the prediction: mode 0 copies, 1 is half-pel in x, 2 in
+ * y, 3 in both */
+INLINE_SSE2 __m128i pred_rows(const uint8_t *p, int line_size, int mode, int rnd, int w)
+{
+    switch (mode) {
+    case 0:
+        return load_rows(p, line_size, w);
+    case 1:
+        return avg2(load_rows(p, line_size, w), load_rows(p + 1, line_size, w), rnd);
+    case 2:
+        return avg2(load_rows(p, line_size, w),
+                    load_rows(p + line_size, line_size, w), rnd);
+    default:
+        return avg4(load_rows(p, line_size, w), load_rows(p + 1, line_size, w),
+                    load_rows(p + line_size, line_size, w),
+                    load_rows(p + line_size + 1, line_size, w), rnd);
+    }
+}
+
+/* avg_ functions average the prediction into the block with rounding,
+ * as op_avg does */
+#define PIXELS_SSE2(name, w, mode, rnd, avg) \
+static void SSE2 name(uint8_t *block, const uint8_t *pixels, int line_size, int h)\
+{\
+    __m128i v;\
+    int i;\
+\
+    for (i = 0; i < h; i += ROWS(w)) {\
+        v = pred_rows(pixels, line_size, mode, rnd, w);\
+        if (avg)\
+            v = _mm_avg_epu8(v, load_rows(block, line_size, w));\
+        store_rows(block, line_size, v, w);\
+        pixels += ROWS(w) * line_size;\
+        block  += ROWS(w) * line_size;\
+    }\
+}
+
+#define PIXELS_TAB_SSE2(OPNAME, avg) \
+PIXELS_SSE2(OPNAME ## _pixels16_sse2,            16, 0, 1, avg)\
+PIXELS_SSE2(OPNAME ## _pixels16_x2_sse2,         16, 1, 1, avg)\
+PIXELS_SSE2(OPNAME ## _pixels16_y2_sse2,         16, 2, 1, avg)\
+PIXELS_SSE2(OPNAME ## _pixels16_xy2_sse2,        16, 3, 1, avg)\
+PIXELS_SSE2(OPNAME ## _no_rnd_pixels16_x2_sse2,  16, 1, 0, avg)\
+PIXELS_SSE2(OPNAME ## _no_rnd_pixels16_y2_sse2,  16, 2, 0, avg)\
+PIXELS_SSE2(OPNAME ## _no_rnd_pixels16_xy2_sse2, 16, 3, 0, avg)\
+PIXELS_SSE2(OPNAME ## _pixels8_sse2,              8, 0, 1, avg)\
+PIXELS_SSE2(OPNAME ## _pixels8_x2_sse2,           8, 1, 1, avg)\
+PIXELS_SSE2(OPNAME ## _pixels8_y2_sse2,           8, 2, 1, avg)\
+PIXELS_SSE2(OPNAME ## _pixels8_xy2_sse2,          8, 3, 1, avg)\
+PIXELS_SSE2(OPNAME ## _no_rnd_pixels8_x2_sse2,    8, 1, 0, avg)\
+PIXELS_SSE2(OPNAME ## _no_rnd_pixels8_y2_sse2,    8, 2, 0, avg)\
+PIXELS_SSE2(OPNAME ## _no_rnd_pixels8_xy2_sse2,   8, 3, 0, avg)
+
+PIXELS_TAB_SSE2(put, 0)
+PIXELS_TAB_SSE2(avg, 1)
+
+static void SSE2 put_pixels_clamped_sse2(const DCTELEM *block, uint8_t *pixels, int line_size)
+{
+    __m128i v;
+    int i;
+
+    for (i = 0; i < 8; i += 2) {
+        v = _mm_packus_epi16(_mm_loadu_si128((const __m128i *)block),
+                             _mm_loadu_si128((const __m128i *)(block + 8)));
+        _mm_storel_epi64((__m128i *)pixels, v);
+        _mm_storel_epi64((__m128i *)(pixels + line_size), _mm_srli_si128(v, 8));
+        pixels += 2 * line_size;
+        block  += 16;
+    }
+}
+
+static void SSE2 add_pixels_clamped_sse2(const DCTELEM *block, uint8_t *pixels, int line_size)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i p0, p1;
+    int i;
+
+    for (i = 0; i < 8; i += 2) {
+        p0 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)pixels), zero);
+        p1 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(pixels + line_size)), zero);
+        p0 = _mm_adds_epi16(p0, _mm_loadu_si128((const __m128i *)block));
+        p1 = _mm_adds_epi16(p1, _mm_loadu_si128((const __m128i *)(block + 8)));
+        p0 = _mm_packus_epi16(p0, p1);
+        _mm_storel_epi64((__m128i *)pixels, p0);
+        _mm_storel_epi64((__m128i *)(pixels + line_size), _mm_srli_si128(p0, 8));
+        pixels += 2 * line_size;
+        block  += 16;
+    }
+}
+
+static void SSE2 clear_blocks_sse2(DCTELEM *blocks)
+{
+    __m128i zero = _mm_setzero_si128();
+    int i;
+
+    for (i = 0; i < 6 * 64; i += 8)
+        _mm_storeu_si128((__m128i *)(blocks + i), zero);
+}
+
+static void SSE2 add_bytes_sse2(uint8_t *dst, uint8_t *src, int w)
+{
+    int i;
+
+    for (i = 0; i + 15 < w; i += 16)
+        _mm_storeu_si128((__m128i *)(dst + i),
+            _mm_add_epi8(_mm_loadu_si128((const __m128i *)(dst + i)),
+                         _mm_loadu_si128((const __m128i *)(src + i))));
+    for (; i < w; i++)
+        dst[i] += src[i];
+}
+
+static void SSE2 diff_bytes_sse2(uint8_t *dst, uint8_t *src1, uint8_t *src2, int w)
+{
+    int i;
+
+    for (i = 0; i + 15 < w; i += 16)
+        _mm_storeu_si128((__m128i *)(dst + i),
+            _mm_sub_epi8(_mm_loadu_si128((const __m128i *)(src1 + i)),
+                         _mm_loadu_si128((const __m128i *)(src2 + i))));
+    for (; i < w; i++)
+        dst[i] = src1[i] - src2[i];
+}
+
+/* sums of absolute differences against a rounded half-pel prediction,
+ * as pix_abs*_c do */
+#define PIX_ABS_SSE2(name, w, mode) \
+static int SSE2 name(uint8_t *pix1, uint8_t *pix2, int line_size)\
+{\
+    __m128i sum = _mm_setzero_si128();\
+    int i;\
+\
+    for (i = 0; i < w; i += ROWS(w)) {\
+        sum = _mm_add_epi64(sum, _mm_sad_epu8(load_rows(pix1, line_size, w),\
+            pred_rows(pix2, line_size, mode, 1, w)));\
+        pix1 += ROWS(w) * line_size;\
+        pix2 += ROWS(w) * line_size;\
+    }\
+    sum = _mm_add_epi64(sum, _mm_srli_si128(sum, 8));\
+    return _mm_cvtsi128_si32(sum);\
+}
+
+PIX_ABS_SSE2(pix_abs16x16_sse2,     16, 0)
+PIX_ABS_SSE2(pix_abs16x16_x2_sse2,  16, 1)
+PIX_ABS_SSE2(pix_abs16x16_y2_sse2,  16, 2)
+PIX_ABS_SSE2(pix_abs16x16_xy2_sse2, 16, 3)
+PIX_ABS_SSE2(pix_abs8x8_sse2,        8, 0)
+PIX_ABS_SSE2(pix_abs8x8_x2_sse2,     8, 1)
+PIX_ABS_SSE2(pix_abs8x8_y2_sse2,     8, 2)
+PIX_ABS_SSE2(pix_abs8x8_xy2_sse2,    8, 3)
+
+static int SSE2 sad16x16_sse2(void *s, uint8_t *a, uint8_t *b, int stride)
+{
+    return pix_abs16x16_sse2(a, b, stride);
+}
+
+static int SSE2 sad8x8_sse2(void *s, uint8_t *a, uint8_t *b, int stride)
+{
+    return pix_abs8x8_sse2(a, b, stride);
+}
+
+/* AVX2: 16 pixels widened to 16 bits fill a register, and two rows of
+ * 16 pixels fit in one */
+
+INLINE_AVX2 __m128i avg4_avx2(const uint8_t *p, int line_size, int rnd)
+{
+    __m256i v;
+
+    v = _mm256_add_epi16(
+            _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)p)),
+            _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(p + 1))));
+    v = _mm256_add_epi16(v,
+            _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(p + line_size))));
+    v = _mm256_add_epi16(v,
+            _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(p + line_size + 1))));
+    v = _mm256_srli_epi16(_mm256_add_epi16(v, _mm256_set1_epi16(rnd ? 2 : 1)), 2);
+    return _mm_packus_epi16(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+}
+
+#define PIXELS16_XY2_AVX2(name, rnd, avg) \
+static void AVX2 name(uint8_t *block, const uint8_t *pixels, int line_size, int h)\
+{\
+    __m128i v;\
+    int i;\
+\
+    for (i = 0; i < h; i++) {\
+        v = avg4_avx2(pixels, line_size, rnd);\
+        if (avg)\
+            v = _mm_avg_epu8(v, _mm_loadu_si128((const __m128i *)block));\
+        _mm_storeu_si128((__m128i *)block, v);\
+        pixels += line_size;\
+        block  += line_size;\
+    }\
+}
+
+PIXELS16_XY2_AVX2(put_pixels16_xy2_avx2,        1, 0)
+PIXELS16_XY2_AVX2(put_no_rnd_pixels16_xy2_avx2, 0, 0)
+PIXELS16_XY2_AVX2(avg_pixels16_xy2_avx2,        1, 1)
+PIXELS16_XY2_AVX2(avg_no_rnd_pixels16_xy2_avx2, 0, 1)
+
+INLINE_AVX2 __m256i load_2rows(const uint8_t *p, int line_size)
+{
+    return _mm256_inserti128_si256(
+        _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)p)),
+        _mm_loadu_si128((const __m128i *)(p + line_size)), 1);
+}
+
+static int AVX2 pix_abs16x16_avx2(uint8_t *pix1, uint8_t *pix2, int line_size)
+{
+    __m256i sum = _mm256_setzero_si256();
+    __m128i s;
+    int i;
+
+    for (i = 0; i < 16; i += 2) {
+        sum = _mm256_add_epi64(sum, _mm256_sad_epu8(load_2rows(pix1, line_size),
+                                                    load_2rows(pix2, line_size)));
+        pix1 += 2 * line_size;
+        pix2 += 2 * line_size;
+    }
+    s = _mm_add_epi64(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    s = _mm_add_epi64(s, _mm_srli_si128(s, 8));
+    return _mm_cvtsi128_si32(s);
+}
+
+static int AVX2 sad16x16_avx2(void *s, uint8_t *a, uint8_t *b, int stride)
+{
+    return pix_abs16x16_avx2(a, b, stride);
+}
+
+static void AVX2 clear_blocks_avx2(DCTELEM *blocks)
+{
+    __m256i zero = _mm256_setzero_si256();
+    int i;
+
+    for (i = 0; i < 6 * 64; i += 16)
+        _mm256_storeu_si256((__m256i *)(blocks + i), zero);
+}
+
+static void AVX2 add_bytes_avx2(uint8_t *dst, uint8_t *src, int w)
+{
+    int i;
+
+    for (i = 0; i + 31 < w; i += 32)
+        _mm256_storeu_si256((__m256i *)(dst + i),
+            _mm256_add_epi8(_mm256_loadu_si256((const __m256i *)(dst + i)),
+                            _mm256_loadu_si256((const __m256i *)(src + i))));
+    for (; i < w; i++)
+        dst[i] += src[i];
+}
+
+static void AVX2 diff_bytes_avx2(uint8_t *dst, uint8_t *src1, uint8_t *src2, int w)
+{
+    int i;
+
+    for (i = 0; i + 31 < w; i += 32)
+        _mm256_storeu_si256((__m256i *)(dst + i),
+            _mm256_sub_epi8(_mm256_loadu_si256((const __m256i *)(src1 + i)),
+                            _mm256_loadu_si256((const __m256i *)(src2 + i))));
+    for (; i < w; i++)
+        dst[i] = src1[i] - src2[i];
+}
+
+/* what the CPU can run, less what avctx->dsp_mask takes away */
+static int x86_flags(AVCodecContext *avctx)
+{
+    int flags = 0;
+
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2"))
+        flags |= FF_MM_SSE2;
+    if (__builtin_cpu_supports("avx2"))
+        flags |= FF_MM_AVX2;
+
+    if (avctx->dsp_mask & FF_MM_FORCE)
+        flags |= avctx->dsp_mask & 0xffff;
+    else
+        flags &= ~avctx->dsp_mask;
+
+    return flags;
+}
+
+void dsputil_init_x86(DSPContext* c, AVCodecContext *avctx)
+{
+    int flags = x86_flags(avctx);
+
+    if (flags & FF_MM_SSE2) {
+        c->put_pixels_clamped = put_pixels_clamped_sse2;
+        c->add_pixels_clamped = add_pixels_clamped_sse2;
+        c->clear_blocks = clear_blocks_sse2;
+        c->add_bytes = add_bytes_sse2;
+        c->diff_bytes = diff_bytes_sse2;
+
+        c->pix_abs16x16     = pix_abs16x16_sse2;
+        c->pix_abs16x16_x2  = pix_abs16x16_x2_sse2;
+        c->pix_abs16x16_y2  = pix_abs16x16_y2_sse2;
+        c->pix_abs16x16_xy2 = pix_abs16x16_xy2_sse2;
+        c->pix_abs8x8       = pix_abs8x8_sse2;
+        c->pix_abs8x8_x2    = pix_abs8x8_x2_sse2;
+        c->pix_abs8x8_y2    = pix_abs8x8_y2_sse2;
+        c->pix_abs8x8_xy2   = pix_abs8x8_xy2_sse2;
+        c->sad[0] = sad16x16_sse2;
+        c->sad[1] = sad8x8_sse2;
+
+#define dspfunc(PFX, IDX, NUM) \
+    c->PFX ## _pixels_tab[IDX][0] = PFX ## _pixels ## NUM ## _sse2;     \
+    c->PFX ## _pixels_tab[IDX][1] = PFX ## _pixels ## NUM ## _x2_sse2;  \
+    c->PFX ## _pixels_tab[IDX][2] = PFX ## _pixels ## NUM ## _y2_sse2;  \
+    c->PFX ## _pixels_tab[IDX][3] = PFX ## _pixels ## NUM ## _xy2_sse2
+
+        dspfunc(put, 0, 16);
+        dspfunc(put, 1, 8);
+        dspfunc(avg, 0, 16);
+        dspfunc(avg, 1, 8);
+#undef dspfunc
+
+        /* a full-pel copy rounds nothing, so the no_rnd ones share it */
+#define dspfunc(PFX, IDX, NUM) \
+    c->PFX ## _no_rnd_pixels_tab[IDX][0] = PFX ## _pixels ## NUM ## _sse2;            \
+    c->PFX ## _no_rnd_pixels_tab[IDX][1] = PFX ## _no_rnd_pixels ## NUM ## _x2_sse2;  \
+    c->PFX ## _no_rnd_pixels_tab[IDX][2] = PFX ## _no_rnd_pixels ## NUM ## _y2_sse2;  \
+    c->PFX ## _no_rnd_pixels_tab[IDX][3] = PFX ## _no_rnd_pixels ## NUM ## _xy2_sse2
+
+        dspfunc(put, 0, 16);
+        dspfunc(put, 1, 8);
+        dspfunc(avg, 0, 16);
+        dspfunc(avg, 1, 8);
+#undef dspfunc
+    }
+
+    if (flags & FF_MM_AVX2) {
+        c->clear_blocks = clear_blocks_avx2;
+        c->add_bytes = add_bytes_avx2;
+        c->diff_bytes = diff_bytes_avx2;
+        c->pix_abs16x16 = pix_abs16x16_avx2;
+        c->sad[0] = sad16x16_avx2;
+        c->put_pixels_tab[0][3] = put_pixels16_xy2_avx2;
+        c->put_no_rnd_pixels_tab[0][3] = put_no_rnd_pixels16_xy2_avx2;
+        c->avg_pixels_tab[0][3] = avg_pixels16_xy2_avx2;
+        c->avg_no_rnd_pixels_tab[0][3] = avg_no_rnd_pixels16_xy2_avx2;
+    }
+}
+
+#endif /* HAVE_X86_SIMD */
@@ -116,6 +116,9 @@ static int flic_decode_frame(AVCodecContext *avctx,
     num_chunks = LE_16(&buf[stream_ptr]);
     stream_ptr += 10;  /* skip padding */
 
+    /* the palette only counts as new in a frame that carries one */
+    s->frame.new_palette = 0;
+
     /* iterate through the chunks */
     frame_size -= 16;
     while ((frame_size > 0) && (num_chunks > 0)) {
@@ -146,7 +149,7 @@ static int flic_decode_frame(AVCodecContext *avctx,
             palette_ptr1 = 0;
             for (i = 0; i < color_packets; i++) {
                 /* first byte is how many colors to skip */
-                palette_ptr1 += (buf[stream_ptr++] * 4);
+                palette_ptr1 += buf[stream_ptr++];
 
                 /* next byte indicates how many entries to change */
                 color_changes = buf[stream_ptr++];
@@ -164,7 +167,7 @@ static int flic_decode_frame(AVCodecContext *avctx,
                     r = buf[stream_ptr + 0] << color_shift;
                     g = buf[stream_ptr + 1] << color_shift;
                     b = buf[stream_ptr + 2] << color_shift;
-                    s->frame.palette[j] =
+                    s->frame.palette[palette_ptr1] =
                         0xFF000000 | (r << 16) | (g << 8) | b;
 
                     palette_ptr1++;
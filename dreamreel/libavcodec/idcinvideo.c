@@ -45,6 +45,9 @@
 #include <string.h>
 #include <unistd.h>
 
+/* the Huffman codes are packed least significant bit first */
+#define CACHED_BITSTREAM_READER
+#define BITSTREAM_READER_LE
 #include "common.h"
 #include "avcodec.h"
 #include "bswap.h"
@@ -84,14 +87,16 @@ static int num_huff_nodes[256];
 static void huff_decode(IdcinDecodeContext *s, AVFrame *frame, uint8_t *buf,
     int buf_size)
 {
+    GetBitContext gb;
     hnode_t *hnodes;
     int prev;
-    unsigned char v = 0;
-    int bit_pos, node_num, dat_pos;
-    int address, x, y;;
+    int node_num;
+    int address, x, y;
 
-    prev = bit_pos = dat_pos = 0;
+    init_get_bits(&gb, buf, buf_size * 8);
+    prev = 0;
     for (y = 0; y < s->height; y++) {
+        OPEN_READER(re, &gb)
         address = y * frame->linesize[0];
         for (x = 0; x < s->width; x++) {
 
@@ -100,23 +105,21 @@ static void huff_decode(IdcinDecodeContext *s, AVFrame *frame, uint8_t *buf,
 
             /* naive Huffman tree traversal */
             while(node_num >= HUF_TOKENS) {
-                if(!bit_pos) {
-                    if(dat_pos > buf_size) {
-                        printf("Huffman decode error.\n");
-                        return;
-                    }
-                    bit_pos = 8;
-                    v = buf[dat_pos++];
-                }
-
-                node_num = hnodes[node_num].children[v & 0x01];
-                v = v >> 1;
-                bit_pos--;
+                UPDATE_CACHE(re, &gb)
+                node_num = hnodes[node_num].children[SHOW_UBITS(re, &gb, 1)];
+                SKIP_BITS(re, &gb, 1)
             }
 
-            frame->data[0][address] = node_num;
+            frame->data[0][address++] = node_num;
             prev = node_num;
         }
+        CLOSE_READER(re, &gb)
+
+        /* past the end of the data the reader returns zeros */
+        if (get_bits_count(&gb) > buf_size * 8) {
+            printf("Huffman decode error.\n");
+            return;
+        }
     }
 
 #if 0
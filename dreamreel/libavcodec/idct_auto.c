@@ -0,0 +1,306 @@
+/*
+ * IDCT accuracy testing and automatic selection
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * @file idct_auto.c
+ * IDCT accuracy testing and automatic selection.
+ *
+ * The accuracy test follows IEEE 1180-1990: blocks of random pixels are
+ * forward transformed in double precision, rounded, and fed to both the
+ * idct under test and a double precision reference; the differences must
+ * stay within the bounds the standard gives. FF_IDCT_AUTO picks the
+ * fastest idct that passes a shorter run of the same test, timed on the
+ * machine it runs on over blocks about as sparse as a decoder's.
+ */
+
+#include <math.h>
+#include <sys/time.h>
+
+#include "avcodec.h"
+#include "dsputil.h"
+#include "simple_idct.h"
+
+/* IEEE 1180 bounds */
+#define PEAK_ERROR          1
+#define PEAK_MSE            0.06
+#define OVERALL_MSE         0.02
+#define PEAK_MEAN_ERROR     0.015
+#define OVERALL_MEAN_ERROR  0.0015
+
+/* the short test that FF_IDCT_AUTO runs; the standard asks for 10000
+ * blocks at each of several ranges */
+#define AUTO_TEST_BLOCKS    1024
+#define AUTO_TEST_RANGE     256
+
+/* how long to time each idct for; long enough that a clock with only
+ * millisecond resolution will do */
+#define AUTO_TIME_US        20000
+#define AUTO_TIME_BLOCKS    64
+
+/* how much faster a later candidate has to be to win, so that timing
+ * noise does not flip the choice from run to run */
+#define AUTO_MARGIN         1.05
+
+typedef struct IDCTCandidate {
+    int idct_algo;
+    void (*idct)(DCTELEM *block);
+    int idct_permutation_type;
+} IDCTCandidate;
+
+/* what FF_IDCT_AUTO chooses from, in the order it prefers them */
+static const IDCTCandidate candidates[] = {
+    { FF_IDCT_SIMPLE, simple_idct,  FF_NO_IDCT_PERM },
+    { FF_IDCT_INT,    j_rev_dct,    FF_LIBMPEG2_IDCT_PERM },
+    { FF_IDCT_FTRV,   ff_idct_ftrv, FF_NO_IDCT_PERM },
+};
+#define NB_CANDIDATES (sizeof(candidates) / sizeof(candidates[0]))
+
+static int auto_idct_algo = FF_IDCT_AUTO;
+
+static double c8[8][8];   ///< c8[k][x] = C(k)/2 * cos((2x+1)k pi/16)
+
+static void init_c8(void)
+{
+    static int init_done = 0;
+    int k, x;
+
+    if (init_done)
+        return;
+    for (k = 0; k < 8; k++)
+        for (x = 0; x < 8; x++)
+            c8[k][x] = (k ? 0.5 : sqrt(0.125)) * cos((2 * x + 1) * k * M_PI / 16);
+    init_done = 1;
+}
+
+/* separable 2-D transforms, forward (pixels to coefficients) or inverse */
+static void transform(double *out, const double *in, int inverse)
+{
+    double tmp[64], sum;
+    int i, j, k;
+
+    for (i = 0; i < 8; i++) {
+        for (j = 0; j < 8; j++) {
+            sum = 0;
+            for (k = 0; k < 8; k++)
+                sum += in[i * 8 + k] * (inverse ? c8[k][j] : c8[j][k]);
+            tmp[i * 8 + j] = sum;
+        }
+    }
+    for (j = 0; j < 8; j++) {
+        for (i = 0; i < 8; i++) {
+            sum = 0;
+            for (k = 0; k < 8; k++)
+                sum += tmp[k * 8 + j] * (inverse ? c8[k][i] : c8[i][k]);
+            out[i * 8 + j] = sum;
+        }
+    }
+}
+
+static int round_clip(double v, int min, int max)
+{
+    int i = (int)floor(v + 0.5);
+
+    return i < min ? min : i > max ? max : i;
+}
+
+void ff_idct_reference(DCTELEM *block)
+{
+    double in[64], out[64];
+    int i;
+
+    init_c8();
+    for (i = 0; i < 64; i++)
+        in[i] = block[i];
+    transform(out, in, 1);
+    for (i = 0; i < 64; i++)
+        block[i] = round_clip(out[i], -256, 255);
+}
+
+/* the generator from the IEEE 1180 test procedure: an integer in
+ * -low..high */
+static int ieee_rand(unsigned int *seed, int low, int high)
+{
+    unsigned int i;
+
+    *seed = *seed * 1103515245 + 12345;
+    i = *seed & 0x7ffffffe;
+    return (int)((double)i / (double)0x7fffffff * (low + high + 1)) - low;
+}
+
+void ff_idct_random_block(DCTELEM *block, int low, int high, int sign, unsigned int *seed)
+{
+    double in[64], out[64];
+    int i;
+
+    init_c8();
+    for (i = 0; i < 64; i++)
+        in[i] = ieee_rand(seed, low, high) * (sign < 0 ? -1 : 1);
+    transform(out, in, 0);
+    for (i = 0; i < 64; i++)
+        block[i] = round_clip(out[i], -2048, 2047);
+}
+
+int ff_idct_get(int idct_algo, void (**idct)(DCTELEM *block), uint8_t *permutation)
+{
+    int i;
+
+    for (i = 0; i < NB_CANDIDATES; i++) {
+        if (candidates[i].idct_algo == idct_algo) {
+            *idct = candidates[i].idct;
+            ff_init_idct_permutation(permutation, candidates[i].idct_permutation_type);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int ff_idct_test(int idct_algo, int blocks, int range, int sign, IDCTAccuracy *acc)
+{
+    void (*idct)(DCTELEM *block);
+    uint8_t permutation[64];
+    DCTELEM coefs[64], ref[64], block[64];
+    int64_t sum[64], sum_sq[64], total = 0, total_sq = 0;
+    unsigned int seed = 1;
+    int i, n, v, err;
+
+    if (ff_idct_get(idct_algo, &idct, permutation) < 0)
+        return -1;
+
+    memset(acc, 0, sizeof(*acc));
+    memset(sum, 0, sizeof(sum));
+    memset(sum_sq, 0, sizeof(sum_sq));
+
+    for (n = 0; n < blocks; n++) {
+        ff_idct_random_block(coefs, range, range, sign, &seed);
+
+        for (i = 0; i < 64; i++)
+            ref[i] = coefs[i];
+        ff_idct_reference(ref);
+
+        for (i = 0; i < 64; i++)
+            block[permutation[i]] = coefs[i];
+        idct(block);
+
+        for (i = 0; i < 64; i++) {
+            v = block[i] < -256 ? -256 : block[i] > 255 ? 255 : block[i];
+            err = v - ref[i];
+            if (ABS(err) > acc->peak_error)
+                acc->peak_error = ABS(err);
+            sum[i] += err;
+            sum_sq[i] += err * err;
+        }
+    }
+
+    for (i = 0; i < 64; i++) {
+        if ((double)sum_sq[i] / blocks > acc->peak_mse)
+            acc->peak_mse = (double)sum_sq[i] / blocks;
+        if (fabs((double)sum[i] / blocks) > acc->peak_mean_error)
+            acc->peak_mean_error = fabs((double)sum[i] / blocks);
+        total += sum[i];
+        total_sq += sum_sq[i];
+    }
+    acc->overall_mse = (double)total_sq / (64.0 * blocks);
+    acc->overall_mean_error = fabs((double)total / (64.0 * blocks));
+
+    return acc->peak_error <= PEAK_ERROR &&
+           acc->peak_mse <= PEAK_MSE &&
+           acc->overall_mse <= OVERALL_MSE &&
+           acc->peak_mean_error <= PEAK_MEAN_ERROR &&
+           acc->overall_mean_error <= OVERALL_MEAN_ERROR;
+}
+
+static int64_t gettime_us(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+void ff_idct_sparse_block(DCTELEM *block, int n, unsigned int *seed)
+{
+    int i;
+
+    ff_idct_random_block(block, AUTO_TEST_RANGE, AUTO_TEST_RANGE, 1, seed);
+    for (i = 1 + (n * 7) % 40; i < 64; i++)
+        block[ff_zigzag_direct[i]] = 0;
+}
+
+/* idcts per second, more or less */
+static double idct_speed(const IDCTCandidate *candidate)
+{
+    DCTELEM coefs[AUTO_TIME_BLOCKS][64], block[64];
+    uint8_t permutation[64];
+    unsigned int seed = 1;
+    int64_t start, elapsed;
+    int i, j, count = 0;
+
+    ff_init_idct_permutation(permutation, candidate->idct_permutation_type);
+    for (i = 0; i < AUTO_TIME_BLOCKS; i++) {
+        ff_idct_sparse_block(block, i, &seed);
+        for (j = 0; j < 64; j++)
+            coefs[i][permutation[j]] = block[j];
+    }
+
+    start = gettime_us();
+    do {
+        for (i = 0; i < AUTO_TIME_BLOCKS; i++) {
+            memcpy(block, coefs[i], sizeof(block));
+            candidate->idct(block);
+        }
+        count += AUTO_TIME_BLOCKS;
+        elapsed = gettime_us() - start;
+    } while (elapsed < AUTO_TIME_US);
+
+    return count * 1000000.0 / elapsed;
+}
+
+int ff_idct_auto(void)
+{
+    IDCTAccuracy acc;
+    double speed, best_speed = 0;
+    int i;
+
+    if (auto_idct_algo != FF_IDCT_AUTO)
+        return auto_idct_algo;
+
+    /* the simple idct is the fallback should nothing pass */
+    auto_idct_algo = FF_IDCT_SIMPLE;
+    for (i = 0; i < NB_CANDIDATES; i++) {
+        if (ff_idct_test(candidates[i].idct_algo, AUTO_TEST_BLOCKS,
+                         AUTO_TEST_RANGE, 1, &acc) != 1)
+            continue;
+        speed = idct_speed(&candidates[i]);
+        if (speed > best_speed * AUTO_MARGIN) {
+            best_speed = speed;
+            auto_idct_algo = candidates[i].idct_algo;
+        }
+    }
+
+    return auto_idct_algo;
+}
+
+void ff_idct_set_auto(int idct_algo)
+{
+    void (*idct)(DCTELEM *block);
+    uint8_t permutation[64];
+
+    /* a saved choice from another build may name an idct this one lacks */
+    if (idct_algo == FF_IDCT_AUTO || ff_idct_get(idct_algo, &idct, permutation) == 0)
+        auto_idct_algo = idct_algo;
+}
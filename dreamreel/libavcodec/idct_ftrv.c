@@ -0,0 +1,180 @@
+/*
+ * Float IDCT as 4x4 matrix transforms
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * @file idct_ftrv.c
+ * Float IDCT built from 4x4 matrix-vector transforms.
+ *
+ * The SH4 has no integer SIMD; what it has is ftrv, which multiplies a
+ * 4-vector by a 4x4 matrix held in the back FPU register bank in a single
+ * instruction. An 8 point IDCT splits into an even half, from coefficients
+ * 0 2 4 6, and an odd half, from 1 3 5 7, each of which is one 4x4
+ * transform, followed by a butterfly. Each pass over the block loads the
+ * even matrix, transforms all 8 lines, then does the same with the odd
+ * matrix, so that the matrices are only loaded 4 times per block.
+ *
+ * The transform is done the same way in C and with SSE; the matrices are
+ * stored column by column, which is the order ftrv wants them in.
+ * ff_idct_ftrv() is the fastest of these that the compiler can build,
+ * ff_idct_ftrv_c() always the C one, and the SSE one matches the C one
+ * bit for bit. There is no ftrv version yet: it cannot go in until it
+ * has been built with the KOS toolchain and checked against
+ * ff_idct_ftrv_c() on the console, so the SH4 build uses the C one.
+ */
+
+#include <math.h>
+
+#include "avcodec.h"
+#include "dsputil.h"
+
+#if defined(__SSE__)
+#define FTRV_SSE
+#include <xmmintrin.h>
+#endif
+
+/* fv' = M fv, with M[col * 4 + row] */
+static float even_matrix[16] __attribute__((aligned(16)));
+static float odd_matrix[16] __attribute__((aligned(16)));
+
+static void init_matrices(void)
+{
+    static int init_done = 0;
+    int n, k;
+    double c;
+
+    if (init_done)
+        return;
+
+    /* x[n] = sum over k of C(k)/2 * cos((2n+1)k pi/16) * X[k], for each
+     * dimension; C(0) = 1/sqrt(2) and C(k) = 1 otherwise */
+    for (n = 0; n < 4; n++) {
+        for (k = 0; k < 4; k++) {
+            c = k ? 0.5 : sqrt(0.125);
+            even_matrix[k * 4 + n] = c * cos((2 * n + 1) * 2 * k * M_PI / 16);
+            odd_matrix[k * 4 + n] = 0.5 * cos((2 * n + 1) * (2 * k + 1) * M_PI / 16);
+        }
+    }
+    init_done = 1;
+}
+
+/* the C reference: what ftrv does, one multiply at a time */
+static const float *xmtrx_c;
+
+static inline void load_matrix_c(const float *m)
+{
+    xmtrx_c = m;
+}
+
+static inline void ftrv_c(float *out, const float *in)
+{
+    int row;
+
+    for (row = 0; row < 4; row++)
+        out[row] = xmtrx_c[row]     * in[0] + xmtrx_c[4 + row]  * in[1] +
+                   xmtrx_c[8 + row] * in[2] + xmtrx_c[12 + row] * in[3];
+}
+
+#if defined(FTRV_SSE)
+
+static __m128 xmtrx[4];
+
+static inline void load_matrix(const float *m)
+{
+    xmtrx[0] = _mm_load_ps(m);
+    xmtrx[1] = _mm_load_ps(m + 4);
+    xmtrx[2] = _mm_load_ps(m + 8);
+    xmtrx[3] = _mm_load_ps(m + 12);
+}
+
+static inline void ftrv(float *out, const float *in)
+{
+    __m128 r;
+
+    r = _mm_mul_ps(xmtrx[0], _mm_set1_ps(in[0]));
+    r = _mm_add_ps(r, _mm_mul_ps(xmtrx[1], _mm_set1_ps(in[1])));
+    r = _mm_add_ps(r, _mm_mul_ps(xmtrx[2], _mm_set1_ps(in[2])));
+    r = _mm_add_ps(r, _mm_mul_ps(xmtrx[3], _mm_set1_ps(in[3])));
+    _mm_storeu_ps(out, r);
+}
+
+#endif
+
+/**
+ * 8 point IDCTs of the 8 lines of a block; element k of line i is at
+ * i * line + k * step.
+ */
+#define IDCT_LINES(name, load_matrix, ftrv) \
+static void name(float *dst, const float *src, int line, int step)\
+{\
+    float v[8][4], even[8][4], odd[8][4];\
+    int i, n;\
+\
+    load_matrix(even_matrix);\
+    for (i = 0; i < 8; i++) {\
+        for (n = 0; n < 4; n++)\
+            v[i][n] = src[i * line + 2 * n * step];\
+        ftrv(even[i], v[i]);\
+    }\
+\
+    load_matrix(odd_matrix);\
+    for (i = 0; i < 8; i++) {\
+        for (n = 0; n < 4; n++)\
+            v[i][n] = src[i * line + (2 * n + 1) * step];\
+        ftrv(odd[i], v[i]);\
+    }\
+\
+    for (i = 0; i < 8; i++) {\
+        for (n = 0; n < 4; n++) {\
+            dst[i * line + n * step]       = even[i][n] + odd[i][n];\
+            dst[i * line + (7 - n) * step] = even[i][n] - odd[i][n];\
+        }\
+    }\
+}
+
+#define IDCT_FTRV(name, idct_lines) \
+void name(DCTELEM *block)\
+{\
+    float tmp[64], out[64];\
+    int i;\
+\
+    init_matrices();\
+\
+    for (i = 0; i < 64; i++)\
+        tmp[i] = block[i];\
+\
+    idct_lines(out, tmp, 8, 1);   /* rows */\
+    idct_lines(tmp, out, 1, 8);   /* columns */\
+\
+    /* round to nearest; the bias keeps what is truncated positive for\
+     * any output a valid block can produce */\
+    for (i = 0; i < 64; i++)\
+        block[i] = (int)(tmp[i] + 8192.5f) - 8192;\
+}
+
+IDCT_LINES(idct_lines_c, load_matrix_c, ftrv_c)
+IDCT_FTRV(ff_idct_ftrv_c, idct_lines_c)
+
+#if defined(FTRV_SSE)
+IDCT_LINES(idct_lines, load_matrix, ftrv)
+IDCT_FTRV(ff_idct_ftrv, idct_lines)
+#else
+void ff_idct_ftrv(DCTELEM *block)
+{
+    ff_idct_ftrv_c(block);
+}
+#endif
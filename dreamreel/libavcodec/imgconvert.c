@@ -259,6 +259,86 @@ static void yuv422_to_yuv420p(AVPicture *dst, AVPicture *src,
     }
 }
 
+/* PIX_FMT_YUV422 is packed Y0 U Y1 V. That is not the byte order of a
+   PVR YUV422 texture, which is U Y0 V Y1; the engine writes those with
+   pack_yuv422() in core/twiddle.c, straight from the decoder's planes,
+   so the converters into YUV422 below are not on the console's way out. */
+
+/* XXX: no chroma interpolating is done */
+static void yuv420p_to_yuv422(AVPicture *dst, AVPicture *src,
+                              int width, int height)
+{
+    const uint8_t *lum, *cb, *cr;
+    uint8_t *q;
+    int w, y;
+
+    for(y=0;y<height;y++) {
+        lum = src->data[0] + y * src->linesize[0];
+        cb = src->data[1] + (y >> 1) * src->linesize[1];
+        cr = src->data[2] + (y >> 1) * src->linesize[2];
+        q = dst->data[0] + y * dst->linesize[0];
+        for(w=width;w>=2;w-=2) {
+            q[0] = lum[0];
+            q[1] = cb[0];
+            q[2] = lum[1];
+            q[3] = cr[0];
+            q += 4;
+            lum += 2;
+            cb++;
+            cr++;
+        }
+        /* an odd last pixel only has room for Y and U */
+        if (w) {
+            q[0] = lum[0];
+            q[1] = cb[0];
+        }
+    }
+}
+
+/* XXX: no chroma interpolating is done */
+static void yuv411p_to_yuv422(AVPicture *dst, AVPicture *src,
+                              int width, int height)
+{
+    const uint8_t *lum, *cb, *cr;
+    uint8_t *q;
+    int w, y;
+
+    for(y=0;y<height;y++) {
+        lum = src->data[0] + y * src->linesize[0];
+        cb = src->data[1] + y * src->linesize[1];
+        cr = src->data[2] + y * src->linesize[2];
+        q = dst->data[0] + y * dst->linesize[0];
+        for(w=width;w>=4;w-=4) {
+            q[0] = lum[0];
+            q[1] = cb[0];
+            q[2] = lum[1];
+            q[3] = cr[0];
+            q[4] = lum[2];
+            q[5] = cb[0];
+            q[6] = lum[3];
+            q[7] = cr[0];
+            q += 8;
+            lum += 4;
+            cb++;
+            cr++;
+        }
+        if (w >= 2) {
+            q[0] = lum[0];
+            q[1] = cb[0];
+            q[2] = lum[1];
+            q[3] = cr[0];
+            q += 4;
+            lum += 2;
+            w -= 2;
+        }
+        /* an odd last pixel only has room for Y and U */
+        if (w) {
+            q[0] = lum[0];
+            q[1] = cb[0];
+        }
+    }
+}
+
 #define SCALEBITS 8
 #define ONE_HALF  (1 << (SCALEBITS - 1))
 #define FIX(x)		((int) ((x) * (1L<<SCALEBITS) + 0.5))
@@ -586,6 +666,74 @@ static void yuv422p_to_ ## rgb_name (AVPicture *dst, AVPicture *src,    \
     }                                                                   \
 }                                                                       \
                                                                         \
+/* XXX: no chroma interpolating is done */                              \
+static void yuv411p_to_ ## rgb_name (AVPicture *dst, AVPicture *src,    \
+                                    int width, int height)              \
+{                                                                       \
+    uint8_t *y1_ptr, *cb_ptr, *cr_ptr, *d, *d1;                         \
+    int w, y, cb, cr, r_add, g_add, b_add, width4;                      \
+    uint8_t *cm = cropTbl + MAX_NEG_CROP;                               \
+    unsigned int r, g, b;                                               \
+                                                                        \
+    d = dst->data[0];                                                   \
+    y1_ptr = src->data[0];                                              \
+    cb_ptr = src->data[1];                                              \
+    cr_ptr = src->data[2];                                              \
+    width4 = (width + 3) >> 2;                                          \
+    for(;height > 0; height --) {                                       \
+        d1 = d;                                                         \
+        for(w = width; w >= 4; w -= 4) {                                \
+            cb = cb_ptr[0] - 128;                                       \
+            cr = cr_ptr[0] - 128;                                       \
+            r_add = C_RV * cr + (1 << (SCALE_BITS - 1));                \
+            g_add = - C_GU * cb - C_GV * cr + (1 << (SCALE_BITS - 1));  \
+            b_add = C_BU * cb + (1 << (SCALE_BITS - 1));                \
+                                                                        \
+            /* output 4 pixels */                                       \
+            YUV_TO_RGB2(r, g, b, y1_ptr[0]);                            \
+            RGB_OUT(d1, r, g, b);                                       \
+                                                                        \
+            YUV_TO_RGB2(r, g, b, y1_ptr[1]);                            \
+            RGB_OUT(d1 + BPP, r, g, b);                                 \
+                                                                        \
+            YUV_TO_RGB2(r, g, b, y1_ptr[2]);                            \
+            RGB_OUT(d1 + 2 * BPP, r, g, b);                             \
+                                                                        \
+            YUV_TO_RGB2(r, g, b, y1_ptr[3]);                            \
+            RGB_OUT(d1 + 3 * BPP, r, g, b);                             \
+                                                                        \
+            d1 += 4 * BPP;                                              \
+                                                                        \
+            y1_ptr += 4;                                                \
+            cb_ptr++;                                                   \
+            cr_ptr++;                                                   \
+        }                                                               \
+        /* handle width */                                              \
+        if (w) {                                                        \
+            cb = cb_ptr[0] - 128;                                       \
+            cr = cr_ptr[0] - 128;                                       \
+            r_add = C_RV * cr + (1 << (SCALE_BITS - 1));                \
+            g_add = - C_GU * cb - C_GV * cr + (1 << (SCALE_BITS - 1));  \
+            b_add = C_BU * cb + (1 << (SCALE_BITS - 1));                \
+                                                                        \
+            /* output 1 to 3 pixels */                                  \
+            for(; w > 0; w--) {                                         \
+                YUV_TO_RGB2(r, g, b, y1_ptr[0]);                        \
+                RGB_OUT(d1, r, g, b);                                   \
+                d1 += BPP;                                              \
+                y1_ptr++;                                               \
+            }                                                           \
+            cb_ptr++;                                                   \
+            cr_ptr++;                                                   \
+        }                                                               \
+        d += dst->linesize[0];                                          \
+        y1_ptr += src->linesize[0] - width;                             \
+        cb_ptr += src->linesize[1] - width4;                            \
+        cr_ptr += src->linesize[2] - width4;                            \
+    }                                                                   \
+}                                                                       \
+                                                                        \
+                                                                        \
 static void rgb_name ## _to_yuv420p(AVPicture *dst, AVPicture *src,     \
                                     int width, int height)              \
 {                                                                       \
@@ -651,6 +799,59 @@ static void rgb_name ## _to_yuv420p(AVPicture *dst, AVPicture *src,     \
     }                                                                   \
 }                                                                       \
                                                                         \
+/* the chroma of each pair of pixels is that of their average */        \
+static void rgb_name ## _to_yuv422(AVPicture *dst, AVPicture *src,      \
+                                   int width, int height)               \
+{                                                                       \
+    const unsigned char *p;                                             \
+    unsigned char *q;                                                   \
+    int r, g, b, r1, g1, b1, dst_wrap, src_wrap;                        \
+    int w, y;                                                           \
+                                                                        \
+    p = src->data[0];                                                   \
+    src_wrap = src->linesize[0] - BPP * width;                          \
+                                                                        \
+    q = dst->data[0];                                                   \
+    dst_wrap = dst->linesize[0] - 2 * width;                            \
+                                                                        \
+    for(y=0;y<height;y++) {                                             \
+        for(w=width;w>=2;w-=2) {                                        \
+            RGB_IN(r, g, b, p);                                         \
+            r1 = r;                                                     \
+            g1 = g;                                                     \
+            b1 = b;                                                     \
+            q[0] = (FIX(0.29900) * r + FIX(0.58700) * g +               \
+                    FIX(0.11400) * b + ONE_HALF) >> SCALEBITS;          \
+            RGB_IN(r, g, b, p + BPP);                                   \
+            r1 += r;                                                    \
+            g1 += g;                                                    \
+            b1 += b;                                                    \
+            q[2] = (FIX(0.29900) * r + FIX(0.58700) * g +               \
+                    FIX(0.11400) * b + ONE_HALF) >> SCALEBITS;          \
+            q[1] = ((- FIX(0.16874) * r1 - FIX(0.33126) * g1 +          \
+                     FIX(0.50000) * b1 + 2 * ONE_HALF - 1) >>           \
+                    (SCALEBITS + 1)) + 128;                             \
+            q[3] = ((FIX(0.50000) * r1 - FIX(0.41869) * g1 -            \
+                     FIX(0.08131) * b1 + 2 * ONE_HALF - 1) >>           \
+                    (SCALEBITS + 1)) + 128;                             \
+            q += 4;                                                     \
+            p += 2 * BPP;                                               \
+        }                                                               \
+        /* an odd last pixel only has room for Y and U */               \
+        if (w) {                                                        \
+            RGB_IN(r, g, b, p);                                         \
+            q[0] = (FIX(0.29900) * r + FIX(0.58700) * g +               \
+                    FIX(0.11400) * b + ONE_HALF) >> SCALEBITS;          \
+            q[1] = ((- FIX(0.16874) * r - FIX(0.33126) * g +            \
+                     FIX(0.50000) * b + ONE_HALF - 1) >> SCALEBITS) + 128;\
+            q += 2;                                                     \
+            p += BPP;                                                   \
+        }                                                               \
+        p += src_wrap;                                                  \
+        q += dst_wrap;                                                  \
+    }                                                                   \
+}                                                                       \
+                                                                        \
 static void rgb_name ## _to_gray(AVPicture *dst, AVPicture *src,        \
                                  int width, int height)                 \
 {                                                                       \
@@ -1084,6 +1285,59 @@ static void rgb24_to_pal8(AVPicture *dst, AVPicture *src,
     while (i < 256)
         pal[i++] = 0;
 }
+
+/* the same sums as rgb24_to_yuv422() makes of pal8_to_rgb24(), taken
+   once per palette entry */
+static void pal8_to_yuv422(AVPicture *dst, AVPicture *src,
+                           int width, int height)
+{
+    const unsigned char *p;
+    unsigned char *q;
+    int r, g, b, dst_wrap, src_wrap;
+    int i, w, y;
+    const uint32_t *palette;
+    uint8_t lum[256];
+    int cb[256], cr[256];
+
+    palette = (uint32_t *)src->data[1];
+    for(i=0;i<256;i++) {
+        r = (palette[i] >> 16) & 0xff;
+        g = (palette[i] >> 8) & 0xff;
+        b = palette[i] & 0xff;
+        lum[i] = (FIX(0.29900) * r + FIX(0.58700) * g +
+                  FIX(0.11400) * b + ONE_HALF) >> SCALEBITS;
+        cb[i] = - FIX(0.16874) * r - FIX(0.33126) * g + FIX(0.50000) * b;
+        cr[i] = FIX(0.50000) * r - FIX(0.41869) * g - FIX(0.08131) * b;
+    }
+
+    p = src->data[0];
+    src_wrap = src->linesize[0] - width;
+
+    q = dst->data[0];
+    dst_wrap = dst->linesize[0] - 2 * width;
+
+    for(y=0;y<height;y++) {
+        for(w=width;w>=2;w-=2) {
+            q[0] = lum[p[0]];
+            q[1] = ((cb[p[0]] + cb[p[1]] + 2 * ONE_HALF - 1) >>
+                    (SCALEBITS + 1)) + 128;
+            q[2] = lum[p[1]];
+            q[3] = ((cr[p[0]] + cr[p[1]] + 2 * ONE_HALF - 1) >>
+                    (SCALEBITS + 1)) + 128;
+            q += 4;
+            p += 2;
+        }
+        /* an odd last pixel only has room for Y and U */
+        if (w) {
+            q[0] = lum[p[0]];
+            q[1] = ((cb[p[0]] + ONE_HALF - 1) >> SCALEBITS) + 128;
+            q += 2;
+            p++;
+        }
+        p += src_wrap;
+        q += dst_wrap;
+    }
+}
         
 typedef struct ConvertEntry {
     void (*convert)(AVPicture *dst, AVPicture *src, int width, int height);
@@ -1110,6 +1364,9 @@ static ConvertEntry convert_table[PIX_FMT_NB][PIX_FMT_NB] = {
         [PIX_FMT_RGBA32] = { 
             .convert = yuv420p_to_rgba32
         },
+        [PIX_FMT_YUV422] = { 
+            .convert = yuv420p_to_yuv422
+        },
     },
     [PIX_FMT_YUV422P] = {
         [PIX_FMT_RGB555] = { 
@@ -1128,6 +1385,26 @@ static ConvertEntry convert_table[PIX_FMT_NB][PIX_FMT_NB] = {
             .convert = yuv422p_to_rgba32
         },
     },
+    [PIX_FMT_YUV411P] = {
+        [PIX_FMT_YUV422] = { 
+            .convert = yuv411p_to_yuv422
+        },
+        [PIX_FMT_RGB555] = { 
+            .convert = yuv411p_to_rgb555
+        },
+        [PIX_FMT_RGB565] = { 
+            .convert = yuv411p_to_rgb565
+        },
+        [PIX_FMT_BGR24] = { 
+            .convert = yuv411p_to_bgr24
+        },
+        [PIX_FMT_RGB24] = { 
+            .convert = yuv411p_to_rgb24
+        },
+        [PIX_FMT_RGBA32] = { 
+            .convert = yuv411p_to_rgba32
+        },
+    },
     [PIX_FMT_YUV422] = { 
         [PIX_FMT_YUV420P] = { 
             .convert = yuv422_to_yuv420p,
@@ -1150,6 +1427,9 @@ static ConvertEntry convert_table[PIX_FMT_NB][PIX_FMT_NB] = {
         [PIX_FMT_PAL8] = { 
             .convert = rgb24_to_pal8
         },
+        [PIX_FMT_YUV422] = { 
+            .convert = rgb24_to_yuv422
+        },
     },
     [PIX_FMT_RGBA32] = {
         [PIX_FMT_YUV420P] = { 
@@ -1158,6 +1438,9 @@ static ConvertEntry convert_table[PIX_FMT_NB][PIX_FMT_NB] = {
         [PIX_FMT_GRAY8] = { 
             .convert = rgba32_to_gray
         },
+        [PIX_FMT_YUV422] = { 
+            .convert = rgba32_to_yuv422
+        },
     },
     [PIX_FMT_BGR24] = {
         [PIX_FMT_YUV420P] = { 
@@ -1166,6 +1449,9 @@ static ConvertEntry convert_table[PIX_FMT_NB][PIX_FMT_NB] = {
         [PIX_FMT_GRAY8] = { 
             .convert = bgr24_to_gray
         },
+        [PIX_FMT_YUV422] = { 
+            .convert = bgr24_to_yuv422
+        },
     },
     [PIX_FMT_RGB555] = {
         [PIX_FMT_YUV420P] = { 
@@ -1174,6 +1460,9 @@ static ConvertEntry convert_table[PIX_FMT_NB][PIX_FMT_NB] = {
         [PIX_FMT_GRAY8] = { 
             .convert = rgb555_to_gray
         },
+        [PIX_FMT_YUV422] = { 
+            .convert = rgb555_to_yuv422
+        },
     },
     [PIX_FMT_RGB565] = {
         [PIX_FMT_YUV420P] = { 
@@ -1182,6 +1471,9 @@ static ConvertEntry convert_table[PIX_FMT_NB][PIX_FMT_NB] = {
         [PIX_FMT_GRAY8] = { 
             .convert = rgb565_to_gray
         },
+        [PIX_FMT_YUV422] = { 
+            .convert = rgb565_to_yuv422
+        },
     },
     [PIX_FMT_GRAY8] = {
         [PIX_FMT_RGB555] = { 
@@ -1232,6 +1524,9 @@ static ConvertEntry convert_table[PIX_FMT_NB][PIX_FMT_NB] = {
         [PIX_FMT_RGBA32] = { 
             .convert = pal8_to_rgba32
         },
+        [PIX_FMT_YUV422] = { 
+            .convert = pal8_to_yuv422
+        },
     },
 };
 
@@ -1259,24 +1554,61 @@ static void avpicture_free(AVPicture *picture)
     av_free(picture->data[0]);
 }
 
-/* XXX: always use linesize. Return -1 if not supported */
-int img_convert(AVPicture *dst, int dst_pix_fmt,
-                AVPicture *src, int src_pix_fmt, 
-                int src_width, int src_height)
+/* the function that brings the chroma planes of one planar YUV format to
+   another, or NULL if there is none */
+static void (*yuv_resize_func(PixFmtInfo *dst_pix, PixFmtInfo *src_pix))
+    (uint8_t *dst, int dst_wrap, uint8_t *src, int src_wrap,
+     int width, int height)
+{
+    int x_shift, y_shift;
+
+    x_shift = (dst_pix->x_chroma_shift - src_pix->x_chroma_shift);
+    y_shift = (dst_pix->y_chroma_shift - src_pix->y_chroma_shift);
+    if (x_shift == 0 && y_shift == 0) {
+        return img_copy; /* should never happen */
+    } else if (x_shift == 0 && y_shift == 1) {
+        return shrink2;
+    } else if (x_shift == 1 && y_shift == 1) {
+        return shrink22;
+    } else if (x_shift == -1 && y_shift == -1) {
+        return grow22;
+    } else if (x_shift == -1 && y_shift == 1) {
+        return conv411;
+    }
+    /* currently not handled */
+    return NULL;
+}
+
+/* true if convert_step() can go from src_pix_fmt to dst_pix_fmt in one
+   step */
+static int can_convert_step(int dst_pix_fmt, int src_pix_fmt)
 {
-    int i, ret, dst_width, dst_height, int_pix_fmt;
     PixFmtInfo *src_pix, *dst_pix;
-    ConvertEntry *ce;
-    AVPicture tmp1, *tmp = &tmp1;
 
-    if (src_pix_fmt < 0 || src_pix_fmt >= PIX_FMT_NB ||
-        dst_pix_fmt < 0 || dst_pix_fmt >= PIX_FMT_NB)
-        return -1;
-    if (src_width <= 0 || src_height <= 0)
-        return 0;
+    dst_pix = &pix_fmt_info[dst_pix_fmt];
+    src_pix = &pix_fmt_info[src_pix_fmt];
+    if (src_pix_fmt == dst_pix_fmt ||
+        convert_table[src_pix_fmt][dst_pix_fmt].convert)
+        return 1;
+    /* only the planar YUV formats are handled below */
+    if (src_pix_fmt == PIX_FMT_GRAY8)
+        return dst_pix->is_yuv && !dst_pix->is_packed;
+    if (dst_pix_fmt == PIX_FMT_GRAY8)
+        return src_pix->is_yuv && !src_pix->is_packed;
+    if (dst_pix->is_yuv && !dst_pix->is_packed &&
+        src_pix->is_yuv && !src_pix->is_packed)
+        return yuv_resize_func(dst_pix, src_pix) != NULL;
+    return 0;
+}
 
-    dst_width = src_width;
-    dst_height = src_height;
+/* one step of a conversion, as can_convert_step() allows */
+static void convert_step(AVPicture *dst, int dst_pix_fmt,
+                         AVPicture *src, int src_pix_fmt,
+                         int dst_width, int dst_height)
+{
+    int i;
+    PixFmtInfo *src_pix, *dst_pix;
+    ConvertEntry *ce;
 
     dst_pix = &pix_fmt_info[dst_pix_fmt];
     src_pix = &pix_fmt_info[src_pix_fmt];
@@ -1295,18 +1627,18 @@ int img_convert(AVPicture *dst, int dst_pix_fmt,
                      src->data[i], src->linesize[i],
                      w, h);
         }
-        return 0;
+        return;
     }
 
     ce = &convert_table[src_pix_fmt][dst_pix_fmt];
     if (ce->convert) {
         /* specific convertion routine */
         ce->convert(dst, src, dst_width, dst_height);
-        return 0;
+        return;
     }
 
     /* gray to YUV */
-    if (dst_pix->is_yuv && src_pix_fmt == PIX_FMT_GRAY8) {
+    if (src_pix_fmt == PIX_FMT_GRAY8) {
         int w, h, y;
         uint8_t *d;
 
@@ -1325,52 +1657,24 @@ int img_convert(AVPicture *dst, int dst_pix_fmt,
                 d += dst->linesize[i];
             }
         }
-        return 0;
+        return;
     }
 
     /* YUV to gray */
-    if (src_pix->is_yuv && dst_pix_fmt == PIX_FMT_GRAY8) {
+    if (dst_pix_fmt == PIX_FMT_GRAY8) {
         img_copy(dst->data[0], dst->linesize[0],
                  src->data[0], src->linesize[0],
                  dst_width, dst_height);
-        return 0;
+        return;
     }
 
     /* YUV to YUV */
-    if (dst_pix->is_yuv && src_pix->is_yuv) {
-        int x_shift, y_shift, w, h;
+    {
         void (*resize_func)(uint8_t *dst, int dst_wrap, 
                             uint8_t *src, int src_wrap,
                             int width, int height);
 
-        /* compute chroma size of the smallest dimensions */
-        w = dst_width;
-        h = dst_height;
-        if (dst_pix->x_chroma_shift >= src_pix->x_chroma_shift)
-            w >>= dst_pix->x_chroma_shift;
-        else
-            w >>= src_pix->x_chroma_shift;
-        if (dst_pix->y_chroma_shift >= src_pix->y_chroma_shift)
-            h >>= dst_pix->y_chroma_shift;
-        else
-            h >>= src_pix->y_chroma_shift;
-
-        x_shift = (dst_pix->x_chroma_shift - src_pix->x_chroma_shift);
-        y_shift = (dst_pix->y_chroma_shift - src_pix->y_chroma_shift);
-        if (x_shift == 0 && y_shift == 0) {
-            resize_func = img_copy; /* should never happen */
-        } else if (x_shift == 0 && y_shift == 1) {
-            resize_func = shrink2;
-        } else if (x_shift == 1 && y_shift == 1) {
-            resize_func = shrink22;
-        } else if (x_shift == -1 && y_shift == -1) {
-            resize_func = grow22;
-        } else if (x_shift == -1 && y_shift == 1) {
-            resize_func = conv411;
-        } else {
-            /* currently not handled */
-            return -1;
-        }
+        resize_func = yuv_resize_func(dst_pix, src_pix);
 
         img_copy(dst->data[0], dst->linesize[0],
                  src->data[0], src->linesize[0],
@@ -1380,33 +1684,185 @@ int img_convert(AVPicture *dst, int dst_pix_fmt,
             resize_func(dst->data[i], dst->linesize[i],
                         src->data[i], src->linesize[i],
                         dst_width>>dst_pix->x_chroma_shift, dst_height>>dst_pix->y_chroma_shift);
-       return 0;
     }
+}
+
+/* routes are searched over the formats, one step at a time, for the one
+   that reads and writes the fewest bytes */
+#define MAX_CONVERT_STEPS 3
+
+struct ImgConvertContext {
+    int width, height;
+    int nb_steps;
+    int pix_fmts[MAX_CONVERT_STEPS + 1]; /* from source to destination */
+    AVPicture tmp[MAX_CONVERT_STEPS - 1]; /* between the steps */
+};
+
+/* true if int_pix_fmt may come between src_pix_fmt and dst_pix_fmt; if
+   lossy is false, it must keep all that the source holds */
+static int can_pass_through(int int_pix_fmt, int src_pix_fmt,
+                            int dst_pix_fmt, int lossy)
+{
+    PixFmtInfo *int_pix, *src_pix;
+
+    int_pix = &pix_fmt_info[int_pix_fmt];
+    src_pix = &pix_fmt_info[src_pix_fmt];
+    if (int_pix_fmt == PIX_FMT_RGB24)
+        return 1;
+    if (int_pix_fmt == PIX_FMT_GRAY8)
+        return src_pix->is_gray || pix_fmt_info[dst_pix_fmt].is_gray;
+    if (int_pix->is_yuv && !int_pix->is_packed) {
+        if (lossy)
+            return 1;
+        return src_pix->is_yuv &&
+            int_pix->x_chroma_shift <= src_pix->x_chroma_shift &&
+            int_pix->y_chroma_shift <= src_pix->y_chroma_shift;
+    }
+    return 0;
+}
 
-    /* try to use an intermediate format */
-    if (src_pix_fmt == PIX_FMT_MONOWHITE ||
-        src_pix_fmt == PIX_FMT_MONOBLACK ||
-        dst_pix_fmt == PIX_FMT_MONOWHITE ||
-        dst_pix_fmt == PIX_FMT_MONOBLACK) {
-        int_pix_fmt = PIX_FMT_GRAY8;
-    } else {
-        int_pix_fmt = PIX_FMT_RGB24;
+/* fills in the cheapest route of s->width x s->height pictures; returns
+   -1 if there is none */
+static int plan_route(ImgConvertContext *s, int dst_pix_fmt,
+                      int src_pix_fmt, int lossy)
+{
+    int cost[PIX_FMT_NB], steps[PIX_FMT_NB], prev[PIX_FMT_NB];
+    int size[PIX_FMT_NB], done[PIX_FMT_NB];
+    int i, fmt, next, c;
+
+    for(i = 0; i < PIX_FMT_NB; i++) {
+        size[i] = avpicture_get_size(i, s->width, s->height);
+        cost[i] = -1;
+        done[i] = 0;
     }
-    if (avpicture_alloc(tmp, int_pix_fmt, dst_width, dst_height) < 0)
-        return -1;
-    ret = -1;
-    if (img_convert(tmp, int_pix_fmt,
-                    src, src_pix_fmt, src_width, src_height) < 0)
-        goto fail1;
-    if (img_convert(dst, dst_pix_fmt,
-                    tmp, int_pix_fmt, dst_width, dst_height) < 0)
-        goto fail1;
-    ret = 0;
- fail1:
-    avpicture_free(tmp);
-    return ret;
+    cost[src_pix_fmt] = 0;
+    steps[src_pix_fmt] = 0;
+    prev[src_pix_fmt] = -1;
+
+    for(;;) {
+        /* the cheapest format not yet done */
+        fmt = -1;
+        for(i = 0; i < PIX_FMT_NB; i++)
+            if (!done[i] && cost[i] >= 0 &&
+                (fmt < 0 || cost[i] < cost[fmt]))
+                fmt = i;
+        if (fmt < 0)
+            return -1;
+        if (fmt == dst_pix_fmt)
+            break;
+        done[fmt] = 1;
+        if (steps[fmt] == MAX_CONVERT_STEPS ||
+            (fmt != src_pix_fmt &&
+             !can_pass_through(fmt, src_pix_fmt, dst_pix_fmt, lossy)))
+            continue;
+        for(next = 0; next < PIX_FMT_NB; next++) {
+            if (done[next] || next == fmt || size[next] < 0 ||
+                !can_convert_step(next, fmt))
+                continue;
+            c = cost[fmt] + size[fmt] + size[next];
+            if (cost[next] < 0 || c < cost[next]) {
+                cost[next] = c;
+                steps[next] = steps[fmt] + 1;
+                prev[next] = fmt;
+            }
+        }
+    }
+
+    /* a same format conversion is one copy */
+    s->nb_steps = steps[dst_pix_fmt] ? steps[dst_pix_fmt] : 1;
+    s->pix_fmts[0] = src_pix_fmt;
+    for(fmt = dst_pix_fmt, i = s->nb_steps; i > 0; fmt = prev[fmt], i--)
+        s->pix_fmts[i] = fmt;
+    return 0;
+}
+
+/**
+ * Plans the conversion of width x height pictures from src_pix_fmt to
+ * dst_pix_fmt, and allocates the pictures needed between its steps, so
+ * that img_convert_frame() does no more than convert.
+ * @return NULL if there is no way between the formats
+ */
+ImgConvertContext *img_convert_init(int dst_pix_fmt, int src_pix_fmt,
+                                    int width, int height)
+{
+    ImgConvertContext *s;
+    int i;
+
+    if (src_pix_fmt < 0 || src_pix_fmt >= PIX_FMT_NB ||
+        dst_pix_fmt < 0 || dst_pix_fmt >= PIX_FMT_NB ||
+        width <= 0 || height <= 0)
+        return NULL;
+
+    s = av_mallocz(sizeof(ImgConvertContext));
+    if (!s)
+        return NULL;
+    s->width = width;
+    s->height = height;
+    /* routes that lose nothing on the way are preferred */
+    if (plan_route(s, dst_pix_fmt, src_pix_fmt, 0) < 0 &&
+        plan_route(s, dst_pix_fmt, src_pix_fmt, 1) < 0)
+        goto fail;
+
+    for(i = 1; i < s->nb_steps; i++)
+        if (avpicture_alloc(&s->tmp[i - 1], s->pix_fmts[i], width, height) < 0)
+            goto fail;
+    return s;
+ fail:
+    img_convert_close(s);
+    return NULL;
 }
 
+int img_convert_frame(ImgConvertContext *s, AVPicture *dst, AVPicture *src)
+{
+    AVPicture *in, *out;
+    int i;
+
+    in = src;
+    for(i = 0; i < s->nb_steps; i++) {
+        out = (i == s->nb_steps - 1) ? dst : &s->tmp[i];
+        convert_step(out, s->pix_fmts[i + 1], in, s->pix_fmts[i],
+                     s->width, s->height);
+        in = out;
+    }
+    return 0;
+}
+
+void img_convert_close(ImgConvertContext *s)
+{
+    int i;
+
+    for(i = 0; i < MAX_CONVERT_STEPS - 1; i++)
+        avpicture_free(&s->tmp[i]);
+    av_free(s);
+}
+
+/* XXX: always use linesize. Return -1 if not supported */
+int img_convert(AVPicture *dst, int dst_pix_fmt,
+                AVPicture *src, int src_pix_fmt, 
+                int src_width, int src_height)
+{
+    ImgConvertContext *s;
+
+    if (src_pix_fmt < 0 || src_pix_fmt >= PIX_FMT_NB ||
+        dst_pix_fmt < 0 || dst_pix_fmt >= PIX_FMT_NB)
+        return -1;
+    if (src_width <= 0 || src_height <= 0)
+        return 0;
+
+    /* a single step needs no planning */
+    if (can_convert_step(dst_pix_fmt, src_pix_fmt)) {
+        convert_step(dst, dst_pix_fmt, src, src_pix_fmt,
+                     src_width, src_height);
+        return 0;
+    }
+
+    s = img_convert_init(dst_pix_fmt, src_pix_fmt, src_width, src_height);
+    if (!s)
+        return -1;
+    img_convert_frame(s, dst, src);
+    img_convert_close(s);
+    return 0;
+}
 
 #ifdef HAVE_MMX
 #define DEINT_INPLACE_LINE_LUM \
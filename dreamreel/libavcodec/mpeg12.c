@@ -0,0 +1,941 @@
+/*
+ * MPEG1 video decoder
+ * Copyright (c) 2000,2001 Fabrice Bellard.
+ * Copyright (C) 2003 the ffmpeg project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * This is a cut down MPEG1 decoder for the Dreamcast. The full
+ * MpegEncContext machinery (mpegvideo.c) is not part of this tree, so the
+ * decoder keeps its own small context and does the prediction itself with
+ * the dsputil primitives. The coefficient parsing and dequantization follow
+ * ffmpeg's mpeg12.c exactly, so that the output matches the reference
+ * decoder bit for bit.
+ *
+ * Each call to decode takes one coded picture (with any sequence and GOP
+ * headers in front of it). Reference pictures come out one picture late,
+ * B pictures right away; B pictures are not decoded at all while
+ * avctx->hurry_up is set, which is how the engine sheds load on a 200 MHz
+ * SH4. A call with buf_size 0 hands out the last reference picture.
+ */
+
+/**
+ * @file mpeg12.c
+ * MPEG1 video decoder.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CACHED_BITSTREAM_READER
+#include "common.h"
+#include "avcodec.h"
+#include "dsputil.h"
+#include "mpegvideo.h"
+
+#include "mpeg12data.h"
+
+#define SEQ_END_CODE            0xb7
+#define SEQ_START_CODE          0xb3
+#define GOP_START_CODE          0xb8
+#define PICTURE_START_CODE      0x00
+#define SLICE_MIN_START_CODE    0x01
+#define SLICE_MAX_START_CODE    0xaf
+#define EXT_START_CODE          0xb5
+#define USER_START_CODE         0xb2
+
+/* the default intra quantizer matrix, in raster order */
+const int16_t ff_mpeg1_default_intra_matrix[64] = {
+     8, 16, 19, 22, 26, 27, 29, 34,
+    16, 16, 22, 24, 27, 29, 34, 37,
+    19, 22, 26, 27, 29, 34, 34, 38,
+    22, 22, 26, 27, 29, 34, 37, 40,
+    22, 26, 27, 29, 32, 35, 40, 48,
+    26, 27, 29, 32, 35, 40, 48, 58,
+    26, 27, 29, 34, 38, 46, 56, 69,
+    27, 29, 35, 38, 46, 56, 69, 83
+};
+
+const int16_t ff_mpeg1_default_non_intra_matrix[64] = {
+    16, 16, 16, 16, 16, 16, 16, 16,
+    16, 16, 16, 16, 16, 16, 16, 16,
+    16, 16, 16, 16, 16, 16, 16, 16,
+    16, 16, 16, 16, 16, 16, 16, 16,
+    16, 16, 16, 16, 16, 16, 16, 16,
+    16, 16, 16, 16, 16, 16, 16, 16,
+    16, 16, 16, 16, 16, 16, 16, 16,
+    16, 16, 16, 16, 16, 16, 16, 16,
+};
+
+/* the VLC lookup tables, built by tablegen/vlcgen.c when the library is
+ * built rather than by init_vlc() when the decoder opens */
+#include "mpeg12vlc.h"
+
+typedef struct Mpeg1Context {
+    AVCodecContext *avctx;
+    DSPContext dsp;
+    GetBitContext gb;
+
+    /* sequence */
+    int seq_ok;                ///< a usable sequence header has been seen
+    int width, height;
+    int mb_width, mb_height;
+    ScanTable scantable;       ///< zigzag order, permutated for the idct
+    uint16_t intra_matrix[64]; ///< in idct_permutation order
+    uint16_t inter_matrix[64]; ///< in idct_permutation order
+
+    /* picture */
+    int pict_type;
+    int full_pel[2];
+    int f_code[2];
+    int linesize, uvlinesize;
+
+    /* slice and macroblock */
+    int qscale;
+    int mb_x, mb_y;
+    int mb_dir;                ///< MB_FOR and MB_BACK of the last macroblock
+    int last_dc[3];
+    int last_mv[2][2];         ///< motion vector predictors, as coded
+    int mv[2][2];              ///< vectors of the macroblock, in half pels
+    DCTELEM (*block)[64];
+
+    AVFrame picture[3];
+    AVFrame *last_picture;     ///< forward reference, already handed out
+    AVFrame *next_picture;     ///< backward reference, still to be shown
+    AVFrame *current_picture;  ///< the picture the slices go into
+    AVFrame *b_picture;        ///< B picture handed out by the last call
+    AVFrame coded_frame;       ///< type of the last coded picture
+
+    uint8_t *slice_buffer;     ///< padded copy of the last unit in a buffer
+    unsigned int slice_buffer_size;
+} Mpeg1Context;
+
+static int mpeg1_decode_init(AVCodecContext *avctx)
+{
+    Mpeg1Context *s = avctx->priv_data;
+    int i, j;
+
+    s->avctx = avctx;
+    avctx->pix_fmt = PIX_FMT_YUV420P;
+    avctx->has_b_frames = 1;
+    avctx->coded_frame = &s->coded_frame;
+
+    dsputil_init(&s->dsp, avctx);
+
+    s->scantable.scantable = ff_zigzag_direct;
+    for (i = 0; i < 64; i++) {
+        j = s->dsp.idct_permutation[i];
+        s->scantable.permutated[i] = s->dsp.idct_permutation[ff_zigzag_direct[i]];
+        s->intra_matrix[j] = ff_mpeg1_default_intra_matrix[i];
+        s->inter_matrix[j] = ff_mpeg1_default_non_intra_matrix[i];
+    }
+
+    s->block = av_malloc(6 * 64 * sizeof(DCTELEM));
+    if (!s->block)
+        return -1;
+
+    return 0;
+}
+
+/* returns the offset just past the next 00 00 01 at or after pos, or
+ * buf_size if there is none */
+static int find_start_code(const uint8_t *buf, int pos, int buf_size)
+{
+    while (pos + 3 <= buf_size) {
+        if (buf[pos + 2] > 1)
+            pos += 3;
+        else if (buf[pos + 1])
+            pos += 2;
+        else if (buf[pos] || buf[pos + 2] != 1)
+            pos++;
+        else
+            return pos + 3;
+    }
+    return buf_size;
+}
+
+static void mpeg1_release_pictures(Mpeg1Context *s)
+{
+    int i;
+
+    for (i = 0; i < 3; i++)
+        if (s->picture[i].data[0])
+            s->avctx->release_buffer(s->avctx, &s->picture[i]);
+    s->last_picture = s->next_picture = NULL;
+    s->current_picture = s->b_picture = NULL;
+}
+
+static AVFrame *mpeg1_alloc_picture(Mpeg1Context *s)
+{
+    AVFrame *pic;
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        pic = &s->picture[i];
+        if (!pic->data[0]) {
+            if (s->avctx->get_buffer(s->avctx, pic) < 0) {
+                fprintf(stderr, "mpeg1: get_buffer() failed\n");
+                return NULL;
+            }
+            return pic;
+        }
+    }
+    fprintf(stderr, "mpeg1: no free picture\n");
+    return NULL;
+}
+
+static int mpeg1_decode_sequence(Mpeg1Context *s, const uint8_t *buf,
+                                 int buf_size)
+{
+    AVCodecContext *avctx = s->avctx;
+    int width, height, frame_rate_index, i, j;
+
+    init_get_bits(&s->gb, buf, buf_size * 8);
+
+    width  = get_bits(&s->gb, 12);
+    height = get_bits(&s->gb, 12);
+    skip_bits(&s->gb, 4); /* aspect ratio */
+    frame_rate_index = get_bits(&s->gb, 4);
+    if (width <= 0 || height <= 0 ||
+        frame_rate_index == 0 || frame_rate_index > 8) {
+        s->seq_ok = 0;
+        return -1;
+    }
+    skip_bits(&s->gb, 18); /* bit rate */
+    skip_bits1(&s->gb);    /* marker */
+    skip_bits(&s->gb, 10); /* vbv buffer size */
+    skip_bits1(&s->gb);    /* constrained parameters */
+
+    /* the matrices come in zigzag order */
+    if (get_bits1(&s->gb)) {
+        for (i = 0; i < 64; i++) {
+            j = s->scantable.permutated[i];
+            s->intra_matrix[j] = get_bits(&s->gb, 8);
+        }
+    } else {
+        for (i = 0; i < 64; i++) {
+            j = s->dsp.idct_permutation[i];
+            s->intra_matrix[j] = ff_mpeg1_default_intra_matrix[i];
+        }
+    }
+    if (get_bits1(&s->gb)) {
+        for (i = 0; i < 64; i++) {
+            j = s->scantable.permutated[i];
+            s->inter_matrix[j] = get_bits(&s->gb, 8);
+        }
+    } else {
+        for (i = 0; i < 64; i++) {
+            j = s->dsp.idct_permutation[i];
+            s->inter_matrix[j] = ff_mpeg1_default_non_intra_matrix[i];
+        }
+    }
+    if (get_bits_count(&s->gb) > buf_size * 8) {
+        fprintf(stderr, "mpeg1: sequence header truncated\n");
+        s->seq_ok = 0;
+        return -1;
+    }
+
+    if (width != s->width || height != s->height) {
+        /* the pictures are the wrong size now */
+        mpeg1_release_pictures(s);
+        s->width = width;
+        s->height = height;
+        s->mb_width = (width + 15) >> 4;
+        s->mb_height = (height + 15) >> 4;
+        avctx->width = width;
+        avctx->height = height;
+    }
+    avctx->frame_rate = frame_rate_tab[frame_rate_index][0];
+    avctx->frame_rate_base = frame_rate_tab[frame_rate_index][1];
+
+    s->seq_ok = 1;
+    return 0;
+}
+
+static int mpeg1_decode_picture_header(Mpeg1Context *s, const uint8_t *buf,
+                                       int buf_size)
+{
+    init_get_bits(&s->gb, buf, buf_size * 8);
+
+    skip_bits(&s->gb, 10); /* temporal reference */
+    s->pict_type = get_bits(&s->gb, 3);
+    skip_bits(&s->gb, 16); /* vbv delay */
+    if (s->pict_type == P_TYPE || s->pict_type == B_TYPE) {
+        s->full_pel[0] = get_bits1(&s->gb);
+        s->f_code[0] = get_bits(&s->gb, 3);
+        if (s->f_code[0] == 0)
+            return -1;
+    }
+    if (s->pict_type == B_TYPE) {
+        s->full_pel[1] = get_bits1(&s->gb);
+        s->f_code[1] = get_bits(&s->gb, 3);
+        if (s->f_code[1] == 0)
+            return -1;
+    }
+    /* D pictures and reserved types */
+    if (s->pict_type < I_TYPE || s->pict_type > B_TYPE)
+        return -1;
+
+    return 0;
+}
+
+/* sets up the picture the slices go into; returns 1 if the picture is
+ * to be skipped */
+static int mpeg1_start_picture(Mpeg1Context *s)
+{
+    AVFrame *pic;
+
+    s->coded_frame.pict_type = s->pict_type;
+    s->coded_frame.key_frame = (s->pict_type == I_TYPE);
+
+    if (s->pict_type == B_TYPE) {
+        /* B pictures are the ones nothing else depends on; they go when
+         * the decoder runs late, and after a seek into an open GOP */
+        if (s->avctx->hurry_up || !s->last_picture || !s->next_picture)
+            return 1;
+    } else {
+        if (s->pict_type == P_TYPE && !s->next_picture)
+            return 1;
+        if (s->last_picture)
+            s->avctx->release_buffer(s->avctx, s->last_picture);
+        s->last_picture = s->next_picture;
+        s->next_picture = NULL;
+    }
+
+    pic = mpeg1_alloc_picture(s);
+    if (!pic)
+        return -1;
+    pic->pict_type = s->pict_type;
+    pic->key_frame = (s->pict_type == I_TYPE);
+    if (s->pict_type != B_TYPE)
+        s->next_picture = pic;
+
+    s->current_picture = pic;
+    s->linesize = pic->linesize[0];
+    s->uvlinesize = pic->linesize[1];
+
+    return 0;
+}
+
+static inline int decode_dc(GetBitContext *gb, int component)
+{
+    int code, diff;
+
+    if (component == 0)
+        code = get_vlc2(gb, dc_lum_vlc, DC_VLC_BITS, 1);
+    else
+        code = get_vlc2(gb, dc_chroma_vlc, DC_VLC_BITS, 2);
+    if (code < 0)
+        return 0xffff;
+    if (code == 0)
+        return 0;
+
+    diff = get_bits(gb, code);
+    if ((diff & (1 << (code - 1))) == 0)
+        diff = (-1 << code) | (diff + 1);
+    return diff;
+}
+
+static int mpeg1_decode_motion(Mpeg1Context *s, int fcode, int pred)
+{
+    int code, sign, val, l, shift;
+
+    code = get_vlc2(&s->gb, mv_vlc, MV_VLC_BITS, 2);
+    if (code == 0)
+        return pred;
+    if (code < 0)
+        return 0xffff;
+
+    sign = get_bits1(&s->gb);
+    shift = fcode - 1;
+    val = code;
+    if (shift) {
+        val = (val - 1) << shift;
+        val |= get_bits(&s->gb, shift);
+        val++;
+    }
+    if (sign)
+        val = -val;
+    val += pred;
+
+    /* modulo decoding */
+    l = 1 << (shift + 4);
+    val = ((val + l) & (l * 2 - 1)) - l;
+    return val;
+}
+
+static int mpeg1_decode_block_intra(Mpeg1Context *s, DCTELEM *block, int n)
+{
+    int level, dc, diff, i, j, run;
+    int component;
+    const RL_VLC_ELEM *rl_vlc = mpeg1_rl_vlc;
+    const uint8_t *scantable = s->scantable.permutated;
+    const uint16_t *quant_matrix = s->intra_matrix;
+    const int qscale = s->qscale;
+
+    /* DC coef */
+    component = (n <= 3 ? 0 : n - 4 + 1);
+    diff = decode_dc(&s->gb, component);
+    if (diff >= 0xffff)
+        return -1;
+    dc = s->last_dc[component];
+    dc += diff;
+    s->last_dc[component] = dc;
+    block[0] = dc << 3;
+    i = 0;
+    {
+        OPEN_READER(re, &s->gb);
+        /* now dequantize the AC coefs */
+        for (;;) {
+            UPDATE_CACHE(re, &s->gb);
+            GET_RL_VLC(level, run, re, &s->gb, rl_vlc, TEX_VLC_BITS, 2);
+
+            if (level == 127) {
+                break;
+            } else if (level != 0) {
+                i += run;
+                if (i > 63)
+                    goto damaged;
+                j = scantable[i];
+                level = (level * qscale * quant_matrix[j]) >> 3;
+                level = (level - 1) | 1;
+                level = (level ^ SHOW_SBITS(re, &s->gb, 1)) - SHOW_SBITS(re, &s->gb, 1);
+                LAST_SKIP_BITS(re, &s->gb, 1);
+            } else {
+                /* escape */
+                run = SHOW_UBITS(re, &s->gb, 6) + 1; SKIP_BITS(re, &s->gb, 6);
+                UPDATE_CACHE(re, &s->gb);
+                level = SHOW_SBITS(re, &s->gb, 8); SKIP_BITS(re, &s->gb, 8);
+                if (level == -128) {
+                    level = SHOW_UBITS(re, &s->gb, 8) - 256; LAST_SKIP_BITS(re, &s->gb, 8);
+                } else if (level == 0) {
+                    level = SHOW_UBITS(re, &s->gb, 8);       LAST_SKIP_BITS(re, &s->gb, 8);
+                }
+                i += run;
+                if (i > 63)
+                    goto damaged;
+                j = scantable[i];
+                if (level < 0) {
+                    level = -level;
+                    level = (level * qscale * quant_matrix[j]) >> 3;
+                    level = (level - 1) | 1;
+                    level = -level;
+                } else {
+                    level = (level * qscale * quant_matrix[j]) >> 3;
+                    level = (level - 1) | 1;
+                }
+            }
+            block[j] = level;
+        }
+        CLOSE_READER(re, &s->gb);
+    }
+    return 0;
+
+damaged:
+    fprintf(stderr, "mpeg1: ac-tex damaged at %d %d\n", s->mb_x, s->mb_y);
+    return -1;
+}
+
+static int mpeg1_decode_block_inter(Mpeg1Context *s, DCTELEM *block)
+{
+    int level, i, j, run;
+    const RL_VLC_ELEM *rl_vlc = mpeg1_rl_vlc;
+    const uint8_t *scantable = s->scantable.permutated;
+    const uint16_t *quant_matrix = s->inter_matrix;
+    const int qscale = s->qscale;
+
+    i = -1;
+    {
+        OPEN_READER(re, &s->gb);
+        UPDATE_CACHE(re, &s->gb);
+        /* the first coefficient has a short code of its own: "1s" is
+         * run 0, level 1 */
+        if (((int32_t)GET_CACHE(re, &s->gb)) < 0) {
+            level = (3 * qscale * quant_matrix[0]) >> 4;
+            level = (level - 1) | 1;
+            if (GET_CACHE(re, &s->gb) & 0x40000000)
+                level = -level;
+            block[0] = level;
+            i = 0;
+            SKIP_BITS(re, &s->gb, 2);
+        }
+
+        for (;;) {
+            UPDATE_CACHE(re, &s->gb);
+            GET_RL_VLC(level, run, re, &s->gb, rl_vlc, TEX_VLC_BITS, 2);
+
+            if (level == 127) {
+                break;
+            } else if (level != 0) {
+                i += run;
+                if (i > 63)
+                    goto damaged;
+                j = scantable[i];
+                level = ((level * 2 + 1) * qscale * quant_matrix[j]) >> 4;
+                level = (level - 1) | 1;
+                level = (level ^ SHOW_SBITS(re, &s->gb, 1)) - SHOW_SBITS(re, &s->gb, 1);
+                LAST_SKIP_BITS(re, &s->gb, 1);
+            } else {
+                /* escape */
+                run = SHOW_UBITS(re, &s->gb, 6) + 1; SKIP_BITS(re, &s->gb, 6);
+                UPDATE_CACHE(re, &s->gb);
+                level = SHOW_SBITS(re, &s->gb, 8); SKIP_BITS(re, &s->gb, 8);
+                if (level == -128) {
+                    level = SHOW_UBITS(re, &s->gb, 8) - 256; LAST_SKIP_BITS(re, &s->gb, 8);
+                } else if (level == 0) {
+                    level = SHOW_UBITS(re, &s->gb, 8);       LAST_SKIP_BITS(re, &s->gb, 8);
+                }
+                i += run;
+                if (i > 63)
+                    goto damaged;
+                j = scantable[i];
+                if (level < 0) {
+                    level = -level;
+                    level = ((level * 2 + 1) * qscale * quant_matrix[j]) >> 4;
+                    level = (level - 1) | 1;
+                    level = -level;
+                } else {
+                    level = ((level * 2 + 1) * qscale * quant_matrix[j]) >> 4;
+                    level = (level - 1) | 1;
+                }
+            }
+            block[j] = level;
+        }
+        CLOSE_READER(re, &s->gb);
+    }
+    return 0;
+
+damaged:
+    fprintf(stderr, "mpeg1: ac-tex damaged at %d %d\n", s->mb_x, s->mb_y);
+    return -1;
+}
+
+/* predicts the macroblock at mb_x, mb_y from one reference; broken
+ * vectors are held inside the picture edges */
+static void mpeg1_motion(Mpeg1Context *s, uint8_t *dest_y, uint8_t *dest_cb,
+                         uint8_t *dest_cr, AVFrame *ref, int mx, int my,
+                         op_pixels_func (*pix_op)[4])
+{
+    const int linesize = s->linesize;
+    const int uvlinesize = s->uvlinesize;
+    int src_x, src_y, dxy, uvsrc_x, uvsrc_y, uvdxy, offset;
+
+    dxy = ((my & 1) << 1) | (mx & 1);
+    src_x = clip(s->mb_x * 16 + (mx >> 1), -16, s->mb_width * 16 - 1);
+    src_y = clip(s->mb_y * 16 + (my >> 1), -16, s->mb_height * 16 - 1);
+    pix_op[0][dxy](dest_y, ref->data[0] + src_y * linesize + src_x,
+                   linesize, 16);
+
+    mx /= 2;
+    my /= 2;
+    uvdxy = ((my & 1) << 1) | (mx & 1);
+    uvsrc_x = clip(s->mb_x * 8 + (mx >> 1), -8, s->mb_width * 8 - 1);
+    uvsrc_y = clip(s->mb_y * 8 + (my >> 1), -8, s->mb_height * 8 - 1);
+    offset = uvsrc_y * uvlinesize + uvsrc_x;
+    pix_op[1][uvdxy](dest_cb, ref->data[1] + offset, uvlinesize, 8);
+    pix_op[1][uvdxy](dest_cr, ref->data[2] + offset, uvlinesize, 8);
+}
+
+static void mpeg1_motion_compensate(Mpeg1Context *s, int dir)
+{
+    AVFrame *pic = s->current_picture;
+    op_pixels_func (*op_pix)[4] = s->dsp.put_pixels_tab;
+    uint8_t *dest_y, *dest_cb, *dest_cr;
+
+    dest_y = pic->data[0] + (s->mb_y * 16) * s->linesize + s->mb_x * 16;
+    dest_cb = pic->data[1] + (s->mb_y * 8) * s->uvlinesize + s->mb_x * 8;
+    dest_cr = pic->data[2] + (s->mb_y * 8) * s->uvlinesize + s->mb_x * 8;
+
+    if (dir & MB_FOR) {
+        mpeg1_motion(s, dest_y, dest_cb, dest_cr, s->last_picture,
+                     s->mv[0][0], s->mv[0][1], op_pix);
+        op_pix = s->dsp.avg_pixels_tab;
+    }
+    if (dir & MB_BACK)
+        mpeg1_motion(s, dest_y, dest_cb, dest_cr, s->next_picture,
+                     s->mv[1][0], s->mv[1][1], op_pix);
+}
+
+/* puts or adds the decoded blocks of the macroblock at mb_x, mb_y */
+static void mpeg1_put_block(Mpeg1Context *s, int n, int intra)
+{
+    AVFrame *pic = s->current_picture;
+    uint8_t *dest;
+    int linesize;
+
+    if (n < 4) {
+        linesize = s->linesize;
+        dest = pic->data[0] + (s->mb_y * 16 + (n & 2) * 4) * linesize +
+            s->mb_x * 16 + (n & 1) * 8;
+    } else {
+        linesize = s->uvlinesize;
+        dest = pic->data[n - 3] + (s->mb_y * 8) * linesize + s->mb_x * 8;
+    }
+    if (intra)
+        s->dsp.idct_put(dest, linesize, s->block[n]);
+    else
+        s->dsp.idct_add(dest, linesize, s->block[n]);
+}
+
+static void mpeg1_advance_mb(Mpeg1Context *s, int count)
+{
+    /* no division on the SH4 fast path */
+    s->mb_x += count;
+    while (s->mb_x >= s->mb_width) {
+        s->mb_x -= s->mb_width;
+        s->mb_y++;
+    }
+}
+
+static void mpeg1_skip_macroblocks(Mpeg1Context *s, int count)
+{
+    int dir;
+
+    s->last_dc[0] = s->last_dc[1] = s->last_dc[2] = 128;
+    if (s->pict_type == P_TYPE) {
+        /* a skipped P macroblock is a copy of the reference */
+        memset(s->last_mv, 0, sizeof(s->last_mv));
+        s->mv[0][0] = s->mv[0][1] = 0;
+        dir = MB_FOR;
+    } else {
+        /* a skipped B macroblock repeats the prediction of the last one */
+        dir = s->mb_dir;
+        if (!dir)
+            dir = MB_FOR;
+    }
+    while (count--) {
+        mpeg1_advance_mb(s, 1);
+        mpeg1_motion_compensate(s, dir);
+    }
+}
+
+static int mpeg1_decode_mv(Mpeg1Context *s, int dir)
+{
+    int mx, my;
+
+    mx = mpeg1_decode_motion(s, s->f_code[dir], s->last_mv[dir][0]);
+    if (mx == 0xffff)
+        return -1;
+    my = mpeg1_decode_motion(s, s->f_code[dir], s->last_mv[dir][1]);
+    if (my == 0xffff)
+        return -1;
+    s->last_mv[dir][0] = mx;
+    s->last_mv[dir][1] = my;
+    s->mv[dir][0] = mx << s->full_pel[dir];
+    s->mv[dir][1] = my << s->full_pel[dir];
+    return 0;
+}
+
+static int mpeg1_decode_mb(Mpeg1Context *s)
+{
+    int type, cbp, dir, i;
+
+    switch (s->pict_type) {
+    case I_TYPE:
+        if (get_bits1(&s->gb))
+            type = MB_INTRA;
+        else if (get_bits1(&s->gb))
+            type = MB_QUANT | MB_INTRA;
+        else
+            return -1;
+        break;
+    case P_TYPE:
+        type = get_vlc2(&s->gb, mb_ptype_vlc, MB_PTYPE_VLC_BITS, 1);
+        if (type < 0)
+            return -1;
+        type = table_mb_ptype[type][2];
+        break;
+    default:
+        type = get_vlc2(&s->gb, mb_btype_vlc, MB_BTYPE_VLC_BITS, 1);
+        if (type < 0)
+            return -1;
+        type = table_mb_btype[type][2];
+        break;
+    }
+
+    if (type & MB_QUANT) {
+        s->qscale = get_bits(&s->gb, 5);
+        if (!s->qscale)
+            return -1;
+    }
+
+    if (type & MB_INTRA) {
+        /* an intra macroblock breaks the chain of vector predictions */
+        memset(s->last_mv, 0, sizeof(s->last_mv));
+        s->mb_dir = 0;
+        s->dsp.clear_blocks(s->block[0]);
+        for (i = 0; i < 6; i++)
+            if (mpeg1_decode_block_intra(s, s->block[i], i) < 0)
+                return -1;
+        for (i = 0; i < 6; i++)
+            mpeg1_put_block(s, i, 1);
+        return 0;
+    }
+
+    s->last_dc[0] = s->last_dc[1] = s->last_dc[2] = 128;
+
+    if (s->pict_type == P_TYPE) {
+        if (type & MB_FOR) {
+            if (mpeg1_decode_mv(s, 0) < 0)
+                return -1;
+        } else {
+            /* no motion compensation: zero vector, predictors reset */
+            s->last_mv[0][0] = s->last_mv[0][1] = 0;
+            s->mv[0][0] = s->mv[0][1] = 0;
+        }
+        dir = MB_FOR;
+    } else {
+        dir = type & (MB_FOR | MB_BACK);
+        if ((dir & MB_FOR) && mpeg1_decode_mv(s, 0) < 0)
+            return -1;
+        if ((dir & MB_BACK) && mpeg1_decode_mv(s, 1) < 0)
+            return -1;
+    }
+    s->mb_dir = dir;
+
+    cbp = 0;
+    if (type & MB_PAT) {
+        cbp = get_vlc2(&s->gb, mb_pat_vlc, MB_PAT_VLC_BITS, 1);
+        if (cbp <= 0)
+            return -1;
+    }
+
+    mpeg1_motion_compensate(s, dir);
+
+    if (cbp) {
+        s->dsp.clear_blocks(s->block[0]);
+        for (i = 0; i < 6; i++) {
+            if (cbp & (32 >> i)) {
+                if (mpeg1_decode_block_inter(s, s->block[i]) < 0)
+                    return -1;
+                mpeg1_put_block(s, i, 0);
+            }
+        }
+    }
+
+    return 0;
+}
+
+static int mpeg1_decode_slice(Mpeg1Context *s, int mb_y, const uint8_t *buf,
+                              int buf_size)
+{
+    int incr, code, addr, mb_count, first;
+
+    if (mb_y >= s->mb_height)
+        return -1;
+
+    init_get_bits(&s->gb, buf, buf_size * 8);
+
+    s->qscale = get_bits(&s->gb, 5);
+    if (!s->qscale)
+        return -1;
+    /* extra information */
+    while (get_bits1(&s->gb))
+        skip_bits(&s->gb, 8);
+
+    s->last_dc[0] = s->last_dc[1] = s->last_dc[2] = 128;
+    memset(s->last_mv, 0, sizeof(s->last_mv));
+    s->mb_dir = 0;
+
+    /* MPEG1 slices may run on past the end of the row, so the address is
+     * kept as a count of macroblocks */
+    s->mb_x = -1;
+    s->mb_y = mb_y;
+    addr = mb_y * s->mb_width - 1;
+    mb_count = s->mb_width * s->mb_height;
+    first = 1;
+    for (;;) {
+        incr = 0;
+        for (;;) {
+            code = get_vlc2(&s->gb, mbincr_vlc, MBINCR_VLC_BITS, 2);
+            if (code < 0)
+                return -1;
+            if (code == MB_ADDR_STUFFING)
+                continue;
+            if (code == MB_ADDR_ESCAPE) {
+                incr += 33;
+                continue;
+            }
+            incr += code + 1;
+            break;
+        }
+        if (addr + incr >= mb_count)
+            return -1;
+
+        if (first) {
+            mpeg1_advance_mb(s, incr);
+            first = 0;
+        } else {
+            if (incr > 1)
+                mpeg1_skip_macroblocks(s, incr - 1);
+            mpeg1_advance_mb(s, 1);
+        }
+        addr += incr;
+
+        if (mpeg1_decode_mb(s) < 0) {
+            fprintf(stderr, "mpeg1: error at macroblock %d %d\n",
+                    s->mb_x, s->mb_y);
+            return -1;
+        }
+
+        /* the slice ends in the zeros that lead into the next start code */
+        if (get_bits_count(&s->gb) >= buf_size * 8 ||
+            show_bits(&s->gb, 23) == 0)
+            break;
+    }
+
+    return 0;
+}
+
+static int mpeg1_decode_frame(AVCodecContext *avctx,
+                              void *data, int *data_size,
+                              uint8_t *buf, int buf_size)
+{
+    Mpeg1Context *s = avctx->priv_data;
+    AVFrame *pict = data;
+    const uint8_t *unit;
+    int pos, next, end, code, unit_size, skip, ret;
+
+    *data_size = 0;
+
+    /* the B picture handed out last time is no longer needed */
+    if (s->b_picture) {
+        avctx->release_buffer(avctx, s->b_picture);
+        s->b_picture = NULL;
+    }
+
+    if (buf_size == 0) {
+        /* end of the stream: hand out the reference still held back */
+        if (s->next_picture) {
+            *pict = *s->next_picture;
+            *data_size = sizeof(AVFrame);
+            if (s->last_picture)
+                avctx->release_buffer(avctx, s->last_picture);
+            s->last_picture = s->next_picture;
+            s->next_picture = NULL;
+        }
+        return 0;
+    }
+
+    s->current_picture = NULL;
+    skip = 1;
+    ret = buf_size;
+
+    pos = find_start_code(buf, 0, buf_size);
+    while (pos < buf_size) {
+        code = buf[pos];
+        next = find_start_code(buf, pos + 1, buf_size);
+        end = (next < buf_size) ? next - 3 : buf_size;
+        unit = buf + pos + 1;
+        unit_size = end - (pos + 1);
+
+        /* the bit reader reads a little past the end; the last unit in
+         * the buffer goes through a padded copy so it can */
+        if (next >= buf_size) {
+            s->slice_buffer = av_fast_realloc(s->slice_buffer,
+                &s->slice_buffer_size, unit_size + FF_INPUT_BUFFER_PADDING_SIZE);
+            if (!s->slice_buffer)
+                return -1;
+            memcpy(s->slice_buffer, unit, unit_size);
+            memset(s->slice_buffer + unit_size, 0, FF_INPUT_BUFFER_PADDING_SIZE);
+            unit = s->slice_buffer;
+        }
+
+        if (code >= SLICE_MIN_START_CODE && code <= SLICE_MAX_START_CODE) {
+            if (!skip && mpeg1_decode_slice(s, code - SLICE_MIN_START_CODE,
+                                            unit, unit_size) < 0)
+                ret = -1;
+        } else {
+            switch (code) {
+            case SEQ_START_CODE:
+                if (mpeg1_decode_sequence(s, unit, unit_size) < 0)
+                    ret = -1;
+                break;
+            case PICTURE_START_CODE:
+                if (s->current_picture) {
+                    fprintf(stderr, "mpeg1: more than one picture in a buffer\n");
+                    skip = 1;
+                    break;
+                }
+                if (!s->seq_ok ||
+                    mpeg1_decode_picture_header(s, unit, unit_size) < 0)
+                    break;
+                skip = mpeg1_start_picture(s);
+                if (skip < 0)
+                    return -1;
+                break;
+            case EXT_START_CODE:
+                if (s->seq_ok)
+                    fprintf(stderr, "mpeg1: MPEG2 streams are not supported\n");
+                s->seq_ok = 0;
+                skip = 1;
+                break;
+            default:
+                /* GOP, user data and sequence end carry nothing we use */
+                break;
+            }
+        }
+        pos = next;
+    }
+
+    if (s->current_picture) {
+        if (s->pict_type == B_TYPE) {
+            *pict = *s->current_picture;
+            *data_size = sizeof(AVFrame);
+            s->b_picture = s->current_picture;
+        } else if (s->last_picture) {
+            *pict = *s->last_picture;
+            *data_size = sizeof(AVFrame);
+        }
+        s->current_picture = NULL;
+    }
+
+    return ret;
+}
+
+static int mpeg1_decode_end(AVCodecContext *avctx)
+{
+    Mpeg1Context *s = avctx->priv_data;
+    AVFrame *pic;
+    int i, j;
+
+    mpeg1_release_pictures(s);
+    for (i = 0; i < 3; i++) {
+        pic = &s->picture[i];
+        if (pic->type == FF_BUFFER_TYPE_INTERNAL) {
+            for (j = 0; j < 4; j++)
+                av_freep(&pic->base[j]);
+            av_freep(&pic->opaque);
+        }
+    }
+    av_freep(&s->block);
+    av_freep(&s->slice_buffer);
+
+    return 0;
+}
+
+AVCodec mpeg_decoder = {
+    "mpegvideo",
+    CODEC_TYPE_VIDEO,
+    CODEC_ID_MPEG1VIDEO,
+    sizeof(Mpeg1Context),
+    mpeg1_decode_init,
+    NULL,
+    mpeg1_decode_end,
+    mpeg1_decode_frame,
+    CODEC_CAP_DR1,
+    NULL
+};
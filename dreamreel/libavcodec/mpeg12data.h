@@ -0,0 +1,277 @@
+/**
+ * @file mpeg12data.h
+ * MPEG1 tables (ISO/IEC 11172-2, annex B).
+ */
+
+#ifndef MPEG12DATA_H
+#define MPEG12DATA_H
+
+/* the bits each VLC table is looked up by; vlcgen builds mpeg12vlc.h
+ * for these widths and mpeg12.c reads the tables with them, so they are
+ * defined once, here */
+#define DC_VLC_BITS 9
+#define MV_VLC_BITS 9
+#define MBINCR_VLC_BITS 9
+#define MB_PAT_VLC_BITS 9
+#define MB_PTYPE_VLC_BITS 6
+#define MB_BTYPE_VLC_BITS 6
+#define TEX_VLC_BITS 9
+
+/* dct_dc_size_luminance and dct_dc_size_chrominance (tables B.12 and
+ * B.13), indexed by size */
+static const uint16_t vlc_dc_lum_code[12] = {
+    0x4, 0x0, 0x1, 0x5, 0x6, 0xe, 0x1e, 0x3e, 0x7e, 0xfe, 0x1fe, 0x1ff,
+};
+static const uint8_t vlc_dc_lum_bits[12] = {
+    3, 2, 2, 3, 3, 4, 5, 6, 7, 8, 9, 9,
+};
+
+static const uint16_t vlc_dc_chroma_code[12] = {
+    0x0, 0x1, 0x2, 0x6, 0xe, 0x1e, 0x3e, 0x7e, 0xfe, 0x1fe, 0x3fe, 0x3ff,
+};
+static const uint8_t vlc_dc_chroma_bits[12] = {
+    2, 2, 2, 3, 4, 5, 6, 7, 8, 9, 10, 10,
+};
+
+/* dct_coeff_first and dct_coeff_next (table B.14) without the sign bit:
+ * code, length. Entry n stands for mpeg1_run[n] zeros followed by a
+ * coefficient of magnitude mpeg1_level[n]; the last two are the escape
+ * and end of block codes. The "1s" code for run 0, level 1 that only the
+ * first coefficient of a non-intra block may use is not in here. */
+#define MPEG1_RL_ESCAPE 111
+#define MPEG1_RL_EOB    112
+
+static const uint16_t mpeg1_vlc[113][2] = {
+ { 0x3, 2 }, { 0x4, 4 }, { 0x5, 5 }, { 0x6, 7 },
+ { 0x26, 8 }, { 0x21, 8 }, { 0xa, 10 }, { 0x1d, 12 },
+ { 0x18, 12 }, { 0x13, 12 }, { 0x10, 12 }, { 0x1a, 13 },
+ { 0x19, 13 }, { 0x18, 13 }, { 0x17, 13 }, { 0x1f, 14 },
+ { 0x1e, 14 }, { 0x1d, 14 }, { 0x1c, 14 }, { 0x1b, 14 },
+ { 0x1a, 14 }, { 0x19, 14 }, { 0x18, 14 }, { 0x17, 14 },
+ { 0x16, 14 }, { 0x15, 14 }, { 0x14, 14 }, { 0x13, 14 },
+ { 0x12, 14 }, { 0x11, 14 }, { 0x10, 14 }, { 0x18, 15 },
+ { 0x17, 15 }, { 0x16, 15 }, { 0x15, 15 }, { 0x14, 15 },
+ { 0x13, 15 }, { 0x12, 15 }, { 0x11, 15 }, { 0x10, 15 },
+ { 0x3, 3 }, { 0x6, 6 }, { 0x25, 8 }, { 0xc, 10 },
+ { 0x1b, 12 }, { 0x16, 13 }, { 0x15, 13 }, { 0x1f, 15 },
+ { 0x1e, 15 }, { 0x1d, 15 }, { 0x1c, 15 }, { 0x1b, 15 },
+ { 0x1a, 15 }, { 0x19, 15 }, { 0x13, 16 }, { 0x12, 16 },
+ { 0x11, 16 }, { 0x10, 16 }, { 0x5, 4 }, { 0x4, 7 },
+ { 0xb, 10 }, { 0x14, 12 }, { 0x14, 13 }, { 0x7, 5 },
+ { 0x24, 8 }, { 0x1c, 12 }, { 0x13, 13 }, { 0x6, 5 },
+ { 0xf, 10 }, { 0x12, 12 }, { 0x7, 6 }, { 0x9, 10 },
+ { 0x12, 13 }, { 0x5, 6 }, { 0x1e, 12 }, { 0x14, 16 },
+ { 0x4, 6 }, { 0x15, 12 }, { 0x7, 7 }, { 0x11, 12 },
+ { 0x5, 7 }, { 0x11, 13 }, { 0x27, 8 }, { 0x10, 13 },
+ { 0x23, 8 }, { 0x1a, 16 }, { 0x22, 8 }, { 0x19, 16 },
+ { 0x20, 8 }, { 0x18, 16 }, { 0xe, 10 }, { 0x17, 16 },
+ { 0xd, 10 }, { 0x16, 16 }, { 0x8, 10 }, { 0x15, 16 },
+ { 0x1f, 12 }, { 0x1a, 12 }, { 0x19, 12 }, { 0x17, 12 },
+ { 0x16, 12 }, { 0x1f, 13 }, { 0x1e, 13 }, { 0x1d, 13 },
+ { 0x1c, 13 }, { 0x1b, 13 }, { 0x1f, 16 }, { 0x1e, 16 },
+ { 0x1d, 16 }, { 0x1c, 16 }, { 0x1b, 16 },
+ { 0x1, 6 }, /* escape */
+ { 0x2, 2 }, /* EOB */
+};
+
+static const int8_t mpeg1_run[111] = {
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  1,  1,  1,  1,  1,  1,  1,  1,
+     1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  2,  2,  2,  2,  2,  3,
+     3,  3,  3,  4,  4,  4,  5,  5,  5,  6,  6,  6,  7,  7,  8,  8,
+     9,  9, 10, 10, 11, 11, 12, 12, 13, 13, 14, 14, 15, 15, 16, 16,
+    17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31,
+};
+
+static const int8_t mpeg1_level[111] = {
+     1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15, 16,
+    17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32,
+    33, 34, 35, 36, 37, 38, 39, 40,  1,  2,  3,  4,  5,  6,  7,  8,
+     9, 10, 11, 12, 13, 14, 15, 16, 17, 18,  1,  2,  3,  4,  5,  1,
+     2,  3,  4,  1,  2,  3,  1,  2,  3,  1,  2,  3,  1,  2,  1,  2,
+     1,  2,  1,  2,  1,  2,  1,  2,  1,  2,  1,  2,  1,  2,  1,  2,
+     1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,
+};
+
+/* macroblock_address_increment (table B.1): code, length for increments
+ * of 1 to 33, then the escape (33 more) and the stuffing codes */
+#define MB_ADDR_ESCAPE   33
+#define MB_ADDR_STUFFING 34
+
+static const uint8_t mbAddrIncrTable[35][2] = {
+    {0x1, 1},
+    {0x3, 3},
+    {0x2, 3},
+    {0x3, 4},
+    {0x2, 4},
+    {0x3, 5},
+    {0x2, 5},
+    {0x7, 7},
+    {0x6, 7},
+    {0xb, 8},
+    {0xa, 8},
+    {0x9, 8},
+    {0x8, 8},
+    {0x7, 8},
+    {0x6, 8},
+    {0x17, 10},
+    {0x16, 10},
+    {0x15, 10},
+    {0x14, 10},
+    {0x13, 10},
+    {0x12, 10},
+    {0x23, 11},
+    {0x22, 11},
+    {0x21, 11},
+    {0x20, 11},
+    {0x1f, 11},
+    {0x1e, 11},
+    {0x1d, 11},
+    {0x1c, 11},
+    {0x1b, 11},
+    {0x1a, 11},
+    {0x19, 11},
+    {0x18, 11},
+    {0x8, 11}, /* escape */
+    {0xf, 11}, /* stuffing */
+};
+
+/* coded_block_pattern (table B.9): code, length, indexed by the pattern;
+ * a pattern of 0 is not allowed in MPEG1 */
+static const uint8_t mbPatTable[64][2] = {
+    {0x0, 0},
+    {0xb, 5},
+    {0x9, 5},
+    {0xd, 6},
+    {0xd, 4},
+    {0x17, 7},
+    {0x13, 7},
+    {0x1f, 8},
+    {0xc, 4},
+    {0x16, 7},
+    {0x12, 7},
+    {0x1e, 8},
+    {0x13, 5},
+    {0x1b, 8},
+    {0x17, 8},
+    {0x13, 8},
+    {0xb, 4},
+    {0x15, 7},
+    {0x11, 7},
+    {0x1d, 8},
+    {0x11, 5},
+    {0x19, 8},
+    {0x15, 8},
+    {0x11, 8},
+    {0xf, 6},
+    {0xf, 8},
+    {0xd, 8},
+    {0x3, 9},
+    {0xf, 5},
+    {0xb, 8},
+    {0x7, 8},
+    {0x7, 9},
+    {0xa, 4},
+    {0x14, 7},
+    {0x10, 7},
+    {0x1c, 8},
+    {0xe, 6},
+    {0xe, 8},
+    {0xc, 8},
+    {0x2, 9},
+    {0x10, 5},
+    {0x18, 8},
+    {0x14, 8},
+    {0x10, 8},
+    {0xe, 5},
+    {0xa, 8},
+    {0x6, 8},
+    {0x6, 9},
+    {0x12, 5},
+    {0x1a, 8},
+    {0x16, 8},
+    {0x12, 8},
+    {0xd, 5},
+    {0x9, 8},
+    {0x5, 8},
+    {0x5, 9},
+    {0xc, 5},
+    {0x8, 8},
+    {0x4, 8},
+    {0x4, 9},
+    {0x7, 3},
+    {0xa, 5},
+    {0x8, 5},
+    {0xc, 6}
+};
+
+/* macroblock_type flags */
+#define MB_INTRA 0x01
+#define MB_PAT   0x02
+#define MB_BACK  0x04
+#define MB_FOR   0x08
+#define MB_QUANT 0x10
+
+/* macroblock_type in P pictures (table B.3): code, length, flags */
+static const uint8_t table_mb_ptype[7][3] = {
+    { 1, 1, MB_FOR | MB_PAT },
+    { 1, 2, MB_PAT },
+    { 1, 3, MB_FOR },
+    { 3, 5, MB_INTRA },
+    { 2, 5, MB_QUANT | MB_FOR | MB_PAT },
+    { 1, 5, MB_QUANT | MB_PAT },
+    { 1, 6, MB_QUANT | MB_INTRA },
+};
+
+/* macroblock_type in B pictures (table B.4): code, length, flags */
+static const uint8_t table_mb_btype[11][3] = {
+    { 2, 2, MB_FOR | MB_BACK },
+    { 3, 2, MB_FOR | MB_BACK | MB_PAT },
+    { 2, 3, MB_BACK },
+    { 3, 3, MB_BACK | MB_PAT },
+    { 2, 4, MB_FOR },
+    { 3, 4, MB_FOR | MB_PAT },
+    { 3, 5, MB_INTRA },
+    { 2, 5, MB_QUANT | MB_FOR | MB_BACK | MB_PAT },
+    { 3, 6, MB_QUANT | MB_FOR | MB_PAT },
+    { 2, 6, MB_QUANT | MB_BACK | MB_PAT },
+    { 1, 6, MB_QUANT | MB_INTRA },
+};
+
+/* motion_code (table B.10) without the sign bit: code, length, indexed
+ * by the magnitude of the motion code */
+static const uint8_t mbMotionVectorTable[17][2] = {
+    { 0x1, 1 },
+    { 0x1, 2 },
+    { 0x1, 3 },
+    { 0x1, 4 },
+    { 0x3, 6 },
+    { 0x5, 7 },
+    { 0x4, 7 },
+    { 0x3, 7 },
+    { 0xb, 9 },
+    { 0xa, 9 },
+    { 0x9, 9 },
+    { 0x11, 10 },
+    { 0x10, 10 },
+    { 0xf, 10 },
+    { 0xe, 10 },
+    { 0xd, 10 },
+    { 0xc, 10 },
+};
+
+/* frame_rate_code: frames per second as a fraction */
+static const int frame_rate_tab[9][2] = {
+    {     0,    1 },
+    { 24000, 1001 },
+    {    24,    1 },
+    {    25,    1 },
+    { 30000, 1001 },
+    {    30,    1 },
+    {    50,    1 },
+    { 60000, 1001 },
+    {    60,    1 },
+};
+
+#endif /* MPEG12DATA_H */
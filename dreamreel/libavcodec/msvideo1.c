@@ -0,0 +1,216 @@
+/*
+ *
+ * Copyright (C) 2003 the ffmpeg project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Microsoft Video-1 Decoder
+ *   by Mike Melanson (melanson@pcisys.net)
+ * For more information about the MS Video-1 format, visit:
+ *   http://www.pcisys.net/~melanson/codecs/
+ *
+ */
+
+/**
+ * @file msvideo1.c
+ * Microsoft Video-1 Decoder.
+ *
+ * This decoder handles the 16-bit variant of the format, which codes
+ * 15-bit RGB pixels in 4x4 blocks, and outputs them as PIX_FMT_RGB555.
+ * With CODEC_FLAG_TWIDDLED set, each block is written straight into the
+ * twiddled order of a PVR ARGB1555 texture instead of raster order (see
+ * texblock.h). The 8-bit, palettized variant is not supported.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "avcodec.h"
+#include "bswap.h"
+#include "texblock.h"
+
+#define CHECK_STREAM_PTR(n) \
+    if ((stream_ptr + n) > buf_size) { \
+        printf ("MS Video-1: stream_ptr out of bounds (%d + %d > %d)\n", \
+            stream_ptr, n, buf_size); \
+        return; \
+    }
+
+typedef struct Msvideo1Context {
+    AVCodecContext *avctx;
+    TexBlockContext tex;
+} Msvideo1Context;
+
+/*
+ * The blocks are coded from the bottom left of the picture, a row of
+ * blocks at a time, and the pixels of a block from its bottom left too.
+ * The texel offsets of a block are in raster order from the top, so pixel
+ * x, y of a block, counted from the bottom, goes to texel[(3 - y) * 4 + x].
+ */
+static void msvideo1_decode_16bit(Msvideo1Context *s, uint8_t *buf,
+                                  int buf_size)
+{
+    TexBlockContext *t = &s->tex;
+    int total_blocks;
+    int pixel_x, pixel_y;  /* pixel width and height iterators */
+    int block_x, block_y;  /* block width and height iterators */
+    uint16_t *block;
+
+    /* decoding parameters */
+    int stream_ptr;
+    unsigned char byte_a, byte_b;
+    unsigned short flags;
+    int skip_blocks;
+    unsigned short colors[8];
+
+    stream_ptr = 0;
+    skip_blocks = 0;
+    total_blocks = (s->avctx->width / 4) * (s->avctx->height / 4);
+
+    for (block_y = s->avctx->height / 4 - 1; block_y >= 0; block_y--) {
+        for (block_x = 0; block_x < s->avctx->width / 4; block_x++) {
+            /* check if this block should be skipped */
+            if (skip_blocks) {
+                skip_blocks--;
+                total_blocks--;
+                continue;
+            }
+
+            block = TEXBLOCK(t, block_x, block_y);
+
+            /* get the next two bytes in the encoded data stream */
+            CHECK_STREAM_PTR(2);
+            byte_a = buf[stream_ptr++];
+            byte_b = buf[stream_ptr++];
+
+            /* check if the decode is finished */
+            if ((byte_a == 0) && (byte_b == 0) && (total_blocks == 0))
+                return;
+            else if ((byte_b & 0xFC) == 0x84) {
+                /* skip code, but don't count the current block */
+                skip_blocks = ((byte_b - 0x84) << 8) + byte_a - 1;
+            } else if (byte_b < 0x80) {
+                /* 2- or 8-color encoding modes */
+                flags = (byte_b << 8) | byte_a;
+
+                CHECK_STREAM_PTR(4);
+                colors[0] = LE_16(&buf[stream_ptr]);
+                stream_ptr += 2;
+                colors[1] = LE_16(&buf[stream_ptr]);
+                stream_ptr += 2;
+
+                if (colors[0] & 0x8000) {
+                    /* 8-color encoding: a pair of colors for each 2x2
+                     * quadrant of the block */
+                    CHECK_STREAM_PTR(12);
+                    for (pixel_x = 2; pixel_x < 8; pixel_x++) {
+                        colors[pixel_x] = LE_16(&buf[stream_ptr]) | 0x8000;
+                        stream_ptr += 2;
+                    }
+                    colors[1] |= 0x8000;
+
+                    for (pixel_y = 0; pixel_y < 4; pixel_y++) {
+                        for (pixel_x = 0; pixel_x < 4; pixel_x++, flags >>= 1)
+                            block[t->texel[(3 - pixel_y) * 4 + pixel_x]] =
+                                colors[((pixel_y & 0x2) << 1) +
+                                    (pixel_x & 0x2) + ((flags & 0x1) ^ 1)];
+                    }
+                } else {
+                    /* otherwise, it's a 2-color block */
+                    colors[0] |= 0x8000;
+                    colors[1] |= 0x8000;
+
+                    for (pixel_y = 0; pixel_y < 4; pixel_y++) {
+                        for (pixel_x = 0; pixel_x < 4; pixel_x++, flags >>= 1)
+                            block[t->texel[(3 - pixel_y) * 4 + pixel_x]] =
+                                colors[(flags & 0x1) ^ 1];
+                    }
+                }
+            } else {
+                /* otherwise, it's a 1-color block */
+                colors[0] = (byte_b << 8) | byte_a;
+
+                for (pixel_x = 0; pixel_x < 16; pixel_x++)
+                    block[t->texel[pixel_x]] = colors[0];
+            }
+
+            total_blocks--;
+        }
+    }
+}
+
+static int msvideo1_decode_init(AVCodecContext *avctx)
+{
+    Msvideo1Context *s = avctx->priv_data;
+
+    s->avctx = avctx;
+
+    if (avctx->bits_per_sample == 8) {
+        printf ("MS Video-1: the palettized variant is not supported\n");
+        return -1;
+    }
+    avctx->pix_fmt = PIX_FMT_RGB555;
+    avctx->has_b_frames = 0;
+
+    /* the single picture that every frame is drawn over */
+    if (ff_texblock_init(&s->tex, avctx) < 0)
+        return -1;
+
+    return 0;
+}
+
+static int msvideo1_decode_frame(AVCodecContext *avctx,
+                                 void *data, int *data_size,
+                                 uint8_t *buf, int buf_size)
+{
+    Msvideo1Context *s = avctx->priv_data;
+
+    /* no supplementary picture */
+    if (buf_size == 0)
+        return 0;
+
+    msvideo1_decode_16bit(s, buf, buf_size);
+
+    *data_size = sizeof(AVFrame);
+    *(AVFrame*)data = s->tex.frame;
+
+    /* report that the buffer was completely consumed */
+    return buf_size;
+}
+
+static int msvideo1_decode_end(AVCodecContext *avctx)
+{
+    Msvideo1Context *s = avctx->priv_data;
+
+    ff_texblock_end(&s->tex, avctx);
+
+    return 0;
+}
+
+AVCodec msvideo1_decoder = {
+    "msvideo1",
+    CODEC_TYPE_VIDEO,
+    CODEC_ID_MSVIDEO1,
+    sizeof(Msvideo1Context),
+    msvideo1_decode_init,
+    NULL,
+    msvideo1_decode_end,
+    msvideo1_decode_frame,
+    CODEC_CAP_DR1,
+    NULL
+};
@@ -0,0 +1,327 @@
+/*
+ * Sample rate convertion for both audio and video frames
+ * Copyright (c) 2000 Fabrice Bellard.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * @file resample.c
+ * Fixed-point audio sample rate converter.
+ *
+ * The resampler steps through the input with an exact rational increment
+ * (input_rate / output_rate, reduced by their gcd), so the number of
+ * output samples produced for any number of input samples never drifts
+ * from the ideal value. The fractional position is kept across calls,
+ * along with enough input history to feed the filter, so a stream may be
+ * fed in buffers of any size.
+ *
+ * Input is consumed in blocks of RESAMPLE_BLOCK samples. All inner loops
+ * are 16x16->32 bit integer multiply-accumulates which map onto the SH4's
+ * mac.w; floating point is only used to design the filter bank at init.
+ */
+
+#include "avcodec.h"
+
+/** number of input samples consumed per filter pass */
+#define RESAMPLE_BLOCK 256
+
+/** filter coefficients are Q15 */
+#define FILTER_SHIFT 15
+
+#define MAX_CHANNELS 2
+
+typedef struct ResampleQuality {
+    int taps;        ///< filter length in input samples
+    int phase_bits;  ///< log2 of the number of polyphase branches
+} ResampleQuality;
+
+static const ResampleQuality qualities[] = {
+    {  2, 15 },  /* RESAMPLE_QUALITY_LINEAR: Q15 weight, no filter bank */
+    {  8,  6 },  /* RESAMPLE_QUALITY_MEDIUM */
+    { 16,  7 },  /* RESAMPLE_QUALITY_HIGH */
+};
+
+struct ReSampleContext {
+    int input_channels, output_channels;
+    int filter_channels;  ///< channels actually run through the filter
+    int quality;
+    int taps;
+    int phase_bits;
+    int16_t *filter_bank; ///< (1 << phase_bits) branches of taps coefficients
+
+    /* input_rate / output_rate = step_int + step_frac / den */
+    int step_int;
+    unsigned int step_frac;
+    unsigned int den;
+    unsigned int phase_mul; ///< maps frac in [0, den) onto a filter branch
+
+    int index;            ///< integer position of the next output in work[]
+    unsigned int frac;    ///< fractional position, in 1/den input samples
+    int filled;           ///< valid samples in work[]
+    int16_t *work[MAX_CHANNELS]; ///< filter history + one input block
+};
+
+/* build a windowed sinc filter bank; each branch is normalized to unity
+ * gain after quantization so that DC passes through exactly */
+static void build_filter_bank(ReSampleContext *s, double cutoff)
+{
+    int phases = 1 << s->phase_bits;
+    int center = s->taps / 2 - 1;
+    int ph, i, sum, largest;
+    double x, y, w, norm;
+    double *f = av_malloc(s->taps * sizeof(double));
+
+    for (ph = 0; ph < phases; ph++) {
+        int16_t *coef = &s->filter_bank[ph * s->taps];
+
+        norm = 0;
+        for (i = 0; i < s->taps; i++) {
+            x = i - center - (double)ph / phases;
+            y = M_PI * x * cutoff;
+            w = 0.5 * (1.0 + cos(M_PI * x / (s->taps / 2)));
+            f[i] = (y == 0 ? 1.0 : sin(y) / y) * w;
+            norm += f[i];
+        }
+
+        sum = 0;
+        largest = 0;
+        for (i = 0; i < s->taps; i++) {
+            coef[i] = (int)floor(f[i] * (1 << FILTER_SHIFT) / norm + 0.5);
+            sum += coef[i];
+            if (coef[i] > coef[largest])
+                largest = i;
+        }
+        coef[largest] += (1 << FILTER_SHIFT) - sum;
+    }
+
+    av_free(f);
+}
+
+ReSampleContext *audio_resample_init_quality(int output_channels,
+                                             int input_channels,
+                                             int output_rate, int input_rate,
+                                             int quality)
+{
+    ReSampleContext *s;
+    int gcd, i;
+
+    if (input_channels < 1 || input_channels > MAX_CHANNELS ||
+        output_channels < 1 || output_channels > MAX_CHANNELS ||
+        input_rate <= 0 || output_rate <= 0)
+        return NULL;
+    if (quality < 0 || quality > RESAMPLE_QUALITY_HIGH)
+        quality = RESAMPLE_QUALITY_DEFAULT;
+
+    s = av_mallocz(sizeof(ReSampleContext));
+    if (!s)
+        return NULL;
+
+    s->input_channels = input_channels;
+    s->output_channels = output_channels;
+    s->filter_channels = FFMIN(input_channels, output_channels);
+
+    gcd = ff_gcd(input_rate, output_rate);
+    s->den = output_rate / gcd;
+    s->step_int = (input_rate / gcd) / s->den;
+    s->step_frac = (input_rate / gcd) % s->den;
+
+    /* equal rates never leave branch 0, where a windowed filter would
+     * only be a needless low pass; copying through is exact and cheaper */
+    if (s->step_int == 1 && s->step_frac == 0)
+        quality = RESAMPLE_QUALITY_LINEAR;
+
+    s->quality = quality;
+    s->taps = qualities[quality].taps;
+    s->phase_bits = qualities[quality].phase_bits;
+    s->phase_mul = (1U << (16 + s->phase_bits)) / s->den;
+    if (quality == RESAMPLE_QUALITY_LINEAR)
+        s->phase_mul = (1U << 31) / s->den;
+
+    if (quality != RESAMPLE_QUALITY_LINEAR) {
+        s->filter_bank = av_malloc((s->taps << s->phase_bits) * sizeof(int16_t));
+        if (!s->filter_bank)
+            goto fail;
+        build_filter_bank(s,
+            0.95 * FFMIN(1.0, (double)output_rate / input_rate));
+    }
+
+    for (i = 0; i < s->filter_channels; i++) {
+        s->work[i] = av_mallocz((s->taps + RESAMPLE_BLOCK) * sizeof(int16_t));
+        if (!s->work[i])
+            goto fail;
+    }
+
+    /* prime the history so that the filter is centered on the first
+     * input sample; output sample 0 then lines up with input sample 0 */
+    s->filled = s->taps / 2 - 1;
+
+    return s;
+
+fail:
+    audio_resample_close(s);
+    return NULL;
+}
+
+ReSampleContext *audio_resample_init(int output_channels, int input_channels,
+                                     int output_rate, int input_rate)
+{
+    return audio_resample_init_quality(output_channels, input_channels,
+        output_rate, input_rate, RESAMPLE_QUALITY_DEFAULT);
+}
+
+/* split interleaved input into the per-channel work buffers, folding
+ * stereo down to mono if that is all the output needs */
+static void load_block(ReSampleContext *s, const short *input, int n)
+{
+    int16_t *w0 = s->work[0] + s->filled;
+    int16_t *w1;
+    int i;
+
+    if (s->input_channels == 1) {
+        memcpy(w0, input, n * sizeof(int16_t));
+    } else if (s->filter_channels == 1) {
+        for (i = 0; i < n; i++)
+            w0[i] = (input[2 * i] + input[2 * i + 1]) >> 1;
+    } else {
+        /* work[1] only exists when both channels are filtered */
+        w1 = s->work[1] + s->filled;
+        for (i = 0; i < n; i++) {
+            w0[i] = input[2 * i];
+            w1[i] = input[2 * i + 1];
+        }
+    }
+    s->filled += n;
+}
+
+static inline int clip_s16(int a)
+{
+    if ((a + 32768) & ~0xFFFF)
+        return (a >> 31) ^ 0x7FFF;
+    return a;
+}
+
+/* run the filter over the current block; returns the number of output
+ * samples (per channel) written */
+static int filter_block(ReSampleContext *s, short *output)
+{
+    const int taps = s->taps;
+    const int out_ch = s->output_channels;
+    const int filt_ch = s->filter_channels;
+    int index = s->index;
+    unsigned int frac = s->frac;
+    int count = 0;
+    int c, i, v;
+
+    if (s->quality == RESAMPLE_QUALITY_LINEAR) {
+        while (index + taps <= s->filled) {
+            int weight = (frac * s->phase_mul) >> 16;
+
+            for (c = 0; c < filt_ch; c++) {
+                const int16_t *in = s->work[c] + index;
+                output[c] = in[0] + (((in[1] - in[0]) * weight) >> FILTER_SHIFT);
+            }
+            if (out_ch > filt_ch)
+                output[1] = output[0];
+            output += out_ch;
+            count++;
+
+            index += s->step_int;
+            frac += s->step_frac;
+            if (frac >= s->den) {
+                frac -= s->den;
+                index++;
+            }
+        }
+    } else {
+        while (index + taps <= s->filled) {
+            const int16_t *coef =
+                &s->filter_bank[((frac * s->phase_mul) >> 16) * taps];
+
+            for (c = 0; c < filt_ch; c++) {
+                const int16_t *in = s->work[c] + index;
+                v = 1 << (FILTER_SHIFT - 1);
+                for (i = 0; i < taps; i++)
+                    v += in[i] * coef[i];
+                output[c] = clip_s16(v >> FILTER_SHIFT);
+            }
+            if (out_ch > filt_ch)
+                output[1] = output[0];
+            output += out_ch;
+            count++;
+
+            index += s->step_int;
+            frac += s->step_frac;
+            if (frac >= s->den) {
+                frac -= s->den;
+                index++;
+            }
+        }
+    }
+
+    /* keep the unconsumed tail (less than taps samples) as history for
+     * the next block */
+    if (index < s->filled) {
+        for (c = 0; c < filt_ch; c++)
+            memmove(s->work[c], s->work[c] + index,
+                (s->filled - index) * sizeof(int16_t));
+        s->filled -= index;
+        index = 0;
+    } else {
+        index -= s->filled;
+        s->filled = 0;
+    }
+    s->index = index;
+    s->frac = frac;
+
+    return count;
+}
+
+/**
+ * Resample nb_samples interleaved input samples (per channel). The output
+ * buffer must have room for nb_samples * output_rate / input_rate + 1
+ * samples per channel.
+ * @return number of samples per channel written to output
+ */
+int audio_resample(ReSampleContext *s, short *output, short *input, int nb_samples)
+{
+    int total = 0;
+    int n;
+
+    while (nb_samples > 0) {
+        n = FFMIN(nb_samples, RESAMPLE_BLOCK);
+        load_block(s, input, n);
+        input += n * s->input_channels;
+        nb_samples -= n;
+
+        n = filter_block(s, output);
+        output += n * s->output_channels;
+        total += n;
+    }
+
+    return total;
+}
+
+void audio_resample_close(ReSampleContext *s)
+{
+    int i;
+
+    if (!s)
+        return;
+    for (i = 0; i < MAX_CHANNELS; i++)
+        av_free(s->work[i]);
+    av_free(s->filter_bank);
+    av_free(s);
+}
@@ -0,0 +1,278 @@
+/*
+ *
+ * Copyright (C) 2003 the ffmpeg project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * QT RPZA Video Decoder
+ *   by Roberto Togni <rtogni@bresciaonline.it>
+ * For more information about the RPZA format, visit:
+ *   http://www.pcisys.net/~melanson/codecs/
+ *
+ */
+
+/**
+ * @file rpza.c
+ * QT RPZA Video Decoder (Apple Video).
+ *
+ * The RPZA format codes 15-bit RGB pixels in 4x4 blocks, and this decoder
+ * outputs them as PIX_FMT_RGB555. With CODEC_FLAG_TWIDDLED set, each
+ * block is written straight into the twiddled order of a PVR ARGB1555
+ * texture instead of raster order (see texblock.h).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "avcodec.h"
+#include "bswap.h"
+#include "texblock.h"
+
+typedef struct RpzaContext {
+    AVCodecContext *avctx;
+    TexBlockContext tex;
+} RpzaContext;
+
+/* the opaque ARGB1555 texel of a 15-bit colour */
+#define TEXEL(color) ((color) | 0x8000)
+
+#define ADVANCE_BLOCK() \
+{ \
+    if (++block_x == s->tex.blocks_wide) { \
+        block_x = 0; \
+        block_y++; \
+    } \
+    /* anything after the last block would be drawn off the picture */ \
+    if (--total_blocks == 0) \
+        return; \
+}
+
+static void rpza_decode_stream(RpzaContext *s, uint8_t *buf, int buf_size)
+{
+    TexBlockContext *t = &s->tex;
+    int stream_ptr = 0;
+    int chunk_size;
+    unsigned char opcode;
+    int n_blocks;
+    unsigned short colorA = 0, colorB;
+    unsigned short color4[4];
+    unsigned char index, idx;
+    unsigned short ta, tb;
+    uint16_t *block;
+    int i;
+
+    int block_x = 0, block_y = 0;
+    int total_blocks;
+
+    /* First byte is always 0xe1. Warn if it's different */
+    if (buf[stream_ptr] != 0xe1)
+        printf("RPZA: First chunk byte is 0x%02x instead of 0xe1\n",
+            buf[stream_ptr]);
+
+    /* Get chunk size, ingnoring first byte */
+    chunk_size = BE_32(&buf[stream_ptr]) & 0x00FFFFFF;
+    stream_ptr += 4;
+
+    /* If length mismatch use size from MOV file and try to decode anyway */
+    if (chunk_size != buf_size) {
+        printf("RPZA: MOV chunk size != encoded chunk size; using MOV chunk size\n");
+        chunk_size = buf_size;
+    }
+
+    /* Number of 4x4 blocks in frame. */
+    total_blocks = t->blocks_wide * t->blocks_high;
+
+    /* Process chunk data */
+    while (stream_ptr < chunk_size) {
+        opcode = buf[stream_ptr++]; /* Get opcode */
+
+        n_blocks = (opcode & 0x1f) + 1; /* Extract block counter from opcode */
+
+        /* If opcode MSbit is 0, we need more data to decide what to do */
+        if ((opcode & 0x80) == 0) {
+            if (stream_ptr + 2 > chunk_size)
+                return;
+            colorA = (opcode << 8) | (buf[stream_ptr++]);
+            opcode = 0;
+            if ((buf[stream_ptr] & 0x80) != 0) {
+                /* Must behave as opcode 110xxxxx, using colorA computed
+                 * above. Use fake opcode 0x20 to enter switch block at
+                 * the right place */
+                opcode = 0x20;
+                n_blocks = 1;
+            }
+        }
+
+        switch (opcode & 0xe0) {
+
+        /* Skip blocks */
+        case 0x80:
+            while (n_blocks--)
+                ADVANCE_BLOCK();
+            break;
+
+        /* Fill blocks with one color */
+        case 0xa0:
+            if (stream_ptr + 2 > chunk_size)
+                return;
+            colorA = TEXEL(BE_16(&buf[stream_ptr]));
+            stream_ptr += 2;
+            while (n_blocks--) {
+                block = TEXBLOCK(t, block_x, block_y);
+                for (i = 0; i < 16; i++)
+                    block[t->texel[i]] = colorA;
+                ADVANCE_BLOCK();
+            }
+            break;
+
+        /* Fill blocks with 4 colors */
+        case 0xc0:
+            if (stream_ptr + 2 > chunk_size)
+                return;
+            colorA = BE_16(&buf[stream_ptr]);
+            stream_ptr += 2;
+        case 0x20:
+            if (stream_ptr + 2 + n_blocks * 4 > chunk_size)
+                return;
+            colorB = BE_16(&buf[stream_ptr]);
+            stream_ptr += 2;
+
+            /* sort out the colors */
+            color4[0] = colorB;
+            color4[1] = 0;
+            color4[2] = 0;
+            color4[3] = colorA;
+
+            /* red components */
+            ta = (colorA >> 10) & 0x1F;
+            tb = (colorB >> 10) & 0x1F;
+            color4[1] |= ((11 * ta + 21 * tb) >> 5) << 10;
+            color4[2] |= ((21 * ta + 11 * tb) >> 5) << 10;
+
+            /* green components */
+            ta = (colorA >> 5) & 0x1F;
+            tb = (colorB >> 5) & 0x1F;
+            color4[1] |= ((11 * ta + 21 * tb) >> 5) << 5;
+            color4[2] |= ((21 * ta + 11 * tb) >> 5) << 5;
+
+            /* blue components */
+            ta = colorA & 0x1F;
+            tb = colorB & 0x1F;
+            color4[1] |= ((11 * ta + 21 * tb) >> 5);
+            color4[2] |= ((21 * ta + 11 * tb) >> 5);
+
+            for (i = 0; i < 4; i++)
+                color4[i] = TEXEL(color4[i]);
+
+            while (n_blocks--) {
+                block = TEXBLOCK(t, block_x, block_y);
+                for (i = 0; i < 16; i += 4) {
+                    index = buf[stream_ptr++];
+                    idx = (index >> 6) & 0x03;
+                    block[t->texel[i]] = color4[idx];
+                    idx = (index >> 4) & 0x03;
+                    block[t->texel[i + 1]] = color4[idx];
+                    idx = (index >> 2) & 0x03;
+                    block[t->texel[i + 2]] = color4[idx];
+                    idx = index & 0x03;
+                    block[t->texel[i + 3]] = color4[idx];
+                }
+                ADVANCE_BLOCK();
+            }
+            break;
+
+        /* Fill block with 16 colors */
+        case 0x00:
+            if (stream_ptr + 30 > chunk_size)
+                return;
+            block = TEXBLOCK(t, block_x, block_y);
+            /* We already have color of upper left pixel */
+            block[t->texel[0]] = TEXEL(colorA);
+            for (i = 1; i < 16; i++) {
+                block[t->texel[i]] = TEXEL(BE_16(&buf[stream_ptr]));
+                stream_ptr += 2;
+            }
+            ADVANCE_BLOCK();
+            break;
+
+        /* Unknown opcode */
+        default:
+            printf("RPZA: Unknown opcode %d in rpza chunk."
+                 " Skip remaining %d bytes of chunk data.\n", opcode,
+                 chunk_size - stream_ptr);
+            return;
+        } /* Opcode switch */
+    }
+}
+
+static int rpza_decode_init(AVCodecContext *avctx)
+{
+    RpzaContext *s = avctx->priv_data;
+
+    s->avctx = avctx;
+    avctx->pix_fmt = PIX_FMT_RGB555;
+    avctx->has_b_frames = 0;
+
+    /* the single picture that every frame is drawn over */
+    if (ff_texblock_init(&s->tex, avctx) < 0)
+        return -1;
+
+    return 0;
+}
+
+static int rpza_decode_frame(AVCodecContext *avctx,
+                             void *data, int *data_size,
+                             uint8_t *buf, int buf_size)
+{
+    RpzaContext *s = avctx->priv_data;
+
+    /* no supplementary picture */
+    if (buf_size == 0)
+        return 0;
+
+    if (buf_size >= 4)
+        rpza_decode_stream(s, buf, buf_size);
+
+    *data_size = sizeof(AVFrame);
+    *(AVFrame*)data = s->tex.frame;
+
+    /* always report that the buffer was completely consumed */
+    return buf_size;
+}
+
+static int rpza_decode_end(AVCodecContext *avctx)
+{
+    RpzaContext *s = avctx->priv_data;
+
+    ff_texblock_end(&s->tex, avctx);
+
+    return 0;
+}
+
+AVCodec rpza_decoder = {
+    "rpza",
+    CODEC_TYPE_VIDEO,
+    CODEC_ID_RPZA,
+    sizeof(RpzaContext),
+    rpza_decode_init,
+    NULL,
+    rpza_decode_end,
+    rpza_decode_frame,
+    CODEC_CAP_DR1,
+    NULL
+};
@@ -0,0 +1,136 @@
+/*
+ * VLC table generator
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * @file vlcgen.c
+ * VLC table generator.
+ *
+ * Runs on the build machine and prints, as constant C arrays, the lookup
+ * tables that init_vlc() would otherwise build each time a codec with
+ * fixed codes opens. The tables come from init_vlc() itself, so they are
+ * exactly what a decoder would have built; they only depend on the
+ * codes, not on the machine, so the output suits any target.
+ *
+ *   vlcgen > mpeg12vlc.h
+ */
+
+#include "avcodec.h"
+#include "common.h"
+#include "mpeg12data.h"
+
+static void make_vlc(VLC *vlc, int nb_bits, int nb_codes,
+                     const void *bits, int bits_wrap, int bits_size,
+                     const void *codes, int codes_wrap, int codes_size)
+{
+    if (init_vlc(vlc, nb_bits, nb_codes, bits, bits_wrap, bits_size,
+                 codes, codes_wrap, codes_size) < 0) {
+        fprintf(stderr, "vlcgen: cannot build a table of %d codes\n", nb_codes);
+        exit(1);
+    }
+}
+
+static void print_vlc(const char *name, int nb_bits, int nb_codes,
+                      const void *bits, int bits_wrap, int bits_size,
+                      const void *codes, int codes_wrap, int codes_size)
+{
+    VLC vlc;
+    int i;
+
+    make_vlc(&vlc, nb_bits, nb_codes, bits, bits_wrap, bits_size,
+             codes, codes_wrap, codes_size);
+
+    printf("static const VLC_TYPE %s[%d][2] = {", name, vlc.table_size);
+    for (i = 0; i < vlc.table_size; i++)
+        printf("%s{ %d, %d },", i % 6 ? " " : "\n    ",
+               vlc.table[i][0], vlc.table[i][1]);
+    printf("\n};\n\n");
+
+    free_vlc(&vlc);
+}
+
+/* the coefficient table, with run and level looked up as well, in the
+ * form GET_RL_VLC reads */
+static void print_mpeg1_rl_vlc(const char *name)
+{
+    VLC vlc;
+    int i;
+
+    make_vlc(&vlc, TEX_VLC_BITS, 113,
+             &mpeg1_vlc[0][1], 4, 2,
+             &mpeg1_vlc[0][0], 4, 2);
+
+    printf("static const RL_VLC_ELEM %s[%d] = {", name, vlc.table_size);
+    for (i = 0; i < vlc.table_size; i++) {
+        int code = vlc.table[i][0];
+        int len  = vlc.table[i][1];
+        int level, run;
+
+        if (len == 0) { // illegal code
+            run   = 65;
+            level = 1;
+        } else if (len < 0) { // more bits needed
+            run   = 0;
+            level = code;
+        } else if (code == MPEG1_RL_ESCAPE) {
+            run   = 0;
+            level = 0;
+        } else if (code == MPEG1_RL_EOB) {
+            run   = 0;
+            level = 127;
+        } else {
+            run   = mpeg1_run[code] + 1;
+            level = mpeg1_level[code];
+        }
+        printf("%s{ %d, %d, %d },", i % 4 ? " " : "\n    ", level, len, run);
+    }
+    printf("\n};\n\n");
+
+    free_vlc(&vlc);
+}
+
+int main(void)
+{
+    printf("/* generated by tablegen/vlcgen.c from mpeg12data.h, do not edit */\n\n");
+    printf("#ifndef MPEG12VLC_H\n#define MPEG12VLC_H\n\n");
+
+    print_vlc("dc_lum_vlc", DC_VLC_BITS, 12,
+              vlc_dc_lum_bits, 1, 1,
+              vlc_dc_lum_code, 2, 2);
+    print_vlc("dc_chroma_vlc", DC_VLC_BITS, 12,
+              vlc_dc_chroma_bits, 1, 1,
+              vlc_dc_chroma_code, 2, 2);
+    print_vlc("mv_vlc", MV_VLC_BITS, 17,
+              &mbMotionVectorTable[0][1], 2, 1,
+              &mbMotionVectorTable[0][0], 2, 1);
+    print_vlc("mbincr_vlc", MBINCR_VLC_BITS, 35,
+              &mbAddrIncrTable[0][1], 2, 1,
+              &mbAddrIncrTable[0][0], 2, 1);
+    print_vlc("mb_pat_vlc", MB_PAT_VLC_BITS, 64,
+              &mbPatTable[0][1], 2, 1,
+              &mbPatTable[0][0], 2, 1);
+    print_vlc("mb_ptype_vlc", MB_PTYPE_VLC_BITS, 7,
+              &table_mb_ptype[0][1], 3, 1,
+              &table_mb_ptype[0][0], 3, 1);
+    print_vlc("mb_btype_vlc", MB_BTYPE_VLC_BITS, 11,
+              &table_mb_btype[0][1], 3, 1,
+              &table_mb_btype[0][0], 3, 1);
+    print_mpeg1_rl_vlc("mpeg1_rl_vlc");
+
+    printf("#endif /* MPEG12VLC_H */\n");
+    return 0;
+}
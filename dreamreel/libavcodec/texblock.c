@@ -0,0 +1,112 @@
+/*
+ *
+ * Copyright (C) 2003 the ffmpeg project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * @file texblock.c
+ * Where the pixels of 4x4 blocks go in a raster or twiddled picture.
+ *
+ * In a square tile of the twiddled order the bits of y and x alternate
+ * in the texel index, y in the even bits and x in the odd, and a texture
+ * that is not square is a row or column of such tiles. The index of a
+ * texel is then the sum of a part that depends only on x and a part that
+ * depends only on y, and the 16 texels of a 4x4 block that starts on a
+ * multiple of 4 come one after the other, 32 bytes in all.
+ */
+
+#include "common.h"
+#include "avcodec.h"
+#include "texblock.h"
+
+/* spreads the bits of v out to the even bits */
+static int twiddle_bits(int v)
+{
+    int i, bits = 0;
+
+    for (i = 0; v >> i; i++)
+        bits |= ((v >> i) & 1) << (2 * i);
+    return bits;
+}
+
+/* the power of 2 texture dimension that n pixels fit in */
+static int texture_dimension(int n)
+{
+    int d = 4;
+
+    while (d < n)
+        d <<= 1;
+    return d;
+}
+
+int ff_texblock_init(TexBlockContext *t, AVCodecContext *avctx)
+{
+    int width, height, size, min, x, y, i;
+
+    t->blocks_wide = (avctx->width + 3) / 4;
+    t->blocks_high = (avctx->height + 3) / 4;
+    t->twiddled = !!(avctx->flags & CODEC_FLAG_TWIDDLED);
+    t->block_x = av_malloc(t->blocks_wide * sizeof(int));
+    t->block_y = av_malloc(t->blocks_high * sizeof(int));
+    if (!t->block_x || !t->block_y)
+        return -1;
+
+    if (t->twiddled) {
+        width = texture_dimension(avctx->width);
+        height = texture_dimension(avctx->height);
+        min = FFMIN(width, height);
+        size = width * height * 2;
+        t->frame.data[0] = av_mallocz(size);
+        if (!t->frame.data[0])
+            return -1;
+        t->frame.linesize[0] = width * 2;
+
+        for (x = 0; x < t->blocks_wide; x++)
+            t->block_x[x] = (twiddle_bits((x * 4) & (min - 1)) << 1) +
+                (x * 4 / min) * min * min;
+        for (y = 0; y < t->blocks_high; y++)
+            t->block_y[y] = twiddle_bits((y * 4) & (min - 1)) +
+                (y * 4 / min) * min * min;
+        for (i = 0; i < 16; i++)
+            t->texel[i] = twiddle_bits(i >> 2) | (twiddle_bits(i & 3) << 1);
+    } else {
+        if (avctx->get_buffer(avctx, &t->frame) < 0) {
+            fprintf(stderr, "get_buffer() failed\n");
+            return -1;
+        }
+        width = t->frame.linesize[0] / 2;
+
+        for (x = 0; x < t->blocks_wide; x++)
+            t->block_x[x] = x * 4;
+        for (y = 0; y < t->blocks_high; y++)
+            t->block_y[y] = y * 4 * width;
+        for (i = 0; i < 16; i++)
+            t->texel[i] = (i >> 2) * width + (i & 3);
+    }
+
+    return 0;
+}
+
+void ff_texblock_end(TexBlockContext *t, AVCodecContext *avctx)
+{
+    if (t->twiddled)
+        av_freep(&t->frame.data[0]);
+    else if (t->frame.data[0])
+        avctx->release_buffer(avctx, &t->frame);
+    av_freep(&t->block_x);
+    av_freep(&t->block_y);
+}
@@ -0,0 +1,57 @@
+/*
+ *
+ * Copyright (C) 2003 the ffmpeg project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * @file texblock.h
+ * The picture of a decoder that draws 16-bit pixels a 4x4 block at a
+ * time, laid out either in raster order or, with CODEC_FLAG_TWIDDLED, in
+ * the twiddled order of a PVR texture.
+ */
+
+#ifndef TEXBLOCK_H
+#define TEXBLOCK_H
+
+#include "avcodec.h"
+
+typedef struct TexBlockContext {
+    AVFrame frame;
+    int twiddled;
+    int blocks_wide, blocks_high;
+    int *block_x;   ///< offset of the first pixel of each column of blocks
+    int *block_y;   ///< offset of the first pixel of each row of blocks
+    int texel[16];  ///< offset of each pixel of a block, in raster order
+} TexBlockContext;
+
+/**
+ * the first pixel of the block at column bx, row by; pixel i of the
+ * block, counted in raster order, is at TEXBLOCK(t, bx, by)[t->texel[i]]
+ */
+#define TEXBLOCK(t, bx, by) \
+    ((uint16_t *)(t)->frame.data[0] + (t)->block_x[bx] + (t)->block_y[by])
+
+/**
+ * sets up the picture for avctx->width x avctx->height pixels. A raster
+ * picture comes from avctx->get_buffer(); a twiddled one is allocated
+ * here, as big as the power of 2 texture the picture fits in, with
+ * linesize[0] the bytes in a row of that texture.
+ */
+int ff_texblock_init(TexBlockContext *t, AVCodecContext *avctx);
+void ff_texblock_end(TexBlockContext *t, AVCodecContext *avctx);
+
+#endif
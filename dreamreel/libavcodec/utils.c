@@ -152,6 +152,8 @@ int avcodec_default_get_buffer(AVCodecContext *s, AVFrame *pic){
         
         switch(s->pix_fmt){
         case PIX_FMT_YUV422:
+        case PIX_FMT_RGB565:
+        case PIX_FMT_RGB555:
             pixel_size=2;
             break;
         case PIX_FMT_RGB24: